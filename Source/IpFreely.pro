@@ -37,9 +37,15 @@ win32 {
     DEFINES += _CRT_SECURE_NO_WARNINGS=1
 
     INCLUDEPATH += $$(OPENCV_DIR)/../../include \
+        $$(FFMPEG_DIR)/include \
         $$(THIRD_PARTY_LIBS) \
         $$(THIRD_PARTY_LIBS)\singleapplication
 
+    LIBS += -L$$(FFMPEG_DIR)/lib \
+            -lavformat \
+            -lavcodec  \
+            -lavutil
+
     CONFIG(debug, debug|release) {
       LIBS += -L$$(OPENCV_DIR)/lib \
               -lopencv_world340d
@@ -82,7 +88,10 @@ else {
             -lopencv_imgproc   \
             -lopencv_video     \
             -lopencv_videoio \
-            -lopencv_highgui
+            -lopencv_highgui \
+            -lavformat \
+            -lavcodec  \
+            -lavutil
 
     SOURCES += \
         /mnt/Data/projects/ThirdParty/singleapplication/singleapplication.cpp
@@ -105,7 +114,27 @@ SOURCES += \
     IpFreelyStreamProcessor.cpp \
     IpFreelyMotionDetector.cpp \
     IpFreelyVideoFrame.cpp \
-    IpFreelyDiskSpaceManager.cpp
+    IpFreelyDiskSpaceManager.cpp \
+    IpFreelyFrameRing.cpp \
+    IpFreelyPacketStream.cpp \
+    IpFreelyPacketRecorder.cpp \
+    IpFreelyPacketSource.cpp \
+    IpFreelyPacketRelay.cpp \
+    IpFreelyVideoEncoder.cpp \
+    IpFreelyRecordingWriter.cpp \
+    IpFreelyFramePool.cpp \
+    IpFreelyWorkerPool.cpp \
+    IpFreelyMotionKernel.cpp \
+    IpFreelyLumaDecoder.cpp \
+    IpFreelyMotionEngine.cpp \
+    IpFreelyFrameDiffEngine.cpp \
+    IpFreelyBackgroundEngine.cpp \
+    IpFreelyMotionBlobs.cpp \
+    IpFreelyRecordingCatalog.cpp \
+    IpFreelyDeletionQueue.cpp \
+    IpFreelyWriteRateModel.cpp \
+    IpFreelyStorageUtils.cpp \
+    IpFreelyArchiveMigrator.cpp
 
 HEADERS += \
     IpFreelyMainWindow.h \
@@ -120,7 +149,30 @@ HEADERS += \
     IpFreelyStreamProcessor.h \
     IpFreelyMotionDetector.h \
     IpFreelyVideoFrame.h \
-    IpFreelyDiskSpaceManager.h
+    IpFreelyDiskSpaceManager.h \
+    IpFreelyFrameRing.h \
+    IpFreelyPacketStream.h \
+    IpFreelyPacketRecorder.h \
+    IpFreelyPacketSource.h \
+    IpFreelyPacketRelay.h \
+    IpFreelyVideoEncoder.h \
+    IpFreelyBoundedQueue.h \
+    IpFreelyRecordingWriter.h \
+    IpFreelyTripleBuffer.h \
+    IpFreelyFramePool.h \
+    IpFreelyWorkerPool.h \
+    IpFreelyMotionKernel.h \
+    IpFreelyLumaDecoder.h \
+    IpFreelyMotionEngine.h \
+    IpFreelyFrameDiffEngine.h \
+    IpFreelyBackgroundEngine.h \
+    IpFreelyMotionBlobs.h \
+    IpFreelyRecordingCatalog.h \
+    IpFreelyDeletionQueue.h \
+    IpFreelyWriteRateModel.h \
+    IpFreelyStorageUtils.h \
+    IpFreelyArchiveMigrator.h \
+    IpFreelyMotionPresets.h
 
 FORMS += \
     IpFreelyMainWindow.ui \
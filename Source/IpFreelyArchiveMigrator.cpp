@@ -0,0 +1,437 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyArchiveMigrator.cpp
+ * \brief File containing definition of IpFreelyArchiveMigrator class.
+ */
+#include "IpFreelyArchiveMigrator.h"
+#include <algorithm>
+#include <iterator>
+#include <limits>
+#include <ctime>
+#include <boost/exception/all.hpp>
+#include <boost/filesystem.hpp>
+#include "Threads/EventThread.h"
+#include "DebugLog/DebugLogging.h"
+#include "IpFreelyStorageUtils.h"
+
+namespace bfs = boost::filesystem;
+
+namespace ipfreely
+{
+
+static constexpr unsigned int   MIGRATION_THREAD_PERIOD_MS = 10;
+static constexpr int            SEARCH_PERIOD_SECS         = 10;
+static constexpr int            RETRY_DELAY_SECS           = 60;
+static constexpr int            MAX_RETRY_DELAY_SECS       = 24 * 3600;
+static constexpr size_t         CHUNK_BYTES                = 1024 * 1024;
+static constexpr double         BYTES_IN_MEBIBYTE          = 1024.0 * 1024.0;
+static constexpr char const*    PARTIAL_EXTENSION          = ".part";
+static constexpr eRecordingType RECORDING_TYPES[]          = {
+    eRecordingType::segment, eRecordingType::motionClip, eRecordingType::snapshot};
+
+IpFreelyArchiveMigrator::IpFreelyArchiveMigrator(
+    std::shared_ptr<IpFreelyRecordingCatalog> const& recordingCatalog,
+    int const archiveAfterHours, double const maxMebibytesPerSec)
+    : m_recordingCatalog(recordingCatalog)
+    , m_archiveAfterHours(archiveAfterHours)
+    , m_maxMebibytesPerSec(maxMebibytesPerSec)
+    , m_buffer(CHUNK_BYTES)
+{
+    if (!m_recordingCatalog || m_recordingCatalog->ArchiveFolderPath().empty())
+    {
+        BOOST_THROW_EXCEPTION(std::invalid_argument(
+            "Archive migrator requires a recording catalog with an archive folder."));
+    }
+
+    DEBUG_MESSAGE_EX_INFO("Creating archive migration thread, archive folder: "
+                          << m_recordingCatalog->ArchiveFolderPath() << ", archiving after "
+                          << m_archiveAfterHours << " hours, limit: " << m_maxMebibytesPerSec
+                          << " MiB/s");
+
+    m_migrationThread = std::make_shared<core_lib::threads::EventThread>(
+        std::bind(&IpFreelyArchiveMigrator::ThreadEventCallback, this),
+        MIGRATION_THREAD_PERIOD_MS);
+}
+
+IpFreelyArchiveMigrator::~IpFreelyArchiveMigrator()
+{
+    // Stop the thread then tidy up any half finished copy, the original is still in place.
+    m_migrationThread.reset();
+
+    if (m_stage != eStage::idle)
+    {
+        m_inFile.close();
+        m_outFile.close();
+
+        boost::system::error_code ec;
+        bfs::remove(m_archivePath + PARTIAL_EXTENSION, ec);
+    }
+}
+
+MigrationStatistics IpFreelyArchiveMigrator::Statistics() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_statistics;
+}
+
+void IpFreelyArchiveMigrator::ThreadEventCallback() noexcept
+{
+    try
+    {
+        if (!m_ioPrioritySet)
+        {
+            SetBackgroundIoPriority("archive migration");
+            m_ioPrioritySet = true;
+        }
+
+        auto const now = std::chrono::steady_clock::now();
+
+        if (now < m_nextChunkTime)
+        {
+            return;
+        }
+
+        size_t chunkBytes = 0;
+
+        switch (m_stage)
+        {
+        case eStage::idle:
+            if (now >= m_nextSearchTime)
+            {
+                StartMigration();
+            }
+
+            return;
+        case eStage::copying:
+            chunkBytes = CopyChunk();
+            break;
+        case eStage::verifying:
+            chunkBytes = VerifyChunk();
+            break;
+        }
+
+        // Space out the next chunk to keep within the budget.
+        if (m_maxMebibytesPerSec > 0.0)
+        {
+            auto const delaySecs =
+                static_cast<double>(chunkBytes) / (m_maxMebibytesPerSec * BYTES_IN_MEBIBYTE);
+
+            m_nextChunkTime =
+                now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                          std::chrono::duration<double>(delaySecs));
+        }
+    }
+    catch (...)
+    {
+        AbandonMigration(boost::current_exception_diagnostic_information());
+    }
+}
+
+bool IpFreelyArchiveMigrator::FindNextRecording(std::chrono::steady_clock::time_point const now)
+{
+    bool    found           = false;
+    int64_t oldestMillisecs = std::numeric_limits<int64_t>::max();
+
+    for (auto const type : RECORDING_TYPES)
+    {
+        // Enough of each type to get past every recording waiting to be tried again.
+        auto const oldest = m_recordingCatalog->OldestRecordings(
+            m_retries.size() + 1, eCamId::noCam, type, eStorageTier::local);
+
+        if (!oldest.empty())
+        {
+            oldestMillisecs = std::min(oldestMillisecs, oldest.front().startMillisecs);
+        }
+
+        for (auto const& entry : oldest)
+        {
+            auto retryIt = m_retries.find(entry.path);
+
+            if ((retryIt != m_retries.end()) && (now < retryIt->second.retryTime))
+            {
+                continue;
+            }
+
+            if (!found || (entry.startMillisecs < m_entry.startMillisecs))
+            {
+                m_entry = entry;
+                found   = true;
+            }
+
+            break;
+        }
+    }
+
+    // Recordings older than any left in the save folder have gone since they failed.
+    for (auto it = m_retries.begin(); it != m_retries.end();)
+    {
+        it = (it->second.startMillisecs < oldestMillisecs) ? m_retries.erase(it) : std::next(it);
+    }
+
+    return found;
+}
+
+void IpFreelyArchiveMigrator::StartMigration()
+{
+    auto const archiveFromMillisecs =
+        (static_cast<int64_t>(time(0)) - static_cast<int64_t>(m_archiveAfterHours) * 3600) * 1000;
+
+    // Look again in a while if there is nothing old enough, or nowhere to archive it to.
+    auto const now   = std::chrono::steady_clock::now();
+    m_nextSearchTime = now + std::chrono::seconds(SEARCH_PERIOD_SECS);
+
+    if (!FindNextRecording(now) || (m_entry.endMillisecs >= archiveFromMillisecs))
+    {
+        return;
+    }
+
+    m_sourcePath = m_recordingCatalog->FullPath(m_entry);
+
+    // Deleted from the save folder without going through the catalog, e.g. by hand.
+    if (!bfs::exists(m_sourcePath))
+    {
+        DEBUG_MESSAGE_EX_WARNING("Recording to archive no longer exists, removing it from catalog: "
+                                 << m_sourcePath);
+
+        m_recordingCatalog->RemoveRecording(m_entry.path);
+        m_retries.erase(m_entry.path);
+        m_nextSearchTime = std::chrono::steady_clock::time_point{};
+        return;
+    }
+
+    // The archive may be on a volume that is not mounted, so wait for it rather than create it.
+    auto const archiveMissing = !bfs::exists(m_recordingCatalog->ArchiveFolderPath());
+
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (archiveMissing && !m_statistics.archiveMissing)
+        {
+            DEBUG_MESSAGE_EX_WARNING("Archive folder not found, recordings will not be archived: "
+                                     << m_recordingCatalog->ArchiveFolderPath());
+        }
+
+        m_statistics.archiveMissing = archiveMissing;
+    }
+
+    if (archiveMissing)
+    {
+        return;
+    }
+
+    m_nextSearchTime = std::chrono::steady_clock::time_point{};
+
+    auto archiveEntry = m_entry;
+    archiveEntry.tier = eStorageTier::archive;
+    m_archivePath     = m_recordingCatalog->FullPath(archiveEntry);
+    m_sourceBytes     = 0;
+    m_archiveBytes    = 0;
+    m_sourceCrc.reset();
+    m_archiveCrc.reset();
+    m_stage = eStage::copying;
+
+    bfs::create_directories(bfs::path(m_archivePath).parent_path());
+
+    m_inFile.open(m_sourcePath, std::ios::binary);
+    m_outFile.open(m_archivePath + PARTIAL_EXTENSION, std::ios::binary | std::ios::trunc);
+
+    if (!m_inFile || !m_outFile)
+    {
+        AbandonMigration("Failed to open recording or its archive copy.");
+    }
+}
+
+size_t IpFreelyArchiveMigrator::CopyChunk()
+{
+    m_inFile.read(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+    auto const chunkBytes = static_cast<size_t>(m_inFile.gcount());
+
+    m_sourceCrc.process_bytes(m_buffer.data(), chunkBytes);
+    m_sourceBytes += chunkBytes;
+    m_outFile.write(m_buffer.data(), static_cast<std::streamsize>(chunkBytes));
+
+    if (!m_outFile || m_inFile.bad())
+    {
+        AbandonMigration("Failed to copy recording to the archive folder.");
+        return chunkBytes;
+    }
+
+    if (m_inFile.eof())
+    {
+        m_inFile.close();
+        m_outFile.close();
+
+        if (m_outFile.fail())
+        {
+            AbandonMigration("Failed to finish writing the archive copy.");
+            return chunkBytes;
+        }
+
+        // Read the copy back from the archive's storage, not the cache the writes went
+        // through, to check it against what was read from the disk.
+        auto const partialPath = m_archivePath + PARTIAL_EXTENSION;
+
+        if (!FlushFileToDisk(partialPath))
+        {
+            AbandonMigration("Failed to flush the archive copy to disk.");
+            return chunkBytes;
+        }
+
+        DropCachedFile(partialPath);
+
+        m_inFile.clear();
+        m_inFile.open(partialPath, std::ios::binary);
+
+        if (!m_inFile)
+        {
+            AbandonMigration("Failed to open the archive copy to verify it.");
+            return chunkBytes;
+        }
+
+        m_stage = eStage::verifying;
+    }
+
+    return chunkBytes;
+}
+
+size_t IpFreelyArchiveMigrator::VerifyChunk()
+{
+    m_inFile.read(m_buffer.data(), static_cast<std::streamsize>(m_buffer.size()));
+    auto const chunkBytes = static_cast<size_t>(m_inFile.gcount());
+
+    m_archiveCrc.process_bytes(m_buffer.data(), chunkBytes);
+    m_archiveBytes += chunkBytes;
+
+    if (m_inFile.bad())
+    {
+        AbandonMigration("Failed to read the archive copy to verify it.");
+    }
+    else if (m_inFile.eof())
+    {
+        m_inFile.close();
+        m_inFile.clear();
+
+        if ((m_archiveBytes != m_sourceBytes) ||
+            (m_archiveCrc.checksum() != m_sourceCrc.checksum()))
+        {
+            AbandonMigration("Archive copy does not match the recording.");
+        }
+        else
+        {
+            FinishMigration();
+        }
+    }
+
+    return chunkBytes;
+}
+
+void IpFreelyArchiveMigrator::FinishMigration()
+{
+    bfs::rename(m_archivePath + PARTIAL_EXTENSION, m_archivePath);
+
+    // A recording's event markers go with it, if it has any. They are only a small text file
+    // so are not verified.
+    if (bfs::exists(m_sourcePath + EVENT_MARKERS_EXTENSION))
+    {
+        boost::system::error_code ec;
+        bfs::remove(m_archivePath + EVENT_MARKERS_EXTENSION, ec);
+        bfs::copy_file(
+            m_sourcePath + EVENT_MARKERS_EXTENSION, m_archivePath + EVENT_MARKERS_EXTENSION, ec);
+
+        if (!ec)
+        {
+            FlushFileToDisk(m_archivePath + EVENT_MARKERS_EXTENSION);
+        }
+    }
+
+    m_stage = eStage::idle;
+    m_retries.erase(m_entry.path);
+
+    // The original is only deleted once the rename is sure to survive a crash.
+    if (!FlushFolderToDisk(bfs::path(m_archivePath).parent_path().string()))
+    {
+        boost::system::error_code ec;
+        bfs::remove(m_archivePath, ec);
+        bfs::remove(m_archivePath + EVENT_MARKERS_EXTENSION, ec);
+        AbandonMigration("Failed to flush the archive folder to disk.");
+        return;
+    }
+
+    // Deleted while it was being copied, so the copy must go too.
+    if (!m_recordingCatalog->MoveRecording(m_entry.path, eStorageTier::archive))
+    {
+        boost::system::error_code ec;
+        bfs::remove(m_archivePath, ec);
+        bfs::remove(m_archivePath + EVENT_MARKERS_EXTENSION, ec);
+        return;
+    }
+
+    boost::system::error_code ec;
+    bfs::remove(m_sourcePath, ec);
+
+    if (ec)
+    {
+        DEBUG_MESSAGE_EX_WARNING("Archived recording but failed to delete original: "
+                                 << m_sourcePath << ", error: " << ec.message());
+    }
+
+    bfs::remove(m_sourcePath + EVENT_MARKERS_EXTENSION, ec);
+    RemoveEmptyDayFolder(bfs::path(m_sourcePath).parent_path().string());
+
+    DEBUG_MESSAGE_EX_INFO("Successfully archived recording: " << m_archivePath);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_statistics.migratedFiles;
+    m_statistics.migratedBytes += m_entry.bytes;
+}
+
+void IpFreelyArchiveMigrator::AbandonMigration(std::string const& reason)
+{
+    DEBUG_MESSAGE_EX_ERROR("Failed to archive recording: " << m_sourcePath << ", " << reason);
+
+    m_inFile.close();
+    m_inFile.clear();
+    m_outFile.close();
+    m_outFile.clear();
+
+    boost::system::error_code ec;
+    bfs::remove(m_archivePath + PARTIAL_EXTENSION, ec);
+
+    // The original stays in the save folder. It is tried again later in case the archive was
+    // busy, waiting longer each time it fails, and in the meantime the next oldest is tried.
+    auto const now   = std::chrono::steady_clock::now();
+    auto&      retry = m_retries[m_entry.path];
+
+    retry.startMillisecs = m_entry.startMillisecs;
+    retry.delaySecs      = (retry.delaySecs == 0)
+                               ? RETRY_DELAY_SECS
+                               : std::min(2 * retry.delaySecs, MAX_RETRY_DELAY_SECS);
+    retry.retryTime      = now + std::chrono::seconds(retry.delaySecs);
+
+    m_stage          = eStage::idle;
+    m_nextSearchTime = now + std::chrono::seconds(SEARCH_PERIOD_SECS);
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ++m_statistics.failedFiles;
+}
+
+} // namespace ipfreely
@@ -0,0 +1,160 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyArchiveMigrator.h
+ * \brief File containing declaration of IpFreelyArchiveMigrator class.
+ */
+#ifndef IPFREELYARCHIVEMIGRATOR_H
+#define IPFREELYARCHIVEMIGRATOR_H
+
+#include <memory>
+#include <mutex>
+#include <map>
+#include <vector>
+#include <fstream>
+#include <chrono>
+#include <cstdint>
+#include <boost/crc.hpp>
+#include "IpFreelyRecordingCatalog.h"
+
+namespace core_lib
+{
+namespace threads
+{
+
+class EventThread;
+
+} // namespace threads
+} // namespace core_lib
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+/*! \brief Structure holding the archive migrator's progress. */
+struct MigrationStatistics final
+{
+    /*! \brief Number of recordings moved to the archive folder. */
+    uint64_t migratedFiles{0};
+
+    /*! \brief Total size of the recordings moved to the archive folder. */
+    uint64_t migratedBytes{0};
+
+    /*! \brief Number of recordings that failed to copy or verify and were left in place. */
+    uint64_t failedFiles{0};
+
+    /*! \brief Flag to show the archive folder could not be found, e.g. it is not mounted. */
+    bool archiveMissing{false};
+};
+
+/*!
+ * \brief Class defining a background migrator of aged recordings to the archive folder.
+ *
+ * Recordings that finished more than a number of hours ago are moved, oldest first, from the
+ * save folder to the same path in the catalog's archive folder, so live recordings are written
+ * to a fast local disk while older ones are kept on cheaper bulk storage.
+ *
+ * Each recording is copied to a temporary file in the archive folder a chunk at a time on a low
+ * priority thread, keeping within a MiB per second budget, flushed to stable storage, then read
+ * back past the cache and its CRC-32 checked against the original's. Only once it matches is the
+ * copy renamed into place, the rename flushed, the catalog updated and the original deleted, so
+ * a failed or interrupted move never loses a recording. A recording that fails to move is tried
+ * again after a delay that doubles each time, while the next oldest is moved in the meantime.
+ */
+class IpFreelyArchiveMigrator final
+{
+public:
+    /*!
+     * \brief IpFreelyArchiveMigrator constructor.
+     * \param[in] recordingCatalog - The catalog of the recordings, with an archive folder set.
+     * \param[in] archiveAfterHours - Hours after a recording finishes to archive it.
+     * \param[in] maxMebibytesPerSec - Most MiB to copy and verify each second, 0 for no limit.
+     */
+    IpFreelyArchiveMigrator(std::shared_ptr<IpFreelyRecordingCatalog> const& recordingCatalog,
+                            int const archiveAfterHours, double const maxMebibytesPerSec);
+
+    /*! \brief IpFreelyArchiveMigrator destructor. */
+    ~IpFreelyArchiveMigrator();
+
+    /*! \brief IpFreelyArchiveMigrator deleted copy constructor. */
+    IpFreelyArchiveMigrator(IpFreelyArchiveMigrator const&) = delete;
+
+    /*! \brief IpFreelyArchiveMigrator deleted copy assignment operator. */
+    IpFreelyArchiveMigrator& operator=(IpFreelyArchiveMigrator const&) = delete;
+
+    /*!
+     * \brief Statistics reports the migrator's progress.
+     * \return The statistics.
+     */
+    MigrationStatistics Statistics() const;
+
+private:
+    /*! \brief Enumeration of the stages of moving a recording. */
+    enum class eStage
+    {
+        idle,
+        copying,
+        verifying
+    };
+
+    /*! \brief Structure holding when to try again to archive a recording that failed. */
+    struct RetryState final
+    {
+        int64_t                               startMillisecs{0};
+        int                                   delaySecs{0};
+        std::chrono::steady_clock::time_point retryTime{};
+    };
+
+    void   ThreadEventCallback() noexcept;
+    bool   FindNextRecording(std::chrono::steady_clock::time_point const now);
+    void   StartMigration();
+    size_t CopyChunk();
+    size_t VerifyChunk();
+    void   FinishMigration();
+    void   AbandonMigration(std::string const& reason);
+
+private:
+    mutable std::mutex                              m_mutex{};
+    std::shared_ptr<IpFreelyRecordingCatalog>       m_recordingCatalog;
+    int                                             m_archiveAfterHours{24};
+    double                                          m_maxMebibytesPerSec{0.0};
+    MigrationStatistics                             m_statistics{};
+    eStage                                          m_stage{eStage::idle};
+    RecordingEntry                                  m_entry{};
+    std::string                                     m_sourcePath{};
+    std::string                                     m_archivePath{};
+    std::ifstream                                   m_inFile{};
+    std::ofstream                                   m_outFile{};
+    std::vector<char>                               m_buffer{};
+    boost::crc_32_type                              m_sourceCrc{};
+    boost::crc_32_type                              m_archiveCrc{};
+    uint64_t                                        m_sourceBytes{0};
+    uint64_t                                        m_archiveBytes{0};
+    bool                                            m_ioPrioritySet{false};
+    std::chrono::steady_clock::time_point           m_nextChunkTime{};
+    std::chrono::steady_clock::time_point           m_nextSearchTime{};
+    std::map<std::string, RetryState>               m_retries{};
+    std::shared_ptr<core_lib::threads::EventThread> m_migrationThread;
+};
+
+} // namespace ipfreely
+
+#endif // IPFREELYARCHIVEMIGRATOR_H
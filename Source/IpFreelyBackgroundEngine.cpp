@@ -0,0 +1,205 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyBackgroundEngine.cpp
+ * \brief File containing definition of IpFreelyBackgroundEngine class.
+ */
+#include "IpFreelyBackgroundEngine.h"
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/throw_exception.hpp>
+
+namespace ipfreely
+{
+
+static constexpr int    MAX_MODEL_HEIGHT   = 240;
+static constexpr double LEARNING_TIME_SECS = 10.0;
+static constexpr double INITIAL_VARIANCE   = 225.0;
+static constexpr double MIN_VARIANCE       = 4.0;
+static constexpr double SIGMA_FACTOR       = 3.0;
+static constexpr double MASK_MAX_VALUE     = 255.0;
+
+namespace utils
+{
+
+inline void SetNoMotion(cv::Size const& frameSize, MotionKernelResult& result)
+{
+    result.stdDev       = 0.0;
+    result.changesFound = false;
+    result.minX         = frameSize.width;
+    result.maxX         = 0;
+    result.minY         = frameSize.height;
+    result.maxY         = 0;
+}
+
+} // namespace utils
+
+IpFreelyBackgroundEngine::IpFreelyBackgroundEngine(double const pixelThreshold, double const fps,
+                                                   cv::Mat const& thresholdMap)
+    : IpFreelyMotionEngine("background model")
+    , m_pixelThreshold(pixelThreshold)
+    , m_learningRate(std::min(1.0 / (std::max(fps, 1.0) * LEARNING_TIME_SECS), 1.0))
+    , m_thresholdMap(thresholdMap)
+{
+}
+
+void IpFreelyBackgroundEngine::Reset()
+{
+    m_background.release();
+    m_variance.release();
+}
+
+void IpFreelyBackgroundEngine::UpdateModel(cv::Mat& greyFrame, MotionKernelResult* result,
+                                           cv::Mat* motionMask)
+{
+    if (greyFrame.empty() || (greyFrame.type() != CV_8UC1))
+    {
+        BOOST_THROW_EXCEPTION(std::invalid_argument("Background model needs 8-bit grey frames."));
+    }
+
+    if (m_background.empty() || (greyFrame.size() != m_frameSize))
+    {
+        InitialiseModel(greyFrame);
+
+        if (result)
+        {
+            utils::SetNoMotion(m_frameSize, *result);
+        }
+
+        return;
+    }
+
+    if (m_modelSize != m_frameSize)
+    {
+        cv::resize(greyFrame, m_scaledFrame, m_modelSize, 0, 0, cv::INTER_AREA);
+        m_scaledFrame.convertTo(m_floatFrame, CV_32F);
+    }
+    else
+    {
+        greyFrame.convertTo(m_floatFrame, CV_32F);
+    }
+
+    cv::absdiff(m_floatFrame, m_background, m_difference);
+    cv::multiply(m_difference, m_difference, m_sqDifference);
+
+    if (result)
+    {
+        FindMotion(greyFrame.size(), *result, motionMask);
+    }
+
+    // Learn the frame into the background, including any moving objects,
+    // so objects that stop moving are eventually treated as background.
+    cv::accumulateWeighted(m_floatFrame, m_background, m_learningRate);
+    cv::accumulateWeighted(m_sqDifference, m_variance, m_learningRate);
+    cv::max(m_variance, MIN_VARIANCE, m_variance);
+}
+
+void IpFreelyBackgroundEngine::InitialiseModel(cv::Mat const& greyFrame)
+{
+    // The model is at most MAX_MODEL_HEIGHT rows high, which is plenty for
+    // finding the extents of motion and keeps the floating point work small.
+    double const scale =
+        std::min(1.0, static_cast<double>(MAX_MODEL_HEIGHT) / static_cast<double>(greyFrame.rows));
+
+    m_frameSize = greyFrame.size();
+    m_modelSize = cv::Size(std::max(1, cvRound(static_cast<double>(greyFrame.cols) * scale)),
+                           std::max(1, cvRound(static_cast<double>(greyFrame.rows) * scale)));
+
+    if (m_modelSize != m_frameSize)
+    {
+        cv::resize(greyFrame, m_scaledFrame, m_modelSize, 0, 0, cv::INTER_AREA);
+        m_scaledFrame.convertTo(m_background, CV_32F);
+    }
+    else
+    {
+        greyFrame.convertTo(m_background, CV_32F);
+    }
+
+    m_variance = cv::Mat(m_modelSize, CV_32FC1, cv::Scalar(INITIAL_VARIANCE));
+
+    if (m_thresholdMap.empty())
+    {
+        return;
+    }
+
+    if ((m_thresholdMap.size() != m_frameSize) || (m_thresholdMap.type() != CV_8UC1))
+    {
+        BOOST_THROW_EXCEPTION(std::invalid_argument(
+            "Background model needs an 8-bit threshold map the frames' size."));
+    }
+
+    // Nearest neighbour keeps each region's own threshold right up to its edges.
+    cv::Mat scaledThresholdMap;
+    cv::resize(m_thresholdMap, scaledThresholdMap, m_modelSize, 0, 0, cv::INTER_NEAREST);
+    scaledThresholdMap.convertTo(m_modelThresholdMap, CV_32F);
+}
+
+void IpFreelyBackgroundEngine::FindMotion(cv::Size const& frameSize, MotionKernelResult& result,
+                                          cv::Mat* motionMask)
+{
+    // A pixel is moving if its difference from the background is above the
+    // threshold and more than SIGMA_FACTOR standard deviations.
+    m_variance.convertTo(m_varianceThreshold, CV_32F, SIGMA_FACTOR * SIGMA_FACTOR);
+
+    if (m_modelThresholdMap.empty())
+    {
+        cv::compare(m_difference, m_pixelThreshold, m_thresholdMask, cv::CMP_GT);
+    }
+    else
+    {
+        cv::compare(m_difference, m_modelThresholdMap, m_thresholdMask, cv::CMP_GT);
+    }
+
+    cv::compare(m_sqDifference, m_varianceThreshold, m_varianceMask, cv::CMP_GT);
+    cv::bitwise_and(m_thresholdMask, m_varianceMask, m_motionMask);
+    cv::erode(m_motionMask, m_motionMask, cv::Mat());
+
+    if (motionMask)
+    {
+        cv::resize(m_motionMask, *motionMask, frameSize, 0, 0, cv::INTER_NEAREST);
+    }
+
+    auto const changedPixels = cv::countNonZero(m_motionMask);
+
+    if (changedPixels == 0)
+    {
+        utils::SetNoMotion(frameSize, result);
+        return;
+    }
+
+    // The same as cv::meanStdDev gives for the mask's pixel values.
+    double const changedFraction =
+        static_cast<double>(changedPixels) / static_cast<double>(m_motionMask.total());
+
+    result.stdDev       = MASK_MAX_VALUE * std::sqrt(changedFraction * (1.0 - changedFraction));
+    result.changesFound = true;
+
+    // Scale the extents of the motion from the model up to the frame.
+    auto const bounds = cv::boundingRect(m_motionMask);
+
+    result.minX = bounds.x * frameSize.width / m_modelSize.width;
+    result.maxX = bounds.br().x * frameSize.width / m_modelSize.width - 1;
+    result.minY = bounds.y * frameSize.height / m_modelSize.height;
+    result.maxY = bounds.br().y * frameSize.height / m_modelSize.height - 1;
+}
+
+} // namespace ipfreely
@@ -0,0 +1,100 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyBackgroundEngine.h
+ * \brief File containing declaration of IpFreelyBackgroundEngine class.
+ */
+#ifndef IPFREELYBACKGROUNDENGINE_H
+#define IPFREELYBACKGROUNDENGINE_H
+
+#include "IpFreelyMotionEngine.h"
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+/*!
+ * \brief Class defining a background model motion engine.
+ *
+ * The engine models each pixel of the background as a single Gaussian, like one mode of MOG2,
+ * with a running average of its value and of its variance. Both are updated incrementally from
+ * every frame, downscaled so the model is small. A pixel is moving if it differs from the
+ * background's average by more than both the pixel threshold and a multiple of its standard
+ * deviation, so naturally noisy areas such as foliage need larger changes to count as motion.
+ *
+ * Unlike frame differencing, objects are found for as long as they differ from the background,
+ * not just while they're moving, until they're slowly learnt into the background.
+ */
+class IpFreelyBackgroundEngine final : public IpFreelyMotionEngine
+{
+public:
+    /*!
+     * \brief IpFreelyBackgroundEngine constructor.
+     * \param[in] pixelThreshold - Differences from the background at or below this are ignored.
+     * \param[in] fps - The video's FPS, used to set how quickly the background is learnt.
+     * \param[in] thresholdMap - (Optional) 8-bit threshold for each pixel of the grey frames, used
+     * instead of pixelThreshold if not empty.
+     */
+    IpFreelyBackgroundEngine(double const pixelThreshold, double const fps,
+                             cv::Mat const& thresholdMap = cv::Mat());
+
+    /*! \brief IpFreelyBackgroundEngine destructor. */
+    ~IpFreelyBackgroundEngine() override = default;
+
+    /*! \brief Reset discards the background model, which is relearnt from the next frame. */
+    void Reset() override;
+
+protected:
+    /*!
+     * \brief UpdateModel compares the grey frame with the background then learns it.
+     * \param[in,out] greyFrame - The next 8-bit grey frame, left unchanged.
+     * \param[out] result - If not null, the motion found in the frame.
+     * \param[out] motionMask - If not null, the motion mask scaled to the grey frame's size.
+     */
+    void UpdateModel(cv::Mat& greyFrame, MotionKernelResult* result,
+                     cv::Mat* motionMask) override;
+
+private:
+    void InitialiseModel(cv::Mat const& greyFrame);
+    void FindMotion(cv::Size const& frameSize, MotionKernelResult& result, cv::Mat* motionMask);
+
+private:
+    double   m_pixelThreshold{0.0};
+    double   m_learningRate{0.0};
+    cv::Mat  m_thresholdMap{};
+    cv::Mat  m_modelThresholdMap{};
+    cv::Size m_frameSize{};
+    cv::Size m_modelSize{};
+    cv::Mat  m_scaledFrame{};
+    cv::Mat  m_floatFrame{};
+    cv::Mat  m_background{};
+    cv::Mat  m_variance{};
+    cv::Mat  m_difference{};
+    cv::Mat  m_sqDifference{};
+    cv::Mat  m_varianceThreshold{};
+    cv::Mat  m_thresholdMask{};
+    cv::Mat  m_varianceMask{};
+    cv::Mat  m_motionMask{};
+};
+
+} // namespace ipfreely
+
+#endif // IPFREELYBACKGROUNDENGINE_H
@@ -0,0 +1,186 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyBoundedQueue.h
+ * \brief File containing declaration of IpFreelyBoundedQueue template class.
+ */
+#ifndef IPFREELYBOUNDEDQUEUE_H
+#define IPFREELYBOUNDEDQUEUE_H
+
+#include <deque>
+#include <mutex>
+#include <chrono>
+#include <utility>
+#include <condition_variable>
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+/*!
+ * \brief Template class defining a thread-safe bounded FIFO queue.
+ *
+ * Producers use TryPush so that a slow consumer never blocks them, the caller decides what to do
+ * with items that don't fit. PushDropOldest instead makes room by dropping the oldest items, for
+ * producers that always prefer newer items. Push ignores the capacity and is intended for the
+ * occasional item that must not be lost.
+ */
+template <typename T> class IpFreelyBoundedQueue final
+{
+public:
+    /*!
+     * \brief IpFreelyBoundedQueue constructor.
+     * \param[in] capacity - The maximum number of items TryPush will queue.
+     */
+    explicit IpFreelyBoundedQueue(size_t const capacity)
+        : m_capacity(capacity)
+    {
+    }
+
+    /*! \brief IpFreelyBoundedQueue destructor. */
+    ~IpFreelyBoundedQueue() = default;
+
+    /*! \brief IpFreelyBoundedQueue deleted copy constructor. */
+    IpFreelyBoundedQueue(IpFreelyBoundedQueue const&) = delete;
+
+    /*! \brief IpFreelyBoundedQueue deleted copy assignment operator. */
+    IpFreelyBoundedQueue& operator=(IpFreelyBoundedQueue const&) = delete;
+
+    /*!
+     * \brief TryPush adds an item to the back of the queue if there is room.
+     * \param[in] item - The item to add.
+     * \return True if the item was queued, false if the queue was full.
+     */
+    bool TryPush(T item)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (m_items.size() >= m_capacity)
+            {
+                return false;
+            }
+
+            m_items.push_back(std::move(item));
+        }
+
+        m_itemAvailable.notify_one();
+        return true;
+    }
+
+    /*!
+     * \brief PushDropOldest adds an item to the back of the queue, dropping items from the front
+     * of the queue if it is full.
+     * \param[in] item - The item to add.
+     * \return The number of items dropped.
+     */
+    size_t PushDropOldest(T item)
+    {
+        size_t dropped = 0;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            while (!m_items.empty() && (m_items.size() >= m_capacity))
+            {
+                m_items.pop_front();
+                ++dropped;
+            }
+
+            m_items.push_back(std::move(item));
+        }
+
+        m_itemAvailable.notify_one();
+        return dropped;
+    }
+
+    /*!
+     * \brief Push adds an item to the back of the queue even if it is full.
+     * \param[in] item - The item to add.
+     */
+    void Push(T item)
+    {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_items.push_back(std::move(item));
+        }
+
+        m_itemAvailable.notify_one();
+    }
+
+    /*!
+     * \brief Pop removes the item at the front of the queue.
+     * \param[out] item - The removed item.
+     * \param[in] timeoutMillisecs - How long to wait for an item if the queue is empty.
+     * \return True if an item was removed, false if the wait timed out.
+     */
+    bool Pop(T& item, unsigned int const timeoutMillisecs)
+    {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        if (!m_itemAvailable.wait_for(lock,
+                                      std::chrono::milliseconds(timeoutMillisecs),
+                                      [this]() { return !m_items.empty(); }))
+        {
+            return false;
+        }
+
+        item = std::move(m_items.front());
+        m_items.pop_front();
+        return true;
+    }
+
+    /*! \brief Clear removes all items from the queue. */
+    void Clear()
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_items.clear();
+    }
+
+    /*!
+     * \brief Size reports the number of items queued.
+     * \return The number of items.
+     */
+    size_t Size() const
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return m_items.size();
+    }
+
+    /*!
+     * \brief Capacity reports the maximum number of items TryPush will queue.
+     * \return The capacity.
+     */
+    size_t Capacity() const noexcept
+    {
+        return m_capacity;
+    }
+
+private:
+    mutable std::mutex      m_mutex{};
+    std::condition_variable m_itemAvailable{};
+    size_t                  m_capacity{0};
+    std::deque<T>           m_items{};
+};
+
+} // namespace ipfreely
+
+#endif // IPFREELYBOUNDEDQUEUE_H
@@ -57,7 +57,29 @@ enum class eMotionDetectorMode
     lowSensitivity,
     mediumSensitivity,
     highSensitivity,
-    manual
+    manual,
+    motionVectors
+};
+
+/*! \brief Recording mode. */
+enum class eRecordingMode
+{
+    reencode,
+    passthrough
+};
+
+/*! \brief Motion detector queue policy, used when the motion detector falls behind. */
+enum class eMotionQueuePolicy
+{
+    dropOldest,
+    latestOnly
+};
+
+/*! \brief Motion detection engine, used to find motion in grey frames. */
+enum class eMotionEngine
+{
+    frameDifferencing,
+    backgroundModel
 };
 
 /*! \brief Minimum allowed recording FPS. */
@@ -66,6 +88,18 @@ static constexpr double MIN_FPS = 1.0;
 /*! \brief Maximum allowed recording FPS. */
 static constexpr double MAX_FPS = 60.0;
 
+/*! \brief Maximum allowed motion recording pre-roll in seconds. */
+static constexpr double MAX_PRE_ROLL_SECS = 30.0;
+
+/*! \brief Maximum memory, in bytes, a camera's motion recording pre-roll may hold. */
+static constexpr size_t MAX_PRE_ROLL_BYTES = 256 * 1024 * 1024;
+
+/*! \brief Default motion recording post-roll in seconds. */
+static constexpr double DEFAULT_POST_ROLL_SECS = 10.0;
+
+/*! \brief Default magnitude, in video pixels, at or below which motion vectors are ignored. */
+static constexpr double DEFAULT_MOTION_VECTOR_THRESHOLD = 2.0;
+
 /*! \brief Camera's details structure. */
 struct IpCamera final
 {
@@ -126,6 +160,45 @@ struct IpCamera final
     /*! \brief Enabled scheduled motion recording mode. */
     bool enabledMotionRecording{false};
 
+    /*! \brief Read the camera's stream on a dedicated capture thread into a bounded frame ring. */
+    bool enableCaptureThread{true};
+
+    /*! \brief Re-encode decoded frames or copy the camera's compressed stream to disk. */
+    eRecordingMode recordingMode{eRecordingMode::reencode};
+
+    /*! \brief Seconds of video before motion was detected to include in a motion recording. */
+    double motionPreRollSecs{0.0};
+
+    /*! \brief Seconds without motion before a motion recording is stopped. */
+    double motionPostRollSecs{DEFAULT_POST_ROLL_SECS};
+
+    /*! \brief How the motion detector's bounded frame queue drops frames when it falls behind. */
+    eMotionQueuePolicy motionQueuePolicy{eMotionQueuePolicy::dropOldest};
+
+    /*! \brief Motion vectors at or below this magnitude, in video pixels, are ignored. */
+    double motionVectorThreshold{DEFAULT_MOTION_VECTOR_THRESHOLD};
+
+    /*! \brief Confirm motion found from motion vectors by differencing grey frames. */
+    bool confirmMotionVectors{false};
+
+    /*! \brief Engine the motion detector uses to find motion in grey frames. */
+    eMotionEngine motionEngine{eMotionEngine::frameDifferencing};
+
+    /*! \brief Pixel threshold for each motion region, missing or 0 uses pixelThreshold. */
+    std::vector<double> motionRegionThresholds{};
+
+    /*! \brief Rate frames are sampled for motion detection, 0 analyses every recorded frame. */
+    double motionAnalysisFps{0.0};
+
+    /*! \brief Most disk space the camera's recordings may use, in GiB, 0 for no limit. */
+    double maxStorageGiB{0.0};
+
+    /*! \brief Days of continuous recordings to keep, 0 uses the preferences' setting. */
+    int maxNumDaysData{0};
+
+    /*! \brief Days of motion clips and snapshots to keep, at least as many as maxNumDaysData. */
+    int maxNumDaysMotionData{0};
+
     /*! \brief IpCamera's default constructor. */
     IpCamera() = default;
 
@@ -248,6 +321,67 @@ struct IpCamera final
             ar(CEREAL_NVP(temp));
             enabledMotionRecording = temp == 1;
         }
+
+        if (version > 7)
+        {
+            // Added with version 8.
+            temp = enableCaptureThread ? 1 : 0;
+            ar(CEREAL_NVP(temp));
+            enableCaptureThread = temp == 1;
+        }
+
+        if (version > 8)
+        {
+            // Added with version 9.
+            ar(CEREAL_NVP(recordingMode));
+        }
+
+        if (version > 9)
+        {
+            // Added with version 10.
+            ar(CEREAL_NVP(motionPreRollSecs), CEREAL_NVP(motionPostRollSecs));
+        }
+
+        if (version > 10)
+        {
+            // Added with version 11.
+            ar(CEREAL_NVP(motionQueuePolicy));
+        }
+
+        if (version > 11)
+        {
+            // Added with version 12.
+            ar(CEREAL_NVP(motionVectorThreshold));
+            temp = confirmMotionVectors ? 1 : 0;
+            ar(CEREAL_NVP(temp));
+            confirmMotionVectors = temp == 1;
+        }
+
+        if (version > 12)
+        {
+            // Added with version 13.
+            ar(CEREAL_NVP(motionEngine));
+        }
+
+        if (version > 13)
+        {
+            // Added with version 14.
+            ar(CEREAL_NVP(motionRegionThresholds));
+        }
+
+        if (version > 14)
+        {
+            // Added with version 15.
+            ar(CEREAL_NVP(motionAnalysisFps));
+        }
+
+        if (version > 15)
+        {
+            // Added with version 16.
+            ar(CEREAL_NVP(maxStorageGiB),
+               CEREAL_NVP(maxNumDaysData),
+               CEREAL_NVP(maxNumDaysMotionData));
+        }
     }
 };
 
@@ -359,7 +493,7 @@ QRect CreateQRectFromVideoFrameDims(int const videoFrameWidth, int const videoFr
 
 } // namespace ipfreely
 
-CEREAL_CLASS_VERSION(ipfreely::IpCamera, 7);
+CEREAL_CLASS_VERSION(ipfreely::IpCamera, 16);
 CEREAL_CLASS_VERSION(ipfreely::IpFreelyCameraDatabase, 1);
 
 #endif // IPFREELYCAMERADATABASE_H
@@ -25,18 +25,41 @@
 #include "IpFreelyCameraSetupDialog.h"
 #include "ui_IpFreelyCameraSetupDialog.h"
 #include <QScreen>
+#include <QStringList>
 #include "IpFreelyCameraDatabase.h"
+#include "IpFreelyMotionPresets.h"
 
-static constexpr double LOW_SENSITIVITY_DIFF_THRESHOLD    = 75.0;
-static constexpr double MEDIUM_SENSITIVITY_DIFF_THRESHOLD = 50.0;
-static constexpr double HIGH_SENSITIVITY_DIFF_THRESHOLD   = 35.0;
-static constexpr double LOW_SENSITIVITY_STDDEV            = 10.0;
-static constexpr double MEDIUM_SENSITIVITY_STDDEV         = 20.0;
-static constexpr double HIGH_SENSITIVITY_STDDEV           = 40.0;
-static constexpr double LOW_SENSITIVITY_AREA_PERCENT      = 0.05;
-static constexpr double MEDIUM_SENSITIVITY_AREA_PERCENT   = 0.025;
-static constexpr double HIGH_SENSITIVITY_AREA_PERCENT     = 0.01;
-static constexpr double BOUNDING_RECT_SMOOTHING_FACTOR    = 0.1;
+static std::vector<double> ParseRegionThresholds(QString const& text)
+{
+    std::vector<double> thresholds;
+
+    if (text.trimmed().isEmpty())
+    {
+        return thresholds;
+    }
+
+    // Blank or invalid entries use the camera's pixel threshold.
+    for (auto const& entry : text.split(','))
+    {
+        bool ok        = false;
+        auto threshold = entry.trimmed().toDouble(&ok);
+        thresholds.push_back(ok && (threshold > 0.0) ? threshold : 0.0);
+    }
+
+    return thresholds;
+}
+
+static QString FormatRegionThresholds(std::vector<double> const& thresholds)
+{
+    QStringList entries;
+
+    for (auto threshold : thresholds)
+    {
+        entries << (threshold > 0.0 ? QString::number(threshold) : QString());
+    }
+
+    return entries.join(", ");
+}
 
 IpFreelyCameraSetupDialog::IpFreelyCameraSetupDialog(ipfreely::IpCamera& camera, QWidget* parent)
     : QDialog(parent)
@@ -75,6 +98,13 @@ void IpFreelyCameraSetupDialog::on_buttonBox_accepted()
     m_camera.description              = ui->descriptionLineEdit->text().toStdString();
     m_camera.cameraMaxFps             = ui->cameraFpsDoubleSpinBox->value();
     m_camera.enableScheduledRecording = ui->scheduledRecordingCheckBox->checkState() == Qt::Checked;
+    m_camera.enableCaptureThread      = ui->captureThreadCheckBox->checkState() == Qt::Checked;
+    m_camera.recordingMode            = ui->recordingModeComboBox->currentIndex() == 1
+                                 ? ipfreely::eRecordingMode::passthrough
+                                 : ipfreely::eRecordingMode::reencode;
+    m_camera.maxStorageGiB        = ui->maxStorageDoubleSpinBox->value();
+    m_camera.maxNumDaysData       = ui->maxNumDaysDataSpinBox->value();
+    m_camera.maxNumDaysMotionData = ui->maxNumDaysMotionDataSpinBox->value();
 
     switch (ui->motionDetectModeComboBox->currentIndex())
     {
@@ -90,6 +120,9 @@ void IpFreelyCameraSetupDialog::on_buttonBox_accepted()
     case 4:
         m_camera.motionDectorMode = ipfreely::eMotionDetectorMode::manual;
         break;
+    case 5:
+        m_camera.motionDectorMode = ipfreely::eMotionDetectorMode::motionVectors;
+        break;
     case 0:
     default:
         m_camera.motionDectorMode = ipfreely::eMotionDetectorMode::off;
@@ -100,9 +133,23 @@ void IpFreelyCameraSetupDialog::on_buttonBox_accepted()
     m_camera.maxMotionStdDev            = ui->maxStdDevDoubleSpinBox->value();
     m_camera.minMotionAreaPercentFactor = ui->minMotionAreaPercentDoubleSpinBox->value() / 100.0;
     m_camera.motionAreaAveFactor        = ui->motionAreaAveFactorDoubleSpinBox->value();
+    m_camera.motionVectorThreshold      = ui->motionVectorThresholdDoubleSpinBox->value();
+    m_camera.confirmMotionVectors =
+        ui->confirmMotionVectorsCheckBox->checkState() == Qt::Checked;
     m_camera.shrinkVideoFrames          = ui->shrinkFramesCheckBox->checkState() == Qt::Checked;
+    m_camera.motionQueuePolicy          = ui->motionQueuePolicyComboBox->currentIndex() == 1
+                                     ? ipfreely::eMotionQueuePolicy::latestOnly
+                                     : ipfreely::eMotionQueuePolicy::dropOldest;
+    m_camera.motionEngine = ui->motionEngineComboBox->currentIndex() == 1
+                                ? ipfreely::eMotionEngine::backgroundModel
+                                : ipfreely::eMotionEngine::frameDifferencing;
+    m_camera.motionRegionThresholds =
+        ParseRegionThresholds(ui->motionRegionThresholdsLineEdit->text());
+    m_camera.motionAnalysisFps = ui->motionAnalysisFpsDoubleSpinBox->value();
     m_camera.enabledMotionRecording =
         ui->enableMotionRecordingCheckBox->checkState() == Qt::Checked;
+    m_camera.motionPreRollSecs  = ui->motionPreRollDoubleSpinBox->value();
+    m_camera.motionPostRollSecs = ui->motionPostRollDoubleSpinBox->value();
 
     accept();
 }
@@ -127,33 +174,40 @@ void IpFreelyCameraSetupDialog::on_revertChangesPushButton_clicked()
 
 void IpFreelyCameraSetupDialog::on_motionDetectModeComboBox_currentIndexChanged(int index)
 {
-    ui->motionDetectSettingsGroupBox->setEnabled(index == 4);
+    ui->motionDetectSettingsGroupBox->setEnabled((index == 4) || (index == 5));
+    ui->motionVectorThresholdDoubleSpinBox->setEnabled(index == 5);
+    ui->confirmMotionVectorsCheckBox->setEnabled(index == 5);
 
     switch (index)
     {
     case 1:
-        ui->maxStdDevDoubleSpinBox->setValue(LOW_SENSITIVITY_STDDEV);
-        ui->minMotionAreaPercentDoubleSpinBox->setValue(LOW_SENSITIVITY_AREA_PERCENT * 100.0);
-        ui->pixelLevelThresholdDoubleSpinBox->setValue(LOW_SENSITIVITY_DIFF_THRESHOLD);
-        ui->motionAreaAveFactorDoubleSpinBox->setValue(BOUNDING_RECT_SMOOTHING_FACTOR);
+        ui->maxStdDevDoubleSpinBox->setValue(ipfreely::LOW_SENSITIVITY_STDDEV);
+        ui->minMotionAreaPercentDoubleSpinBox->setValue(
+            ipfreely::LOW_SENSITIVITY_AREA_PERCENT * 100.0);
+        ui->pixelLevelThresholdDoubleSpinBox->setValue(ipfreely::LOW_SENSITIVITY_DIFF_THRESHOLD);
+        ui->motionAreaAveFactorDoubleSpinBox->setValue(ipfreely::BOUNDING_RECT_SMOOTHING_FACTOR);
         break;
     case 2:
-        ui->maxStdDevDoubleSpinBox->setValue(MEDIUM_SENSITIVITY_STDDEV);
-        ui->minMotionAreaPercentDoubleSpinBox->setValue(MEDIUM_SENSITIVITY_AREA_PERCENT * 100.0);
-        ui->pixelLevelThresholdDoubleSpinBox->setValue(MEDIUM_SENSITIVITY_DIFF_THRESHOLD);
-        ui->motionAreaAveFactorDoubleSpinBox->setValue(BOUNDING_RECT_SMOOTHING_FACTOR);
+        ui->maxStdDevDoubleSpinBox->setValue(ipfreely::MEDIUM_SENSITIVITY_STDDEV);
+        ui->minMotionAreaPercentDoubleSpinBox->setValue(
+            ipfreely::MEDIUM_SENSITIVITY_AREA_PERCENT * 100.0);
+        ui->pixelLevelThresholdDoubleSpinBox->setValue(ipfreely::MEDIUM_SENSITIVITY_DIFF_THRESHOLD);
+        ui->motionAreaAveFactorDoubleSpinBox->setValue(ipfreely::BOUNDING_RECT_SMOOTHING_FACTOR);
         break;
     case 3:
-        ui->maxStdDevDoubleSpinBox->setValue(HIGH_SENSITIVITY_STDDEV);
-        ui->minMotionAreaPercentDoubleSpinBox->setValue(HIGH_SENSITIVITY_AREA_PERCENT * 100.0);
-        ui->pixelLevelThresholdDoubleSpinBox->setValue(HIGH_SENSITIVITY_DIFF_THRESHOLD);
-        ui->motionAreaAveFactorDoubleSpinBox->setValue(BOUNDING_RECT_SMOOTHING_FACTOR);
+        ui->maxStdDevDoubleSpinBox->setValue(ipfreely::HIGH_SENSITIVITY_STDDEV);
+        ui->minMotionAreaPercentDoubleSpinBox->setValue(
+            ipfreely::HIGH_SENSITIVITY_AREA_PERCENT * 100.0);
+        ui->pixelLevelThresholdDoubleSpinBox->setValue(ipfreely::HIGH_SENSITIVITY_DIFF_THRESHOLD);
+        ui->motionAreaAveFactorDoubleSpinBox->setValue(ipfreely::BOUNDING_RECT_SMOOTHING_FACTOR);
         break;
     case 4:
-        ui->maxStdDevDoubleSpinBox->setValue(MEDIUM_SENSITIVITY_STDDEV);
-        ui->minMotionAreaPercentDoubleSpinBox->setValue(MEDIUM_SENSITIVITY_AREA_PERCENT * 100.0);
-        ui->pixelLevelThresholdDoubleSpinBox->setValue(MEDIUM_SENSITIVITY_DIFF_THRESHOLD);
-        ui->motionAreaAveFactorDoubleSpinBox->setValue(BOUNDING_RECT_SMOOTHING_FACTOR);
+    case 5:
+        ui->maxStdDevDoubleSpinBox->setValue(ipfreely::MEDIUM_SENSITIVITY_STDDEV);
+        ui->minMotionAreaPercentDoubleSpinBox->setValue(
+            ipfreely::MEDIUM_SENSITIVITY_AREA_PERCENT * 100.0);
+        ui->pixelLevelThresholdDoubleSpinBox->setValue(ipfreely::MEDIUM_SENSITIVITY_DIFF_THRESHOLD);
+        ui->motionAreaAveFactorDoubleSpinBox->setValue(ipfreely::BOUNDING_RECT_SMOOTHING_FACTOR);
         break;
     case 0:
     default:
@@ -226,6 +280,13 @@ void IpFreelyCameraSetupDialog::InitialiseCameraSettings(ipfreely::IpCamera cons
     ui->cameraFpsDoubleSpinBox->setValue(camera.cameraMaxFps);
     ui->scheduledRecordingCheckBox->setCheckState(camera.enableScheduledRecording ? Qt::Checked
                                                                                   : Qt::Unchecked);
+    ui->captureThreadCheckBox->setCheckState(camera.enableCaptureThread ? Qt::Checked
+                                                                        : Qt::Unchecked);
+    ui->recordingModeComboBox->setCurrentIndex(
+        camera.recordingMode == ipfreely::eRecordingMode::passthrough ? 1 : 0);
+    ui->maxStorageDoubleSpinBox->setValue(camera.maxStorageGiB);
+    ui->maxNumDaysDataSpinBox->setValue(camera.maxNumDaysData);
+    ui->maxNumDaysMotionDataSpinBox->setValue(camera.maxNumDaysMotionData);
     switch (m_camera.motionDectorMode)
     {
     case ipfreely::eMotionDetectorMode::off:
@@ -243,13 +304,28 @@ void IpFreelyCameraSetupDialog::InitialiseCameraSettings(ipfreely::IpCamera cons
     case ipfreely::eMotionDetectorMode::manual:
         ui->motionDetectModeComboBox->setCurrentIndex(4);
         break;
+    case ipfreely::eMotionDetectorMode::motionVectors:
+        ui->motionDetectModeComboBox->setCurrentIndex(5);
+        break;
     }
 
     ui->pixelLevelThresholdDoubleSpinBox->setValue(camera.pixelThreshold);
     ui->maxStdDevDoubleSpinBox->setValue(camera.maxMotionStdDev);
     ui->minMotionAreaPercentDoubleSpinBox->setValue(camera.minMotionAreaPercentFactor * 100.0);
     ui->motionAreaAveFactorDoubleSpinBox->setValue(camera.motionAreaAveFactor);
+    ui->motionVectorThresholdDoubleSpinBox->setValue(camera.motionVectorThreshold);
+    ui->confirmMotionVectorsCheckBox->setCheckState(camera.confirmMotionVectors ? Qt::Checked
+                                                                                : Qt::Unchecked);
     ui->shrinkFramesCheckBox->setCheckState(camera.shrinkVideoFrames ? Qt::Checked : Qt::Unchecked);
+    ui->motionQueuePolicyComboBox->setCurrentIndex(
+        camera.motionQueuePolicy == ipfreely::eMotionQueuePolicy::latestOnly ? 1 : 0);
+    ui->motionEngineComboBox->setCurrentIndex(
+        camera.motionEngine == ipfreely::eMotionEngine::backgroundModel ? 1 : 0);
+    ui->motionRegionThresholdsLineEdit->setText(
+        FormatRegionThresholds(camera.motionRegionThresholds));
+    ui->motionAnalysisFpsDoubleSpinBox->setValue(camera.motionAnalysisFps);
     ui->enableMotionRecordingCheckBox->setCheckState(camera.enabledMotionRecording ? Qt::Checked
                                                                                    : Qt::Unchecked);
+    ui->motionPreRollDoubleSpinBox->setValue(camera.motionPreRollSecs);
+    ui->motionPostRollDoubleSpinBox->setValue(camera.motionPostRollSecs);
 }
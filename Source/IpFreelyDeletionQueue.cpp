@@ -0,0 +1,263 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyDeletionQueue.cpp
+ * \brief File containing definition of IpFreelyDeletionQueue class.
+ */
+#include "IpFreelyDeletionQueue.h"
+#include <algorithm>
+#include <boost/exception/all.hpp>
+#include <boost/filesystem.hpp>
+#include "Threads/EventThread.h"
+#include "DebugLog/DebugLogging.h"
+#include "IpFreelyStorageUtils.h"
+
+namespace bfs = boost::filesystem;
+
+namespace ipfreely
+{
+
+static constexpr unsigned int DELETION_THREAD_PERIOD_MS = 10;
+static constexpr unsigned int WRITER_PRESSURE_HOLD_MS   = 5000;
+static constexpr double       BYTES_IN_MEBIBYTE         = 1024.0 * 1024.0;
+
+IpFreelyDeletionQueue::IpFreelyDeletionQueue(
+    std::shared_ptr<IpFreelyRecordingCatalog> const& recordingCatalog, double const maxFilesPerSec,
+    double const maxMebibytesPerSec)
+    : m_recordingCatalog(recordingCatalog)
+    , m_maxFilesPerSec(maxFilesPerSec)
+    , m_maxMebibytesPerSec(maxMebibytesPerSec)
+{
+    if (!m_recordingCatalog)
+    {
+        BOOST_THROW_EXCEPTION(
+            std::invalid_argument("Deletion queue requires a recording catalog."));
+    }
+
+    DEBUG_MESSAGE_EX_INFO("Creating deletion thread, limits: "
+                          << m_maxFilesPerSec << " files/s, " << m_maxMebibytesPerSec << " MiB/s");
+
+    m_deletionThread = std::make_shared<core_lib::threads::EventThread>(
+        std::bind(&IpFreelyDeletionQueue::ThreadEventCallback, this), DELETION_THREAD_PERIOD_MS);
+}
+
+IpFreelyDeletionQueue::~IpFreelyDeletionQueue()
+{
+    // Stop the thread then return anything not yet deleted to the catalog.
+    m_deletionThread.reset();
+
+    for (auto const& entry : m_backlog)
+    {
+        try
+        {
+            m_recordingCatalog->CancelPendingDeletion(entry.path);
+        }
+        catch (...)
+        {
+            auto exceptionMsg = boost::current_exception_diagnostic_information();
+            DEBUG_MESSAGE_EX_ERROR(exceptionMsg);
+        }
+    }
+}
+
+void IpFreelyDeletionQueue::SetRateLimits(double const maxFilesPerSec,
+                                          double const maxMebibytesPerSec)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_maxFilesPerSec     = maxFilesPerSec;
+    m_maxMebibytesPerSec = maxMebibytesPerSec;
+}
+
+void IpFreelyDeletionQueue::Push(RecordingEntry const& entry)
+{
+    // Hidden in the catalog straight away so the recording is not picked for deletion again,
+    // but only removed from it once deleted so a crash cannot leave the file uncatalogued.
+    if (!m_recordingCatalog->MarkPendingDeletion(entry.path))
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_backlog.emplace_back(entry);
+    m_backlogBytes += entry.bytes;
+
+    if (entry.tier == eStorageTier::archive)
+    {
+        m_archiveBacklogBytes += entry.bytes;
+    }
+}
+
+void IpFreelyDeletionQueue::NoteWriterPressure() noexcept
+{
+    auto pausedUntil = std::chrono::steady_clock::now() +
+                       std::chrono::milliseconds(WRITER_PRESSURE_HOLD_MS);
+    m_pausedUntilTicks = pausedUntil.time_since_epoch().count();
+}
+
+DeletionStatistics IpFreelyDeletionQueue::Statistics() const
+{
+    DeletionStatistics stats;
+    stats.paused = std::chrono::steady_clock::now().time_since_epoch().count() < m_pausedUntilTicks;
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    stats.backlogFiles = m_backlog.size();
+    stats.backlogBytes        = m_backlogBytes;
+    stats.localBacklogBytes   = m_backlogBytes - m_archiveBacklogBytes;
+    stats.archiveBacklogBytes = m_archiveBacklogBytes;
+    stats.deletedFiles        = m_deletedFiles;
+    stats.deletedBytes        = m_deletedBytes;
+    stats.failedFiles         = m_failedFiles;
+    return stats;
+}
+
+void IpFreelyDeletionQueue::ThreadEventCallback() noexcept
+{
+    try
+    {
+        if (!m_ioPrioritySet)
+        {
+            SetBackgroundIoPriority("deletion");
+            m_ioPrioritySet = true;
+        }
+
+        auto const now = std::chrono::steady_clock::now();
+
+        if ((now.time_since_epoch().count() < m_pausedUntilTicks) || (now < m_nextDeletionTime))
+        {
+            return;
+        }
+
+        RecordingEntry entry;
+        double         maxFilesPerSec;
+        double         maxMebibytesPerSec;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (m_backlog.empty())
+            {
+                return;
+            }
+
+            entry              = m_backlog.front();
+            maxFilesPerSec     = m_maxFilesPerSec;
+            maxMebibytesPerSec = m_maxMebibytesPerSec;
+        }
+
+        // The disk is only touched outside the lock so pushing never waits on it.
+        auto const deleted = DeleteRecording(entry);
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_backlog.pop_front();
+            m_backlogBytes -= entry.bytes;
+
+            if (entry.tier == eStorageTier::archive)
+            {
+                m_archiveBacklogBytes -= entry.bytes;
+            }
+
+            if (deleted)
+            {
+                ++m_deletedFiles;
+                m_deletedBytes += entry.bytes;
+            }
+            else
+            {
+                ++m_failedFiles;
+            }
+        }
+
+        // Space out the next deletion to keep within both budgets.
+        double delaySecs = 0.0;
+
+        if (maxFilesPerSec > 0.0)
+        {
+            delaySecs = 1.0 / maxFilesPerSec;
+        }
+
+        if (maxMebibytesPerSec > 0.0)
+        {
+            delaySecs = std::max(delaySecs,
+                                 static_cast<double>(entry.bytes) /
+                                     (maxMebibytesPerSec * BYTES_IN_MEBIBYTE));
+        }
+
+        m_nextDeletionTime =
+            now + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                      std::chrono::duration<double>(delaySecs));
+    }
+    catch (...)
+    {
+        auto exceptionMsg = boost::current_exception_diagnostic_information();
+        DEBUG_MESSAGE_EX_ERROR(exceptionMsg);
+    }
+}
+
+bool IpFreelyDeletionQueue::DeleteRecording(RecordingEntry const& entry)
+{
+    bfs::path                 p(m_recordingCatalog->FullPath(entry));
+    boost::system::error_code ec;
+
+    // A recording that has already gone counts as deleted, unless its whole archive has gone
+    // because the volume is not mounted.
+    if ((entry.tier == eStorageTier::archive) &&
+        !bfs::exists(m_recordingCatalog->ArchiveFolderPath(), ec))
+    {
+        ec = boost::system::errc::make_error_code(boost::system::errc::no_such_device);
+    }
+    else
+    {
+        bfs::remove(p, ec);
+    }
+
+    if (ec)
+    {
+        DEBUG_MESSAGE_EX_ERROR("Failed to delete recording: " << p.string()
+                                                              << ", error: " << ec.message());
+
+        // Back in the catalog it will be picked for deletion again by a later check.
+        try
+        {
+            m_recordingCatalog->CancelPendingDeletion(entry.path);
+        }
+        catch (...)
+        {
+            auto exceptionMsg = boost::current_exception_diagnostic_information();
+            DEBUG_MESSAGE_EX_ERROR(exceptionMsg);
+        }
+
+        return false;
+    }
+
+    m_recordingCatalog->RemoveRecording(entry.path);
+
+    // Segments and motion clips can both have event markers.
+    bfs::remove(p.string() + EVENT_MARKERS_EXTENSION, ec);
+
+    DEBUG_MESSAGE_EX_INFO("Successfully deleted recording: " << p.string());
+
+    RemoveEmptyDayFolder(p.parent_path().string());
+
+    return true;
+}
+
+} // namespace ipfreely
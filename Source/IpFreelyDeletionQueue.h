@@ -0,0 +1,163 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyDeletionQueue.h
+ * \brief File containing declaration of IpFreelyDeletionQueue class.
+ */
+#ifndef IPFREELYDELETIONQUEUE_H
+#define IPFREELYDELETIONQUEUE_H
+
+#include <memory>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "IpFreelyRecordingCatalog.h"
+
+namespace core_lib
+{
+namespace threads
+{
+
+class EventThread;
+
+} // namespace threads
+} // namespace core_lib
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+/*! \brief Structure holding the deletion queue's backlog and progress. */
+struct DeletionStatistics final
+{
+    /*! \brief Number of recordings waiting to be deleted. */
+    size_t backlogFiles{0};
+
+    /*! \brief Total size of the recordings waiting to be deleted. */
+    uint64_t backlogBytes{0};
+
+    /*! \brief Size of the recordings waiting to be deleted from the save folder. */
+    uint64_t localBacklogBytes{0};
+
+    /*! \brief Size of the recordings waiting to be deleted from the archive folder. */
+    uint64_t archiveBacklogBytes{0};
+
+    /*! \brief Number of recordings deleted. */
+    uint64_t deletedFiles{0};
+
+    /*! \brief Total size of the recordings deleted. */
+    uint64_t deletedBytes{0};
+
+    /*! \brief Number of recordings that could not be deleted and were returned to the catalog. */
+    uint64_t failedFiles{0};
+
+    /*! \brief Flag to show deletion is paused while the recording writers are under pressure. */
+    bool paused{false};
+};
+
+/*!
+ * \brief Class defining a background queue of recordings to delete.
+ *
+ * Recordings are marked pending deletion in the catalog as soon as they are queued, and removed
+ * from it once deleted. They are deleted one at a time on a low priority thread, using the idle
+ * I/O class on Linux and background mode on Windows. Deletions are spaced out to keep within a
+ * files per second and a MiB per second budget, and stop for a few seconds whenever a recording
+ * writer reports its queue is backing up, so they never hold up the live recordings' writes.
+ *
+ * A recording that cannot be deleted is returned to the catalog, as are any still queued when
+ * the queue is destroyed or left behind by a crash, so they are picked for deletion again later.
+ */
+class IpFreelyDeletionQueue final
+{
+public:
+    /*!
+     * \brief IpFreelyDeletionQueue constructor.
+     * \param[in] recordingCatalog - The catalog of the recordings to delete.
+     * \param[in] maxFilesPerSec - Most recordings to delete each second, 0 for no limit.
+     * \param[in] maxMebibytesPerSec - Most MiB of recordings to delete each second, 0 for no limit.
+     */
+    IpFreelyDeletionQueue(std::shared_ptr<IpFreelyRecordingCatalog> const& recordingCatalog,
+                          double const maxFilesPerSec, double const maxMebibytesPerSec);
+
+    /*! \brief IpFreelyDeletionQueue destructor. */
+    ~IpFreelyDeletionQueue();
+
+    /*! \brief IpFreelyDeletionQueue deleted copy constructor. */
+    IpFreelyDeletionQueue(IpFreelyDeletionQueue const&) = delete;
+
+    /*! \brief IpFreelyDeletionQueue deleted copy assignment operator. */
+    IpFreelyDeletionQueue& operator=(IpFreelyDeletionQueue const&) = delete;
+
+    /*!
+     * \brief SetRateLimits changes the deletion budget.
+     * \param[in] maxFilesPerSec - Most recordings to delete each second, 0 for no limit.
+     * \param[in] maxMebibytesPerSec - Most MiB of recordings to delete each second, 0 for no limit.
+     */
+    void SetRateLimits(double const maxFilesPerSec, double const maxMebibytesPerSec);
+
+    /*!
+     * \brief Push queues a recording to be deleted, marking it pending deletion in the catalog.
+     * \param[in] entry - The recording's catalog entry.
+     *
+     * A recording that is no longer in the catalog, or is already queued, is ignored.
+     */
+    void Push(RecordingEntry const& entry);
+
+    /*!
+     * \brief NoteWriterPressure pauses deletion while a recording writer is falling behind.
+     *
+     * Called by the writers each time they find their queue backing up, deletion resumes once
+     * they have not done so for a few seconds.
+     */
+    void NoteWriterPressure() noexcept;
+
+    /*!
+     * \brief Statistics reports the queue's backlog and progress.
+     * \return The statistics.
+     */
+    DeletionStatistics Statistics() const;
+
+private:
+    void ThreadEventCallback() noexcept;
+    bool DeleteRecording(RecordingEntry const& entry);
+
+private:
+    mutable std::mutex                              m_mutex{};
+    std::shared_ptr<IpFreelyRecordingCatalog>       m_recordingCatalog;
+    double                                          m_maxFilesPerSec{0.0};
+    double                                          m_maxMebibytesPerSec{0.0};
+    std::deque<RecordingEntry>                      m_backlog{};
+    uint64_t                                        m_backlogBytes{0};
+    uint64_t                                        m_archiveBacklogBytes{0};
+    uint64_t                                        m_deletedFiles{0};
+    uint64_t                                        m_deletedBytes{0};
+    uint64_t                                        m_failedFiles{0};
+    std::atomic<int64_t>                            m_pausedUntilTicks{0};
+    bool                                            m_ioPrioritySet{false};
+    std::chrono::steady_clock::time_point           m_nextDeletionTime{};
+    std::shared_ptr<core_lib::threads::EventThread> m_deletionThread;
+};
+
+} // namespace ipfreely
+
+#endif // IPFREELYDELETIONQUEUE_H
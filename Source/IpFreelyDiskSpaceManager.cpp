@@ -26,27 +26,84 @@
 #include <QStorageInfo>
 #include <sstream>
 #include <algorithm>
+#include <ctime>
 #include <boost/exception/all.hpp>
 #include <boost/filesystem.hpp>
 #include "Threads/EventThread.h"
 #include "DebugLog/DebugLogging.h"
-#include "FileUtils/FileUtils.h"
-#include "StringUtils/StringUtils.h"
+#include "IpFreelyRecordingCatalog.h"
+#include "IpFreelyDeletionQueue.h"
+#include "IpFreelyArchiveMigrator.h"
 
 namespace bfs = boost::filesystem;
 
 namespace ipfreely
 {
 
-static constexpr unsigned int UPDATE_PERIOD_MS = 60000;
+static constexpr unsigned int UPDATE_PERIOD_MS             = 60000;
+static constexpr size_t       MAX_DELETION_BACKLOG         = 1000;
+static constexpr int          LOW_WATERMARK_MARGIN_PERCENT = 1;
+static constexpr double       FREE_AHEAD_WITHIN_HOURS      = 6.0;
+static constexpr int          FREE_AHEAD_HOURS             = 12;
+static constexpr int          FORECAST_HORIZON_HOURS       = 24 * 90;
+static constexpr time_t       WARNING_PERIOD_SECS          = 24 * 3600;
+static constexpr eCamId       CAMERA_IDS[]                 = {
+    eCamId::cam1, eCamId::cam2, eCamId::cam3, eCamId::cam4};
 
-IpFreelyDiskSpaceManager::IpFreelyDiskSpaceManager(std::string const& saveFolderPath,
-                                                   int const          maxNumDaysToStore,
-                                                   int const          maxPercentUsedSpace)
+namespace utils
+{
+
+inline int64_t KeepFromMillisecs(int const numDays)
+{
+    // Midnight at the start of the oldest day to keep.
+    auto now       = time(0);
+    auto localTime = *std::localtime(&now);
+    localTime.tm_mday -= std::max(numDays - 1, 0);
+    localTime.tm_hour  = 0;
+    localTime.tm_min   = 0;
+    localTime.tm_sec   = 0;
+    localTime.tm_isdst = -1;
+
+    return static_cast<int64_t>(std::mktime(&localTime)) * 1000;
+}
+
+inline bool OldestMotionRecording(IpFreelyRecordingCatalog const& catalog, eCamId const camId,
+                                  eStorageTier const tier, RecordingEntry& entry)
+{
+    auto const foundClip = catalog.OldestRecording(entry, camId, eRecordingType::motionClip, tier);
+
+    RecordingEntry snapshot;
+    auto const     foundSnapshot =
+        catalog.OldestRecording(snapshot, camId, eRecordingType::snapshot, tier);
+
+    if (foundSnapshot && (!foundClip || (snapshot.startMillisecs < entry.startMillisecs)))
+    {
+        entry = snapshot;
+    }
+
+    return foundClip || foundSnapshot;
+}
+
+} // namespace utils
+
+IpFreelyDiskSpaceManager::IpFreelyDiskSpaceManager(
+    std::string const& saveFolderPath, int const maxNumDaysToStore, int const maxPercentUsedSpace,
+    std::shared_ptr<IpFreelyRecordingCatalog> const& recordingCatalog,
+    std::shared_ptr<IpFreelyDeletionQueue> const& deletionQueue, int const archiveAfterHours,
+    double const archiveMebibytesPerSec, camera_retention_t const& cameraRetention)
     : m_saveFolderPath(saveFolderPath)
     , m_maxNumDaysToStore(maxNumDaysToStore)
     , m_maxPercentUsedSpace(maxPercentUsedSpace)
+    , m_recordingCatalog(recordingCatalog)
+    , m_deletionQueue(deletionQueue)
+    , m_cameraRetention(cameraRetention)
 {
+    if (!m_recordingCatalog || !m_deletionQueue)
+    {
+        BOOST_THROW_EXCEPTION(std::invalid_argument(
+            "Disk space manager requires a recording catalog and deletion queue."));
+    }
+
     bfs::path p(m_saveFolderPath);
     p = bfs::system_complete(p);
 
@@ -60,6 +117,12 @@ IpFreelyDiskSpaceManager::IpFreelyDiskSpaceManager(std::string const& saveFolder
     DEBUG_MESSAGE_EX_INFO(
         "Started disk space manager for disk containing save folder:" << m_saveFolderPath);
 
+    if (!m_recordingCatalog->ArchiveFolderPath().empty())
+    {
+        m_archiveMigrator = std::make_shared<IpFreelyArchiveMigrator>(
+            m_recordingCatalog, archiveAfterHours, archiveMebibytesPerSec);
+    }
+
     m_eventThread = std::make_shared<core_lib::threads::EventThread>(
         std::bind(&IpFreelyDiskSpaceManager::ThreadEventCallback, this), UPDATE_PERIOD_MS);
 }
@@ -69,17 +132,67 @@ IpFreelyDiskSpaceManager::~IpFreelyDiskSpaceManager()
     // Do nothing.
 }
 
+void IpFreelyDiskSpaceManager::SetCameraRetention(camera_retention_t const& cameraRetention)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_cameraRetention = cameraRetention;
+}
+
+DiskSpaceForecast IpFreelyDiskSpaceManager::Forecast() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_forecast;
+}
+
 void IpFreelyDiskSpaceManager::ThreadEventCallback() noexcept
 {
     try
     {
-        // Get list of recording sub-directories.
-        m_subDirs = core_lib::file_utils::ListSubDirectories(
-            core_lib::string_utils::StringToWString(m_saveFolderPath));
+        // Loading or scanning for the catalog can take a long time so is done here, off the GUI
+        // thread. Nothing is checked until it is open.
+        if (!m_recordingCatalog->IsOpen())
+        {
+            m_recordingCatalog->Open();
+        }
+
+        camera_retention_t cameraRetention;
 
-        // Perform checks.
-        CheckUsedDiskSpace();
-        CheckNumDaysDataStored();
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            cameraRetention = m_cameraRetention;
+        }
+
+        // Perform checks, expired recordings first as they have to go regardless.
+        CheckNumDaysDataStored(cameraRetention);
+        CheckCameraQuotas(cameraRetention);
+        CheckUsedDiskSpace(cameraRetention);
+
+        auto const stats = m_deletionQueue->Statistics();
+
+        if (stats.backlogFiles > 0)
+        {
+            DEBUG_MESSAGE_EX_INFO("Deletion backlog: "
+                                  << stats.backlogFiles << " recordings (" << stats.backlogBytes
+                                  << " bytes), deleted: " << stats.deletedFiles << " recordings ("
+                                  << stats.deletedBytes << " bytes), failed: " << stats.failedFiles
+                                  << (stats.paused ? ", paused for recording writers." : "."));
+        }
+
+        if (m_archiveMigrator)
+        {
+            auto const migrationStats = m_archiveMigrator->Statistics();
+
+            if (migrationStats.migratedFiles != m_numMigrationsLogged)
+            {
+                DEBUG_MESSAGE_EX_INFO("Archived: " << migrationStats.migratedFiles
+                                                   << " recordings ("
+                                                   << migrationStats.migratedBytes
+                                                   << " bytes), failed: "
+                                                   << migrationStats.failedFiles);
+
+                m_numMigrationsLogged = migrationStats.migratedFiles;
+            }
+        }
     }
     catch (...)
     {
@@ -88,79 +201,306 @@ void IpFreelyDiskSpaceManager::ThreadEventCallback() noexcept
     }
 }
 
-void IpFreelyDiskSpaceManager::CheckUsedDiskSpace()
+void IpFreelyDiskSpaceManager::CheckNumDaysDataStored(camera_retention_t const& cameraRetention)
 {
-    while (true)
+    for (auto const camId : CAMERA_IDS)
     {
-        QStorageInfo info(QString::fromStdString(m_saveFolderPath));
-
-        auto percentUsed =
-            static_cast<int>(100.0 * (1.0 - (static_cast<double>(info.bytesAvailable()) /
-                                             static_cast<double>(info.bytesTotal()))));
+        auto maxNumDays       = m_maxNumDaysToStore;
+        auto maxNumMotionDays = 0;
+        auto retentionIt      = cameraRetention.find(camId);
 
-        if (percentUsed > m_maxPercentUsedSpace)
+        if (retentionIt != cameraRetention.end())
         {
-            DEBUG_MESSAGE_EX_INFO("Percentage disk space used is too great ("
-                                  << percentUsed << "%), will attempt to delete oldest data.");
-
-            if (!DeleteOldestRecording())
+            if (retentionIt->second.maxNumDays > 0)
             {
-                break;
+                maxNumDays = retentionIt->second.maxNumDays;
             }
+
+            maxNumMotionDays = retentionIt->second.maxNumMotionDays;
         }
-        else
+
+        // Motion clips and snapshots are never deleted before continuous recordings.
+        maxNumMotionDays = std::max(maxNumDays, maxNumMotionDays);
+
+        DeleteExpiredRecordings(camId, eRecordingType::segment, maxNumDays);
+        DeleteExpiredRecordings(camId, eRecordingType::motionClip, maxNumMotionDays);
+        DeleteExpiredRecordings(camId, eRecordingType::snapshot, maxNumMotionDays);
+    }
+
+    // Recordings not known to be from any camera only have the save folder's days to keep.
+    auto const     keepFromMillisecs = utils::KeepFromMillisecs(m_maxNumDaysToStore);
+    RecordingEntry oldest;
+    size_t         numDeleted = 0;
+
+    while (m_recordingCatalog->OldestUnknownCameraRecording(oldest) &&
+           (oldest.startMillisecs < keepFromMillisecs) && QueueDeletion(oldest))
+    {
+        ++numDeleted;
+    }
+
+    if (numDeleted > 0)
+    {
+        DEBUG_MESSAGE_EX_INFO("Queued " << numDeleted << " recordings older than "
+                                        << m_maxNumDaysToStore
+                                        << " days for deletion, camera ID unknown.");
+    }
+}
+
+void IpFreelyDiskSpaceManager::CheckCameraQuotas(camera_retention_t const& cameraRetention)
+{
+    for (auto const& retention : cameraRetention)
+    {
+        if (retention.second.maxBytes == 0)
         {
-            break;
+            continue;
+        }
+
+        auto const usedBytes = m_recordingCatalog->TotalBytes(retention.first);
+
+        if (usedBytes > retention.second.maxBytes)
+        {
+            DEBUG_MESSAGE_EX_INFO("Recordings use too much disk space ("
+                                  << usedBytes << " of " << retention.second.maxBytes
+                                  << " bytes), camera ID: " << static_cast<int>(retention.first)
+                                  << ", will attempt to delete oldest data.");
+
+            FreeSpace(retention.first,
+                      usedBytes - retention.second.maxBytes,
+                      eStorageTier::anyTier);
         }
     }
 }
 
-void IpFreelyDiskSpaceManager::CheckNumDaysDataStored()
+void IpFreelyDiskSpaceManager::CheckUsedDiskSpace(camera_retention_t const& cameraRetention)
 {
-    while (m_subDirs.size() > static_cast<size_t>(m_maxNumDaysToStore))
+    // The disk is read once per check, the forecast says how much more will be needed.
+    QStorageInfo info(QString::fromStdString(m_saveFolderPath));
+
+    if (info.bytesTotal() <= 0)
     {
-        DEBUG_MESSAGE_EX_INFO("Too many days data found on disk. Expected: "
-                              << m_maxNumDaysToStore << " but found: " << m_subDirs.size()
-                              << ". Will attempt to delete oldest data.");
+        return;
+    }
+
+    auto const now = time(0);
+    m_writeRateModel.Update(*m_recordingCatalog, now);
+
+    // Recordings already waiting to be deleted from this disk count as freed.
+    auto const deletionStats = m_deletionQueue->Statistics();
+    auto const totalBytes    = static_cast<double>(info.bytesTotal());
+    auto const backlogBytes  = static_cast<double>(deletionStats.localBacklogBytes);
+    auto const usedBytes     = totalBytes - static_cast<double>(info.bytesAvailable());
+    auto const limitBytes    = totalBytes * static_cast<double>(m_maxPercentUsedSpace) / 100.0;
+    auto const percentUsed   = static_cast<int>(100.0 * usedBytes / totalBytes);
 
-        if (!DeleteOldestRecording())
+    auto const archiveRecordingBytes = m_archiveMigrator ? CheckArchiveDiskSpace() : 0.0;
+    auto const forecast              = UpdateForecast(
+        cameraRetention, now, limitBytes, usedBytes - backlogBytes, archiveRecordingBytes);
+
+    // Free just enough to bring usage a little below the limit, not a whole day's data.
+    auto const targetBytes = std::max(
+        totalBytes * static_cast<double>(m_maxPercentUsedSpace - LOW_WATERMARK_MARGIN_PERCENT) /
+            100.0,
+        0.0);
+    double bytesToFree = 0.0;
+
+    if (percentUsed > m_maxPercentUsedSpace)
+    {
+        DEBUG_MESSAGE_EX_INFO("Percentage disk space used is too great ("
+                              << percentUsed << "%), will attempt to delete oldest data.");
+
+        bytesToFree = usedBytes - backlogBytes - targetBytes;
+    }
+    else if (!m_archiveMigrator && (forecast.hoursToLimit < FREE_AHEAD_WITHIN_HOURS) &&
+             IsQuietHour(now))
+    {
+        DEBUG_MESSAGE_EX_INFO("Disk space limit forecast to be reached in "
+                              << forecast.hoursToLimit
+                              << " hours, will delete oldest data while recording is quiet.");
+
+        // Make room now for the coming hours' recordings so the limit is never reached, and
+        // deleting never competes with recording, at the busiest times. With an archive folder
+        // the migrator clears older recordings off this disk instead.
+        bytesToFree = usedBytes - backlogBytes - targetBytes +
+                      m_writeRateModel.ForecastBytes(now, FREE_AHEAD_HOURS);
+    }
+
+    // Only recordings in the save folder free space on its disk.
+    if (bytesToFree > 0.0)
+    {
+        FreeSpace(eCamId::noCam, static_cast<uint64_t>(bytesToFree), eStorageTier::local);
+    }
+}
+
+double IpFreelyDiskSpaceManager::CheckArchiveDiskSpace()
+{
+    QStorageInfo info(QString::fromStdString(m_recordingCatalog->ArchiveFolderPath()));
+
+    if (!info.isValid() || !info.isReady() || (info.bytesTotal() <= 0))
+    {
+        return 0.0;
+    }
+
+    auto const deletionStats = m_deletionQueue->Statistics();
+    auto const totalBytes    = static_cast<double>(info.bytesTotal());
+    auto const backlogBytes  = static_cast<double>(deletionStats.archiveBacklogBytes);
+    auto const usedBytes     = totalBytes - static_cast<double>(info.bytesAvailable());
+    auto const limitBytes    = totalBytes * static_cast<double>(m_maxPercentUsedSpace) / 100.0;
+    auto const percentUsed   = static_cast<int>(100.0 * usedBytes / totalBytes);
+
+    if (percentUsed > m_maxPercentUsedSpace)
+    {
+        DEBUG_MESSAGE_EX_INFO("Percentage archive disk space used is too great ("
+                              << percentUsed << "%), will attempt to delete oldest data.");
+
+        auto const targetBytes = std::max(
+            totalBytes *
+                static_cast<double>(m_maxPercentUsedSpace - LOW_WATERMARK_MARGIN_PERCENT) / 100.0,
+            0.0);
+        auto const bytesToFree = usedBytes - backlogBytes - targetBytes;
+
+        if (bytesToFree > 0.0)
         {
-            break;
+            FreeSpace(eCamId::noCam, static_cast<uint64_t>(bytesToFree), eStorageTier::archive);
         }
     }
+
+    // Space the archive has for recordings once everything else on its disk is allowed for.
+    auto const archivedBytes = static_cast<double>(
+        m_recordingCatalog->TotalBytes(eCamId::noCam, eStorageTier::archive));
+    return std::max(limitBytes - std::max(usedBytes - backlogBytes - archivedBytes, 0.0), 0.0);
+}
+
+DiskSpaceForecast IpFreelyDiskSpaceManager::UpdateForecast(
+    camera_retention_t const& cameraRetention, time_t const now, double const limitBytes,
+    double const usedBytes, double const archiveRecordingBytes)
+{
+    DiskSpaceForecast forecast;
+    forecast.bytesPerDay  = m_writeRateModel.BytesPerDay();
+    forecast.hoursToLimit = m_writeRateModel.HoursToRecord(
+        now, std::max(limitBytes - usedBytes, 0.0), FORECAST_HORIZON_HOURS);
+
+    // Space left for recordings once everything else on the disks is allowed for.
+    auto const otherBytes = std::max(
+        usedBytes -
+            static_cast<double>(m_recordingCatalog->TotalBytes(eCamId::noCam, eStorageTier::local)),
+        0.0);
+    auto const recordingBytes = std::max(limitBytes - otherBytes, 0.0) + archiveRecordingBytes;
+    double     neededBytes    = 0.0;
+
+    for (auto const camId : CAMERA_IDS)
+    {
+        auto maxNumDays  = m_maxNumDaysToStore;
+        auto retentionIt = cameraRetention.find(camId);
+
+        if ((retentionIt != cameraRetention.end()) && (retentionIt->second.maxNumDays > 0))
+        {
+            maxNumDays = retentionIt->second.maxNumDays;
+        }
+
+        neededBytes += m_writeRateModel.BytesPerDay(camId) * static_cast<double>(maxNumDays);
+    }
+
+    if (forecast.bytesPerDay > 0.0)
+    {
+        forecast.daysStorable = recordingBytes / forecast.bytesPerDay;
+        forecast.retentionMet = neededBytes <= recordingBytes;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Warn as soon as the days cannot be met, then daily while they still cannot.
+    if (!forecast.retentionMet && (m_forecast.retentionMet || (now >= m_nextWarningTime)))
+    {
+        DEBUG_MESSAGE_EX_WARNING("At the current recording rate of "
+                                 << forecast.bytesPerDay << " bytes per day the disk space limit "
+                                 << "only holds " << forecast.daysStorable
+                                 << " days of recordings, fewer than the cameras are set to keep. "
+                                 << "The limit will be reached in " << forecast.hoursToLimit
+                                 << " hours.");
+
+        m_nextWarningTime = now + WARNING_PERIOD_SECS;
+    }
+
+    m_forecast = forecast;
+    return forecast;
 }
 
-bool IpFreelyDiskSpaceManager::DeleteOldestRecording()
+bool IpFreelyDiskSpaceManager::IsQuietHour(time_t const now) const
 {
-    if (m_subDirs.size() <= 1)
+    auto const bytesPerDay = m_writeRateModel.BytesPerDay();
+
+    // Nothing learned yet so there is nothing to free ahead of.
+    if (bytesPerDay <= 0.0)
     {
-        DEBUG_MESSAGE_EX_WARNING(
-            "No data will be deleted only the current day's sub-directory was found.");
         return false;
     }
 
-    m_subDirs.sort();
-    auto oldestSubDirItr = m_subDirs.begin();
+    return m_writeRateModel.BytesPerHour(std::localtime(&now)->tm_hour) <= bytesPerDay / 24.0;
+}
 
-    bfs::path p(m_saveFolderPath);
-    p /= *oldestSubDirItr;
-    p = bfs::system_complete(p);
+void IpFreelyDiskSpaceManager::DeleteExpiredRecordings(eCamId const         camId,
+                                                       eRecordingType const type,
+                                                       int const            maxNumDays)
+{
+    auto const     keepFromMillisecs = utils::KeepFromMillisecs(maxNumDays);
+    RecordingEntry oldest;
+    size_t         numDeleted = 0;
 
-    if (bfs::exists(p))
+    while (m_recordingCatalog->OldestRecording(oldest, camId, type) &&
+           (oldest.startMillisecs < keepFromMillisecs) && QueueDeletion(oldest))
     {
-        if (bfs::remove_all(p))
+        ++numDeleted;
+    }
+
+    if (numDeleted > 0)
+    {
+        DEBUG_MESSAGE_EX_INFO("Queued " << numDeleted << " recordings older than " << maxNumDays
+                                        << " days for deletion, camera ID: "
+                                        << static_cast<int>(camId));
+    }
+}
+
+void IpFreelyDiskSpaceManager::FreeSpace(eCamId const camId, uint64_t bytesToFree,
+                                         eStorageTier const tier)
+{
+    RecordingEntry oldest;
+    size_t         numDeleted = 0;
+
+    while (bytesToFree > 0)
+    {
+        // Continuous recordings go first, motion clips and snapshots only once there are none.
+        if (!m_recordingCatalog->OldestRecording(oldest, camId, eRecordingType::segment, tier) &&
+            !utils::OldestMotionRecording(*m_recordingCatalog, camId, tier, oldest))
         {
-            DEBUG_MESSAGE_EX_INFO(
-                "Successfully deleted data recording sub-directory: " << p.string());
+            DEBUG_MESSAGE_EX_WARNING("No data will be deleted, no recordings were found.");
+            break;
         }
-        else
+
+        if (!QueueDeletion(oldest))
         {
-            DEBUG_MESSAGE_EX_ERROR("Failed to delete data recording subdirectory: " << p.string());
+            break;
         }
+
+        bytesToFree -= std::min(bytesToFree, oldest.bytes);
+        ++numDeleted;
     }
 
-    m_subDirs.erase(oldestSubDirItr);
+    if (numDeleted > 0)
+    {
+        DEBUG_MESSAGE_EX_INFO("Queued " << numDeleted
+                                        << " oldest recordings for deletion to free space.");
+    }
+}
+
+bool IpFreelyDiskSpaceManager::QueueDeletion(RecordingEntry const& entry)
+{
+    // Leave the rest for a later check once the queue has caught up.
+    if (m_deletionQueue->Statistics().backlogFiles >= MAX_DELETION_BACKLOG)
+    {
+        return false;
+    }
 
+    m_deletionQueue->Push(entry);
     return true;
 }
 
@@ -26,8 +26,13 @@
 #define IPFREELYDISKSPACEMANAGER_H
 
 #include <string>
-#include <list>
 #include <memory>
+#include <map>
+#include <mutex>
+#include <cstdint>
+#include <ctime>
+#include "IpFreelyCameraDatabase.h"
+#include "IpFreelyWriteRateModel.h"
 
 namespace core_lib
 {
@@ -43,7 +48,74 @@ class EventThread;
 namespace ipfreely
 {
 
-/*! \brief Class defining disk space manager thread. */
+class IpFreelyRecordingCatalog;
+class IpFreelyDeletionQueue;
+class IpFreelyArchiveMigrator;
+struct RecordingEntry;
+enum class eRecordingType : uint8_t;
+enum class eStorageTier : uint8_t;
+
+/*! \brief Structure holding a camera's retention limits. */
+struct CameraRetention final
+{
+    /*! \brief Most bytes the camera's recordings may use, 0 for no limit. */
+    uint64_t maxBytes{0};
+
+    /*! \brief Days of continuous recordings to keep, 0 uses the save folder's limit. */
+    int maxNumDays{0};
+
+    /*! \brief Days of motion clips and snapshots to keep, never fewer than maxNumDays. */
+    int maxNumMotionDays{0};
+};
+
+/*! \brief Typedef to the retention limits of each camera. */
+typedef std::map<eCamId, CameraRetention> camera_retention_t;
+
+/*! \brief Structure holding a forecast of the disk space used by recordings. */
+struct DiskSpaceForecast final
+{
+    /*! \brief Bytes all cameras are forecast to record in a day, 0 until a full hour is learned. */
+    double bytesPerDay{0.0};
+
+    /*! \brief Hours until the disk space limit is reached, the forecast horizon if further. */
+    double hoursToLimit{0.0};
+
+    /*! \brief Days of recordings the disk space limit holds at the forecast rate. */
+    double daysStorable{0.0};
+
+    /*! \brief Flag to show if every camera's days of recordings fit within the limit. */
+    bool retentionMet{true};
+};
+
+/*!
+ * \brief Class defining disk space manager thread.
+ *
+ * The recordings stored are found from the save folder's recording catalog, so the save folder
+ * itself is never scanned. Individual recordings are deleted, oldest first, once they are older
+ * than their camera's day limit, while a camera uses more than its quota and while too much of
+ * the disk is used. Disk usage is brought down to just below the limit rather than by a whole
+ * day's data at a time.
+ *
+ * Motion clips and snapshots outlive continuous recordings: they may be kept for more days and
+ * are only deleted to free space once there are no continuous recordings left to delete.
+ *
+ * The recordings chosen are handed to a background deletion queue, which deletes them at a
+ * limited rate so they never swamp the disk the live recordings are being written to. The queue's
+ * backlog counts towards the space being freed, and no more is queued once it is long.
+ *
+ * The bytes each camera records in each hour of the day are learned from the catalog and used to
+ * forecast when the disk space limit will be reached. In quiet hours enough is freed ahead of time
+ * for the coming hours' recordings, so the limit is not reached, and deleting does not compete
+ * with the recordings, at the busiest times. A warning is logged when the cameras' days of
+ * recordings will not fit within the limit at the forecast rate.
+ *
+ * The catalog is opened on the manager's thread, before its first checks, as loading it may mean
+ * scanning the save and archive folders.
+ *
+ * If the catalog has an archive folder, recordings are moved to it by a background migrator
+ * once they are a number of hours old. The archive's disk is kept within the same percentage
+ * limit, and its space counts towards the days of recordings that can be kept.
+ */
 class IpFreelyDiskSpaceManager final
 {
 public:
@@ -52,9 +124,18 @@ public:
      * \param[in] saveFolderPath - A local folder to save captured videos to.
      * \param[in] maxNumDaysToStore - Maximum number of days of data to store.
      * \param[in] maxPercentUsedSpace - Maximum disk space percentage to be used.
+     * \param[in] recordingCatalog - The save folder's recording catalog.
+     * \param[in] deletionQueue - The queue to delete recordings through.
+     * \param[in] archiveAfterHours - Hours after a recording finishes to move it to the archive.
+     * \param[in] archiveMebibytesPerSec - Most MiB to archive each second, 0 for no limit.
+     * \param[in] cameraRetention - (Optional) The retention limits of each camera.
      */
     IpFreelyDiskSpaceManager(std::string const& saveFolderPath, int const maxNumDaysToStore,
-                             int const maxPercentUsedSpace);
+                             int const maxPercentUsedSpace,
+                             std::shared_ptr<IpFreelyRecordingCatalog> const& recordingCatalog,
+                             std::shared_ptr<IpFreelyDeletionQueue> const&    deletionQueue,
+                             int const archiveAfterHours, double const archiveMebibytesPerSec,
+                             camera_retention_t const& cameraRetention = {});
 
     /*! \brief IpFreelyDiskSpaceManager destructor. */
     virtual ~IpFreelyDiskSpaceManager();
@@ -65,17 +146,46 @@ public:
     /*! \brief IpFreelyDiskSpaceManager deleted copy assignment operator. */
     IpFreelyDiskSpaceManager& operator=(IpFreelyDiskSpaceManager const&) = delete;
 
+    /*!
+     * \brief SetCameraRetention changes the retention limits of each camera.
+     * \param[in] cameraRetention - The retention limits, used from the next check.
+     */
+    void SetCameraRetention(camera_retention_t const& cameraRetention);
+
+    /*!
+     * \brief Forecast gets the latest forecast of the disk space used by recordings.
+     * \return The forecast, updated at each check.
+     */
+    DiskSpaceForecast Forecast() const;
+
 private:
     void ThreadEventCallback() noexcept;
-    void CheckUsedDiskSpace();
-    void CheckNumDaysDataStored();
-    bool DeleteOldestRecording();
+    void CheckNumDaysDataStored(camera_retention_t const& cameraRetention);
+    void CheckCameraQuotas(camera_retention_t const& cameraRetention);
+    void CheckUsedDiskSpace(camera_retention_t const& cameraRetention);
+    double CheckArchiveDiskSpace();
+    DiskSpaceForecast UpdateForecast(camera_retention_t const& cameraRetention,
+                                     time_t const now, double const limitBytes,
+                                     double const usedBytes, double const archiveRecordingBytes);
+    bool IsQuietHour(time_t const now) const;
+    void DeleteExpiredRecordings(eCamId const camId, eRecordingType const type,
+                                 int const maxNumDays);
+    void FreeSpace(eCamId const camId, uint64_t bytesToFree, eStorageTier const tier);
+    bool QueueDeletion(RecordingEntry const& entry);
 
 private:
+    mutable std::mutex                              m_mutex{};
     std::string                                     m_saveFolderPath{};
     int                                             m_maxNumDaysToStore{7};
     int                                             m_maxPercentUsedSpace{90};
-    std::list<std::wstring>                         m_subDirs;
+    std::shared_ptr<IpFreelyRecordingCatalog>       m_recordingCatalog;
+    std::shared_ptr<IpFreelyDeletionQueue>          m_deletionQueue;
+    std::shared_ptr<IpFreelyArchiveMigrator>        m_archiveMigrator;
+    uint64_t                                        m_numMigrationsLogged{0};
+    camera_retention_t                              m_cameraRetention{};
+    DiskSpaceForecast                               m_forecast{};
+    IpFreelyWriteRateModel                          m_writeRateModel{};
+    time_t                                          m_nextWarningTime{0};
     std::shared_ptr<core_lib::threads::EventThread> m_eventThread;
 };
 
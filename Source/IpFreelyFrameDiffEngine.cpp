@@ -0,0 +1,80 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyFrameDiffEngine.cpp
+ * \brief File containing definition of IpFreelyFrameDiffEngine class.
+ */
+#include "IpFreelyFrameDiffEngine.h"
+
+namespace ipfreely
+{
+
+IpFreelyFrameDiffEngine::IpFreelyFrameDiffEngine(double const   pixelThreshold,
+                                                 cv::Mat const& thresholdMap)
+    : IpFreelyMotionEngine("frame differencing")
+    , m_pixelThreshold(pixelThreshold)
+    , m_thresholdMap(thresholdMap)
+{
+}
+
+void IpFreelyFrameDiffEngine::Reset()
+{
+    m_initialiseFrames = true;
+}
+
+void IpFreelyFrameDiffEngine::UpdateModel(cv::Mat& greyFrame, MotionKernelResult* result,
+                                          cv::Mat* motionMask)
+{
+    if (m_initialiseFrames)
+    {
+        m_initialiseFrames = false;
+
+        greyFrame.copyTo(m_prevGreyFrame);
+        greyFrame.copyTo(m_currentGreyFrame);
+    }
+
+    // Swapping hands the oldest grey frame's buffer back to the caller to reuse for its next frame.
+    cv::swap(m_nextGreyFrame, greyFrame);
+
+    if (result && !m_thresholdMap.empty())
+    {
+        FusedMotionKernel(m_prevGreyFrame,
+                          m_currentGreyFrame,
+                          m_nextGreyFrame,
+                          m_thresholdMap,
+                          *result,
+                          motionMask);
+    }
+    else if (result)
+    {
+        FusedMotionKernel(m_prevGreyFrame,
+                          m_currentGreyFrame,
+                          m_nextGreyFrame,
+                          m_pixelThreshold,
+                          *result,
+                          motionMask);
+    }
+
+    cv::swap(m_prevGreyFrame, m_currentGreyFrame);
+    cv::swap(m_currentGreyFrame, m_nextGreyFrame);
+}
+
+} // namespace ipfreely
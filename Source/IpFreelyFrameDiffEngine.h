@@ -0,0 +1,80 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyFrameDiffEngine.h
+ * \brief File containing declaration of IpFreelyFrameDiffEngine class.
+ */
+#ifndef IPFREELYFRAMEDIFFENGINE_H
+#define IPFREELYFRAMEDIFFENGINE_H
+
+#include "IpFreelyMotionEngine.h"
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+/*!
+ * \brief Class defining the three frame differencing motion engine.
+ *
+ * The engine's model is simply the two grey frames before the latest. Motion is the AND of the
+ * differences between the latest frame and each of them, thresholded and eroded by
+ * FusedMotionKernel. This was the motion detector's only algorithm before engines were added.
+ */
+class IpFreelyFrameDiffEngine final : public IpFreelyMotionEngine
+{
+public:
+    /*!
+     * \brief IpFreelyFrameDiffEngine constructor.
+     * \param[in] pixelThreshold - Differences at or below this level are ignored.
+     * \param[in] thresholdMap - (Optional) 8-bit threshold for each pixel, used instead of
+     * pixelThreshold if not empty.
+     */
+    explicit IpFreelyFrameDiffEngine(double const   pixelThreshold,
+                                     cv::Mat const& thresholdMap = cv::Mat());
+
+    /*! \brief IpFreelyFrameDiffEngine destructor. */
+    ~IpFreelyFrameDiffEngine() override = default;
+
+    /*! \brief Reset discards the previous grey frames. */
+    void Reset() override;
+
+protected:
+    /*!
+     * \brief UpdateModel differences the grey frame against the previous two.
+     * \param[in,out] greyFrame - The next 8-bit grey frame, swapped for the oldest frame's buffer.
+     * \param[out] result - If not null, the motion found in the frame.
+     * \param[out] motionMask - If not null, the motion mask.
+     */
+    void UpdateModel(cv::Mat& greyFrame, MotionKernelResult* result,
+                     cv::Mat* motionMask) override;
+
+private:
+    double  m_pixelThreshold{0.0};
+    cv::Mat m_thresholdMap{};
+    bool    m_initialiseFrames{true};
+    cv::Mat m_prevGreyFrame{};
+    cv::Mat m_currentGreyFrame{};
+    cv::Mat m_nextGreyFrame{};
+};
+
+} // namespace ipfreely
+
+#endif // IPFREELYFRAMEDIFFENGINE_H
@@ -0,0 +1,144 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyFramePool.cpp
+ * \brief File containing definition of IpFreelyFramePool class.
+ */
+#include "IpFreelyFramePool.h"
+#include <algorithm>
+#include "DebugLog/DebugLogging.h"
+
+namespace ipfreely
+{
+
+IpFreelyFramePool::IpFreelyFramePool(std::string const& name, size_t const maxBuffers)
+    : m_name(name)
+    , m_maxBuffers(maxBuffers)
+{
+}
+
+cv::Mat IpFreelyFramePool::Acquire(int const rows, int const cols, int const type)
+{
+    if ((rows <= 0) || (cols <= 0))
+    {
+        return cv::Mat();
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    cv::Mat* match = nullptr;
+    cv::Mat* spare = nullptr;
+    size_t   inUse = 1;
+
+    for (auto& buffer : m_buffers)
+    {
+        if (!IsFree(buffer))
+        {
+            ++inUse;
+        }
+        else if (!match && (buffer.rows == rows) && (buffer.cols == cols) &&
+                 (buffer.type() == type))
+        {
+            match = &buffer;
+        }
+        else if (!spare)
+        {
+            spare = &buffer;
+        }
+    }
+
+    if (inUse > m_highWaterMark)
+    {
+        m_highWaterMark = inUse;
+    }
+
+    if (match)
+    {
+        return *match;
+    }
+
+    // Grow the pool until it covers the number of frames in flight, after
+    // that a free buffer of a size no longer asked for can be replaced.
+    if (m_buffers.size() < m_maxBuffers)
+    {
+        m_buffers.emplace_back(rows, cols, type);
+        return m_buffers.back();
+    }
+
+    if (spare)
+    {
+        spare->create(rows, cols, type);
+        return *spare;
+    }
+
+    ++m_overflows;
+
+    if (!m_overflowWarned)
+    {
+        DEBUG_MESSAGE_EX_WARNING("Frame pool of " << m_maxBuffers
+                                                  << " buffers exhausted for camera: " << m_name);
+        m_overflowWarned = true;
+    }
+
+    return cv::Mat(rows, cols, type);
+}
+
+void IpFreelyFramePool::SetMaxBuffers(size_t const maxBuffers)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    m_maxBuffers     = maxBuffers;
+    m_overflowWarned = false;
+
+    // Free buffers are removed first. Borrowed buffers stay valid after being
+    // removed from the pool, they're simply freed rather than returned once released.
+    if (m_buffers.size() > m_maxBuffers)
+    {
+        std::stable_partition(m_buffers.begin(), m_buffers.end(), [](cv::Mat const& buffer) {
+            return !IsFree(buffer);
+        });
+        m_buffers.resize(m_maxBuffers);
+    }
+}
+
+size_t IpFreelyFramePool::BuffersAllocated() const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_buffers.size();
+}
+
+size_t IpFreelyFramePool::HighWaterMark() const noexcept
+{
+    return m_highWaterMark;
+}
+
+uint64_t IpFreelyFramePool::Overflows() const noexcept
+{
+    return m_overflows;
+}
+
+bool IpFreelyFramePool::IsFree(cv::Mat const& buffer) noexcept
+{
+    // The pool's own reference is the only one left once the buffer has been returned.
+    return (buffer.u != nullptr) && (CV_XADD(&buffer.u->refcount, 0) == 1);
+}
+
+} // namespace ipfreely
@@ -0,0 +1,117 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyFramePool.h
+ * \brief File containing declaration of IpFreelyFramePool class.
+ */
+#ifndef IPFREELYFRAMEPOOL_H
+#define IPFREELYFRAMEPOOL_H
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+/*!
+ * \brief Class defining a pool of reusable video frame buffers.
+ *
+ * Buffers are borrowed as cv::Mat objects and rely on cv::Mat's own reference counting, so they
+ * can be passed between threads and stages like any other frame. A buffer returns to the pool
+ * once every cv::Mat referring to it has been released. Once the pool has grown to cover the
+ * number of frames in flight no further buffers are allocated.
+ */
+class IpFreelyFramePool final
+{
+public:
+    /*!
+     * \brief IpFreelyFramePool constructor.
+     * \param[in] name - A name for the pool, used for logging.
+     * \param[in] maxBuffers - The maximum number of buffers the pool holds.
+     */
+    IpFreelyFramePool(std::string const& name, size_t const maxBuffers);
+
+    /*! \brief IpFreelyFramePool destructor. */
+    ~IpFreelyFramePool() = default;
+
+    /*! \brief IpFreelyFramePool deleted copy constructor. */
+    IpFreelyFramePool(IpFreelyFramePool const&) = delete;
+
+    /*! \brief IpFreelyFramePool deleted copy assignment operator. */
+    IpFreelyFramePool& operator=(IpFreelyFramePool const&) = delete;
+
+    /*!
+     * \brief Acquire borrows a buffer from the pool.
+     * \param[in] rows - The frame's height.
+     * \param[in] cols - The frame's width.
+     * \param[in] type - The frame's OpenCV type, e.g. CV_8UC3.
+     * \return A frame using a pooled buffer, or a newly allocated frame if all the pool's
+     * buffers are in use.
+     *
+     * The frame's pixels are left as they were when the buffer was last used.
+     */
+    cv::Mat Acquire(int const rows, int const cols, int const type);
+
+    /*!
+     * \brief SetMaxBuffers changes the maximum number of buffers the pool holds.
+     * \param[in] maxBuffers - The maximum number of buffers.
+     */
+    void SetMaxBuffers(size_t const maxBuffers);
+
+    /*!
+     * \brief BuffersAllocated reports the number of buffers the pool holds.
+     * \return The number of buffers.
+     */
+    size_t BuffersAllocated() const;
+
+    /*!
+     * \brief HighWaterMark reports the most buffers that have been borrowed at once.
+     * \return The number of buffers.
+     */
+    size_t HighWaterMark() const noexcept;
+
+    /*!
+     * \brief Overflows reports the number of frames allocated because the pool was exhausted.
+     * \return The number of frames.
+     */
+    uint64_t Overflows() const noexcept;
+
+private:
+    static bool IsFree(cv::Mat const& buffer) noexcept;
+
+private:
+    mutable std::mutex    m_mutex{};
+    std::string           m_name{"cam"};
+    size_t                m_maxBuffers{0};
+    std::vector<cv::Mat>  m_buffers{};
+    std::atomic<size_t>   m_highWaterMark{0};
+    std::atomic<uint64_t> m_overflows{0};
+    bool                  m_overflowWarned{false};
+};
+
+} // namespace ipfreely
+
+#endif // IPFREELYFRAMEPOOL_H
@@ -0,0 +1,117 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyFrameRing.cpp
+ * \brief File containing definition of IpFreelyFrameRing class.
+ */
+#include "IpFreelyFrameRing.h"
+#include <stdexcept>
+#include <boost/throw_exception.hpp>
+
+namespace ipfreely
+{
+
+IpFreelyFrameRing::IpFreelyFrameRing(size_t const capacity)
+    : m_slots(capacity)
+{
+    if (capacity == 0)
+    {
+        BOOST_THROW_EXCEPTION(std::invalid_argument("Frame ring capacity must be non-zero."));
+    }
+}
+
+void IpFreelyFrameRing::Push(cv::Mat const&                               frame,
+                             std::chrono::steady_clock::time_point const& timestamp)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto& slot = m_slots[m_head];
+
+    if ((slot.sequence != 0) && !slot.consumed)
+    {
+        ++m_framesDropped;
+    }
+
+    slot.frame     = frame;
+    slot.timestamp = timestamp;
+    slot.sequence  = m_nextSequence++;
+    slot.consumed  = false;
+
+    m_head = (m_head + 1) % m_slots.size();
+}
+
+bool IpFreelyFrameRing::Latest(uint64_t& lastSequence, cv::Mat& frame, uint64_t* skipped,
+                               std::chrono::steady_clock::time_point* timestamp) const
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto const& slot = m_slots[(m_head + m_slots.size() - 1) % m_slots.size()];
+
+    if ((slot.sequence == 0) || (slot.sequence <= lastSequence))
+    {
+        return false;
+    }
+
+    if (skipped)
+    {
+        *skipped = (lastSequence == 0) ? 0 : slot.sequence - lastSequence - 1;
+    }
+
+    // Older frames are never handed out now so are left unconsumed,
+    // to be counted as dropped when they are overwritten.
+    slot.consumed = true;
+
+    if (timestamp)
+    {
+        *timestamp = slot.timestamp;
+    }
+
+    frame        = slot.frame;
+    lastSequence = slot.sequence;
+
+    return true;
+}
+
+void IpFreelyFrameRing::Clear()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    for (auto& slot : m_slots)
+    {
+        slot = Slot();
+    }
+
+    m_head = 0;
+}
+
+uint64_t IpFreelyFrameRing::FramesPushed() const noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_nextSequence - 1;
+}
+
+uint64_t IpFreelyFrameRing::FramesDropped() const noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_framesDropped;
+}
+
+} // namespace ipfreely
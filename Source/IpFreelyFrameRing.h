@@ -0,0 +1,126 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyFrameRing.h
+ * \brief File containing declaration of IpFreelyFrameRing class.
+ */
+#ifndef IPFREELYFRAMERING_H
+#define IPFREELYFRAMERING_H
+
+#include <vector>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+/*!
+ * \brief Class defining a bounded, drop-oldest ring of captured video frames.
+ *
+ * A single producer (the capture thread) pushes frames as fast as the camera sends them. When the
+ * ring is full the oldest frame is overwritten. Any number of consumers can then take the latest
+ * frame at their own rate, each tracking the sequence number of the last frame it took so that
+ * the frames it never saw can be counted.
+ */
+class IpFreelyFrameRing final
+{
+public:
+    /*!
+     * \brief IpFreelyFrameRing constructor.
+     * \param[in] capacity - Maximum number of frames held in the ring.
+     */
+    explicit IpFreelyFrameRing(size_t const capacity);
+
+    /*! \brief IpFreelyFrameRing destructor. */
+    ~IpFreelyFrameRing() = default;
+
+    /*! \brief IpFreelyFrameRing deleted copy constructor. */
+    IpFreelyFrameRing(IpFreelyFrameRing const&) = delete;
+
+    /*! \brief IpFreelyFrameRing deleted copy assignment operator. */
+    IpFreelyFrameRing& operator=(IpFreelyFrameRing const&) = delete;
+
+    /*!
+     * \brief Push adds a new frame to the ring, overwriting the oldest frame if full.
+     * \param[in] frame - The new video frame, the ring takes a reference to its pixel buffer.
+     * \param[in] timestamp - The time the frame was captured.
+     */
+    void Push(cv::Mat const& frame, std::chrono::steady_clock::time_point const& timestamp);
+
+    /*!
+     * \brief Latest gives access to the newest frame in the ring.
+     * \param[in,out] lastSequence - Consumer's last taken sequence number, updated on success.
+     * \param[out] frame - The newest video frame.
+     * \param[out] skipped - (Optional) Number of frames the consumer did not see since its last call.
+     * \param[out] timestamp - (Optional) The time the frame was captured.
+     * \return True if a frame newer than lastSequence was available, false otherwise.
+     */
+    bool Latest(uint64_t& lastSequence, cv::Mat& frame, uint64_t* skipped = nullptr,
+                std::chrono::steady_clock::time_point* timestamp = nullptr) const;
+
+    /*!
+     * \brief Clear removes all frames from the ring, sequence numbers are not reset.
+     */
+    void Clear();
+
+    /*!
+     * \brief FramesPushed reports the total number of frames pushed into the ring.
+     * \return The number of frames.
+     */
+    uint64_t FramesPushed() const noexcept;
+
+    /*!
+     * \brief FramesDropped reports the number of frames overwritten before any consumer took them.
+     * \return The number of frames.
+     */
+    uint64_t FramesDropped() const noexcept;
+
+private:
+    /*! \brief Structure defining a ring slot. */
+    struct Slot final
+    {
+        /*! \brief The slot's video frame. */
+        cv::Mat frame{};
+
+        /*! \brief The time the frame was captured. */
+        std::chrono::steady_clock::time_point timestamp{};
+
+        /*! \brief The frame's sequence number, 0 means the slot is empty. */
+        uint64_t sequence{0};
+
+        /*! \brief Flag to show if any consumer has taken the frame. */
+        mutable bool consumed{false};
+    };
+
+private:
+    mutable std::mutex m_mutex{};
+    std::vector<Slot>  m_slots{};
+    size_t             m_head{0};
+    uint64_t           m_nextSequence{1};
+    uint64_t           m_framesDropped{0};
+};
+
+} // namespace ipfreely
+
+#endif // IPFREELYFRAMERING_H
@@ -0,0 +1,521 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyLumaDecoder.cpp
+ * \brief File containing definition of IpFreelyLumaDecoder threaded class.
+ */
+#include "IpFreelyLumaDecoder.h"
+#include <sstream>
+#include <cmath>
+#include <algorithm>
+#include <functional>
+#include <boost/exception/all.hpp>
+#include "IpFreelyPacketSource.h"
+#include "Threads/EventThread.h"
+#include "DebugLog/DebugLogging.h"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+#include <libavutil/pixdesc.h>
+#include <libavutil/frame.h>
+#include <libavutil/motion_vector.h>
+}
+
+namespace ipfreely
+{
+
+static constexpr unsigned int DECODER_THREAD_PERIOD_MS  = 1;
+static constexpr unsigned int DECODER_WAIT_TIMEOUT_MS   = 100;
+static constexpr size_t       PACKET_QUEUE_CAPACITY     = 50;
+static constexpr size_t       LUMA_FRAME_RING_CAPACITY  = 2;
+static constexpr size_t       LUMA_FRAME_POOL_BUFFERS   = 8;
+static constexpr double       LIMITED_RANGE_LUMA_BLACK  = 16.0;
+static constexpr double       LIMITED_RANGE_LUMA_EXTENT = 219.0;
+static constexpr double       FULL_RANGE_LUMA_EXTENT    = 255.0;
+static constexpr int          MOTION_VECTOR_BLOCK_SIZE  = 16;
+static constexpr int          MAX_FRAMES_WITHOUT_MVS    = 25;
+static constexpr int          MAX_DECODER_THREADS       = 2;
+
+namespace utils
+{
+
+inline bool HasLumaPlane(AVPixFmtDescriptor const* desc)
+{
+    // The first component must be 8-bit luma stored alone in the first plane.
+    return (desc != nullptr) &&
+           ((desc->flags &
+             (AV_PIX_FMT_FLAG_RGB | AV_PIX_FMT_FLAG_PAL | AV_PIX_FMT_FLAG_HWACCEL)) == 0) &&
+           (desc->nb_components > 0) && (desc->comp[0].plane == 0) &&
+           (desc->comp[0].step == 1) && (desc->comp[0].offset == 0) &&
+           (desc->comp[0].depth == 8);
+}
+
+inline bool IsFullRange(AVFrame const& frame)
+{
+    switch (frame.format)
+    {
+    case AV_PIX_FMT_GRAY8:
+    case AV_PIX_FMT_YUVJ420P:
+    case AV_PIX_FMT_YUVJ422P:
+    case AV_PIX_FMT_YUVJ444P:
+    case AV_PIX_FMT_YUVJ440P:
+        return true;
+    default:
+        return frame.color_range == AVCOL_RANGE_JPEG;
+    }
+}
+
+} // namespace utils
+
+IpFreelyLumaDecoder::IpFreelyLumaDecoder(std::string const& name, cv::Size const& frameSize,
+                                         std::shared_ptr<IpFreelyPacketSource> const& packetSource,
+                                         bool const greyFrames, bool const motionVectors,
+                                         double const greyFps)
+    : m_name(name)
+    , m_frameSize(frameSize)
+    , m_greyFrames(greyFrames)
+    , m_greyFramePeriod((greyFps > 0.0)
+                            ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                                  std::chrono::duration<double>(1.0 / greyFps))
+                            : std::chrono::steady_clock::duration::zero())
+    , m_exportMotionVectors(motionVectors)
+    , m_packetSource(packetSource)
+    , m_packetQueue(PACKET_QUEUE_CAPACITY)
+    , m_framePool(name + "_luma", LUMA_FRAME_POOL_BUFFERS)
+    , m_frameRing(LUMA_FRAME_RING_CAPACITY)
+{
+    if (!m_greyFrames && !m_exportMotionVectors)
+    {
+        BOOST_THROW_EXCEPTION(std::invalid_argument("Luma decoder has nothing to produce."));
+    }
+
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 10, 100)
+    static std::once_flag initFlag;
+    std::call_once(initFlag, []() { avcodec_register_all(); });
+#endif
+
+    m_codecParams = avcodec_parameters_alloc();
+    m_frame       = av_frame_alloc();
+
+    if (!m_codecParams || !m_frame)
+    {
+        Cleanup();
+        BOOST_THROW_EXCEPTION(std::runtime_error("Failed to allocate luma decoder."));
+    }
+
+    // Stretches limited range luma to full range, as converting to BGR does.
+    m_rangeLut.create(1, 256, CV_8UC1);
+
+    for (int i = 0; i < 256; ++i)
+    {
+        m_rangeLut.at<uint8_t>(0, i) = cv::saturate_cast<uint8_t>(
+            (static_cast<double>(i) - LIMITED_RANGE_LUMA_BLACK) * FULL_RANGE_LUMA_EXTENT /
+            LIMITED_RANGE_LUMA_EXTENT);
+    }
+
+    m_packetHandlerId = m_packetSource->AddPacketHandler(
+        std::bind(&IpFreelyLumaDecoder::PacketHandler,
+                  this,
+                  std::placeholders::_1,
+                  std::placeholders::_2,
+                  std::placeholders::_3));
+
+    DEBUG_MESSAGE_EX_INFO("Creating luma decoder thread for camera: " << m_name);
+
+    m_eventThread = std::make_shared<core_lib::threads::EventThread>(
+        std::bind(&IpFreelyLumaDecoder::ThreadEventCallback, this), DECODER_THREAD_PERIOD_MS);
+}
+
+IpFreelyLumaDecoder::~IpFreelyLumaDecoder()
+{
+    m_packetSource->RemovePacketHandler(m_packetHandlerId);
+    m_eventThread.reset();
+    m_packetQueue.Clear();
+    Cleanup();
+}
+
+bool IpFreelyLumaDecoder::Latest(uint64_t& lastSequence, cv::Mat& frame, uint64_t* skipped,
+                                 std::chrono::steady_clock::time_point* timestamp) const
+{
+    return m_frameRing.Latest(lastSequence, frame, skipped, timestamp);
+}
+
+bool IpFreelyLumaDecoder::TakeMotionVectors(cv::Mat&                               motionVectors,
+                                            std::chrono::steady_clock::time_point* timestamp)
+{
+    std::lock_guard<std::mutex> lock(m_motionVectorsMutex);
+
+    if (m_motionVectors.empty())
+    {
+        return false;
+    }
+
+    // Hand over the field itself, the next frame's vectors start a new one.
+    motionVectors = m_motionVectors;
+    m_motionVectors.release();
+
+    if (timestamp)
+    {
+        *timestamp = m_motionVectorsTime;
+    }
+
+    return true;
+}
+
+bool IpFreelyLumaDecoder::ExportingMotionVectors() const noexcept
+{
+    return m_exportMotionVectors;
+}
+
+bool IpFreelyLumaDecoder::Failed() const noexcept
+{
+    return m_failed;
+}
+
+uint64_t IpFreelyLumaDecoder::FramesDecoded() const noexcept
+{
+    return m_framesDecoded;
+}
+
+uint64_t IpFreelyLumaDecoder::PacketsDropped() const noexcept
+{
+    return m_packetsDropped;
+}
+
+void IpFreelyLumaDecoder::PacketHandler(AVPacket const&          packet,
+                                        AVCodecParameters const& codecParams,
+                                        AVRational const& /*timeBase*/)
+{
+    if (m_failed)
+    {
+        return;
+    }
+
+    auto arrivalTime = std::chrono::steady_clock::now();
+
+    {
+        std::lock_guard<std::mutex> lock(m_codecParamsMutex);
+
+        // The stream's codec parameters never change so only the first packet's are kept.
+        if (!m_codecParamsSet)
+        {
+            if (avcodec_parameters_copy(m_codecParams, &codecParams) < 0)
+            {
+                SetFailed("failed to copy codec parameters");
+                return;
+            }
+
+            m_codecParamsSet = true;
+        }
+    }
+
+    // After packets have been dropped the frames that follow can't be
+    // decoded properly until the next keyframe, so skip them too.
+    if (m_waitForKeyFrame)
+    {
+        if ((packet.flags & AV_PKT_FLAG_KEY) == 0)
+        {
+            ++m_packetsDropped;
+            return;
+        }
+
+        m_waitForKeyFrame = false;
+    }
+
+    std::shared_ptr<AVPacket> queuedPacket(av_packet_clone(&packet),
+                                           [](AVPacket* p) { av_packet_free(&p); });
+
+    if (queuedPacket && m_packetQueue.TryPush(std::make_pair(arrivalTime, queuedPacket)))
+    {
+        return;
+    }
+
+    // Decoding has fallen too far behind so throw away the backlog.
+    m_packetsDropped += m_packetQueue.Size() + 1;
+    m_packetQueue.Clear();
+    m_waitForKeyFrame = true;
+
+    DEBUG_MESSAGE_EX_WARNING("Luma decoder falling behind, dropping packets for camera: "
+                             << m_name);
+}
+
+void IpFreelyLumaDecoder::ThreadEventCallback() noexcept
+{
+    try
+    {
+        timed_packet_t packet;
+
+        if (!m_packetQueue.Pop(packet, DECODER_WAIT_TIMEOUT_MS) || m_failed)
+        {
+            return;
+        }
+
+        if (!m_codecCtx)
+        {
+            OpenDecoder();
+        }
+
+        if (m_codecCtx)
+        {
+            DecodePacket(packet);
+        }
+    }
+    catch (...)
+    {
+        auto exceptionMsg = boost::current_exception_diagnostic_information();
+        DEBUG_MESSAGE_EX_ERROR(exceptionMsg);
+    }
+}
+
+void IpFreelyLumaDecoder::OpenDecoder()
+{
+    std::lock_guard<std::mutex> lock(m_codecParamsMutex);
+
+    auto codec = avcodec_find_decoder(m_codecParams->codec_id);
+
+    if (!codec)
+    {
+        SetFailed(std::string("no decoder for codec ") +
+                  avcodec_get_name(m_codecParams->codec_id));
+        return;
+    }
+
+    m_codecCtx = avcodec_alloc_context3(codec);
+
+    if (!m_codecCtx)
+    {
+        SetFailed("failed to allocate codec context");
+        return;
+    }
+
+    // Slice threading doesn't delay frames like frame threading, so
+    // each frame is decoded as soon as the packet it's in arrives. Every
+    // camera has its own decoder so each only gets a couple of threads,
+    // rather than one for every core.
+    auto result = avcodec_parameters_to_context(m_codecCtx, m_codecParams);
+    m_codecCtx->thread_count = MAX_DECODER_THREADS;
+    m_codecCtx->thread_type  = FF_THREAD_SLICE;
+
+    if (m_exportMotionVectors)
+    {
+        m_codecCtx->flags2 |= AV_CODEC_FLAG2_EXPORT_MVS;
+    }
+
+    if (result >= 0)
+    {
+        result = avcodec_open2(m_codecCtx, codec, nullptr);
+    }
+
+    if (result < 0)
+    {
+        avcodec_free_context(&m_codecCtx);
+        SetFailed("failed to open decoder");
+        return;
+    }
+
+    DEBUG_MESSAGE_EX_INFO("Opened luma decoder for camera: "
+                          << m_name << ", codec: " << codec->name << ", size: "
+                          << m_codecParams->width << "x" << m_codecParams->height);
+}
+
+void IpFreelyLumaDecoder::DecodePacket(timed_packet_t const& packet)
+{
+    // Corrupt packets are common on lossy networks and the
+    // decoder recovers by itself, so they're just skipped.
+    if (avcodec_send_packet(m_codecCtx, packet.second.get()) < 0)
+    {
+        return;
+    }
+
+    while (avcodec_receive_frame(m_codecCtx, m_frame) == 0)
+    {
+        // The grey frame is published first so it's ready
+        // by the time its motion vectors can be taken.
+        if ((m_greyFrames || !m_exportMotionVectors) && PublishDue(packet.first))
+        {
+            PublishFrame(packet.first);
+        }
+
+        if (m_exportMotionVectors)
+        {
+            AccumulateMotionVectors(packet.first);
+        }
+
+        ++m_framesDecoded;
+        av_frame_unref(m_frame);
+    }
+}
+
+bool IpFreelyLumaDecoder::PublishDue(std::chrono::steady_clock::time_point const& timestamp)
+{
+    if (timestamp < m_nextGreyFrameTime)
+    {
+        return false;
+    }
+
+    // Step the next time on by the period so the rate is kept on average,
+    // unless we're so far behind we'd then publish a burst of frames.
+    m_nextGreyFrameTime += m_greyFramePeriod;
+
+    if (m_nextGreyFrameTime <= timestamp)
+    {
+        m_nextGreyFrameTime = timestamp + m_greyFramePeriod;
+    }
+
+    return true;
+}
+
+void IpFreelyLumaDecoder::PublishFrame(std::chrono::steady_clock::time_point const& timestamp)
+{
+    auto desc = av_pix_fmt_desc_get(static_cast<AVPixelFormat>(m_frame->format));
+
+    if (!utils::HasLumaPlane(desc))
+    {
+        std::ostringstream oss;
+        oss << "unsupported pixel format " << (desc ? desc->name : "unknown");
+        SetFailed(oss.str());
+        return;
+    }
+
+    // Wrap the decoder's luma plane, which is only valid until the frame is unreferenced.
+    cv::Mat luma(m_frame->height,
+                 m_frame->width,
+                 CV_8UC1,
+                 m_frame->data[0],
+                 static_cast<size_t>(m_frame->linesize[0]));
+
+    auto size      = m_frameSize.empty() ? luma.size() : m_frameSize;
+    auto greyFrame = m_framePool.Acquire(size.height, size.width, CV_8UC1);
+    bool fullRange = utils::IsFullRange(*m_frame);
+
+    if (size != luma.size())
+    {
+        cv::resize(luma, greyFrame, size, 0, 0, cv::INTER_AREA);
+
+        if (!fullRange)
+        {
+            cv::LUT(greyFrame, m_rangeLut, greyFrame);
+        }
+    }
+    else if (!fullRange)
+    {
+        cv::LUT(luma, m_rangeLut, greyFrame);
+    }
+    else
+    {
+        luma.copyTo(greyFrame);
+    }
+
+    m_frameRing.Push(greyFrame, timestamp);
+}
+
+void IpFreelyLumaDecoder::AccumulateMotionVectors(
+    std::chrono::steady_clock::time_point const& timestamp)
+{
+    auto sideData = av_frame_get_side_data(m_frame, AV_FRAME_DATA_MOTION_VECTORS);
+
+    if (!sideData)
+    {
+        // Intra frames never have motion vectors but if predicted frames
+        // don't either then the codec's decoder can't export them.
+        if ((m_frame->pict_type != AV_PICTURE_TYPE_I) &&
+            (++m_framesWithoutVectors == MAX_FRAMES_WITHOUT_MVS))
+        {
+            m_exportMotionVectors = false;
+
+            DEBUG_MESSAGE_EX_WARNING("Motion vectors unavailable, decoding grey frames for camera: "
+                                     << m_name);
+        }
+
+        return;
+    }
+
+    m_framesWithoutVectors = 0;
+
+    auto const cols = (m_frame->width + MOTION_VECTOR_BLOCK_SIZE - 1) / MOTION_VECTOR_BLOCK_SIZE;
+    auto const rows = (m_frame->height + MOTION_VECTOR_BLOCK_SIZE - 1) / MOTION_VECTOR_BLOCK_SIZE;
+    auto const vectors = reinterpret_cast<AVMotionVector const*>(sideData->data);
+    auto const count   = static_cast<size_t>(sideData->size) / sizeof(AVMotionVector);
+
+    std::lock_guard<std::mutex> lock(m_motionVectorsMutex);
+
+    if (m_motionVectors.empty())
+    {
+        m_motionVectors = cv::Mat::zeros(rows, cols, CV_8UC1);
+    }
+
+    for (size_t i = 0; i < count; ++i)
+    {
+        auto const& vector    = vectors[i];
+        auto const  magnitude = cv::saturate_cast<uint8_t>(
+            std::hypot(static_cast<double>(vector.src_x - vector.dst_x),
+                       static_cast<double>(vector.src_y - vector.dst_y)));
+
+        if (magnitude == 0)
+        {
+            continue;
+        }
+
+        // The destination is the centre of the predicted block, which may be
+        // smaller than a 16x16 block or cover several of them.
+        auto const left   = std::max(vector.dst_x - vector.w / 2, 0);
+        auto const top    = std::max(vector.dst_y - vector.h / 2, 0);
+        auto const right  = std::min(vector.dst_x + (vector.w + 1) / 2, m_frame->width) - 1;
+        auto const bottom = std::min(vector.dst_y + (vector.h + 1) / 2, m_frame->height) - 1;
+
+        if ((right < left) || (bottom < top))
+        {
+            continue;
+        }
+
+        for (int y = top / MOTION_VECTOR_BLOCK_SIZE; y <= bottom / MOTION_VECTOR_BLOCK_SIZE; ++y)
+        {
+            auto row = m_motionVectors.ptr<uint8_t>(y);
+
+            for (int x = left / MOTION_VECTOR_BLOCK_SIZE; x <= right / MOTION_VECTOR_BLOCK_SIZE;
+                 ++x)
+            {
+                row[x] = std::max(row[x], magnitude);
+            }
+        }
+    }
+
+    m_motionVectorsTime = timestamp;
+}
+
+void IpFreelyLumaDecoder::SetFailed(std::string const& reason) noexcept
+{
+    if (!m_failed.exchange(true))
+    {
+        DEBUG_MESSAGE_EX_WARNING("Luma decoding unavailable for camera: "
+                                 << m_name << ", reason: " << reason);
+    }
+}
+
+void IpFreelyLumaDecoder::Cleanup() noexcept
+{
+    avcodec_free_context(&m_codecCtx);
+    av_frame_free(&m_frame);
+    avcodec_parameters_free(&m_codecParams);
+}
+
+} // namespace ipfreely
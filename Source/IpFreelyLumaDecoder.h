@@ -0,0 +1,205 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyLumaDecoder.h
+ * \brief File containing declaration of IpFreelyLumaDecoder threaded class.
+ */
+#ifndef IPFREELYLUMADECODER_H
+#define IPFREELYLUMADECODER_H
+
+#include <string>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <utility>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include "IpFreelyBoundedQueue.h"
+#include "IpFreelyFrameRing.h"
+#include "IpFreelyFramePool.h"
+
+// Forward declarations.
+struct AVCodecContext;
+struct AVCodecParameters;
+struct AVFrame;
+struct AVPacket;
+struct AVRational;
+
+namespace core_lib
+{
+namespace threads
+{
+
+class EventThread;
+
+} // namespace threads
+} // namespace core_lib
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+class IpFreelyPacketSource;
+
+/*!
+ * \brief Class defining a decoder that turns a packet source's compressed video into grey frames.
+ *
+ * The decoder registers itself with a packet source, such as a camera's passthrough packet
+ * stream, and decodes its packets on a dedicated thread using libavcodec. As the camera's video
+ * capture decodes the stream too this doubles the decoding cost, so it is only worth it when the
+ * codec's motion vectors are wanted. The decoded frame's
+ * luma plane is used directly as a grey frame, scaled to the required size, so no colour
+ * conversion is ever done. Full range luma is always produced so the grey frames match those
+ * converted from BGR frames.
+ *
+ * Only 8-bit YUV pixel formats, by far the most common for cameras, are supported. If the stream
+ * cannot be decoded to one of these the decoder reports itself as failed.
+ *
+ * The decoder can also export the codec's motion vectors, building a field holding the largest
+ * vector magnitude in each 16x16 block. Fields from successive frames are combined until taken so
+ * no motion is missed. Not every codec's decoder exports motion vectors, e.g. libavcodec's H.265
+ * decoder doesn't, so if predicted frames arrive without any the decoder stops exporting them and
+ * produces grey frames instead.
+ *
+ * Grey frames can be limited to a lower rate than the video's, only the frames that will be
+ * analysed are then scaled and converted, though every frame still has to be decoded.
+ */
+class IpFreelyLumaDecoder final
+{
+public:
+    /*!
+     * \brief IpFreelyLumaDecoder constructor.
+     * \param[in] name - A name for the decoder, used for logging.
+     * \param[in] frameSize - Size of the grey frames, an empty size means the video's size.
+     * \param[in] packetSource - Packet source to decode.
+     * \param[in] greyFrames - (Optional) Produce grey frames, may only be false if exporting
+     * motion vectors.
+     * \param[in] motionVectors - (Optional) Export the codec's motion vectors.
+     * \param[in] greyFps - (Optional) Maximum rate grey frames are produced, 0 for every frame.
+     */
+    IpFreelyLumaDecoder(std::string const& name, cv::Size const& frameSize,
+                        std::shared_ptr<IpFreelyPacketSource> const& packetSource,
+                        bool const greyFrames = true, bool const motionVectors = false,
+                        double const greyFps = 0.0);
+
+    /*! \brief IpFreelyLumaDecoder destructor. */
+    ~IpFreelyLumaDecoder();
+
+    /*! \brief IpFreelyLumaDecoder deleted copy constructor. */
+    IpFreelyLumaDecoder(IpFreelyLumaDecoder const&) = delete;
+
+    /*! \brief IpFreelyLumaDecoder deleted copy assignment operator. */
+    IpFreelyLumaDecoder& operator=(IpFreelyLumaDecoder const&) = delete;
+
+    /*!
+     * \brief Latest gives access to the newest grey frame.
+     * \param[in,out] lastSequence - Consumer's last taken sequence number, updated on success.
+     * \param[out] frame - The newest grey frame.
+     * \param[out] skipped - (Optional) Number of frames not seen since the consumer's last call.
+     * \param[out] timestamp - (Optional) The time the frame's packet arrived.
+     * \return True if a frame newer than lastSequence was available, false otherwise.
+     */
+    bool Latest(uint64_t& lastSequence, cv::Mat& frame, uint64_t* skipped = nullptr,
+                std::chrono::steady_clock::time_point* timestamp = nullptr) const;
+
+    /*!
+     * \brief TakeMotionVectors takes the motion vectors of the frames decoded since the last call.
+     * \param[out] motionVectors - 8-bit field of the largest magnitude in each 16x16 block.
+     * \param[out] timestamp - (Optional) The time the newest frame's packet arrived.
+     * \return True if any frames with motion vectors were decoded, false otherwise.
+     */
+    bool TakeMotionVectors(cv::Mat&                               motionVectors,
+                           std::chrono::steady_clock::time_point* timestamp = nullptr);
+
+    /*!
+     * \brief ExportingMotionVectors reports if the decoder is exporting motion vectors.
+     * \return True if exporting, false if not requested or the codec's decoder can't export them.
+     */
+    bool ExportingMotionVectors() const noexcept;
+
+    /*!
+     * \brief Failed reports if the stream cannot be decoded to grey frames.
+     * \return True if failed, false otherwise.
+     */
+    bool Failed() const noexcept;
+
+    /*!
+     * \brief FramesDecoded reports the number of frames decoded.
+     * \return The number of frames.
+     */
+    uint64_t FramesDecoded() const noexcept;
+
+    /*!
+     * \brief PacketsDropped reports the number of packets dropped because decoding fell behind.
+     * \return The number of packets.
+     */
+    uint64_t PacketsDropped() const noexcept;
+
+private:
+    /*! \brief Typedef to a packet and the time it arrived. */
+    typedef std::pair<std::chrono::steady_clock::time_point, std::shared_ptr<AVPacket>>
+        timed_packet_t;
+
+private:
+    void PacketHandler(AVPacket const& packet, AVCodecParameters const& codecParams,
+                       AVRational const& timeBase);
+    void ThreadEventCallback() noexcept;
+    void OpenDecoder();
+    void DecodePacket(timed_packet_t const& packet);
+    bool PublishDue(std::chrono::steady_clock::time_point const& timestamp);
+    void PublishFrame(std::chrono::steady_clock::time_point const& timestamp);
+    void AccumulateMotionVectors(std::chrono::steady_clock::time_point const& timestamp);
+    void SetFailed(std::string const& reason) noexcept;
+    void Cleanup() noexcept;
+
+private:
+    mutable std::mutex                              m_codecParamsMutex{};
+    mutable std::mutex                              m_motionVectorsMutex{};
+    std::string                                     m_name{"cam"};
+    cv::Size                                        m_frameSize{};
+    bool                                            m_greyFrames{true};
+    std::chrono::steady_clock::duration             m_greyFramePeriod{};
+    std::chrono::steady_clock::time_point           m_nextGreyFrameTime{};
+    std::atomic<bool>                               m_exportMotionVectors{false};
+    std::shared_ptr<IpFreelyPacketSource>           m_packetSource;
+    int                                             m_packetHandlerId{0};
+    AVCodecParameters*                              m_codecParams{nullptr};
+    bool                                            m_codecParamsSet{false};
+    AVCodecContext*                                 m_codecCtx{nullptr};
+    AVFrame*                                        m_frame{nullptr};
+    cv::Mat                                         m_rangeLut{};
+    IpFreelyBoundedQueue<timed_packet_t>            m_packetQueue;
+    bool                                            m_waitForKeyFrame{false};
+    IpFreelyFramePool                               m_framePool;
+    IpFreelyFrameRing                               m_frameRing;
+    int                                             m_framesWithoutVectors{0};
+    cv::Mat                                         m_motionVectors{};
+    std::chrono::steady_clock::time_point           m_motionVectorsTime{};
+    std::atomic<bool>                               m_failed{false};
+    std::atomic<uint64_t>                           m_framesDecoded{0};
+    std::atomic<uint64_t>                           m_packetsDropped{0};
+    std::shared_ptr<core_lib::threads::EventThread> m_eventThread;
+};
+
+} // namespace ipfreely
+
+#endif // IPFREELYLUMADECODER_H
@@ -40,6 +40,8 @@
 #include <string>
 #include <ctime>
 #include <set>
+#include <algorithm>
+#include <chrono>
 #include <boost/filesystem.hpp>
 #include "IpFreelyVideoFrame.h"
 #include "IpFreelyVideoForm.h"
@@ -49,6 +51,9 @@
 #include "IpFreelySdCardViewerDialog.h"
 #include "IpFreelyStreamProcessor.h"
 #include "IpFreelyDiskSpaceManager.h"
+#include "IpFreelyRecordingCatalog.h"
+#include "IpFreelyDeletionQueue.h"
+#include "IpFreelyWorkerPool.h"
 #include "StringUtils/StringUtils.h"
 #include "DebugLog/DebugLogging.h"
 
@@ -57,7 +62,12 @@ namespace bfs = boost::filesystem;
 namespace
 {
 
-static constexpr int DEFAULT_UPDATE_PERIOD_MS = 100;
+static constexpr int    DEFAULT_UPDATE_PERIOD_MS = 100;
+static constexpr int    CAM_FEED_DISPLAY_ID      = 0;
+static constexpr int    VIDEO_FORM_DISPLAY_ID    = 1;
+static constexpr int    TOOLTIP_UPDATE_PERIOD_MS = 1000;
+static constexpr double BYTES_IN_MEBIBYTE        = 1024.0 * 1024.0;
+static constexpr double BYTES_IN_GIBIBYTE        = 1024.0 * 1024.0 * 1024.0;
 
 void ClearLayout(QLayout* layout, bool deleteWidgets)
 {
@@ -89,6 +99,30 @@ void ClearLayout(QLayout* layout, bool deleteWidgets)
     }
 }
 
+ipfreely::camera_retention_t MakeCameraRetention(ipfreely::IpFreelyCameraDatabase const& camDb)
+{
+    ipfreely::camera_retention_t cameraRetention;
+
+    for (auto const camId : {ipfreely::eCamId::cam1,
+                             ipfreely::eCamId::cam2,
+                             ipfreely::eCamId::cam3,
+                             ipfreely::eCamId::cam4})
+    {
+        ipfreely::IpCamera camera;
+
+        if (camDb.FindCamera(camId, camera))
+        {
+            auto& retention = cameraRetention[camId];
+            retention.maxBytes =
+                static_cast<uint64_t>(std::max(camera.maxStorageGiB, 0.0) * BYTES_IN_GIBIBYTE);
+            retention.maxNumDays       = camera.maxNumDaysData;
+            retention.maxNumMotionDays = camera.maxNumDaysMotionData;
+        }
+    }
+
+    return cameraRetention;
+}
+
 } // namespace
 
 IpFreelyMainWindow::IpFreelyMainWindow(QString const& appVersion, QWidget* parent)
@@ -98,8 +132,15 @@ IpFreelyMainWindow::IpFreelyMainWindow(QString const& appVersion, QWidget* paren
     , m_updateFeedsTimer(new QTimer(this))
     , m_numConnections(0)
     , m_videoForm(std::make_shared<IpFreelyVideoForm>())
+    , m_motionWorkerPool(std::make_shared<ipfreely::IpFreelyWorkerPool>("motion"))
+    , m_recordingCatalog(std::make_shared<ipfreely::IpFreelyRecordingCatalog>(
+          m_prefs.SaveFolderPath(), m_prefs.ArchiveFolderPath()))
+    , m_deletionQueue(std::make_shared<ipfreely::IpFreelyDeletionQueue>(
+          m_recordingCatalog, m_prefs.DeletionFilesPerSec(), m_prefs.DeletionMebibytesPerSec()))
     , m_diskSpaceMgr(std::make_shared<ipfreely::IpFreelyDiskSpaceManager>(
-          m_prefs.SaveFolderPath(), m_prefs.MaxNumDaysData(), m_prefs.MaxUsedDiskSpacePercent()))
+          m_prefs.SaveFolderPath(), m_prefs.MaxNumDaysData(), m_prefs.MaxUsedDiskSpacePercent(),
+          m_recordingCatalog, m_deletionQueue, m_prefs.ArchiveAfterHours(),
+          m_prefs.ArchiveMebibytesPerSec(), MakeCameraRetention(m_camDb)))
 {
     ui->setupUi(this);
 
@@ -167,6 +208,16 @@ void IpFreelyMainWindow::on_actionPreferences_triggered()
         }
     }
 
+    // Nothing is recording now so reopen the catalog in case the save or archive folder has
+    // changed. The disk space manager's thread loads it.
+    m_diskSpaceMgr.reset();
+    m_deletionQueue.reset();
+    m_recordingCatalog.reset();
+    m_recordingCatalog = std::make_shared<ipfreely::IpFreelyRecordingCatalog>(
+        m_prefs.SaveFolderPath(), m_prefs.ArchiveFolderPath());
+    m_deletionQueue = std::make_shared<ipfreely::IpFreelyDeletionQueue>(
+        m_recordingCatalog, m_prefs.DeletionFilesPerSec(), m_prefs.DeletionMebibytesPerSec());
+
     // Reconnect to cameras that were previsouly running before changing preferences.
     for (auto const& camId : camIds)
     {
@@ -191,9 +242,10 @@ void IpFreelyMainWindow::on_actionPreferences_triggered()
     }
 
     // Recreate disk space manager.
-    m_diskSpaceMgr.reset();
     m_diskSpaceMgr = std::make_shared<ipfreely::IpFreelyDiskSpaceManager>(
-        m_prefs.SaveFolderPath(), m_prefs.MaxNumDaysData(), m_prefs.MaxUsedDiskSpacePercent());
+        m_prefs.SaveFolderPath(), m_prefs.MaxNumDaysData(), m_prefs.MaxUsedDiskSpacePercent(),
+        m_recordingCatalog, m_deletionQueue, m_prefs.ArchiveAfterHours(),
+        m_prefs.ArchiveMebibytesPerSec(), MakeCameraRetention(m_camDb));
 }
 
 void IpFreelyMainWindow::on_actionAbout_triggered()
@@ -541,21 +593,49 @@ void IpFreelyMainWindow::on_updateFeedsTimer()
 {
     for (auto const& streamProcessor : m_streamProcessors)
     {
-        if (streamProcessor.second->VideoFrameUpdated())
+        // The stream processors scale frames to fit our displays on their own
+        // threads so we only have to draw them. The camera feeds only shrink them.
+        auto camFeedIter = m_camFeeds.find(streamProcessor.first);
+
+        if (camFeedIter != m_camFeeds.end())
+        {
+            streamProcessor.second->RegisterDisplaySize(
+                CAM_FEED_DISPLAY_ID, camFeedIter->second->size(), false);
+        }
+
+        bool videoFormVisible =
+            m_videoForm->isVisible() && (m_videoFormId == streamProcessor.first);
+
+        if (videoFormVisible)
+        {
+            streamProcessor.second->RegisterDisplaySize(VIDEO_FORM_DISPLAY_ID,
+                                                        m_videoForm->VideoFrameSize());
+        }
+        else
         {
-            QRect motionBoundingRect;
-            auto currentVideoFrame = streamProcessor.second->CurrentVideoFrame(&motionBoundingRect);
+            streamProcessor.second->UnregisterDisplaySize(VIDEO_FORM_DISPLAY_ID);
+        }
+
+        ipfreely::VideoSnapshot snapshot;
 
-            auto originalFps = streamProcessor.second->OriginalFps();
-            auto fps         = streamProcessor.second->CurrentFps();
-            auto isRecording = streamProcessor.second->VideoWritingEnabled();
+        if (streamProcessor.second->CurrentSnapshot(snapshot))
+        {
+            auto const& motionBoundingRect = snapshot.motionRectangle;
+            auto        originalFps        = snapshot.originalFps;
+            auto        fps                = snapshot.fps;
+            auto        isRecording        = snapshot.recording;
 
-            UpdateCamFeedFrame(
-                streamProcessor.first, currentVideoFrame, motionBoundingRect, isRecording);
+            UpdateCamFeedFrame(streamProcessor.first,
+                               snapshot.displayFrames[CAM_FEED_DISPLAY_ID],
+                               snapshot.frameSize,
+                               motionBoundingRect,
+                               isRecording);
 
             SetFpsInTitle(streamProcessor.first, fps, originalFps);
+            SetStatisticsInToolTip(streamProcessor.first,
+                                   streamProcessor.second->GetCaptureStatistics());
 
-            if (m_videoForm->isVisible() && (m_videoFormId == streamProcessor.first))
+            if (videoFormVisible)
             {
                 ipfreely::IpCamera::regions_t motionRegions;
 
@@ -564,7 +644,8 @@ void IpFreelyMainWindow::on_updateFeedsTimer()
                     motionRegions = m_camMotionRegions[streamProcessor.first];
                 }
 
-                m_videoForm->SetVideoFrame(currentVideoFrame,
+                m_videoForm->SetVideoFrame(snapshot.displayFrames[VIDEO_FORM_DISPLAY_ID],
+                                           snapshot.frameSize,
                                            fps,
                                            originalFps,
                                            motionBoundingRect,
@@ -1008,6 +1089,7 @@ void IpFreelyMainWindow::SetupCameraInDb(ipfreely::eCamId const camId, QToolButt
     }
 
     m_camDb.Save();
+    m_diskSpaceMgr->SetCameraRetention(MakeCameraRetention(m_camDb));
     connectBtn->setEnabled(camera.IsValid());
 }
 
@@ -1033,6 +1115,7 @@ void IpFreelyMainWindow::ConnectionHandler(ipfreely::IpCamera const& camera,
         m_streamProcessors.erase(camera.camId);
         m_camFeeds.erase(camera.camId);
         m_camMotionRegions.erase(camera.camId);
+        m_toolTipUpdateTimes.erase(camera.camId);
 
         switch (camera.camId)
         {
@@ -1135,6 +1218,9 @@ void IpFreelyMainWindow::ConnectionHandler(ipfreely::IpCamera const& camera,
                                                                     camera,
                                                                     p.string(),
                                                                     m_prefs.FileDurationInSecs(),
+                                                                    m_motionWorkerPool,
+                                                                    m_recordingCatalog,
+                                                                    m_deletionQueue,
                                                                     schedule,
                                                                     motionSchedule);
         }
@@ -1229,6 +1315,7 @@ void IpFreelyMainWindow::RecordActionHandler(ipfreely::eCamId const camId, QTool
 }
 
 void IpFreelyMainWindow::UpdateCamFeedFrame(ipfreely::eCamId const camId, QImage const& videoFrame,
+                                            QSize const& originalSize,
                                             QRect const& motionBoundingRect,
                                             bool const   streamProcIsWriting)
 {
@@ -1240,40 +1327,17 @@ void IpFreelyMainWindow::UpdateCamFeedFrame(ipfreely::eCamId const camId, QImage
         return;
     }
 
-    QImage displayFrame;
-    double scalar = 1.0;
-
-    if ((camFeedIter->second->width() < videoFrame.width()) ||
-        (camFeedIter->second->height() < videoFrame.height()))
-    {
-        double frameAspectRatio =
-            static_cast<double>(videoFrame.width()) / static_cast<double>(videoFrame.height());
-        double targetAspectRatio = static_cast<double>(camFeedIter->second->width()) /
-                                   static_cast<double>(camFeedIter->second->height());
-        int newWidth  = 0;
-        int newHeight = 0;
-
-        if (targetAspectRatio < frameAspectRatio)
-        {
-            newWidth  = camFeedIter->second->width();
-            newHeight = static_cast<int>(static_cast<double>(newWidth) / frameAspectRatio);
-        }
-        else
-        {
-            newHeight = camFeedIter->second->height();
-            newWidth  = static_cast<int>(static_cast<double>(newHeight) * frameAspectRatio);
-        }
-
-        scalar = static_cast<double>(newWidth) / static_cast<double>(videoFrame.width());
-
-        displayFrame =
-            videoFrame.scaled(newWidth, newHeight, Qt::KeepAspectRatio, Qt::SmoothTransformation);
-    }
-    else
+    // Until the stream processor has picked up our size there's nothing to show.
+    if (videoFrame.isNull() || originalSize.isEmpty())
     {
-        displayFrame = videoFrame;
+        return;
     }
 
+    // The video frame has already been shrunk to fit the camera feed if too big for it.
+    QImage displayFrame = videoFrame;
+    double scalar =
+        static_cast<double>(videoFrame.width()) / static_cast<double>(originalSize.width());
+
     auto motionAreasEnabled = m_motionAreaSetupEnabled[camId];
 
     if (!motionBoundingRect.isNull() || streamProcIsWriting || motionAreasEnabled)
@@ -1417,6 +1481,24 @@ void IpFreelyMainWindow::SaveImageSnapshot(ipfreely::eCamId const camId)
                               QString::fromStdString(oss.str()),
                               QMessageBox::Ok,
                               QMessageBox::Ok);
+        return;
+    }
+
+    try
+    {
+        ipfreely::RecordingEntry entry;
+        entry.path           = p.string();
+        entry.camId          = camId;
+        entry.type           = ipfreely::eRecordingType::snapshot;
+        entry.startMillisecs = static_cast<int64_t>(timestamp) * 1000;
+        entry.endMillisecs   = entry.startMillisecs;
+        entry.bytes          = bfs::file_size(p);
+        m_recordingCatalog->AddRecording(entry);
+    }
+    catch (std::exception& e)
+    {
+        DEBUG_MESSAGE_EX_ERROR("Failed to catalog snapshot image: " << p.string()
+                                                                    << ", error: " << e.what());
     }
 }
 
@@ -1450,6 +1532,101 @@ void IpFreelyMainWindow::SetFpsInTitle(ipfreely::eCamId const camId, double fps,
     }
 }
 
+void IpFreelyMainWindow::SetStatisticsInToolTip(ipfreely::eCamId const               camId,
+                                                ipfreely::CaptureStatistics const& captureStats)
+{
+    // Statistics are only refreshed about once a second, they change too
+    // little between display updates to be worth rebuilding every time.
+    auto const now        = std::chrono::steady_clock::now();
+    auto&      lastUpdate = m_toolTipUpdateTimes[camId];
+
+    if ((lastUpdate != std::chrono::steady_clock::time_point()) &&
+        (now - lastUpdate < std::chrono::milliseconds(TOOLTIP_UPDATE_PERIOD_MS)))
+    {
+        return;
+    }
+
+    lastUpdate = now;
+
+    ipfreely::IpCamera camera;
+
+    if (!m_camDb.FindCamera(camId, camera))
+    {
+        return;
+    }
+
+    QString hint = QString::fromStdString(camera.description);
+
+    if (!hint.isEmpty())
+    {
+        hint += "\n";
+    }
+
+    QString motionSource;
+
+    if (captureStats.motionLumaDecode)
+    {
+        motionSource += tr(", luma decode");
+    }
+
+    if (captureStats.motionFromVectors)
+    {
+        motionSource += tr(", motion vectors");
+    }
+
+    QString const engineName = (camera.motionEngine == ipfreely::eMotionEngine::backgroundModel)
+                                   ? tr("background model")
+                                   : tr("frame differencing");
+
+    hint += tr("Frames grabbed: %1, decoded: %2, dropped: %3\n")
+                .arg(captureStats.framesGrabbed)
+                .arg(captureStats.framesCaptured)
+                .arg(captureStats.framesDropped);
+    hint += tr("Frames skipped by display: %1, motion detector: %2, recording: %3\n")
+                .arg(captureStats.displayFramesSkipped)
+                .arg(captureStats.motionFramesSkipped)
+                .arg(captureStats.recordingFramesSkipped);
+    hint += tr("Motion queue: %1, dropped: %2, latency: %3 ms%4\n")
+                .arg(static_cast<qulonglong>(captureStats.motionQueueDepth))
+                .arg(captureStats.motionFramesDropped)
+                .arg(captureStats.motionLatencyMillisecs, 0, 'f', 1)
+                .arg(motionSource);
+    hint += tr("Motion engine: %1, analysing: %2 FPS, cost: %3 ms\n")
+                .arg(engineName)
+                .arg(captureStats.motionAnalysisFps, 0, 'f', 1)
+                .arg(captureStats.motionEngineMillisecs, 0, 'f', 2);
+    hint += tr("Motion pre-roll: %1 s, %2 MB\n")
+                .arg(captureStats.preRollSecs, 0, 'f', 1)
+                .arg(static_cast<double>(captureStats.preRollBytes) / BYTES_IN_MEBIBYTE, 0, 'f', 1);
+    hint += tr("Recording queue: %1, dropped: %2, encode time: %3 ms\n")
+                .arg(static_cast<qulonglong>(captureStats.writerQueueDepth))
+                .arg(captureStats.writerFramesDropped)
+                .arg(captureStats.encodeMillisecs, 0, 'f', 1);
+    hint += tr("Frame buffers: %1, most in use: %2, overflows: %3")
+                .arg(static_cast<qulonglong>(captureStats.framePoolBuffers))
+                .arg(static_cast<qulonglong>(captureStats.framePoolHighWaterMark))
+                .arg(captureStats.framePoolOverflows);
+
+    switch (camId)
+    {
+    case ipfreely::eCamId::cam1:
+        ui->camFeed1GroupBox->setToolTip(hint);
+        break;
+    case ipfreely::eCamId::cam2:
+        ui->camFeed2GroupBox->setToolTip(hint);
+        break;
+    case ipfreely::eCamId::cam3:
+        ui->camFeed3GroupBox->setToolTip(hint);
+        break;
+    case ipfreely::eCamId::cam4:
+        ui->camFeed4GroupBox->setToolTip(hint);
+        break;
+    case ipfreely::eCamId::noCam:
+        // Do nothing.
+        break;
+    }
+}
+
 void IpFreelyMainWindow::ShowExpandedVideoForm(ipfreely::eCamId const camId)
 {
     if (m_videoForm->isVisible())
@@ -1589,6 +1766,7 @@ void IpFreelyMainWindow::RemoveMotionRegions(ipfreely::eCamId const camId)
 
     m_camMotionRegions[camId].clear();
     camera.motionRegions = m_camMotionRegions[camId];
+    camera.motionRegionThresholds.clear();
     m_camDb.UpdateCamera(camera);
     m_camDb.Save();
 
@@ -28,8 +28,10 @@
 #include <QMainWindow>
 #include <QImage>
 #include <QPoint>
+#include <QSize>
 #include <memory>
 #include <map>
+#include <chrono>
 #include "IpFreelyPreferences.h"
 #include "IpFreelyCameraDatabase.h"
 
@@ -43,6 +45,10 @@ namespace ipfreely
 {
 class IpFreelyStreamProcessor;
 class IpFreelyDiskSpaceManager;
+class IpFreelyRecordingCatalog;
+class IpFreelyDeletionQueue;
+class IpFreelyWorkerPool;
+struct CaptureStatistics;
 } // namespace ipfreely
 
 class QToolButton;
@@ -60,6 +66,7 @@ class IpFreelyMainWindow : public QMainWindow
     Q_OBJECT
 
     typedef std::shared_ptr<ipfreely::IpFreelyStreamProcessor> stream_proc_t;
+    typedef std::chrono::steady_clock::time_point              time_point_t;
 
 public:
     /*!
@@ -125,9 +132,12 @@ private:
     void     RecordActionHandler(ipfreely::eCamId const camId, QToolButton* recordBtn);
     QWidget* GetParentFrame(ipfreely::eCamId const camId) const;
     void     UpdateCamFeedFrame(ipfreely::eCamId const camId, QImage const& videoFrame,
-                                QRect const& motionBoundingRect, bool const streamProcIsWriting);
+                                QSize const& originalSize, QRect const& motionBoundingRect,
+                                bool const streamProcIsWriting);
     void     SaveImageSnapshot(ipfreely::eCamId const camId);
     void     SetFpsInTitle(ipfreely::eCamId const camId, double fps, double originalFps);
+    void     SetStatisticsInToolTip(ipfreely::eCamId const               camId,
+                                    ipfreely::CaptureStatistics const& captureStats);
     void     ShowExpandedVideoForm(ipfreely::eCamId const camId);
     void     ViewStorage(ipfreely::IpCamera const& camera);
     void     VideoFrameAreaSelection(int const cameraId, QRectF const& percentageSelection);
@@ -148,7 +158,11 @@ private:
     std::map<ipfreely::eCamId, IpFreelyVideoFrame*>           m_camFeeds;
     std::map<ipfreely::eCamId, ipfreely::IpCamera::regions_t> m_camMotionRegions;
     std::map<ipfreely::eCamId, bool>                          m_motionAreaSetupEnabled;
+    std::map<ipfreely::eCamId, time_point_t>                  m_toolTipUpdateTimes;
+    std::shared_ptr<ipfreely::IpFreelyWorkerPool>             m_motionWorkerPool;
     std::map<ipfreely::eCamId, stream_proc_t>                 m_streamProcessors;
+    std::shared_ptr<ipfreely::IpFreelyRecordingCatalog>       m_recordingCatalog;
+    std::shared_ptr<ipfreely::IpFreelyDeletionQueue>          m_deletionQueue;
     std::shared_ptr<ipfreely::IpFreelyDiskSpaceManager>       m_diskSpaceMgr;
 };
 
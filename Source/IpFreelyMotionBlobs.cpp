@@ -0,0 +1,193 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+
+/*!
+ * \file IpFreelyMotionBlobs.cpp
+ * \brief File containing definition of IpFreelyMotionBlobs class.
+ */
+#include "IpFreelyMotionBlobs.h"
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/throw_exception.hpp>
+
+namespace ipfreely
+{
+
+static constexpr int NO_BLOB = -1;
+
+namespace utils
+{
+
+inline int SkipStill(uint8_t const* row, int x, int const cols)
+{
+    // Most of a motion mask is still so skip it 8 pixels at a time.
+    while (x + static_cast<int>(sizeof(uint64_t)) <= cols)
+    {
+        uint64_t pixels;
+        std::memcpy(&pixels, row + x, sizeof(pixels));
+
+        if (pixels != 0)
+        {
+            break;
+        }
+
+        x += static_cast<int>(sizeof(pixels));
+    }
+
+    while ((x < cols) && (row[x] == 0))
+    {
+        ++x;
+    }
+
+    return x;
+}
+
+inline int SkipMoving(uint8_t const* row, int x, int const cols)
+{
+    while ((x < cols) && (row[x] != 0))
+    {
+        ++x;
+    }
+
+    return x;
+}
+
+} // namespace utils
+
+std::vector<MotionBlob> const& IpFreelyMotionBlobs::FindBlobs(cv::Mat const& motionMask)
+{
+    if (motionMask.type() != CV_8UC1)
+    {
+        BOOST_THROW_EXCEPTION(std::invalid_argument("Blob labeller needs an 8-bit motion mask."));
+    }
+
+    m_runs.clear();
+    m_parents.clear();
+    m_blobs.clear();
+
+    size_t prevRowBegin = 0;
+    size_t prevRowEnd   = 0;
+
+    for (int y = 0; y < motionMask.rows; ++y)
+    {
+        auto   row      = motionMask.ptr<uint8_t>(y);
+        size_t rowBegin = m_runs.size();
+        size_t prev     = prevRowBegin;
+        int    x        = utils::SkipStill(row, 0, motionMask.cols);
+
+        while (x < motionMask.cols)
+        {
+            Run run;
+            run.row   = y;
+            run.start = x;
+            run.end   = utils::SkipMoving(row, x, motionMask.cols);
+            run.label = static_cast<int>(m_parents.size());
+            m_parents.push_back(run.label);
+
+            // Runs in the row above that end before this run starts, diagonals
+            // included, can't touch this run or any later run in this row.
+            while ((prev < prevRowEnd) && (m_runs[prev].end < run.start))
+            {
+                ++prev;
+            }
+
+            for (auto above = prev; (above < prevRowEnd) && (m_runs[above].start <= run.end);
+                 ++above)
+            {
+                Join(run.label, m_runs[above].label);
+            }
+
+            m_runs.push_back(run);
+            x = utils::SkipStill(row, run.end, motionMask.cols);
+        }
+
+        prevRowBegin = rowBegin;
+        prevRowEnd   = m_runs.size();
+    }
+
+    // Roots are always a blob's lowest label, i.e. its first run, so
+    // numbering roots in label order gives the blobs top to bottom.
+    m_blobIndices.assign(m_parents.size(), NO_BLOB);
+
+    for (auto const& run : m_runs)
+    {
+        auto  root  = FindRoot(run.label);
+        auto& index = m_blobIndices[static_cast<size_t>(root)];
+
+        if (index == NO_BLOB)
+        {
+            index = static_cast<int>(m_blobs.size());
+
+            MotionBlob blob;
+            blob.bounds = cv::Rect(run.start, run.row, run.end - run.start, 1);
+            blob.pixels = run.end - run.start;
+            m_blobs.push_back(blob);
+        }
+        else
+        {
+            auto& blob = m_blobs[static_cast<size_t>(index)];
+            blob.bounds |= cv::Rect(run.start, run.row, run.end - run.start, 1);
+            blob.pixels += run.end - run.start;
+        }
+    }
+
+    return m_blobs;
+}
+
+int IpFreelyMotionBlobs::FindRoot(int label)
+{
+    auto root = label;
+
+    while (m_parents[static_cast<size_t>(root)] != root)
+    {
+        root = m_parents[static_cast<size_t>(root)];
+    }
+
+    // Point the whole path at the root so later finds are quick.
+    while (m_parents[static_cast<size_t>(label)] != root)
+    {
+        auto next                             = m_parents[static_cast<size_t>(label)];
+        m_parents[static_cast<size_t>(label)] = root;
+        label                                 = next;
+    }
+
+    return root;
+}
+
+void IpFreelyMotionBlobs::Join(int const label1, int const label2)
+{
+    auto root1 = FindRoot(label1);
+    auto root2 = FindRoot(label2);
+
+    // The lower label is kept as the root, see FindBlobs.
+    if (root1 < root2)
+    {
+        m_parents[static_cast<size_t>(root2)] = root1;
+    }
+    else if (root2 < root1)
+    {
+        m_parents[static_cast<size_t>(root1)] = root2;
+    }
+}
+
+} // namespace ipfreely
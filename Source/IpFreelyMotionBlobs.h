@@ -0,0 +1,100 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+
+/*!
+ * \file IpFreelyMotionBlobs.h
+ * \brief File containing declaration of IpFreelyMotionBlobs class.
+ */
+#ifndef IPFREELYMOTIONBLOBS_H
+#define IPFREELYMOTIONBLOBS_H
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+/*! \brief Structure holding a blob of connected moving pixels. */
+struct MotionBlob final
+{
+    /*! \brief Bounding rectangle of the blob's pixels. */
+    cv::Rect bounds{};
+
+    /*! \brief Number of pixels in the blob. */
+    int pixels{0};
+};
+
+/*!
+ * \brief Class defining a connected component labeller for motion masks.
+ *
+ * Each row of the mask is split into runs of moving pixels, which are joined to the 8-connected
+ * runs of the row above with a union-find, so the cost is proportional to the number of runs
+ * rather than pixels. The blobs have the same bounds and pixel counts as the components
+ * cv::connectedComponentsWithStats finds with 8-connectivity. The labeller keeps its buffers
+ * between masks so labelling doesn't allocate once they're big enough.
+ */
+class IpFreelyMotionBlobs final
+{
+public:
+    /*! \brief IpFreelyMotionBlobs default constructor. */
+    IpFreelyMotionBlobs() = default;
+
+    /*! \brief IpFreelyMotionBlobs default destructor. */
+    ~IpFreelyMotionBlobs() = default;
+
+    /*! \brief IpFreelyMotionBlobs deleted copy constructor. */
+    IpFreelyMotionBlobs(IpFreelyMotionBlobs const&) = delete;
+
+    /*! \brief IpFreelyMotionBlobs deleted copy assignment operator. */
+    IpFreelyMotionBlobs& operator=(IpFreelyMotionBlobs const&) = delete;
+
+    /*!
+     * \brief FindBlobs finds the blobs of connected moving pixels in a motion mask.
+     * \param[in] motionMask - 8-bit motion mask, non-zero pixels are moving.
+     * \return The blobs, top to bottom by their first row, valid until the next call.
+     */
+    std::vector<MotionBlob> const& FindBlobs(cv::Mat const& motionMask);
+
+private:
+    /*! \brief Structure holding a run of moving pixels in a row. */
+    struct Run final
+    {
+        int row{0};
+        int start{0};
+        int end{0};
+        int label{0};
+    };
+
+private:
+    int  FindRoot(int label);
+    void Join(int label1, int label2);
+
+private:
+    std::vector<Run>        m_runs{};
+    std::vector<int>        m_parents{};
+    std::vector<int>        m_blobIndices{};
+    std::vector<MotionBlob> m_blobs{};
+};
+
+} // namespace ipfreely
+
+#endif // IPFREELYMOTIONBLOBS_H
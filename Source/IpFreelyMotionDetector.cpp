@@ -23,76 +23,109 @@
  * \brief File containing definition of IpFreelyMotionDetector threaded class.
  */
 #include "IpFreelyMotionDetector.h"
-#include <sstream>
-#include <cmath>
 #include <cstdint>
-#include <boost/throw_exception.hpp>
-#include <boost/filesystem.hpp>
+#include <cmath>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/exception/all.hpp>
 #include "StringUtils/StringUtils.h"
 #include "DebugLog/DebugLogging.h"
 
-namespace bfs = boost::filesystem;
-
 namespace ipfreely
 {
 
-static constexpr int    MESSAGE_ID           = 1;
-static constexpr double DIFF_MAX_VALUE       = 255.0;
-static constexpr int    IDEAL_FRAME_HEIGHT   = 600;
-static constexpr size_t HOLD_ON_OFF_SECS     = 10;
-static constexpr int    BOUNDING_RECT_MARGIN = 1;
+static constexpr int    IDEAL_FRAME_HEIGHT    = 600;
+static constexpr int    BOUNDING_RECT_MARGIN  = 1;
+static constexpr size_t MOTION_QUEUE_CAPACITY = 4;
+static constexpr double LATENCY_AVE_FACTOR    = 0.9;
+static constexpr int    REGION_PADDING        = 1;
+static constexpr double MASKED_THRESHOLD      = 255.0;
+static constexpr double RECT_SHRINK_FACTOR    = 0.25;
+static constexpr double MAX_GREY_GAP_PERIODS  = 5.0;
 
 #if defined(MOTION_DETECTOR_DEBUG)
 static constexpr int CONTOUR_LINE_THICKNESS = 2;
 #endif
 
-IpFreelyMotionDetector::IpFreelyMotionDetector(std::string const& name,
-                                               IpCamera const&    cameraDetails,
-                                               std::string const& saveFolderPath,
-                                               double const       requiredFileDurationSecs,
-                                               double const fps, int const originalWidth,
-                                               int const originalHeight)
+namespace utils
+{
+
+inline double LapMillisecs(std::chrono::steady_clock::time_point& lapStart)
+{
+    auto now       = std::chrono::steady_clock::now();
+    auto millisecs = std::chrono::duration<double, std::milli>(now - lapStart).count();
+    lapStart       = now;
+    return millisecs;
+}
+
+} // namespace utils
+
+IpFreelyMotionDetector::IpFreelyMotionDetector(
+    std::string const& name, IpCamera const& cameraDetails, double const fps,
+    int const originalWidth, int const originalHeight,
+    std::shared_ptr<IpFreelyWorkerPool> const& workerPool)
     : m_name(core_lib::string_utils::RemoveIllegalChars(name))
     , m_cameraDetails(cameraDetails)
-    , m_saveFolderPath(saveFolderPath)
-    , m_requiredFileDurationSecs(requiredFileDurationSecs)
     , m_fps(fps)
+    , m_analysisFps((m_cameraDetails.motionAnalysisFps > 0.0)
+                        ? std::min(m_cameraDetails.motionAnalysisFps, m_fps)
+                        : m_fps)
     , m_originalWidth(originalWidth)
     , m_originalHeight(originalHeight)
     , m_updatePeriodMillisecs(static_cast<unsigned int>(1000.0 / m_fps))
-    , m_erosionKernel(cv::getStructuringElement(cv::MORPH_RECT, cv::Size(2, 2)))
-    , m_holdOffFrameCountLimit(static_cast<size_t>(std::ceil(m_fps)) * HOLD_ON_OFF_SECS)
-    , m_msgQueueThread(std::bind(&IpFreelyMotionDetector::MessageDecoder, std::placeholders::_1),
-                       core_lib::threads::eOnDestroyOptions::processRemainingItems)
+    , m_queue((m_cameraDetails.motionQueuePolicy == eMotionQueuePolicy::latestOnly)
+                  ? 1
+                  : MOTION_QUEUE_CAPACITY)
+    , m_workerPool(workerPool)
 {
-    bfs::path p(m_saveFolderPath);
-    p = bfs::system_complete(p);
-
-    if (!bfs::exists(p))
+    if (!m_workerPool)
     {
-        if (!bfs::create_directories(p))
-        {
-            std::ostringstream oss;
-            oss << "Failed to create directories: " << p.string();
-            BOOST_THROW_EXCEPTION(std::runtime_error(oss.str()));
-        }
+        BOOST_THROW_EXCEPTION(std::invalid_argument("Motion detector requires a worker pool."));
     }
 
     Initialise();
 
-    DEBUG_MESSAGE_EX_INFO("Started motion detector for stream at: "
-                          << m_cameraDetails.streamUrl
-                          << ", required file duration (in seconds) set to: "
-                          << m_requiredFileDurationSecs);
+    DEBUG_MESSAGE_EX_INFO("Started motion detector for stream at: " << m_cameraDetails.streamUrl);
 
-    m_msgQueueThread.RegisterMessageHandler(
-        MESSAGE_ID,
-        std::bind(&IpFreelyMotionDetector::MessageHandler, this, std::placeholders::_1));
+    m_workerClient =
+        m_workerPool->AddClient(std::bind(&IpFreelyMotionDetector::AnalyseNextFrame, this));
 }
 
-void IpFreelyMotionDetector::AddNextFrame(cv::Mat const& videoFrame)
+IpFreelyMotionDetector::~IpFreelyMotionDetector()
 {
-    m_msgQueueThread.Push(std::make_shared<cv::Mat>(videoFrame));
+    // Wait for any analysis in progress before releasing any queued frames.
+    m_workerPool->RemoveClient(m_workerClient);
+    m_queue.Clear();
+}
+
+void IpFreelyMotionDetector::AddNextFrame(cv::Mat                                      videoFrame,
+                                          std::chrono::steady_clock::time_point const& timestamp,
+                                          cv::Mat motionVectors)
+{
+    QueuedFrame frame;
+    frame.timestamp     = timestamp;
+    frame.videoFrame    = std::move(videoFrame);
+    frame.motionVectors = std::move(motionVectors);
+
+    // Both policies drop the oldest queued frames, skipping to the
+    // latest frame simply means the queue only holds one frame.
+    auto dropped = m_queue.PushDropOldest(std::move(frame));
+
+    m_workerPool->Notify(m_workerClient);
+
+    if (dropped == 0)
+    {
+        m_queueFullWarned = false;
+        return;
+    }
+
+    m_framesDropped += dropped;
+
+    if (!m_queueFullWarned.exchange(true))
+    {
+        DEBUG_MESSAGE_EX_WARNING("Motion detector falling behind, dropping frames for camera: "
+                                 << m_name);
+    }
 }
 
 QRect IpFreelyMotionDetector::CurrentMotionRect() const noexcept
@@ -104,10 +137,51 @@ QRect IpFreelyMotionDetector::CurrentMotionRect() const noexcept
                  m_motionBoundingRect.height);
 }
 
-bool IpFreelyMotionDetector::WritingStream() const noexcept
+bool IpFreelyMotionDetector::MotionInProgress() const noexcept
+{
+    std::lock_guard<std::mutex> lock(m_motionInProgressMutex);
+    return m_motionInProgress;
+}
+
+size_t IpFreelyMotionDetector::QueueDepth() const
+{
+    return m_queue.Size();
+}
+
+uint64_t IpFreelyMotionDetector::FramesDropped() const noexcept
+{
+    return m_framesDropped;
+}
+
+double IpFreelyMotionDetector::LatencyMillisecs() const noexcept
+{
+    return m_latencyMillisecs;
+}
+
+cv::Size IpFreelyMotionDetector::AnalysisFrameSize() const noexcept
+{
+    return m_motionFrameSize;
+}
+
+double IpFreelyMotionDetector::AnalysisFps() const noexcept
+{
+    return m_analysisFps;
+}
+
+double IpFreelyMotionDetector::EngineCostMillisecs() const noexcept
+{
+    return m_motionEngine->CostMillisecs();
+}
+
+uint64_t IpFreelyMotionDetector::FramesAnalysed() const noexcept
+{
+    return m_framesAnalysed;
+}
+
+MotionStageTimings IpFreelyMotionDetector::StageTimings() const
 {
-    std::lock_guard<std::mutex> lock(m_writingMutex);
-    return m_writingStream;
+    std::lock_guard<std::mutex> lock(m_timingsMutex);
+    return m_stageTimings;
 }
 
 void IpFreelyMotionDetector::Initialise()
@@ -128,12 +202,21 @@ void IpFreelyMotionDetector::Initialise()
         DEBUG_MESSAGE_EX_INFO("Full-size video frames for motion detection.");
     }
 
+    // Matches the size cv::resize gives when scaling by m_motionFrameScalar.
+    m_motionFrameSize =
+        cv::Size(cvRound(static_cast<double>(m_originalWidth) * m_motionFrameScalar),
+                 cvRound(static_cast<double>(m_originalHeight) * m_motionFrameScalar));
+
     double const motionFrameArea = static_cast<double>(m_originalHeight * m_originalWidth) *
                                    m_motionFrameScalar * m_motionFrameScalar;
 
     m_minImageChangeArea =
         static_cast<int>(motionFrameArea * m_cameraDetails.minMotionAreaPercentFactor);
 
+    CompileMotionRegions();
+
+    m_motionEngine = CreateMotionEngine(m_cameraDetails, m_analysisFps, m_thresholdMap);
+
     switch (m_cameraDetails.motionDectorMode)
     {
     case eMotionDetectorMode::lowSensitivity:
@@ -149,74 +232,152 @@ void IpFreelyMotionDetector::Initialise()
     case eMotionDetectorMode::manual:
         DEBUG_MESSAGE_EX_INFO("Motion tracking (manual settings) enabled for camera: " << m_name);
         break;
+    case eMotionDetectorMode::motionVectors:
+        DEBUG_MESSAGE_EX_INFO("Motion tracking (motion vectors) enabled for camera: " << m_name);
+        break;
     case eMotionDetectorMode::off:
         // Do nothing - but remove compiler warning
         return;
     }
+
+    DEBUG_MESSAGE_EX_INFO("Motion engine: " << m_motionEngine->Name() << ", analysing "
+                                            << m_analysisFps << " FPS, for camera: " << m_name);
 }
 
-void IpFreelyMotionDetector::InitialiseFrames()
+void IpFreelyMotionDetector::CompileMotionRegions()
 {
-    if (!m_initialiseFrames)
+    cv::Rect const motionFrameRect(cv::Point(0, 0), m_motionFrameSize);
+
+    m_regionRects.clear();
+    m_analysisRect = motionFrameRect;
+    m_thresholdMap.release();
+
+    auto const& regions    = m_cameraDetails.motionRegions;
+    auto const& thresholds = m_cameraDetails.motionRegionThresholds;
+
+    if (regions.empty())
     {
         return;
     }
 
-    m_initialiseFrames = false;
+    // Pixels outside every region are masked out, overlapping regions use the lowest threshold.
+    cv::Mat  thresholdMap(m_motionFrameSize, CV_8UC1, cv::Scalar(MASKED_THRESHOLD));
+    cv::Rect bounds;
 
-    if (m_cameraDetails.shrinkVideoFrames)
-    {
-        cv::resize(*m_originalFrame,
-                   m_prevGreyFrame,
-                   {},
-                   m_motionFrameScalar,
-                   m_motionFrameScalar,
-                   cv::INTER_AREA);
-    }
-    else
+    for (size_t i = 0; i < regions.size(); ++i)
     {
-        m_prevGreyFrame = *m_originalFrame;
-    }
+        auto r = CreateQRectFromVideoFrameDims(m_originalWidth, m_originalHeight, regions[i]);
+        m_regionRects.emplace_back(r.left(), r.top(), r.width(), r.height());
 
-    cv::cvtColor(m_prevGreyFrame, m_prevGreyFrame, cv::COLOR_BGR2GRAY);
+        // Round outwards so pixels on the region's edges are always analysed.
+        cv::Point tl(cvFloor(static_cast<double>(r.left()) * m_motionFrameScalar),
+                     cvFloor(static_cast<double>(r.top()) * m_motionFrameScalar));
+        cv::Point br(cvCeil(static_cast<double>(r.left() + r.width()) * m_motionFrameScalar),
+                     cvCeil(static_cast<double>(r.top() + r.height()) * m_motionFrameScalar));
+        auto      regionRect = cv::Rect(tl, br) & motionFrameRect;
 
-    if (m_cameraDetails.shrinkVideoFrames)
-    {
-        cv::resize(*m_originalFrame,
-                   m_currentGreyFrame,
-                   {},
-                   m_motionFrameScalar,
-                   m_motionFrameScalar,
-                   cv::INTER_AREA);
+        if (regionRect.area() == 0)
+        {
+            continue;
+        }
+
+        // Differences above the threshold count, so flooring keeps fractional thresholds exact.
+        double const threshold = ((i < thresholds.size()) && (thresholds[i] > 0.0))
+                                     ? thresholds[i]
+                                     : m_cameraDetails.pixelThreshold;
+        cv::Mat regionThresholds = thresholdMap(regionRect);
+        cv::min(regionThresholds,
+                cv::Scalar(std::min(std::max(std::floor(threshold), 0.0), MASKED_THRESHOLD)),
+                regionThresholds);
+
+        bounds = (bounds.area() == 0) ? regionRect : (bounds | regionRect);
     }
-    else
+
+    if (bounds.area() == 0)
     {
-        m_currentGreyFrame = *m_originalFrame;
+        DEBUG_MESSAGE_EX_WARNING("Motion regions are outside the video frame for camera: "
+                                 << m_name);
+        return;
     }
 
-    cv::cvtColor(m_currentGreyFrame, m_currentGreyFrame, cv::COLOR_BGR2GRAY);
+    // Pad the bounds so erosion treats the regions' edges as it would in the whole
+    // frame and keep the top left even so the same rows and columns are sampled.
+    cv::Point tl(std::max(bounds.x - REGION_PADDING, 0) & ~1,
+                 std::max(bounds.y - REGION_PADDING, 0) & ~1);
+    cv::Point br(std::min(bounds.br().x + REGION_PADDING, m_motionFrameSize.width),
+                 std::min(bounds.br().y + REGION_PADDING, m_motionFrameSize.height));
+
+    m_analysisRect = cv::Rect(tl, br);
+    m_thresholdMap = thresholdMap(m_analysisRect).clone();
+
+    DEBUG_MESSAGE_EX_INFO("Motion regions cover "
+                          << 100 * m_analysisRect.area() / motionFrameRect.area()
+                          << "% of the analysis frame for camera: " << m_name);
+}
+
+cv::Rect IpFreelyMotionDetector::SourceRect(cv::Size const& frameSize) const
+{
+    // The area of a frame of the given size that scales to the analysis area.
+    double const xScalar =
+        static_cast<double>(frameSize.width) / static_cast<double>(m_motionFrameSize.width);
+    double const yScalar =
+        static_cast<double>(frameSize.height) / static_cast<double>(m_motionFrameSize.height);
+
+    cv::Point tl(cvFloor(static_cast<double>(m_analysisRect.x) * xScalar),
+                 cvFloor(static_cast<double>(m_analysisRect.y) * yScalar));
+    cv::Point br(cvCeil(static_cast<double>(m_analysisRect.br().x) * xScalar),
+                 cvCeil(static_cast<double>(m_analysisRect.br().y) * yScalar));
+
+    return cv::Rect(tl, br) & cv::Rect(cv::Point(0, 0), frameSize);
 }
 
-void IpFreelyMotionDetector::UpdateNextFrame()
+void IpFreelyMotionDetector::ConvertToGrey(cv::Mat& greyFrame, MotionStageTimings& timings)
 {
-    if (m_cameraDetails.shrinkVideoFrames)
+    auto lapStart = std::chrono::steady_clock::now();
+
+    // The motion engines hand back buffers of old grey frames,
+    // so once sized OpenCV converts into the existing buffers.
+    // Only the analysis area covering the motion regions is converted.
+    if (m_originalFrame.channels() == 1)
+    {
+        // Frames from the luma decoder are already grey and are
+        // usually decoded straight to the motion frame's size.
+        if (m_originalFrame.size() == m_motionFrameSize)
+        {
+            m_originalFrame(m_analysisRect).copyTo(greyFrame);
+            timings.greyMillisecs += utils::LapMillisecs(lapStart);
+        }
+        else
+        {
+            cv::resize(m_originalFrame(SourceRect(m_originalFrame.size())),
+                       greyFrame,
+                       m_analysisRect.size(),
+                       0,
+                       0,
+                       cv::INTER_AREA);
+            timings.resizeMillisecs += utils::LapMillisecs(lapStart);
+        }
+    }
+    else if (m_cameraDetails.shrinkVideoFrames)
     {
-        cv::resize(m_nextGreyFrame,
-                   m_nextGreyFrame,
-                   {},
-                   m_motionFrameScalar,
-                   m_motionFrameScalar,
+        cv::resize(m_originalFrame(SourceRect(m_originalFrame.size())),
+                   m_scaledFrame,
+                   m_analysisRect.size(),
+                   0,
+                   0,
                    cv::INTER_AREA);
+        timings.resizeMillisecs += utils::LapMillisecs(lapStart);
+        cv::cvtColor(m_scaledFrame, greyFrame, cv::COLOR_BGR2GRAY);
+        timings.greyMillisecs += utils::LapMillisecs(lapStart);
     }
     else
     {
-        m_nextGreyFrame = *m_originalFrame;
+        cv::cvtColor(m_originalFrame(m_analysisRect), greyFrame, cv::COLOR_BGR2GRAY);
+        timings.greyMillisecs += utils::LapMillisecs(lapStart);
     }
-
-    cv::cvtColor(m_nextGreyFrame, m_nextGreyFrame, cv::COLOR_BGR2GRAY);
 }
 
-bool IpFreelyMotionDetector::DetectMotion()
+bool IpFreelyMotionDetector::DetectMotion(cv::Mat const& motionVectors, double const frameSecs)
 {
     // This algorithm is inspired by an example given here:
     // https://github.com/cedricve/motion-detection
@@ -228,106 +389,171 @@ bool IpFreelyMotionDetector::DetectMotion()
     // out motion regions less than a configurable percentage
     // of the frame's total area.
 
-    // Calculate differences between the images and do AND-operation
-    // then threshold image, low differences are ignored (ex. contrast
-    // change due to sunlight).
-    cv::Mat diff1, diff2, motion;
-    cv::absdiff(m_prevGreyFrame, m_nextGreyFrame, diff1);
-    cv::absdiff(m_nextGreyFrame, m_currentGreyFrame, diff2);
-    cv::bitwise_and(diff1, diff2, motion);
-    cv::threshold(
-        motion, motion, m_cameraDetails.pixelThreshold, DIFF_MAX_VALUE, cv::THRESH_BINARY);
-    cv::erode(motion, motion, m_erosionKernel);
-
-    // Now work out the std dev of the motion frame.
-    cv::Scalar mean, stddev;
-    cv::meanStdDev(motion, mean, stddev);
-
-    // Initialise motion bounding rectangle variables.
-    cv::Rect maxBoundingRect;
-    int      min_x = motion.cols;
-    int      max_x = 0;
-    int      min_y = motion.rows;
-    int      max_y = 0;
+    MotionKernelResult kernelResult;
+    MotionStageTimings timings;
+    cv::Mat*           motionMask = nullptr;
+
+#if defined(MOTION_DETECTOR_DEBUG)
+    motionMask = &m_motionFrame;
+#endif
+
+    // Set when the motion engine's result, for the analysis area only, is used.
+    bool engineResult = false;
+
+    // The motion engine's model is only updated when there is a grey frame. An
+    // occasional missing one is skipped, but after a long gap the model is stale
+    // so it has to start again.
+    bool const greyFrame = !m_originalFrame.empty();
+    m_greyGapSecs += frameSecs;
+
+    if (greyFrame)
+    {
+        if (m_greyGapSecs > (MAX_GREY_GAP_PERIODS / m_analysisFps))
+        {
+            m_motionEngine->Reset();
+        }
+
+        m_greyGapSecs = 0.0;
+        ConvertToGrey(m_greyFrame, timings);
+    }
+
+    auto lapStart = std::chrono::steady_clock::now();
+
+    if (motionVectors.empty())
+    {
+        if (greyFrame)
+        {
+            m_motionEngine->Update(m_greyFrame, &kernelResult, &m_engineMotionMask);
+            engineResult = true;
+        }
+    }
+    else
+    {
+        // Each block of the field counts as moving if its largest motion vector is
+        // above the threshold, which is far cheaper than analysing grey frames.
+        VectorMotionKernel(motionVectors,
+                           m_cameraDetails.motionVectorThreshold,
+                           m_motionFrameSize,
+                           kernelResult,
+                           motionMask,
+                           &m_blockMask);
+
+        // Only pay for the motion engine to find motion when the motion
+        // vectors have found a candidate worth confirming.
+        bool const confirm = greyFrame && m_cameraDetails.confirmMotionVectors &&
+                             kernelResult.changesFound &&
+                             (kernelResult.stdDev < m_cameraDetails.maxMotionStdDev);
+
+        if (greyFrame)
+        {
+            m_motionEngine->Update(m_greyFrame,
+                                   confirm ? &kernelResult : nullptr,
+                                   confirm ? &m_engineMotionMask : nullptr);
+            engineResult = confirm;
+        }
+    }
+
+    timings.engineMillisecs += utils::LapMillisecs(lapStart);
+
+#if defined(MOTION_DETECTOR_DEBUG)
+    if (engineResult)
+    {
+        m_motionFrame = cv::Mat::zeros(m_motionFrameSize, CV_8UC1);
+        m_engineMotionMask.copyTo(m_motionFrame(m_analysisRect));
+    }
+#endif
+
+    m_motionBlobs.clear();
 
     // This check guards against there being too much motion all at once,
     // e.g. changes related to rain, snow, sunlight flares etc.
-    if (stddev[0] < m_cameraDetails.maxMotionStdDev)
+    if (kernelResult.changesFound && (kernelResult.stdDev < m_cameraDetails.maxMotionStdDev))
+    {
+        if (engineResult)
+        {
+            FindMotionBlobs(m_engineMotionMask, m_analysisRect);
+        }
+        else
+        {
+            FindMotionBlobs(m_blockMask, cv::Rect(cv::Point(0, 0), m_motionFrameSize));
+        }
+    }
+
+    bool const motionFound = UpdateMotionRect(frameSecs);
+
+    timings.blobsMillisecs += utils::LapMillisecs(lapStart);
+    timings.frames = 1;
+
+    std::lock_guard<std::mutex> lock(m_timingsMutex);
+    m_stageTimings += timings;
+
+    return motionFound;
+}
+
+void IpFreelyMotionDetector::FindMotionBlobs(cv::Mat const& motionMask, cv::Rect const& maskRect)
+{
+    // Scale each blob from the mask into the area of the motion frame the mask covers,
+    // so a block of the motion vector field covers all of the pixels in the block.
+    for (auto const& blob : m_blobLabeller.FindBlobs(motionMask))
     {
-        size_t numChanges = 0;
+        cv::Point tl(maskRect.x + blob.bounds.x * maskRect.width / motionMask.cols,
+                     maskRect.y + blob.bounds.y * maskRect.height / motionMask.rows);
+        cv::Point br(maskRect.x + blob.bounds.br().x * maskRect.width / motionMask.cols,
+                     maskRect.y + blob.bounds.br().y * maskRect.height / motionMask.rows);
+
+        m_motionBlobs.emplace_back(tl, br);
+    }
+}
+
+bool IpFreelyMotionDetector::UpdateMotionRect(double const frameSecs)
+{
+#if defined(MOTION_DETECTOR_DEBUG)
+    cv::Mat& motion = m_motionFrame;
+#endif
+
+    cv::Rect const motionFrameRect(cv::Point(0, 0), m_motionFrameSize);
+
+    // Bounding rectangle, in the original video frame, of all the blobs that count.
+    cv::Rect minBoundingRect;
+    bool     motionFound = false;
 
-        // Loop over image and detect changes. This is better
-        // for CPU performance compared to using OpenCV's
-        // contour fitting algorithms.
-        for (int j = 0; j < motion.rows; j += 2)
+    for (auto const& blob : m_motionBlobs)
+    {
+        auto blobRect = cv::Rect(blob.x - BOUNDING_RECT_MARGIN,
+                                 blob.y - BOUNDING_RECT_MARGIN,
+                                 blob.width + 2 * BOUNDING_RECT_MARGIN,
+                                 blob.height + 2 * BOUNDING_RECT_MARGIN) &
+                        motionFrameRect;
+
+        // Is the area of motion larger than our threshold. This means
+        // we ignore small, most likely insignificnt motion.
+        if (blobRect.area() <= m_minImageChangeArea)
         {
-            for (int i = 0; i < motion.cols; i += 2)
-            {
-                // check if at pixel (j,i) intensity is equal to 255
-                // this means that the pixel is different in the sequence
-                // of images (prev_frame, current_frame, next_frame)
-                if (static_cast<int>(motion.at<uint8_t>(j, i)) == 255)
-                {
-                    ++numChanges;
-
-                    // Track the boundary of the motion related changes.
-                    if (min_x > i)
-                    {
-                        min_x = i;
-                    }
-
-                    if (max_x < i)
-                    {
-                        max_x = i;
-                    }
-
-                    if (min_y > j)
-                    {
-                        min_y = j;
-                    }
-
-                    if (max_y < j)
-                    {
-                        max_y = j;
-                    }
-                }
-            }
+            continue;
         }
 
-        // If we have some changes create a bounding rectangle
-        // that encompasses all the motion detected.
-        if (numChanges > 0)
+        // Create a motion bounding rectangle scaled to original
+        // video frame's size.
+        cv::Point tl(static_cast<int>(static_cast<double>(blobRect.x) / m_motionFrameScalar),
+                     static_cast<int>(static_cast<double>(blobRect.y) / m_motionFrameScalar));
+        cv::Point br(static_cast<int>(static_cast<double>(blobRect.br().x) / m_motionFrameScalar),
+                     static_cast<int>(static_cast<double>(blobRect.br().y) / m_motionFrameScalar));
+
+        auto videoRect = cv::Rect(tl, br);
+
+        if (!IntersectsMotionRegion(videoRect))
         {
-            if (min_x - BOUNDING_RECT_MARGIN > 0)
-            {
-                min_x -= BOUNDING_RECT_MARGIN;
-            }
-
-            if (min_y - BOUNDING_RECT_MARGIN > 0)
-            {
-                min_y -= BOUNDING_RECT_MARGIN;
-            }
-
-            if (max_x + BOUNDING_RECT_MARGIN < (motion.cols - 1))
-            {
-                max_x += BOUNDING_RECT_MARGIN;
-            }
-
-            if (max_y + BOUNDING_RECT_MARGIN < (motion.rows - 1))
-            {
-                max_y += BOUNDING_RECT_MARGIN;
-            }
-
-            cv::Point x(min_x, min_y);
-            cv::Point y(max_x, max_y);
-            maxBoundingRect = cv::Rect(x, y);
+            continue;
         }
 
+        minBoundingRect = motionFound ? (minBoundingRect | videoRect) : videoRect;
+        motionFound     = true;
+
 #if defined(MOTION_DETECTOR_DEBUG)
-        // Draw bounding rectangle on motion frame.
+        // Draw blob's bounding rectangle on motion frame.
         cv::rectangle(motion,
-                      maxBoundingRect.tl(),
-                      maxBoundingRect.br(),
+                      blobRect.tl(),
+                      blobRect.br(),
                       cv::Scalar(255, 255, 255),
                       CONTOUR_LINE_THICKNESS,
                       cv::LINE_8);
@@ -338,40 +564,27 @@ bool IpFreelyMotionDetector::DetectMotion()
     imshow("motion", motion);
 #endif
 
-    // Is the area of motion larger than our threshold. This means
-    // we ignore small, most likely insignificnt motion.
-    if (maxBoundingRect.area() > m_minImageChangeArea)
-    {
-        // Create a motion bounding rectangle scaled to original
-        // video frame's size.
-        cv::Point tl1(static_cast<int>(static_cast<double>(min_x) / m_motionFrameScalar),
-                      static_cast<int>(static_cast<double>(min_y) / m_motionFrameScalar));
-        cv::Point br1(static_cast<int>(static_cast<double>(max_x) / m_motionFrameScalar),
-                      static_cast<int>(static_cast<double>(max_y) / m_motionFrameScalar));
-
-        auto minBoundingRect = cv::Rect(tl1, br1);
+    // The smoothing factors are per frame at the video's FPS, so they're
+    // compounded over the video frames since the last analysed frame.
+    double const videoFrames     = frameSecs * m_fps;
+    double const aveFactor       = std::pow(m_cameraDetails.motionAreaAveFactor, videoFrames);
+    double const heightAveFactor = std::pow(RECT_SHRINK_FACTOR, videoFrames);
 
+    if (motionFound)
+    {
         // To make the bounding rectangle appear less janky we'll
         // combine it with the previous bounding rectangle using a
         // smoothing rolling average controlled by the smoothing factor.
         std::lock_guard<std::mutex> lock(m_motionMutex);
 
-        double l = (static_cast<double>(m_motionBoundingRect.tl().x) *
-                    m_cameraDetails.motionAreaAveFactor) +
-                   (static_cast<double>(minBoundingRect.tl().x) *
-                    (1.0 - m_cameraDetails.motionAreaAveFactor));
-        double t = (static_cast<double>(m_motionBoundingRect.tl().y) *
-                    m_cameraDetails.motionAreaAveFactor) +
-                   (static_cast<double>(minBoundingRect.tl().y) *
-                    (1.0 - m_cameraDetails.motionAreaAveFactor));
-        double r = (static_cast<double>(m_motionBoundingRect.br().x) *
-                    m_cameraDetails.motionAreaAveFactor) +
-                   (static_cast<double>(minBoundingRect.br().x) *
-                    (1.0 - m_cameraDetails.motionAreaAveFactor));
-        double b = (static_cast<double>(m_motionBoundingRect.br().y) *
-                    m_cameraDetails.motionAreaAveFactor) +
-                   (static_cast<double>(minBoundingRect.br().y) *
-                    (1.0 - m_cameraDetails.motionAreaAveFactor));
+        double l = (static_cast<double>(m_motionBoundingRect.tl().x) * aveFactor) +
+                   (static_cast<double>(minBoundingRect.tl().x) * (1.0 - aveFactor));
+        double t = (static_cast<double>(m_motionBoundingRect.tl().y) * aveFactor) +
+                   (static_cast<double>(minBoundingRect.tl().y) * (1.0 - aveFactor));
+        double r = (static_cast<double>(m_motionBoundingRect.br().x) * aveFactor) +
+                   (static_cast<double>(minBoundingRect.br().x) * (1.0 - aveFactor));
+        double b = (static_cast<double>(m_motionBoundingRect.br().y) * aveFactor) +
+                   (static_cast<double>(minBoundingRect.br().y) * (1.0 - aveFactor));
 
         cv::Point tl2(static_cast<int>(l), static_cast<int>(t));
         cv::Point br2(static_cast<int>(r), static_cast<int>(b));
@@ -388,43 +601,29 @@ bool IpFreelyMotionDetector::DetectMotion()
                    static_cast<int>(static_cast<double>(m_motionBoundingRect.width) * 0.5);
         double t = m_motionBoundingRect.tl().y +
                    static_cast<int>(static_cast<double>(m_motionBoundingRect.height) * 0.5);
-        double w =
-            (static_cast<double>(m_motionBoundingRect.width) * m_cameraDetails.motionAreaAveFactor);
-        double h = (static_cast<double>(m_motionBoundingRect.height) * 0.25);
+        double w = (static_cast<double>(m_motionBoundingRect.width) * aveFactor);
+        double h = (static_cast<double>(m_motionBoundingRect.height) * heightAveFactor);
 
         m_motionBoundingRect = cv::Rect(
             static_cast<int>(l), static_cast<int>(t), static_cast<int>(w), static_cast<int>(h));
     }
 
-    return CheckForIntersections();
+    return motionFound;
 }
 
-bool IpFreelyMotionDetector::CheckForIntersections()
+bool IpFreelyMotionDetector::IntersectsMotionRegion(cv::Rect const& videoRect) const
 {
-    if (m_motionBoundingRect.area() == 0)
-    {
-        return false;
-    }
-
-    if (m_cameraDetails.motionRegions.empty())
+    if (m_regionRects.empty())
     {
         return true;
     }
 
-    QRect mr(m_motionBoundingRect.tl().x,
-             m_motionBoundingRect.tl().y,
-             m_motionBoundingRect.width,
-             m_motionBoundingRect.height);
-
-    bool motionIntersection{false};
-
-    for (auto const& region : m_cameraDetails.motionRegions)
+    // The regions' rectangles were worked out once by CompileMotionRegions.
+    for (size_t i = 0; i < m_regionRects.size(); ++i)
     {
-        auto r = ipfreely::CreateQRectFromVideoFrameDims(m_originalWidth, m_originalHeight, region);
-
-        if (mr.intersects(r))
+        if ((videoRect & m_regionRects[i]).area() > 0)
         {
-            motionIntersection = true;
+            auto const& region = m_cameraDetails.motionRegions[i];
 
             DEBUG_MESSAGE_EX_INFO("Motion detector intersection found for camera stream URL: "
                                   << m_cameraDetails.streamUrl << ", region details: L = "
@@ -432,156 +631,115 @@ bool IpFreelyMotionDetector::CheckForIntersections()
                                   << ", W = " << region.second.first
                                   << ", H = " << region.second.second);
 
-            break;
+            return true;
         }
     }
 
-    return motionIntersection;
-}
-
-void IpFreelyMotionDetector::RotateFrames()
-{
-    m_prevGreyFrame    = m_currentGreyFrame;
-    m_currentGreyFrame = m_nextGreyFrame;
-}
-
-int IpFreelyMotionDetector::MessageDecoder(video_frame_t const& /*msg*/)
-{
-    return MESSAGE_ID;
+    return false;
 }
 
-bool IpFreelyMotionDetector::MessageHandler(video_frame_t& msg)
+bool IpFreelyMotionDetector::AnalyseNextFrame() noexcept
 {
-    m_originalFrame = msg;
-
-    // Get current time stamp.
-    m_currentTime = time(nullptr);
+    bool moreFrames = false;
+    bool analysed   = false;
 
-    InitialiseFrames();
-    UpdateNextFrame();
-
-    bool recording      = m_videoWriter.get() != nullptr;
-    bool motionDetected = false;
-
-    if (DetectMotion())
+    try
     {
-        motionDetected = true;
+        QueuedFrame frame;
 
-        // Reset hold-off count if we've detected motion.
-        m_holdOffFrameCount = 0;
-    }
-    else
-    {
-        // If recording in progress increment hold-off count.
-        if (recording)
+        if (m_queue.Pop(frame, 0))
         {
-            ++m_holdOffFrameCount;
+            analysed = true;
+            AnalyseFrame(frame);
         }
-    }
 
-    // If hold-off count reached then reset count and reset writer
-    // and finally set recording flag to false.
-    if (m_holdOffFrameCount == m_holdOffFrameCountLimit)
+        moreFrames = m_queue.Size() > 0;
+    }
+    catch (...)
     {
-        DEBUG_MESSAGE_EX_INFO("Motion detector hold-off period finished, camera stream URL: "
-                              << m_cameraDetails.streamUrl);
-
-        m_holdOffFrameCount = 0;
-        m_videoWriter.release();
-        recording = false;
-        SetWritingStream(false);
+        auto exceptionMsg = boost::current_exception_diagnostic_information();
+        DEBUG_MESSAGE_EX_ERROR(exceptionMsg);
     }
 
-    if (motionDetected || recording)
+    // Only counted once the frame has been released, even if its analysis failed.
+    if (analysed)
     {
-        CreateCaptureObjects();
+        ++m_framesAnalysed;
     }
 
-    WriteVideoFrame();
-    RotateFrames();
-
-    return true;
+    return moreFrames;
 }
 
-void IpFreelyMotionDetector::CreateCaptureObjects()
+void IpFreelyMotionDetector::AnalyseFrame(QueuedFrame const& frame)
 {
-    if (m_videoWriter)
-    {
-        if (m_fileDurationSecs < m_requiredFileDurationSecs)
-        {
-            return;
-        }
+    m_originalFrame = frame.videoFrame;
 
-        DEBUG_MESSAGE_EX_INFO(
-            "Motion detector file duration reached for current video file, camera stream URL: "
-            << m_cameraDetails.streamUrl << ", file writer being closed.");
+    bool const useVectors =
+        (m_cameraDetails.motionDectorMode == eMotionDetectorMode::motionVectors) &&
+        !frame.motionVectors.empty();
 
-        m_videoWriter.release();
-        SetWritingStream(false);
-    }
+    if (!useVectors && (m_cameraDetails.motionDectorMode == eMotionDetectorMode::motionVectors) &&
+        !m_vectorFallbackWarned)
+    {
+        m_vectorFallbackWarned = true;
 
-    auto localTime = std::localtime(&m_currentTime);
-    char folderName[9];
-    std::strftime(folderName, sizeof(folderName), "%Y%m%d", localTime);
+        DEBUG_MESSAGE_EX_WARNING("Motion vectors unavailable, using motion engine for camera: "
+                                 << m_name);
+    }
 
-    bfs::path p(m_saveFolderPath);
-    p /= folderName;
-    p = bfs::system_complete(p);
+    // Time since the last analysed frame, which depends on the analysis FPS and any dropped frames.
+    double frameSecs = 1.0 / m_analysisFps;
 
-    if (!bfs::exists(p))
+    if (m_lastFrameTime != std::chrono::steady_clock::time_point())
     {
-        if (!bfs::create_directories(p))
-        {
-            std::ostringstream oss;
-            oss << "Failed to create directories: " << p.string();
-            BOOST_THROW_EXCEPTION(std::runtime_error(oss.str()));
-        }
+        frameSecs = std::chrono::duration<double>(frame.timestamp - m_lastFrameTime).count();
     }
 
-    std::ostringstream oss;
-    oss << m_name << "_motion_" << m_currentTime << ".avi";
+    m_lastFrameTime = frame.timestamp;
 
-    p /= oss.str();
+    bool inProgress     = MotionInProgress();
+    bool motionDetected = DetectMotion(useVectors ? frame.motionVectors : cv::Mat(), frameSecs);
 
-    DEBUG_MESSAGE_EX_INFO("Creating new output video file: " << p.string() << ", FPS: " << m_fps);
+    if (motionDetected)
+    {
+        m_lastMotionTime = frame.timestamp;
 
-    m_fileDurationSecs = 0.0;
+        if (!inProgress)
+        {
+            SetMotionInProgress(true);
+        }
+    }
+    else if (inProgress)
+    {
+        // If the post-roll period has passed without motion then
+        // the motion event is over.
+        auto secsSinceMotion =
+            std::chrono::duration<double>(frame.timestamp - m_lastMotionTime).count();
 
-#if BOOST_OS_WINDOWS
-    m_videoWriter = cv::makePtr<cv::VideoWriter>(p.string().c_str(),
-                                                 cv::VideoWriter::fourcc('D', 'I', 'V', 'X'),
-                                                 m_fps,
-                                                 cv::Size(m_originalWidth, m_originalHeight));
-#else
-    m_videoWriter = cv::makePtr<cv::VideoWriter>(p.string().c_str(),
-                                                 cv::VideoWriter::fourcc('X', 'V', 'I', 'D'),
-                                                 m_fps,
-                                                 cv::Size(m_originalWidth, m_originalHeight));
-#endif
+        if (secsSinceMotion >= m_cameraDetails.motionPostRollSecs)
+        {
+            DEBUG_MESSAGE_EX_INFO("Motion detector post-roll period finished, camera stream URL: "
+                                  << m_cameraDetails.streamUrl);
 
-    if (!m_videoWriter->isOpened())
-    {
-        m_videoWriter.release();
-        DEBUG_MESSAGE_EX_ERROR("Failed to open VideoWriter object: " << p.string());
-        return;
+            SetMotionInProgress(false);
+        }
     }
 
-    SetWritingStream(true);
-}
+    // Return the frame's buffer to the stream processor's frame pool.
+    m_originalFrame.release();
 
-void IpFreelyMotionDetector::WriteVideoFrame()
-{
-    if (m_videoWriter)
-    {
-        *m_videoWriter << *m_originalFrame;
-        m_fileDurationSecs += static_cast<double>(m_updatePeriodMillisecs) / 1000.0;
-    }
+    auto latencyMillisecs = std::chrono::duration<double, std::milli>(
+                                std::chrono::steady_clock::now() - frame.timestamp)
+                                .count();
+
+    m_latencyMillisecs = (m_latencyMillisecs * LATENCY_AVE_FACTOR) +
+                         (latencyMillisecs * (1.0 - LATENCY_AVE_FACTOR));
 }
 
-void IpFreelyMotionDetector::SetWritingStream(bool const writing) noexcept
+void IpFreelyMotionDetector::SetMotionInProgress(bool const inProgress) noexcept
 {
-    std::lock_guard<std::mutex> lock(m_writingMutex);
-    m_writingStream = writing;
+    std::lock_guard<std::mutex> lock(m_motionInProgressMutex);
+    m_motionInProgress = inProgress;
 }
 
 } // namespace ipfreely
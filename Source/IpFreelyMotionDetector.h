@@ -28,42 +28,117 @@
 #include <QRect>
 #include <string>
 #include <memory>
-#include <ctime>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <utility>
+#include <vector>
+#include <cstdint>
 #include <opencv2/opencv.hpp>
-#include "Threads/MessageQueueThread.h"
 #include "IpFreelyCameraDatabase.h"
+#include "IpFreelyBoundedQueue.h"
+#include "IpFreelyWorkerPool.h"
+#include "IpFreelyMotionKernel.h"
+#include "IpFreelyMotionEngine.h"
+#include "IpFreelyMotionBlobs.h"
 
 /*! \brief The ipfreely namespace. */
 namespace ipfreely
 {
 
-/*! \brief Class defining a motion detector. */
+/*! \brief Structure holding the motion detector's total time spent in each stage of analysis. */
+struct MotionStageTimings final
+{
+    /*! \brief Frames analysed. */
+    uint64_t frames{0};
+
+    /*! \brief Time scaling frames to the analysis frame's size. */
+    double resizeMillisecs{0.0};
+
+    /*! \brief Time converting or copying frames to grey. */
+    double greyMillisecs{0.0};
+
+    /*! \brief Time finding motion, in the motion engine or from motion vectors. */
+    double engineMillisecs{0.0};
+
+    /*! \brief Time finding and checking the motion blobs. */
+    double blobsMillisecs{0.0};
+
+    /*!
+     * \brief operator+= adds another set of timings to these.
+     * \param[in] rhs - The other timings.
+     * \return These timings.
+     */
+    MotionStageTimings& operator+=(MotionStageTimings const& rhs) noexcept
+    {
+        frames += rhs.frames;
+        resizeMillisecs += rhs.resizeMillisecs;
+        greyMillisecs += rhs.greyMillisecs;
+        engineMillisecs += rhs.engineMillisecs;
+        blobsMillisecs += rhs.blobsMillisecs;
+        return *this;
+    }
+};
+
+/*!
+ * \brief Class defining a motion detector.
+ *
+ * The motion detector only analyses video frames, reporting when motion is in progress. Motion
+ * clips are recorded by the stream processor from the camera's shared packet source.
+ *
+ * Frames are analysed in order, from a bounded queue, on a worker pool shared with the other
+ * cameras' motion detectors. If analysis falls behind frames are dropped according to the camera's
+ * motion queue policy.
+ *
+ * Motion is found in grey frames by the motion engine selected for the camera, the motion detector
+ * itself only converts frames to grey and post-processes the engine's result. The moving pixels
+ * are grouped into blobs and each blob is checked against the minimum motion area and the motion
+ * regions by itself, so small changes far apart never add up to one large area of motion.
+ *
+ * The camera's motion regions are compiled once, when the motion detector is created, into a
+ * threshold map holding each region's pixel threshold, with everywhere else masked out, and the
+ * tight area of the analysis frame that covers them. Only that area is converted to grey and
+ * analysed by the motion engine.
+ *
+ * In motion vectors mode motion is found from a field of the codec's motion vectors instead, and
+ * grey frames are then only needed if hits are to be confirmed by the motion engine. Frames added
+ * without motion vectors are always analysed by the motion engine.
+ *
+ * Frames may be sampled for analysis at a lower rate than the video's FPS. The motion bounding
+ * rectangle's smoothing, like the post-roll period, is timed from the frames' capture times so it
+ * behaves the same at any analysis rate, or when recorded video is replayed faster than real time.
+ */
 class IpFreelyMotionDetector final
 {
-    /*! \brief Typedef to queue object. */
-    typedef std::shared_ptr<cv::Mat> video_frame_t;
+    /*! \brief Structure holding a queued frame. */
+    struct QueuedFrame final
+    {
+        /*! \brief The time the frame was captured. */
+        std::chrono::steady_clock::time_point timestamp{};
+
+        /*! \brief The video frame, may be empty if motion vectors are given. */
+        cv::Mat videoFrame{};
+
+        /*! \brief The frame's motion vector field, empty if not available. */
+        cv::Mat motionVectors{};
+    };
 
 public:
     /*!
      * \brief IpFreelyMotionDetector constructor.
-     * \param[in] name - A name for the stream, used to name output video files.
+     * \param[in] name - A name for the stream, used for logging.
      * \param[in] cameraDetails - Camera details we want to stream from.
-     * \param[in] saveFolderPath - A local folder to save captured videos to.
-     * \param[in] requiredFileDurationSecs - Duration to use for captured video files.
-     * \param[in] fps - The video's FPS.
+     * \param[in] fps - The video's FPS, the camera's motion analysis FPS is limited to this.
      * \param[in] originalWidth - The video's original width.
      * \param[in] originalHeight - The video's original height.
-     *
-     * The stream processor can be used to receive and thus display RTSP video streams but can also
-     * record the stream in DivX format mp4 files to disk. Files are recorded with the given
-     * duration. One recording session can span multiple back-to-back video files.
+     * \param[in] workerPool - The worker pool the motion analysis is done on.
      */
     IpFreelyMotionDetector(std::string const& name, IpCamera const& cameraDetails,
-                           std::string const& saveFolderPath, double const requiredFileDurationSecs,
-                           double const fps, int const originalWidth, int const originalHeight);
+                           double const fps, int const originalWidth, int const originalHeight,
+                           std::shared_ptr<IpFreelyWorkerPool> const& workerPool);
 
     /*! \brief IpFreelyMotionDetector destructor. */
-    ~IpFreelyMotionDetector() = default;
+    ~IpFreelyMotionDetector();
 
     /*! \brief IpFreelyMotionDetector deleted copy constructor. */
     IpFreelyMotionDetector(IpFreelyMotionDetector const&) = delete;
@@ -73,9 +148,19 @@ public:
 
     /*!
      * \brief AddNextFrame add next video frame to motion detector queue.
-     * \param[in] videoFrame - Next video frame to process.
+     * \param[in] videoFrame - Next video frame to process, either BGR or 8-bit grey.
+     * \param[in] timestamp - The time the frame was captured.
+     * \param[in] motionVectors - (Optional) The frame's motion vector field, see
+     * IpFreelyLumaDecoder::TakeMotionVectors.
+     *
+     * The motion detector takes shared ownership of the frame's pixel buffer, which must not be
+     * modified by anyone once added. The caller should release its own reference as soon as it
+     * no longer needs the frame so the buffer can be reused once analysed.
+     *
+     * In motion vectors mode the video frame may be empty, unless hits are to be confirmed.
      */
-    void AddNextFrame(cv::Mat const& videoFrame);
+    void AddNextFrame(cv::Mat videoFrame, std::chrono::steady_clock::time_point const& timestamp,
+                      cv::Mat motionVectors = cv::Mat());
 
     /*!
      * \brief CurrentMotionRect gives acces to motion bounding rectangle.
@@ -84,55 +169,121 @@ public:
     QRect CurrentMotionRect() const noexcept;
 
     /*!
-     * \brief WritingStream reports if motion detector is currently writing the viedo stream to
-     * disk.
-     * \return |True if writong, false otherwise.
+     * \brief MotionInProgress reports if motion is currently in progress, including the
+     * post-roll period after the motion stopped.
+     * \return True if motion is in progress, false otherwise.
+     */
+    bool MotionInProgress() const noexcept;
+
+    /*!
+     * \brief QueueDepth reports the number of frames waiting to be analysed.
+     * \return The queue depth.
+     */
+    size_t QueueDepth() const;
+
+    /*!
+     * \brief FramesDropped reports the number of frames dropped because analysis fell behind.
+     * \return The number of frames.
+     */
+    uint64_t FramesDropped() const noexcept;
+
+    /*!
+     * \brief LatencyMillisecs reports the average time from a frame's capture to the end of its
+     * analysis.
+     * \return The time in milliseconds.
+     */
+    double LatencyMillisecs() const noexcept;
+
+    /*!
+     * \brief AnalysisFrameSize reports the size frames are scaled to for analysis.
+     * \return The frame size.
+     *
+     * Grey frames already at this size are analysed without any scaling.
+     */
+    cv::Size AnalysisFrameSize() const noexcept;
+
+    /*!
+     * \brief AnalysisFps reports the rate frames should be added for analysis.
+     * \return The FPS, the video's FPS unless the camera's motion analysis FPS is lower.
+     */
+    double AnalysisFps() const noexcept;
+
+    /*!
+     * \brief EngineCostMillisecs reports the motion engine's average cost per frame.
+     * \return The time in milliseconds.
+     */
+    double EngineCostMillisecs() const noexcept;
+
+    /*!
+     * \brief FramesAnalysed reports the number of frames analysed so far.
+     * \return The number of frames.
+     *
+     * Frames are finished with once counted, so their buffers may be reused.
+     */
+    uint64_t FramesAnalysed() const noexcept;
+
+    /*!
+     * \brief StageTimings reports the total time spent in each stage of analysis so far.
+     * \return The timings.
      */
-    bool WritingStream() const noexcept;
+    MotionStageTimings StageTimings() const;
 
 private:
     void       Initialise();
-    void       InitialiseFrames();
-    void       UpdateNextFrame();
-    bool       DetectMotion();
-    bool       CheckForIntersections();
-    void       RotateFrames();
-    static int MessageDecoder(video_frame_t const& msg);
-    bool       MessageHandler(video_frame_t& msg);
-    void       CreateCaptureObjects();
-    void       WriteVideoFrame();
-    void       SetWritingStream(bool const writing) noexcept;
+    void       CompileMotionRegions();
+    cv::Rect   SourceRect(cv::Size const& frameSize) const;
+    void       ConvertToGrey(cv::Mat& greyFrame, MotionStageTimings& timings);
+    bool       DetectMotion(cv::Mat const& motionVectors, double const frameSecs);
+    void       FindMotionBlobs(cv::Mat const& motionMask, cv::Rect const& maskRect);
+    bool       UpdateMotionRect(double const frameSecs);
+    bool       IntersectsMotionRegion(cv::Rect const& videoRect) const;
+    bool       AnalyseNextFrame() noexcept;
+    void       AnalyseFrame(QueuedFrame const& frame);
+    void       SetMotionInProgress(bool const inProgress) noexcept;
 
 private:
-    mutable std::mutex                                        m_motionMutex{};
-    mutable std::mutex                                        m_writingMutex{};
-    mutable std::mutex                                        m_fpsMutex{};
-    std::string                                               m_name{"cam"};
-    IpCamera                                                  m_cameraDetails{};
-    std::string                                               m_saveFolderPath{};
-    double                                                    m_requiredFileDurationSecs{0.0};
-    double                                                    m_fps{25.0};
-    int                                                       m_originalWidth{0};
-    int                                                       m_originalHeight{0};
-    unsigned int                                              m_updatePeriodMillisecs{40};
-    cv::Mat                                                   m_erosionKernel{};
-    cv::Scalar                                                m_rectangleColor{0, 255, 0};
-    video_frame_t                                             m_originalFrame;
-    size_t                                                    m_holdOffFrameCountLimit{0};
-    size_t                                                    m_holdOffFrameCount{0};
-    double                                                    m_motionFrameScalar{1.0};
-    int                                                       m_minImageChangeArea{0};
-    size_t                                                    m_imageChangesThreshold{0};
-    bool                                                      m_initialiseFrames{true};
-    cv::Mat                                                   m_prevGreyFrame{};
-    cv::Mat                                                   m_currentGreyFrame{};
-    cv::Mat                                                   m_nextGreyFrame{};
-    cv::Rect                                                  m_motionBoundingRect{0, 0, 0, 0};
-    double                                                    m_fileDurationSecs{0.0};
-    time_t                                                    m_currentTime{};
-    cv::Ptr<cv::VideoWriter>                                  m_videoWriter{};
-    bool                                                      m_writingStream{false};
-    core_lib::threads::MessageQueueThread<int, video_frame_t> m_msgQueueThread;
+    mutable std::mutex                    m_motionMutex{};
+    mutable std::mutex                    m_motionInProgressMutex{};
+    mutable std::mutex                    m_fpsMutex{};
+    mutable std::mutex                    m_timingsMutex{};
+    std::string                           m_name{"cam"};
+    IpCamera                              m_cameraDetails{};
+    double                                m_fps{25.0};
+    double                                m_analysisFps{25.0};
+    int                                   m_originalWidth{0};
+    int                                   m_originalHeight{0};
+    unsigned int                          m_updatePeriodMillisecs{40};
+    cv::Scalar                            m_rectangleColor{0, 255, 0};
+    cv::Mat                               m_originalFrame{};
+    std::chrono::steady_clock::time_point m_lastMotionTime{};
+    std::chrono::steady_clock::time_point m_lastFrameTime{};
+    double                                m_greyGapSecs{0.0};
+    double                                m_motionFrameScalar{1.0};
+    cv::Size                              m_motionFrameSize{};
+    int                                   m_minImageChangeArea{0};
+    size_t                                m_imageChangesThreshold{0};
+    std::vector<cv::Rect>                 m_regionRects{};
+    cv::Rect                              m_analysisRect{};
+    cv::Mat                               m_thresholdMap{};
+    std::shared_ptr<IpFreelyMotionEngine> m_motionEngine;
+    cv::Mat                               m_greyFrame{};
+    cv::Mat                               m_engineMotionMask{};
+    cv::Mat                               m_blockMask{};
+    IpFreelyMotionBlobs                   m_blobLabeller{};
+    std::vector<cv::Rect>                 m_motionBlobs{};
+    cv::Mat                               m_scaledFrame{};
+    cv::Mat                               m_motionFrame{};
+    cv::Rect                              m_motionBoundingRect{0, 0, 0, 0};
+    bool                                  m_motionInProgress{false};
+    bool                                  m_vectorFallbackWarned{false};
+    IpFreelyBoundedQueue<QueuedFrame>     m_queue;
+    std::atomic<uint64_t>                 m_framesDropped{0};
+    std::atomic<uint64_t>                 m_framesAnalysed{0};
+    MotionStageTimings                    m_stageTimings{};
+    std::atomic<double>                   m_latencyMillisecs{0.0};
+    std::atomic<bool>                     m_queueFullWarned{false};
+    std::shared_ptr<IpFreelyWorkerPool>   m_workerPool;
+    IpFreelyWorkerPool::client_t          m_workerClient;
 };
 
 } // namespace ipfreely
@@ -0,0 +1,81 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyMotionEngine.cpp
+ * \brief File containing definition of IpFreelyMotionEngine base class.
+ */
+#include "IpFreelyMotionEngine.h"
+#include <chrono>
+#include "IpFreelyFrameDiffEngine.h"
+#include "IpFreelyBackgroundEngine.h"
+
+namespace ipfreely
+{
+
+static constexpr double COST_AVE_FACTOR = 0.9;
+
+IpFreelyMotionEngine::IpFreelyMotionEngine(std::string const& name)
+    : m_name(name)
+{
+}
+
+void IpFreelyMotionEngine::Update(cv::Mat& greyFrame, MotionKernelResult* result,
+                                  cv::Mat* motionMask)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    UpdateModel(greyFrame, result, motionMask);
+
+    auto costMillisecs =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+            .count();
+
+    m_costMillisecs =
+        (m_costMillisecs * COST_AVE_FACTOR) + (costMillisecs * (1.0 - COST_AVE_FACTOR));
+}
+
+std::string const& IpFreelyMotionEngine::Name() const noexcept
+{
+    return m_name;
+}
+
+double IpFreelyMotionEngine::CostMillisecs() const noexcept
+{
+    return m_costMillisecs;
+}
+
+std::shared_ptr<IpFreelyMotionEngine> CreateMotionEngine(IpCamera const& cameraDetails,
+                                                         double const    fps,
+                                                         cv::Mat const&  thresholdMap)
+{
+    switch (cameraDetails.motionEngine)
+    {
+    case eMotionEngine::backgroundModel:
+        return std::make_shared<IpFreelyBackgroundEngine>(
+            cameraDetails.pixelThreshold, fps, thresholdMap);
+    case eMotionEngine::frameDifferencing:
+    default:
+        return std::make_shared<IpFreelyFrameDiffEngine>(cameraDetails.pixelThreshold,
+                                                         thresholdMap);
+    }
+}
+
+} // namespace ipfreely
@@ -0,0 +1,121 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyMotionEngine.h
+ * \brief File containing declaration of IpFreelyMotionEngine base class.
+ */
+#ifndef IPFREELYMOTIONENGINE_H
+#define IPFREELYMOTIONENGINE_H
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <opencv2/opencv.hpp>
+#include "IpFreelyCameraDatabase.h"
+#include "IpFreelyMotionKernel.h"
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+/*!
+ * \brief Base class defining a motion detection engine.
+ *
+ * An engine keeps its own model of the scene, updated from every grey frame the motion detector
+ * passes it, and works out the motion in a frame against that model. The motion detector only
+ * post-processes the engine's result so engines can be swapped per camera. Each engine reports
+ * its average cost per frame so the cheapest engine that works well for a camera can be chosen.
+ */
+class IpFreelyMotionEngine
+{
+public:
+    /*!
+     * \brief IpFreelyMotionEngine constructor.
+     * \param[in] name - The engine's name.
+     */
+    explicit IpFreelyMotionEngine(std::string const& name);
+
+    /*! \brief IpFreelyMotionEngine destructor. */
+    virtual ~IpFreelyMotionEngine() = default;
+
+    /*! \brief IpFreelyMotionEngine deleted copy constructor. */
+    IpFreelyMotionEngine(IpFreelyMotionEngine const&) = delete;
+
+    /*! \brief IpFreelyMotionEngine deleted copy assignment operator. */
+    IpFreelyMotionEngine& operator=(IpFreelyMotionEngine const&) = delete;
+
+    /*!
+     * \brief Update updates the engine's model with the next grey frame.
+     * \param[in,out] greyFrame - The next 8-bit grey frame, the motion detector's analysis area.
+     * \param[out] result - (Optional) If given, the motion found in the frame.
+     * \param[out] motionMask - (Optional) The engine's motion mask, only needed for debugging.
+     *
+     * The engine may swap the frame's buffer for one of its own, so the caller must not keep any
+     * other reference to the frame, but can reuse the buffer for its next frame.
+     */
+    void Update(cv::Mat& greyFrame, MotionKernelResult* result = nullptr,
+                cv::Mat* motionMask = nullptr);
+
+    /*! \brief Reset discards the engine's model, e.g. after frames were missed. */
+    virtual void Reset() = 0;
+
+    /*!
+     * \brief Name gives access to the engine's name.
+     * \return The name.
+     */
+    std::string const& Name() const noexcept;
+
+    /*!
+     * \brief CostMillisecs reports the engine's average cost per frame.
+     * \return The time in milliseconds.
+     */
+    double CostMillisecs() const noexcept;
+
+protected:
+    /*!
+     * \brief UpdateModel is implemented by each engine to do the work of Update.
+     * \param[in,out] greyFrame - The next 8-bit grey frame.
+     * \param[out] result - If not null, the motion found in the frame.
+     * \param[out] motionMask - If not null, the engine's motion mask.
+     */
+    virtual void UpdateModel(cv::Mat& greyFrame, MotionKernelResult* result,
+                             cv::Mat* motionMask) = 0;
+
+private:
+    std::string         m_name{};
+    std::atomic<double> m_costMillisecs{0.0};
+};
+
+/*!
+ * \brief CreateMotionEngine creates the motion detection engine selected for a camera.
+ * \param[in] cameraDetails - The camera's details.
+ * \param[in] fps - The video's FPS.
+ * \param[in] thresholdMap - (Optional) 8-bit threshold for each pixel of the grey frames, used
+ * instead of the camera's pixel threshold if not empty.
+ * \return The motion engine.
+ */
+std::shared_ptr<IpFreelyMotionEngine> CreateMotionEngine(IpCamera const& cameraDetails,
+                                                         double const    fps,
+                                                         cv::Mat const&  thresholdMap = cv::Mat());
+
+} // namespace ipfreely
+
+#endif // IPFREELYMOTIONENGINE_H
@@ -0,0 +1,551 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyMotionKernel.cpp
+ * \brief File containing definitions of the motion detector's kernels.
+ */
+#include "IpFreelyMotionKernel.h"
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <cstdlib>
+#include <mutex>
+#include <bitset>
+#include <algorithm>
+#include <stdexcept>
+#include <boost/throw_exception.hpp>
+#include <opencv2/core/hal/intrin.hpp>
+
+namespace ipfreely
+{
+
+static constexpr double   DIFF_MAX_VALUE  = 255.0;
+static constexpr int      MIN_BAND_ROWS   = 32;
+static constexpr unsigned EVEN_LANES_MASK = 0x5555;
+
+namespace utils
+{
+
+/*! \brief Structure holding the statistics of a band of rows. */
+struct BandStatistics final
+{
+    uint64_t changedPixels{0};
+    bool     changesFound{false};
+    int      minX{0};
+    int      maxX{0};
+    int      minY{0};
+    int      maxY{0};
+};
+
+inline int ThresholdToInt(double const pixelThreshold)
+{
+    // cv::threshold compares 8-bit pixels against the threshold's floor.
+    return static_cast<int>(std::floor(pixelThreshold));
+}
+
+inline int LowestBit(unsigned bits)
+{
+    int index = 0;
+
+    while ((bits & 1u) == 0)
+    {
+        bits >>= 1;
+        ++index;
+    }
+
+    return index;
+}
+
+inline int HighestBit(unsigned bits)
+{
+    int index = -1;
+
+    while (bits != 0)
+    {
+        bits >>= 1;
+        ++index;
+    }
+
+    return index;
+}
+
+// As ThresholdRow but with a threshold for each pixel.
+inline void ThresholdRowMap(uint8_t const* prev, uint8_t const* current, uint8_t const* next,
+                            int const cols, uint8_t const* thresholds, uint8_t* out)
+{
+    int x = 0;
+
+#if CV_SIMD128
+    for (; x <= cols - 16; x += 16)
+    {
+        auto vNext   = cv::v_load(next + x);
+        auto vMotion = cv::v_absdiff(cv::v_load(prev + x), vNext) &
+                       cv::v_absdiff(vNext, cv::v_load(current + x));
+        cv::v_store(out + x, vMotion > cv::v_load(thresholds + x));
+    }
+#endif
+
+    for (; x < cols; ++x)
+    {
+        int motion = std::abs(prev[x] - next[x]) & std::abs(next[x] - current[x]);
+        out[x]     = motion > thresholds[x] ? 0xFF : 0;
+    }
+}
+
+// Threshold the AND of the two frame differences for one row, 0xFF where changed.
+inline void ThresholdRow(uint8_t const* prev, uint8_t const* current, uint8_t const* next,
+                         int const cols, int const threshold, uint8_t const* thresholds,
+                         uint8_t* out)
+{
+    if (thresholds)
+    {
+        ThresholdRowMap(prev, current, next, cols, thresholds, out);
+        return;
+    }
+
+    if (threshold < 0)
+    {
+        std::memset(out, 0xFF, static_cast<size_t>(cols));
+        return;
+    }
+
+    int x = 0;
+
+#if CV_SIMD128
+    auto const vThreshold = cv::v_setall_u8(static_cast<uint8_t>(threshold));
+
+    for (; x <= cols - 16; x += 16)
+    {
+        auto vNext   = cv::v_load(next + x);
+        auto vMotion = cv::v_absdiff(cv::v_load(prev + x), vNext) &
+                       cv::v_absdiff(vNext, cv::v_load(current + x));
+        cv::v_store(out + x, vMotion > vThreshold);
+    }
+#endif
+
+    for (; x < cols; ++x)
+    {
+        int motion = std::abs(prev[x] - next[x]) & std::abs(next[x] - current[x]);
+        out[x]     = motion > threshold ? 0xFF : 0;
+    }
+}
+
+// Erode a thresholded row with a 2x2 kernel anchored at its bottom right, as cv::erode does,
+// and gather the row's statistics. Both rows must have a 0xFF pixel before their first pixel.
+inline void ErodeRow(uint8_t const* above, uint8_t const* row, int const cols, int const y,
+                     BandStatistics& stats, uint8_t* out)
+{
+    bool const sampledRow = (y % 2) == 0;
+    int        rowMinX    = -1;
+    int        rowMaxX    = -1;
+    int        x          = 0;
+
+#if CV_SIMD128
+    for (; x <= cols - 16; x += 16)
+    {
+        auto vEroded = cv::v_load(row + x) & cv::v_load(row + x - 1) & cv::v_load(above + x) &
+                       cv::v_load(above + x - 1);
+
+        if (out)
+        {
+            cv::v_store(out + x, vEroded);
+        }
+
+        auto bits = static_cast<unsigned>(cv::v_signmask(vEroded));
+
+        if (bits == 0)
+        {
+            continue;
+        }
+
+        stats.changedPixels += std::bitset<16>(bits).count();
+
+        // x is even so even lanes are the sampled columns.
+        auto sampledBits = bits & EVEN_LANES_MASK;
+
+        if (sampledRow && (sampledBits != 0))
+        {
+            if (rowMinX < 0)
+            {
+                rowMinX = x + LowestBit(sampledBits);
+            }
+
+            rowMaxX = x + HighestBit(sampledBits);
+        }
+    }
+#endif
+
+    for (; x < cols; ++x)
+    {
+        uint8_t eroded = row[x] & row[x - 1] & above[x] & above[x - 1];
+
+        if (out)
+        {
+            out[x] = eroded;
+        }
+
+        if (eroded == 0)
+        {
+            continue;
+        }
+
+        ++stats.changedPixels;
+
+        if (sampledRow && ((x % 2) == 0))
+        {
+            if (rowMinX < 0)
+            {
+                rowMinX = x;
+            }
+
+            rowMaxX = x;
+        }
+    }
+
+    if (rowMinX < 0)
+    {
+        return;
+    }
+
+    if (!stats.changesFound)
+    {
+        stats.changesFound = true;
+        stats.minY         = y;
+    }
+
+    stats.minX = std::min(stats.minX, rowMinX);
+    stats.maxX = std::max(stats.maxX, rowMaxX);
+    stats.maxY = y;
+}
+
+inline void ProcessBand(cv::Mat const& prevGreyFrame, cv::Mat const& currentGreyFrame,
+                        cv::Mat const& nextGreyFrame, int const threshold,
+                        cv::Mat const* thresholdMap, cv::Range const& rows,
+                        BandStatistics& stats, cv::Mat* motionMask)
+{
+    auto const cols = prevGreyFrame.cols;
+
+    // Two thresholded rows, each with a leading 0xFF pixel standing in for the
+    // border, which cv::erode treats as never limiting the minimum.
+    cv::AutoBuffer<uint8_t> rowBuffers(static_cast<size_t>(2 * (cols + 1)));
+    uint8_t*                above = rowBuffers.data() + 1;
+    uint8_t*                row   = above + cols + 1;
+    above[-1]                     = 0xFF;
+    row[-1]                       = 0xFF;
+
+    // Rows above the frame are border too, otherwise the band
+    // needs the thresholded row just above it.
+    if (rows.start == 0)
+    {
+        std::memset(above, 0xFF, static_cast<size_t>(cols));
+    }
+    else
+    {
+        ThresholdRow(prevGreyFrame.ptr<uint8_t>(rows.start - 1),
+                     currentGreyFrame.ptr<uint8_t>(rows.start - 1),
+                     nextGreyFrame.ptr<uint8_t>(rows.start - 1),
+                     cols,
+                     threshold,
+                     thresholdMap ? thresholdMap->ptr<uint8_t>(rows.start - 1) : nullptr,
+                     above);
+    }
+
+    for (int y = rows.start; y < rows.end; ++y)
+    {
+        ThresholdRow(prevGreyFrame.ptr<uint8_t>(y),
+                     currentGreyFrame.ptr<uint8_t>(y),
+                     nextGreyFrame.ptr<uint8_t>(y),
+                     cols,
+                     threshold,
+                     thresholdMap ? thresholdMap->ptr<uint8_t>(y) : nullptr,
+                     row);
+        ErodeRow(above, row, cols, y, stats, motionMask ? motionMask->ptr<uint8_t>(y) : nullptr);
+        std::swap(above, row);
+    }
+}
+
+inline void SetStdDev(uint64_t const changedPixels, size_t const totalPixels,
+                      MotionKernelResult& result)
+{
+    // Mirrors cv::meanStdDev, whose sums of a binary mask's pixel values are exact.
+    double scale = totalPixels > 0 ? 1.0 / static_cast<double>(totalPixels) : 0.0;
+    double mean  = static_cast<double>(changedPixels * 255) * scale;
+    double sqSum = static_cast<double>(changedPixels * 255 * 255) * scale;
+
+    result.stdDev = std::sqrt(std::max(sqSum - (mean * mean), 0.0));
+}
+
+inline void VerifyFrames(cv::Mat const& prevGreyFrame, cv::Mat const& currentGreyFrame,
+                         cv::Mat const& nextGreyFrame)
+{
+    if ((prevGreyFrame.type() != CV_8UC1) || (currentGreyFrame.type() != CV_8UC1) ||
+        (nextGreyFrame.type() != CV_8UC1) || (prevGreyFrame.size() != nextGreyFrame.size()) ||
+        (currentGreyFrame.size() != nextGreyFrame.size()))
+    {
+        BOOST_THROW_EXCEPTION(
+            std::invalid_argument("Motion kernel needs three 8-bit grey frames of one size."));
+    }
+}
+
+inline void VerifyThresholdMap(cv::Mat const& thresholdMap, cv::Mat const& nextGreyFrame)
+{
+    if ((thresholdMap.type() != CV_8UC1) || (thresholdMap.size() != nextGreyFrame.size()))
+    {
+        BOOST_THROW_EXCEPTION(
+            std::invalid_argument("Motion kernel needs an 8-bit threshold map the frames' size."));
+    }
+}
+
+inline void FusedKernel(cv::Mat const& prevGreyFrame, cv::Mat const& currentGreyFrame,
+                        cv::Mat const& nextGreyFrame, int const threshold,
+                        cv::Mat const* thresholdMap, MotionKernelResult& result,
+                        cv::Mat* motionMask)
+{
+    auto const rows = nextGreyFrame.rows;
+    auto const cols = nextGreyFrame.cols;
+
+    if (motionMask)
+    {
+        motionMask->create(rows, cols, CV_8UC1);
+    }
+
+    BandStatistics total;
+    total.minX = cols;
+    total.minY = rows;
+
+    std::mutex totalMutex;
+
+    cv::parallel_for_(
+        cv::Range(0, rows),
+        [&](cv::Range const& band) {
+            BandStatistics stats;
+            stats.minX = cols;
+            stats.minY = rows;
+
+            ProcessBand(prevGreyFrame,
+                        currentGreyFrame,
+                        nextGreyFrame,
+                        threshold,
+                        thresholdMap,
+                        band,
+                        stats,
+                        motionMask);
+
+            std::lock_guard<std::mutex> lock(totalMutex);
+
+            total.changedPixels += stats.changedPixels;
+
+            if (stats.changesFound)
+            {
+                total.minX = std::min(total.minX, stats.minX);
+                total.maxX = std::max(total.maxX, stats.maxX);
+                total.minY = total.changesFound ? std::min(total.minY, stats.minY) : stats.minY;
+                total.maxY = std::max(total.maxY, stats.maxY);
+                total.changesFound = true;
+            }
+        },
+        std::max(1.0, static_cast<double>(rows) / static_cast<double>(MIN_BAND_ROWS)));
+
+    SetStdDev(total.changedPixels, nextGreyFrame.total(), result);
+    result.changesFound = total.changesFound;
+    result.minX         = total.minX;
+    result.maxX         = total.maxX;
+    result.minY         = total.minY;
+    result.maxY         = total.maxY;
+}
+
+inline void ReferenceKernel(cv::Mat const& prevGreyFrame, cv::Mat const& currentGreyFrame,
+                            cv::Mat const& nextGreyFrame, double const pixelThreshold,
+                            cv::Mat const* thresholdMap, MotionKernelResult& result,
+                            cv::Mat* motionMask)
+{
+    // Calculate differences between the images and do AND-operation
+    // then threshold image, low differences are ignored (ex. contrast
+    // change due to sunlight).
+    cv::Mat diff1, diff2, motion;
+    cv::absdiff(prevGreyFrame, nextGreyFrame, diff1);
+    cv::absdiff(nextGreyFrame, currentGreyFrame, diff2);
+    cv::bitwise_and(diff1, diff2, motion);
+
+    if (thresholdMap)
+    {
+        cv::compare(motion, *thresholdMap, motion, cv::CMP_GT);
+    }
+    else
+    {
+        cv::threshold(motion, motion, pixelThreshold, DIFF_MAX_VALUE, cv::THRESH_BINARY);
+    }
+
+    cv::erode(motion, motion, cv::getStructuringElement(cv::MORPH_RECT, cv::Size(2, 2)));
+
+    // Now work out the std dev of the motion frame.
+    cv::Scalar mean, stddev;
+    cv::meanStdDev(motion, mean, stddev);
+    result.stdDev = stddev[0];
+
+    result.changesFound = false;
+    result.minX         = motion.cols;
+    result.maxX         = 0;
+    result.minY         = motion.rows;
+    result.maxY         = 0;
+
+    // Loop over image and detect changes.
+    for (int j = 0; j < motion.rows; j += 2)
+    {
+        for (int i = 0; i < motion.cols; i += 2)
+        {
+            if (static_cast<int>(motion.at<uint8_t>(j, i)) == 255)
+            {
+                result.changesFound = true;
+                result.minX         = std::min(result.minX, i);
+                result.maxX         = std::max(result.maxX, i);
+                result.minY         = std::min(result.minY, j);
+                result.maxY         = std::max(result.maxY, j);
+            }
+        }
+    }
+
+    if (motionMask)
+    {
+        motion.copyTo(*motionMask);
+    }
+}
+
+} // namespace utils
+
+void FusedMotionKernel(cv::Mat const& prevGreyFrame, cv::Mat const& currentGreyFrame,
+                       cv::Mat const& nextGreyFrame, double const pixelThreshold,
+                       MotionKernelResult& result, cv::Mat* motionMask)
+{
+    utils::VerifyFrames(prevGreyFrame, currentGreyFrame, nextGreyFrame);
+
+    utils::FusedKernel(prevGreyFrame,
+                       currentGreyFrame,
+                       nextGreyFrame,
+                       std::min(utils::ThresholdToInt(pixelThreshold), 255),
+                       nullptr,
+                       result,
+                       motionMask);
+}
+
+void FusedMotionKernel(cv::Mat const& prevGreyFrame, cv::Mat const& currentGreyFrame,
+                       cv::Mat const& nextGreyFrame, cv::Mat const& thresholdMap,
+                       MotionKernelResult& result, cv::Mat* motionMask)
+{
+    utils::VerifyFrames(prevGreyFrame, currentGreyFrame, nextGreyFrame);
+    utils::VerifyThresholdMap(thresholdMap, nextGreyFrame);
+
+    utils::FusedKernel(
+        prevGreyFrame, currentGreyFrame, nextGreyFrame, 0, &thresholdMap, result, motionMask);
+}
+
+void ReferenceMotionKernel(cv::Mat const& prevGreyFrame, cv::Mat const& currentGreyFrame,
+                           cv::Mat const& nextGreyFrame, double const pixelThreshold,
+                           MotionKernelResult& result, cv::Mat* motionMask)
+{
+    utils::VerifyFrames(prevGreyFrame, currentGreyFrame, nextGreyFrame);
+
+    utils::ReferenceKernel(prevGreyFrame,
+                           currentGreyFrame,
+                           nextGreyFrame,
+                           pixelThreshold,
+                           nullptr,
+                           result,
+                           motionMask);
+}
+
+void ReferenceMotionKernel(cv::Mat const& prevGreyFrame, cv::Mat const& currentGreyFrame,
+                           cv::Mat const& nextGreyFrame, cv::Mat const& thresholdMap,
+                           MotionKernelResult& result, cv::Mat* motionMask)
+{
+    utils::VerifyFrames(prevGreyFrame, currentGreyFrame, nextGreyFrame);
+    utils::VerifyThresholdMap(thresholdMap, nextGreyFrame);
+
+    utils::ReferenceKernel(
+        prevGreyFrame, currentGreyFrame, nextGreyFrame, 0.0, &thresholdMap, result, motionMask);
+}
+
+void VectorMotionKernel(cv::Mat const& motionVectors, double const vectorThreshold,
+                        cv::Size const& frameSize, MotionKernelResult& result,
+                        cv::Mat* motionMask, cv::Mat* blockMask)
+{
+    if (motionVectors.empty() || (motionVectors.type() != CV_8UC1) || frameSize.empty())
+    {
+        BOOST_THROW_EXCEPTION(
+            std::invalid_argument("Motion kernel needs an 8-bit motion vector field."));
+    }
+
+    auto const threshold    = utils::ThresholdToInt(vectorThreshold);
+    uint64_t   movingBlocks = 0;
+    int        minBlockX    = motionVectors.cols;
+    int        maxBlockX    = -1;
+    int        minBlockY    = motionVectors.rows;
+    int        maxBlockY    = -1;
+
+    for (int y = 0; y < motionVectors.rows; ++y)
+    {
+        auto row = motionVectors.ptr<uint8_t>(y);
+
+        for (int x = 0; x < motionVectors.cols; ++x)
+        {
+            if (static_cast<int>(row[x]) > threshold)
+            {
+                ++movingBlocks;
+                minBlockX = std::min(minBlockX, x);
+                maxBlockX = std::max(maxBlockX, x);
+                minBlockY = std::min(minBlockY, y);
+                maxBlockY = std::max(maxBlockY, y);
+            }
+        }
+    }
+
+    utils::SetStdDev(movingBlocks, motionVectors.total(), result);
+    result.changesFound = movingBlocks > 0;
+
+    if (result.changesFound)
+    {
+        result.minX = minBlockX * frameSize.width / motionVectors.cols;
+        result.maxX = (maxBlockX + 1) * frameSize.width / motionVectors.cols - 1;
+        result.minY = minBlockY * frameSize.height / motionVectors.rows;
+        result.maxY = (maxBlockY + 1) * frameSize.height / motionVectors.rows - 1;
+    }
+    else
+    {
+        result.minX = frameSize.width;
+        result.maxX = 0;
+        result.minY = frameSize.height;
+        result.maxY = 0;
+    }
+
+    if (motionMask || blockMask)
+    {
+        cv::Mat localBlockMask;
+        auto&   mask = blockMask ? *blockMask : localBlockMask;
+        cv::threshold(motionVectors, mask, threshold, DIFF_MAX_VALUE, cv::THRESH_BINARY);
+
+        if (motionMask)
+        {
+            cv::resize(mask, *motionMask, frameSize, 0, 0, cv::INTER_NEAREST);
+        }
+    }
+}
+
+} // namespace ipfreely
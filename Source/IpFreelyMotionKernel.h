@@ -0,0 +1,141 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyMotionKernel.h
+ * \brief File containing declarations of the motion detector's kernels.
+ */
+#ifndef IPFREELYMOTIONKERNEL_H
+#define IPFREELYMOTIONKERNEL_H
+
+#include <opencv2/opencv.hpp>
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+/*! \brief Structure holding the result of a motion kernel. */
+struct MotionKernelResult final
+{
+    /*! \brief Standard deviation of the motion mask's pixel values. */
+    double stdDev{0.0};
+
+    /*! \brief Flag to show if changes were found at the sampled, even row and column, pixels. */
+    bool changesFound{false};
+
+    /*! \brief Left most sampled change, the mask's width if none found. */
+    int minX{0};
+
+    /*! \brief Right most sampled change, 0 if none found. */
+    int maxX{0};
+
+    /*! \brief Top most sampled change, the mask's height if none found. */
+    int minY{0};
+
+    /*! \brief Bottom most sampled change, 0 if none found. */
+    int maxY{0};
+};
+
+/*!
+ * \brief FusedMotionKernel works out the motion between three consecutive grey frames.
+ * \param[in] prevGreyFrame - The previous 8-bit grey frame.
+ * \param[in] currentGreyFrame - The current 8-bit grey frame.
+ * \param[in] nextGreyFrame - The next 8-bit grey frame.
+ * \param[in] pixelThreshold - Differences at or below this level are ignored.
+ * \param[out] result - The motion mask's statistics and the extents of the changes.
+ * \param[out] motionMask - (Optional) The motion mask itself, only needed for debugging.
+ *
+ * The motion mask is the AND of the differences between the next frame and the other two frames,
+ * thresholded and then eroded with a 2x2 kernel. The mask, its statistics and the extents of the
+ * changes are all worked out in a single vectorised pass over bands of rows run in parallel.
+ * The result is identical to that of ReferenceMotionKernel.
+ */
+void FusedMotionKernel(cv::Mat const& prevGreyFrame, cv::Mat const& currentGreyFrame,
+                       cv::Mat const& nextGreyFrame, double const pixelThreshold,
+                       MotionKernelResult& result, cv::Mat* motionMask = nullptr);
+
+/*!
+ * \brief FusedMotionKernel works out the motion between three consecutive grey frames.
+ * \param[in] prevGreyFrame - The previous 8-bit grey frame.
+ * \param[in] currentGreyFrame - The current 8-bit grey frame.
+ * \param[in] nextGreyFrame - The next 8-bit grey frame.
+ * \param[in] thresholdMap - 8-bit threshold for each pixel, differences at or below it are ignored.
+ * \param[out] result - The motion mask's statistics and the extents of the changes.
+ * \param[out] motionMask - (Optional) The motion mask itself, only needed for debugging.
+ *
+ * As the other overload but with a threshold for each pixel. Pixels with a threshold of 255 never
+ * change, so can be used to mask out areas of the frames.
+ */
+void FusedMotionKernel(cv::Mat const& prevGreyFrame, cv::Mat const& currentGreyFrame,
+                       cv::Mat const& nextGreyFrame, cv::Mat const& thresholdMap,
+                       MotionKernelResult& result, cv::Mat* motionMask = nullptr);
+
+/*!
+ * \brief ReferenceMotionKernel works out the motion between three consecutive grey frames.
+ * \param[in] prevGreyFrame - The previous 8-bit grey frame.
+ * \param[in] currentGreyFrame - The current 8-bit grey frame.
+ * \param[in] nextGreyFrame - The next 8-bit grey frame.
+ * \param[in] pixelThreshold - Differences at or below this level are ignored.
+ * \param[out] result - The motion mask's statistics and the extents of the changes.
+ * \param[out] motionMask - (Optional) The motion mask itself, only needed for debugging.
+ *
+ * This is the original implementation, one OpenCV call per step with a pass over the whole frame
+ * for each. It is kept to verify and benchmark FusedMotionKernel against.
+ */
+void ReferenceMotionKernel(cv::Mat const& prevGreyFrame, cv::Mat const& currentGreyFrame,
+                           cv::Mat const& nextGreyFrame, double const pixelThreshold,
+                           MotionKernelResult& result, cv::Mat* motionMask = nullptr);
+
+/*!
+ * \brief ReferenceMotionKernel works out the motion between three consecutive grey frames.
+ * \param[in] prevGreyFrame - The previous 8-bit grey frame.
+ * \param[in] currentGreyFrame - The current 8-bit grey frame.
+ * \param[in] nextGreyFrame - The next 8-bit grey frame.
+ * \param[in] thresholdMap - 8-bit threshold for each pixel, differences at or below it are ignored.
+ * \param[out] result - The motion mask's statistics and the extents of the changes.
+ * \param[out] motionMask - (Optional) The motion mask itself, only needed for debugging.
+ *
+ * The original implementation with a threshold for each pixel, to verify FusedMotionKernel's
+ * overload against.
+ */
+void ReferenceMotionKernel(cv::Mat const& prevGreyFrame, cv::Mat const& currentGreyFrame,
+                           cv::Mat const& nextGreyFrame, cv::Mat const& thresholdMap,
+                           MotionKernelResult& result, cv::Mat* motionMask = nullptr);
+
+/*!
+ * \brief VectorMotionKernel works out the motion from a field of codec motion vectors.
+ * \param[in] motionVectors - 8-bit field of the largest motion vector magnitude in each block.
+ * \param[in] vectorThreshold - Magnitudes at or below this level are ignored.
+ * \param[in] frameSize - Size of the frame the extents are given for.
+ * \param[out] result - The block mask's statistics and the extents of the moving blocks.
+ * \param[out] motionMask - (Optional) The block mask scaled to frameSize, only for debugging.
+ * \param[out] blockMask - (Optional) The block mask itself, 255 for each moving block.
+ *
+ * Each block of the field counts as one pixel of a motion mask, so the standard deviation is
+ * directly comparable with the frame differencing kernels'. The extents cover the whole of each
+ * moving block, scaled from the field to frameSize.
+ */
+void VectorMotionKernel(cv::Mat const& motionVectors, double const vectorThreshold,
+                        cv::Size const& frameSize, MotionKernelResult& result,
+                        cv::Mat* motionMask = nullptr, cv::Mat* blockMask = nullptr);
+
+} // namespace ipfreely
+
+#endif // IPFREELYMOTIONKERNEL_H
@@ -0,0 +1,52 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyMotionPresets.h
+ * \brief File containing the motion detector's sensitivity presets.
+ */
+#ifndef IPFREELYMOTIONPRESETS_H
+#define IPFREELYMOTIONPRESETS_H
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+/*! \brief Pixel difference threshold for each sensitivity. */
+static constexpr double LOW_SENSITIVITY_DIFF_THRESHOLD    = 75.0;
+static constexpr double MEDIUM_SENSITIVITY_DIFF_THRESHOLD = 50.0;
+static constexpr double HIGH_SENSITIVITY_DIFF_THRESHOLD   = 35.0;
+
+/*! \brief Maximum standard deviation of motion for each sensitivity. */
+static constexpr double LOW_SENSITIVITY_STDDEV    = 10.0;
+static constexpr double MEDIUM_SENSITIVITY_STDDEV = 20.0;
+static constexpr double HIGH_SENSITIVITY_STDDEV   = 40.0;
+
+/*! \brief Minimum motion area, as a factor of the frame area, for each sensitivity. */
+static constexpr double LOW_SENSITIVITY_AREA_PERCENT    = 0.05;
+static constexpr double MEDIUM_SENSITIVITY_AREA_PERCENT = 0.025;
+static constexpr double HIGH_SENSITIVITY_AREA_PERCENT   = 0.01;
+
+/*! \brief Smoothing factor for the motion bounding rectangle, the same for every sensitivity. */
+static constexpr double BOUNDING_RECT_SMOOTHING_FACTOR = 0.1;
+
+} // namespace ipfreely
+
+#endif // IPFREELYMOTIONPRESETS_H
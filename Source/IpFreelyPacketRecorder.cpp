@@ -0,0 +1,530 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyPacketRecorder.cpp
+ * \brief File containing definition of IpFreelyPacketRecorder class.
+ */
+#include "IpFreelyPacketRecorder.h"
+#include <sstream>
+#include <ctime>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include <fstream>
+#include <boost/throw_exception.hpp>
+#include <boost/exception/all.hpp>
+#include <boost/filesystem.hpp>
+#include "IpFreelyCameraDatabase.h"
+#include "IpFreelyPacketSource.h"
+#include "IpFreelyStorageUtils.h"
+#include "DebugLog/DebugLogging.h"
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+}
+
+namespace bfs = boost::filesystem;
+
+namespace ipfreely
+{
+
+namespace utils
+{
+
+inline int64_t PacketTimestamp(AVPacket const& packet)
+{
+    return (packet.dts != AV_NOPTS_VALUE) ? packet.dts : packet.pts;
+}
+
+inline bool IsKeyFrame(AVPacket const& packet)
+{
+    return (packet.flags & AV_PKT_FLAG_KEY) != 0;
+}
+
+} // namespace utils
+
+IpFreelyPacketRecorder::IpFreelyPacketRecorder(
+    std::string const& filePrefix, std::string const& fileExtension,
+    std::string const& saveFolderPath, double const requiredFileDurationSecs,
+    double const preRollSecs, std::shared_ptr<IpFreelyPacketSource> const& packetSource,
+    std::shared_ptr<IpFreelyRecordingCatalog> const& recordingCatalog, eCamId const camId,
+    eRecordingType const recordingType)
+    : m_filePrefix(filePrefix)
+    , m_fileExtension(fileExtension)
+    , m_saveFolderPath(saveFolderPath)
+    , m_requiredFileDurationSecs(requiredFileDurationSecs)
+    , m_preRollSecs(preRollSecs)
+    , m_packetSource(packetSource)
+    , m_recordingCatalog(recordingCatalog)
+    , m_camId(camId)
+    , m_recordingType(recordingType)
+{
+    m_packet = av_packet_alloc();
+
+    if (!m_packet)
+    {
+        BOOST_THROW_EXCEPTION(std::runtime_error("Failed to allocate AVPacket."));
+    }
+
+    m_packetHandlerId = m_packetSource->AddPacketHandler(
+        std::bind(&IpFreelyPacketRecorder::PacketHandler,
+                  this,
+                  std::placeholders::_1,
+                  std::placeholders::_2,
+                  std::placeholders::_3));
+}
+
+IpFreelyPacketRecorder::~IpFreelyPacketRecorder()
+{
+    m_packetSource->RemovePacketHandler(m_packetHandlerId);
+    Stop();
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ClearPreRoll();
+    av_packet_free(&m_packet);
+}
+
+void IpFreelyPacketRecorder::Start() noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_recordingEnabled = true;
+}
+
+void IpFreelyPacketRecorder::Stop() noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_recordingEnabled = false;
+    CloseFile();
+}
+
+bool IpFreelyPacketRecorder::IsRecording() const noexcept
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_recordingEnabled;
+}
+
+size_t IpFreelyPacketRecorder::PreRollBytes() const noexcept
+{
+    return m_preRollBytes;
+}
+
+double IpFreelyPacketRecorder::PreRollSecs() const noexcept
+{
+    return m_preRollDurationSecs;
+}
+
+void IpFreelyPacketRecorder::PacketHandler(AVPacket const&          packet,
+                                           AVCodecParameters const& codecParams,
+                                           AVRational const&        timeBase)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto ts = utils::PacketTimestamp(packet);
+
+    // Without a timestamp we can't place the packet in the file.
+    if (ts == AV_NOPTS_VALUE)
+    {
+        return;
+    }
+
+    bool keyFrame  = utils::IsKeyFrame(packet);
+    m_timeBaseSecs = av_q2d(timeBase);
+
+    if (!m_recordingEnabled)
+    {
+        BufferPreRollPacket(packet, ts, keyFrame);
+        return;
+    }
+
+    if (m_outputCtx)
+    {
+        if (ts < m_lastDts)
+        {
+            // The source's timestamps have jumped back, most likely because
+            // the packet stream has reconnected, so start a new file.
+            DEBUG_MESSAGE_EX_WARNING("Packet timestamps went backwards, closing current file for: "
+                                     << m_filePrefix);
+            CloseFile();
+        }
+        else if (keyFrame)
+        {
+            auto fileDurationSecs = static_cast<double>(ts - m_fileStartTs) * m_timeBaseSecs;
+
+            if (fileDurationSecs >= m_requiredFileDurationSecs)
+            {
+                CloseFile();
+            }
+        }
+    }
+
+    if (!m_outputCtx)
+    {
+        DiscardStalePreRoll(ts);
+
+        if (!m_preRollPackets.empty())
+        {
+            // The pre-roll always starts on a keyframe so
+            // we can start the new file with it.
+            OpenFile(codecParams, timeBase, utils::PacketTimestamp(*m_preRollPackets.front()), ts);
+
+            for (auto preRollPacket : m_preRollPackets)
+            {
+                WritePacket(*preRollPacket, timeBase);
+            }
+
+            ClearPreRoll();
+        }
+        else
+        {
+            // Files must start on a keyframe to be decodable.
+            if (!keyFrame)
+            {
+                return;
+            }
+
+            OpenFile(codecParams, timeBase, ts, ts);
+        }
+    }
+
+    WritePacket(packet, timeBase);
+}
+
+void IpFreelyPacketRecorder::BufferPreRollPacket(AVPacket const& packet, int64_t const ts,
+                                                 bool const keyFrame)
+{
+    if (m_preRollSecs <= 0.0)
+    {
+        return;
+    }
+
+    DiscardStalePreRoll(ts);
+
+    // The pre-roll must start on a keyframe to be decodable.
+    if (m_preRollPackets.empty() && !keyFrame)
+    {
+        return;
+    }
+
+    auto preRollPacket = av_packet_clone(&packet);
+
+    if (!preRollPacket)
+    {
+        DEBUG_MESSAGE_EX_ERROR("Failed to clone pre-roll packet for: " << m_filePrefix);
+        return;
+    }
+
+    m_preRollPackets.push_back(preRollPacket);
+    m_preRollBytes += static_cast<size_t>(preRollPacket->size);
+
+    // Drop whole groups of pictures from the front of the pre-roll while
+    // the remainder still covers the pre-roll duration or we're over the
+    // memory cap, so the pre-roll still starts on a keyframe.
+    while (true)
+    {
+        auto nextKeyFrame = std::find_if(std::next(m_preRollPackets.begin()),
+                                         m_preRollPackets.end(),
+                                         [](AVPacket const* p) { return utils::IsKeyFrame(*p); });
+
+        if (nextKeyFrame == m_preRollPackets.end())
+        {
+            break;
+        }
+
+        auto remainingSecs =
+            static_cast<double>(ts - utils::PacketTimestamp(**nextKeyFrame)) * m_timeBaseSecs;
+
+        if ((remainingSecs < m_preRollSecs) && (m_preRollBytes <= MAX_PRE_ROLL_BYTES))
+        {
+            break;
+        }
+
+        while (m_preRollPackets.begin() != nextKeyFrame)
+        {
+            m_preRollBytes -= static_cast<size_t>(m_preRollPackets.front()->size);
+            av_packet_free(&m_preRollPackets.front());
+            m_preRollPackets.pop_front();
+        }
+    }
+
+    // A single group of pictures is bigger than the cap.
+    if (m_preRollBytes > MAX_PRE_ROLL_BYTES)
+    {
+        if (!m_preRollCapWarned)
+        {
+            DEBUG_MESSAGE_EX_WARNING("Pre-roll exceeds memory cap of "
+                                     << MAX_PRE_ROLL_BYTES << " bytes, discarding it for: "
+                                     << m_filePrefix);
+            m_preRollCapWarned = true;
+        }
+
+        ClearPreRoll();
+    }
+
+    UpdatePreRollSecs();
+}
+
+void IpFreelyPacketRecorder::DiscardStalePreRoll(int64_t const ts) noexcept
+{
+    if (m_preRollPackets.empty())
+    {
+        return;
+    }
+
+    // If the source's timestamps have jumped back, or the source has not
+    // produced packets for longer than the pre-roll, such as when encoding
+    // has been paused, the pre-roll no longer leads up to this packet.
+    auto gapSecs =
+        static_cast<double>(ts - utils::PacketTimestamp(*m_preRollPackets.back())) * m_timeBaseSecs;
+
+    if ((gapSecs < 0.0) || (gapSecs > m_preRollSecs))
+    {
+        ClearPreRoll();
+    }
+}
+
+void IpFreelyPacketRecorder::ClearPreRoll() noexcept
+{
+    for (auto& preRollPacket : m_preRollPackets)
+    {
+        av_packet_free(&preRollPacket);
+    }
+
+    m_preRollPackets.clear();
+    m_preRollBytes        = 0;
+    m_preRollDurationSecs = 0.0;
+}
+
+void IpFreelyPacketRecorder::UpdatePreRollSecs() noexcept
+{
+    if (m_preRollPackets.empty())
+    {
+        m_preRollDurationSecs = 0.0;
+        return;
+    }
+
+    m_preRollDurationSecs = static_cast<double>(utils::PacketTimestamp(*m_preRollPackets.back()) -
+                                                utils::PacketTimestamp(*m_preRollPackets.front())) *
+                            m_timeBaseSecs;
+}
+
+void IpFreelyPacketRecorder::WritePacket(AVPacket const& packet, AVRational const& timeBase)
+{
+    // A previous write may have failed and closed the file.
+    if (!m_outputCtx)
+    {
+        return;
+    }
+
+    m_lastDts = utils::PacketTimestamp(packet);
+
+    auto result = av_packet_ref(m_packet, &packet);
+
+    if (result < 0)
+    {
+        DEBUG_MESSAGE_EX_ERROR("Failed to reference packet for: " << m_filePrefix);
+        return;
+    }
+
+    if (m_packet->pts != AV_NOPTS_VALUE)
+    {
+        m_packet->pts -= m_fileStartTs;
+    }
+
+    if (m_packet->dts != AV_NOPTS_VALUE)
+    {
+        m_packet->dts -= m_fileStartTs;
+    }
+
+    m_packet->stream_index = 0;
+    m_packet->pos          = -1;
+
+    av_packet_rescale_ts(m_packet, timeBase, m_outputCtx->streams[0]->time_base);
+
+    // The muxer takes ownership of the packet's reference.
+    result = av_interleaved_write_frame(m_outputCtx, m_packet);
+
+    if (result < 0)
+    {
+        DEBUG_MESSAGE_EX_ERROR(
+            "Failed to write packet, closing current file for: " << m_filePrefix);
+        CloseFile();
+    }
+}
+
+void IpFreelyPacketRecorder::OpenFile(AVCodecParameters const& codecParams,
+                                      AVRational const& timeBase, int64_t const startTs,
+                                      int64_t const currentTs)
+{
+    // Name the file after the wall-clock time of its first packet, which for a
+    // pre-roll is earlier than now by the media time the pre-roll covers.
+    auto nowMillisecs = std::chrono::duration_cast<std::chrono::milliseconds>(
+                            std::chrono::system_clock::now().time_since_epoch())
+                            .count();
+    auto startMillisecs =
+        nowMillisecs - static_cast<int64_t>(std::llround(
+                           static_cast<double>(currentTs - startTs) * m_timeBaseSecs * 1000.0));
+
+    m_fileStartTs        = startTs;
+    m_fileStartMillisecs = startMillisecs;
+
+    auto startTime = static_cast<time_t>(startMillisecs / 1000);
+    auto localTime = std::localtime(&startTime);
+    char folderName[9];
+    std::strftime(folderName, sizeof(folderName), "%Y%m%d", localTime);
+
+    bfs::path p(m_saveFolderPath);
+    p /= folderName;
+    p = bfs::system_complete(p);
+
+    if (!bfs::exists(p))
+    {
+        if (!bfs::create_directories(p))
+        {
+            std::ostringstream oss;
+            oss << "Failed to create directories: " << p.string();
+            BOOST_THROW_EXCEPTION(std::runtime_error(oss.str()));
+        }
+    }
+
+    std::ostringstream oss;
+    oss << m_filePrefix << "_" << startMillisecs << m_fileExtension;
+
+    p /= oss.str();
+    m_filePath = p.string();
+
+    DEBUG_MESSAGE_EX_INFO("Creating new output packet file: "
+                          << p.string()
+                          << ", codec: " << avcodec_get_name(codecParams.codec_id));
+
+    auto result =
+        avformat_alloc_output_context2(&m_outputCtx, nullptr, nullptr, p.string().c_str());
+
+    if (result >= 0)
+    {
+        auto outStream = avformat_new_stream(m_outputCtx, nullptr);
+
+        if (!outStream)
+        {
+            result = AVERROR(ENOMEM);
+        }
+        else
+        {
+            result = avcodec_parameters_copy(outStream->codecpar, &codecParams);
+
+            // Let the muxer choose the tag suitable for its container.
+            outStream->codecpar->codec_tag = 0;
+            outStream->time_base           = timeBase;
+        }
+    }
+
+    if (result >= 0)
+    {
+        result = avio_open(&m_outputCtx->pb, p.string().c_str(), AVIO_FLAG_WRITE);
+    }
+
+    if (result >= 0)
+    {
+        result = avformat_write_header(m_outputCtx, nullptr);
+    }
+
+    if (result < 0)
+    {
+        if (m_outputCtx)
+        {
+            avio_closep(&m_outputCtx->pb);
+            avformat_free_context(m_outputCtx);
+            m_outputCtx = nullptr;
+        }
+
+        std::ostringstream err;
+        err << "Failed to open output packet file: " << p.string();
+        BOOST_THROW_EXCEPTION(std::runtime_error(err.str()));
+    }
+}
+
+void IpFreelyPacketRecorder::AddEventMarker(std::string const& eventName)
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_outputCtx)
+    {
+        return;
+    }
+
+    // Events are rare so open the sidecar file each time, this
+    // way a crash can't leave unflushed markers behind.
+    std::ofstream markers(m_filePath + EVENT_MARKERS_EXTENSION, std::ios::app);
+
+    if (!markers)
+    {
+        DEBUG_MESSAGE_EX_ERROR("Failed to write event marker for: " << m_filePath);
+        return;
+    }
+
+    auto offsetSecs = static_cast<double>(m_lastDts - m_fileStartTs) * m_timeBaseSecs;
+    markers << eventName << "," << offsetSecs << ","
+            << m_fileStartMillisecs + static_cast<int64_t>(std::llround(offsetSecs * 1000.0))
+            << "\n";
+}
+
+void IpFreelyPacketRecorder::CloseFile() noexcept
+{
+    if (!m_outputCtx)
+    {
+        return;
+    }
+
+    av_write_trailer(m_outputCtx);
+    avio_closep(&m_outputCtx->pb);
+    avformat_free_context(m_outputCtx);
+    m_outputCtx = nullptr;
+
+    if (!m_recordingCatalog)
+    {
+        return;
+    }
+
+    try
+    {
+        RecordingEntry entry;
+        entry.path           = m_filePath;
+        entry.camId          = m_camId;
+        entry.type           = m_recordingType;
+        entry.startMillisecs = m_fileStartMillisecs;
+        entry.endMillisecs =
+            m_fileStartMillisecs +
+            static_cast<int64_t>(std::llround(
+                static_cast<double>(m_lastDts - m_fileStartTs) * m_timeBaseSecs * 1000.0));
+        entry.bytes = bfs::file_size(m_filePath);
+
+        m_recordingCatalog->AddRecording(entry);
+    }
+    catch (...)
+    {
+        auto exceptionMsg = boost::current_exception_diagnostic_information();
+        DEBUG_MESSAGE_EX_ERROR("Failed to add file to catalog: " << m_filePath << ", reason: "
+                                                                  << exceptionMsg);
+    }
+}
+
+} // namespace ipfreely
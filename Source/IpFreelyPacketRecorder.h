@@ -0,0 +1,179 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyPacketRecorder.h
+ * \brief File containing declaration of IpFreelyPacketRecorder class.
+ */
+#ifndef IPFREELYPACKETRECORDER_H
+#define IPFREELYPACKETRECORDER_H
+
+#include <string>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include "IpFreelyRecordingCatalog.h"
+
+// Forward declarations.
+struct AVFormatContext;
+struct AVPacket;
+struct AVCodecParameters;
+struct AVRational;
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+class IpFreelyPacketSource;
+
+/*!
+ * \brief Class defining a recorder that writes a packet source's compressed packets to disk.
+ *
+ * The recorder registers itself with a packet source and, while started, muxes the source's
+ * packets unchanged into a series of files whose container is chosen by the file extension. A new
+ * file is only ever started on a keyframe, so each file can be played independently, and files
+ * are rotated on the first keyframe after the required file duration has been reached.
+ *
+ * Event markers, such as the start and end of motion, can be added to the current file. These
+ * are appended to a CSV sidecar file next to it giving each event's offset into the file.
+ *
+ * Each file is added to the recording catalog, if given one, when it is closed.
+ *
+ * Files are written on the thread the packet source calls its handlers from, so a camera's packet
+ * stream is recorded through a packet relay to keep file writes off the thread reading it.
+ *
+ * While stopped the recorder can hold a pre-roll of the most recent packets, always starting on a
+ * keyframe, which is written at the start of the next file so that it includes the seconds before
+ * recording was started. The pre-roll's memory use is capped.
+ */
+class IpFreelyPacketRecorder final
+{
+public:
+    /*!
+     * \brief IpFreelyPacketRecorder constructor.
+     * \param[in] filePrefix - Prefix used for each file's name, the file's start time is appended.
+     * \param[in] fileExtension - Extension of each file's name, e.g. ".mkv" or ".avi".
+     * \param[in] saveFolderPath - Folder under which daily folders of files are created.
+     * \param[in] requiredFileDurationSecs - Duration of each file before a new one is started.
+     * \param[in] preRollSecs - Seconds of packets to hold while stopped, 0 disables pre-roll.
+     * \param[in] packetSource - Packet source to record from.
+     * \param[in] recordingCatalog - (Optional) Catalog to add the files to.
+     * \param[in] camId - (Optional) The camera recorded, for the catalog.
+     * \param[in] recordingType - (Optional) The type of recording, for the catalog.
+     */
+    IpFreelyPacketRecorder(
+        std::string const& filePrefix, std::string const& fileExtension,
+        std::string const& saveFolderPath, double const requiredFileDurationSecs,
+        double const preRollSecs, std::shared_ptr<IpFreelyPacketSource> const& packetSource,
+        std::shared_ptr<IpFreelyRecordingCatalog> const& recordingCatalog = nullptr,
+        eCamId const camId = eCamId::noCam,
+        eRecordingType const recordingType = eRecordingType::segment);
+
+    /*! \brief IpFreelyPacketRecorder destructor. */
+    ~IpFreelyPacketRecorder();
+
+    /*! \brief IpFreelyPacketRecorder deleted copy constructor. */
+    IpFreelyPacketRecorder(IpFreelyPacketRecorder const&) = delete;
+
+    /*! \brief IpFreelyPacketRecorder deleted copy assignment operator. */
+    IpFreelyPacketRecorder& operator=(IpFreelyPacketRecorder const&) = delete;
+
+    /*!
+     * \brief Start enables recording.
+     *
+     * If a pre-roll is held the first file is opened with it on the next packet, otherwise the
+     * first file is opened on the next keyframe.
+     */
+    void Start() noexcept;
+
+    /*!
+     * \brief Stop disables recording and closes any open file.
+     */
+    void Stop() noexcept;
+
+    /*!
+     * \brief IsRecording reports if recording is enabled.
+     * \return True if enabled, false otherwise.
+     */
+    bool IsRecording() const noexcept;
+
+    /*!
+     * \brief PreRollBytes reports the memory used by the pre-roll's packets.
+     * \return The number of bytes.
+     *
+     * This and PreRollSecs never wait for a packet being written.
+     */
+    size_t PreRollBytes() const noexcept;
+
+    /*!
+     * \brief PreRollSecs reports the duration of the pre-roll currently held.
+     * \return The duration in seconds.
+     */
+    double PreRollSecs() const noexcept;
+
+    /*!
+     * \brief AddEventMarker records an event against the current file, if one is open.
+     * \param[in] eventName - The event's name.
+     */
+    void AddEventMarker(std::string const& eventName);
+
+private:
+    void PacketHandler(AVPacket const& packet, AVCodecParameters const& codecParams,
+                       AVRational const& timeBase);
+    void BufferPreRollPacket(AVPacket const& packet, int64_t const ts, bool const keyFrame);
+    void DiscardStalePreRoll(int64_t const ts) noexcept;
+    void ClearPreRoll() noexcept;
+    void UpdatePreRollSecs() noexcept;
+    void WritePacket(AVPacket const& packet, AVRational const& timeBase);
+    void OpenFile(AVCodecParameters const& codecParams, AVRational const& timeBase,
+                  int64_t const startTs, int64_t const currentTs);
+    void CloseFile() noexcept;
+
+private:
+    mutable std::mutex                        m_mutex{};
+    std::string                               m_filePrefix{};
+    std::string                               m_fileExtension{};
+    std::string                               m_saveFolderPath{};
+    double                                    m_requiredFileDurationSecs{0.0};
+    double                                    m_preRollSecs{0.0};
+    std::shared_ptr<IpFreelyPacketSource>     m_packetSource{};
+    std::shared_ptr<IpFreelyRecordingCatalog> m_recordingCatalog{};
+    eCamId                                    m_camId{eCamId::noCam};
+    eRecordingType                            m_recordingType{eRecordingType::segment};
+    int                                       m_packetHandlerId{0};
+    bool                                      m_recordingEnabled{false};
+    AVFormatContext*                          m_outputCtx{nullptr};
+    std::string                               m_filePath{};
+    AVPacket*                                 m_packet{nullptr};
+    int64_t                                   m_fileStartTs{0};
+    int64_t                                   m_fileStartMillisecs{0};
+    int64_t                                   m_lastDts{0};
+    double                                    m_timeBaseSecs{0.0};
+    std::deque<AVPacket*>                     m_preRollPackets{};
+    std::atomic<size_t>                       m_preRollBytes{0};
+    std::atomic<double>                       m_preRollDurationSecs{0.0};
+    bool                                      m_preRollCapWarned{false};
+};
+
+} // namespace ipfreely
+
+#endif // IPFREELYPACKETRECORDER_H
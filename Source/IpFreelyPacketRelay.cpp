@@ -0,0 +1,155 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyPacketRelay.cpp
+ * \brief File containing definition of IpFreelyPacketRelay class.
+ */
+#include "IpFreelyPacketRelay.h"
+#include <stdexcept>
+#include <boost/throw_exception.hpp>
+#include "IpFreelyRecordingWriter.h"
+#include "DebugLog/DebugLogging.h"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+}
+
+namespace ipfreely
+{
+
+namespace utils
+{
+
+inline std::shared_ptr<AVPacket> ClonePacket(AVPacket const& packet)
+{
+    return std::shared_ptr<AVPacket>(av_packet_clone(&packet),
+                                     [](AVPacket* p) { av_packet_free(&p); });
+}
+
+inline std::shared_ptr<AVCodecParameters> CopyCodecParameters(AVCodecParameters const& codecParams)
+{
+    std::shared_ptr<AVCodecParameters> copy(avcodec_parameters_alloc(),
+                                            [](AVCodecParameters* p) {
+                                                avcodec_parameters_free(&p);
+                                            });
+
+    if (!copy || (avcodec_parameters_copy(copy.get(), &codecParams) < 0))
+    {
+        return nullptr;
+    }
+
+    return copy;
+}
+
+} // namespace utils
+
+IpFreelyPacketRelay::IpFreelyPacketRelay(
+    std::string const& name, std::shared_ptr<IpFreelyPacketSource> const& packetSource,
+    std::shared_ptr<IpFreelyRecordingWriter> const& recordingWriter)
+    : m_name(name)
+    , m_packetSource(packetSource)
+    , m_recordingWriter(recordingWriter)
+{
+    if (!m_packetSource || !recordingWriter)
+    {
+        BOOST_THROW_EXCEPTION(
+            std::invalid_argument("Packet relay requires a packet source and recording writer."));
+    }
+
+    m_packetHandlerId = m_packetSource->AddPacketHandler(
+        std::bind(&IpFreelyPacketRelay::PacketHandler,
+                  this,
+                  std::placeholders::_1,
+                  std::placeholders::_2,
+                  std::placeholders::_3));
+}
+
+IpFreelyPacketRelay::~IpFreelyPacketRelay()
+{
+    m_packetSource->RemovePacketHandler(m_packetHandlerId);
+}
+
+uint64_t IpFreelyPacketRelay::PacketsDropped() const noexcept
+{
+    return m_packetsDropped;
+}
+
+void IpFreelyPacketRelay::PacketHandler(AVPacket const&          packet,
+                                        AVCodecParameters const& codecParams,
+                                        AVRational const&        timeBase)
+{
+    auto recordingWriter = m_recordingWriter.lock();
+
+    if (!recordingWriter)
+    {
+        return;
+    }
+
+    bool const keyFrame = (packet.flags & AV_PKT_FLAG_KEY) != 0;
+
+    // Once a packet has been dropped the recorders can only carry on from a keyframe.
+    if (m_waitForKeyFrame && !keyFrame)
+    {
+        ++m_packetsDropped;
+        return;
+    }
+
+    // The source's parameters only change when it reconnects, which always
+    // starts on a keyframe, so they are only copied on keyframes.
+    if (!m_codecParams || keyFrame)
+    {
+        m_codecParams = utils::CopyCodecParameters(codecParams);
+    }
+
+    auto queuedPacket = utils::ClonePacket(packet);
+
+    if (!queuedPacket || !m_codecParams)
+    {
+        DEBUG_MESSAGE_EX_ERROR("Failed to copy packet for recording writer for: " << m_name);
+        m_codecParams.reset();
+        m_waitForKeyFrame = true;
+        ++m_packetsDropped;
+        return;
+    }
+
+    auto queuedCodecParams = m_codecParams;
+    auto relayPacket       = [this, queuedPacket, queuedCodecParams, timeBase]() {
+        DispatchPacket(*queuedPacket, *queuedCodecParams, timeBase);
+    };
+
+    if (recordingWriter->TryPost(relayPacket))
+    {
+        m_waitForKeyFrame = false;
+        return;
+    }
+
+    if (!m_waitForKeyFrame)
+    {
+        DEBUG_MESSAGE_EX_WARNING(
+            "Recording writer queue full, dropping packets to next keyframe for: " << m_name);
+    }
+
+    m_waitForKeyFrame = true;
+    ++m_packetsDropped;
+}
+
+} // namespace ipfreely
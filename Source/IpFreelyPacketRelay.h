@@ -0,0 +1,100 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyPacketRelay.h
+ * \brief File containing declaration of IpFreelyPacketRelay class.
+ */
+#ifndef IPFREELYPACKETRELAY_H
+#define IPFREELYPACKETRELAY_H
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include "IpFreelyPacketSource.h"
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+class IpFreelyRecordingWriter;
+
+/*!
+ * \brief Class defining a packet source that passes on another source's packets from a
+ * recording writer's thread.
+ *
+ * A camera's compressed packets are read on the packet stream's thread. Recorders open, rotate
+ * and write files as they receive packets, so registering them with the relay instead keeps slow
+ * disks from holding up reading the stream. Each packet is copied onto the writer's queue, in
+ * order with the writer's other work, and passed to the relay's handlers from the writer's
+ * thread.
+ *
+ * While the writer's queue is full packets are dropped, up to the next keyframe so that the
+ * recorders' files stay decodable.
+ *
+ * Queued packets refer to the relay, so the writer must be destroyed before the relay.
+ */
+class IpFreelyPacketRelay final : public IpFreelyPacketSource
+{
+public:
+    /*!
+     * \brief IpFreelyPacketRelay constructor.
+     * \param[in] name - A name for the relay, used for logging.
+     * \param[in] packetSource - The source whose packets are passed on.
+     * \param[in] recordingWriter - The writer whose thread the packets are passed on from.
+     */
+    IpFreelyPacketRelay(std::string const&                              name,
+                        std::shared_ptr<IpFreelyPacketSource> const&    packetSource,
+                        std::shared_ptr<IpFreelyRecordingWriter> const& recordingWriter);
+
+    /*! \brief IpFreelyPacketRelay destructor. */
+    ~IpFreelyPacketRelay() override;
+
+    /*! \brief IpFreelyPacketRelay deleted copy constructor. */
+    IpFreelyPacketRelay(IpFreelyPacketRelay const&) = delete;
+
+    /*! \brief IpFreelyPacketRelay deleted copy assignment operator. */
+    IpFreelyPacketRelay& operator=(IpFreelyPacketRelay const&) = delete;
+
+    /*!
+     * \brief PacketsDropped reports the number of packets dropped because the writer's queue was
+     * full.
+     * \return The number of packets.
+     */
+    uint64_t PacketsDropped() const noexcept;
+
+private:
+    void PacketHandler(AVPacket const& packet, AVCodecParameters const& codecParams,
+                       AVRational const& timeBase);
+
+private:
+    std::string                            m_name{"cam"};
+    std::shared_ptr<IpFreelyPacketSource>  m_packetSource{};
+    std::weak_ptr<IpFreelyRecordingWriter> m_recordingWriter{};
+    int                                    m_packetHandlerId{0};
+    std::shared_ptr<AVCodecParameters>     m_codecParams{};
+    bool                                   m_waitForKeyFrame{false};
+    std::atomic<uint64_t>                  m_packetsDropped{0};
+};
+
+} // namespace ipfreely
+
+#endif // IPFREELYPACKETRELAY_H
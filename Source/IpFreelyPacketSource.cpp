@@ -0,0 +1,56 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyPacketSource.cpp
+ * \brief File containing definition of IpFreelyPacketSource class.
+ */
+#include "IpFreelyPacketSource.h"
+
+namespace ipfreely
+{
+
+int IpFreelyPacketSource::AddPacketHandler(packet_handler_t const& handler)
+{
+    std::lock_guard<std::mutex> lock(m_handlersMutex);
+    auto                        handlerId = m_nextHandlerId++;
+    m_packetHandlers[handlerId]           = handler;
+    return handlerId;
+}
+
+void IpFreelyPacketSource::RemovePacketHandler(int const handlerId)
+{
+    std::lock_guard<std::mutex> lock(m_handlersMutex);
+    m_packetHandlers.erase(handlerId);
+}
+
+void IpFreelyPacketSource::DispatchPacket(AVPacket const&          packet,
+                                          AVCodecParameters const& codecParams,
+                                          AVRational const&        timeBase)
+{
+    std::lock_guard<std::mutex> lock(m_handlersMutex);
+
+    for (auto const& handler : m_packetHandlers)
+    {
+        handler.second(packet, codecParams, timeBase);
+    }
+}
+
+} // namespace ipfreely
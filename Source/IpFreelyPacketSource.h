@@ -0,0 +1,104 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyPacketSource.h
+ * \brief File containing declaration of IpFreelyPacketSource class.
+ */
+#ifndef IPFREELYPACKETSOURCE_H
+#define IPFREELYPACKETSOURCE_H
+
+#include <map>
+#include <mutex>
+#include <functional>
+
+// Forward declarations.
+struct AVPacket;
+struct AVCodecParameters;
+struct AVRational;
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+/*!
+ * \brief Class defining a source of compressed video packets.
+ *
+ * A packet source is the single point where a camera's compressed video is produced, either read
+ * directly from the camera or encoded from decoded frames. Any number of sinks, such as packet
+ * recorders, register a handler to receive every packet so that they all share one stream.
+ */
+class IpFreelyPacketSource
+{
+public:
+    /*! \brief Typedef to packet handler function object. */
+    typedef std::function<void(AVPacket const&          packet,
+                               AVCodecParameters const& codecParams,
+                               AVRational const&        timeBase)>
+        packet_handler_t;
+
+    /*! \brief IpFreelyPacketSource constructor. */
+    IpFreelyPacketSource() = default;
+
+    /*! \brief IpFreelyPacketSource destructor. */
+    virtual ~IpFreelyPacketSource() = default;
+
+    /*! \brief IpFreelyPacketSource deleted copy constructor. */
+    IpFreelyPacketSource(IpFreelyPacketSource const&) = delete;
+
+    /*! \brief IpFreelyPacketSource deleted copy assignment operator. */
+    IpFreelyPacketSource& operator=(IpFreelyPacketSource const&) = delete;
+
+    /*!
+     * \brief AddPacketHandler registers a function to be called for every video packet.
+     * \param[in] handler - The packet handler, called on the thread producing the packets.
+     * \return An ID to pass to RemovePacketHandler.
+     *
+     * Handlers must take their own reference to the packet if they need it after returning.
+     */
+    int AddPacketHandler(packet_handler_t const& handler);
+
+    /*!
+     * \brief RemovePacketHandler unregisters a packet handler.
+     * \param[in] handlerId - The ID returned by AddPacketHandler.
+     *
+     * Once this returns the handler will not be called again.
+     */
+    void RemovePacketHandler(int const handlerId);
+
+protected:
+    /*!
+     * \brief DispatchPacket passes a packet to all registered handlers.
+     * \param[in] packet - The compressed video packet.
+     * \param[in] codecParams - The codec parameters of the packet's stream.
+     * \param[in] timeBase - The time base of the packet's timestamps.
+     */
+    void DispatchPacket(AVPacket const& packet, AVCodecParameters const& codecParams,
+                        AVRational const& timeBase);
+
+private:
+    std::mutex                      m_handlersMutex{};
+    std::map<int, packet_handler_t> m_packetHandlers{};
+    int                             m_nextHandlerId{1};
+};
+
+} // namespace ipfreely
+
+#endif // IPFREELYPACKETSOURCE_H
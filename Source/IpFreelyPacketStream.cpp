@@ -0,0 +1,247 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyPacketStream.cpp
+ * \brief File containing definition of IpFreelyPacketStream threaded class.
+ */
+#include "IpFreelyPacketStream.h"
+#include <sstream>
+#include <mutex>
+#include <thread>
+#include <chrono>
+#include <boost/exception/all.hpp>
+#include "Threads/EventThread.h"
+#include "DebugLog/DebugLogging.h"
+
+extern "C"
+{
+#include <libavformat/avformat.h>
+#include <libavcodec/avcodec.h>
+}
+
+namespace ipfreely
+{
+
+static constexpr unsigned int PACKET_THREAD_PERIOD_MS = 1;
+static constexpr unsigned int PACKET_RETRY_PERIOD_MS  = 100;
+static constexpr unsigned int MAX_READ_FAILURES       = 50;
+
+namespace utils
+{
+
+inline void InitialiseLibAv()
+{
+    static std::once_flag initFlag;
+
+    std::call_once(initFlag, []() {
+#if LIBAVFORMAT_VERSION_INT < AV_VERSION_INT(58, 9, 100)
+        av_register_all();
+#endif
+        avformat_network_init();
+    });
+}
+
+inline std::string AvErrorToString(int const errorCode)
+{
+    char buf[AV_ERROR_MAX_STRING_SIZE] = {0};
+    av_strerror(errorCode, buf, sizeof(buf));
+    return buf;
+}
+
+} // namespace utils
+
+IpFreelyPacketStream::IpFreelyPacketStream(std::string const& name, std::string const& streamUrl)
+    : m_name(name)
+    , m_streamUrl(streamUrl)
+{
+    utils::InitialiseLibAv();
+
+    m_packet = av_packet_alloc();
+
+    if (!m_packet)
+    {
+        BOOST_THROW_EXCEPTION(std::runtime_error("Failed to allocate AVPacket."));
+    }
+
+    try
+    {
+        OpenStream();
+    }
+    catch (...)
+    {
+        av_packet_free(&m_packet);
+        throw;
+    }
+
+    DEBUG_MESSAGE_EX_INFO("Creating packet stream thread for camera: " << m_name);
+
+    m_eventThread = std::make_shared<core_lib::threads::EventThread>(
+        std::bind(&IpFreelyPacketStream::ThreadEventCallback, this), PACKET_THREAD_PERIOD_MS);
+}
+
+IpFreelyPacketStream::~IpFreelyPacketStream()
+{
+    // Abort any blocking read so the thread can exit promptly.
+    m_stopping = true;
+    m_eventThread.reset();
+    CloseStream();
+    av_packet_free(&m_packet);
+}
+
+uint64_t IpFreelyPacketStream::PacketsRead() const noexcept
+{
+    return m_packetsRead;
+}
+
+int IpFreelyPacketStream::InterruptCallback(void* opaque)
+{
+    auto packetStream = reinterpret_cast<IpFreelyPacketStream*>(opaque);
+    return packetStream->m_stopping ? 1 : 0;
+}
+
+void IpFreelyPacketStream::OpenStream()
+{
+    m_formatCtx = avformat_alloc_context();
+
+    if (!m_formatCtx)
+    {
+        BOOST_THROW_EXCEPTION(std::runtime_error("Failed to allocate AVFormatContext."));
+    }
+
+    m_formatCtx->interrupt_callback.callback = &IpFreelyPacketStream::InterruptCallback;
+    m_formatCtx->interrupt_callback.opaque   = this;
+
+    // RTSP over UDP loses packets under load, which corrupts the recorded
+    // stream until the next keyframe, so always ask for TCP transport.
+    AVDictionary* options = nullptr;
+    av_dict_set(&options, "rtsp_transport", "tcp", 0);
+
+    auto result = avformat_open_input(&m_formatCtx, m_streamUrl.c_str(), nullptr, &options);
+    av_dict_free(&options);
+
+    // On failure avformat_open_input frees the context for us.
+    if (result < 0)
+    {
+        std::ostringstream oss;
+        oss << "Failed to open packet stream for camera: " << m_name
+            << ", error: " << utils::AvErrorToString(result);
+        BOOST_THROW_EXCEPTION(std::runtime_error(oss.str()));
+    }
+
+    result = avformat_find_stream_info(m_formatCtx, nullptr);
+
+    if (result >= 0)
+    {
+        result = av_find_best_stream(m_formatCtx, AVMEDIA_TYPE_VIDEO, -1, -1, nullptr, 0);
+    }
+
+    if (result < 0)
+    {
+        CloseStream();
+        std::ostringstream oss;
+        oss << "Failed to find video in packet stream for camera: " << m_name
+            << ", error: " << utils::AvErrorToString(result);
+        BOOST_THROW_EXCEPTION(std::runtime_error(oss.str()));
+    }
+
+    m_videoStreamIndex = result;
+
+    auto codecpar = m_formatCtx->streams[m_videoStreamIndex]->codecpar;
+
+    DEBUG_MESSAGE_EX_INFO("Opened packet stream for camera: "
+                          << m_name << ", codec: " << avcodec_get_name(codecpar->codec_id)
+                          << ", size: " << codecpar->width << "x" << codecpar->height);
+}
+
+void IpFreelyPacketStream::CloseStream() noexcept
+{
+    if (m_formatCtx)
+    {
+        avformat_close_input(&m_formatCtx);
+    }
+}
+
+void IpFreelyPacketStream::ThreadEventCallback() noexcept
+{
+    try
+    {
+        // A previous reconnection attempt failed so try again.
+        if (!m_formatCtx)
+        {
+            OpenStream();
+        }
+
+        auto result = av_read_frame(m_formatCtx, m_packet);
+
+        if (result < 0)
+        {
+            if (m_stopping)
+            {
+                return;
+            }
+
+            // Don't spin if the stream has dropped out and after too many
+            // consecutive failures reconnect to the camera. The codec
+            // parameters are assumed unchanged so any recorders can carry on.
+            if (++m_readFailures < MAX_READ_FAILURES)
+            {
+                std::this_thread::sleep_for(std::chrono::milliseconds(PACKET_RETRY_PERIOD_MS));
+                return;
+            }
+
+            DEBUG_MESSAGE_EX_WARNING("Reconnecting packet stream for camera: "
+                                     << m_name
+                                     << ", last error: " << utils::AvErrorToString(result));
+
+            m_readFailures = 0;
+            CloseStream();
+            OpenStream();
+            return;
+        }
+
+        m_readFailures = 0;
+
+        if (m_packet->stream_index == m_videoStreamIndex)
+        {
+            ++m_packetsRead;
+
+            auto const& stream = *m_formatCtx->streams[m_videoStreamIndex];
+            DispatchPacket(*m_packet, *stream.codecpar, stream.time_base);
+        }
+
+        av_packet_unref(m_packet);
+    }
+    catch (...)
+    {
+        av_packet_unref(m_packet);
+
+        auto exceptionMsg = boost::current_exception_diagnostic_information();
+        DEBUG_MESSAGE_EX_ERROR(exceptionMsg);
+
+        // If reconnecting failed don't hammer the camera.
+        if (!m_formatCtx)
+        {
+            std::this_thread::sleep_for(std::chrono::milliseconds(PACKET_RETRY_PERIOD_MS));
+        }
+    }
+}
+
+} // namespace ipfreely
@@ -0,0 +1,105 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyPacketStream.h
+ * \brief File containing declaration of IpFreelyPacketStream threaded class.
+ */
+#ifndef IPFREELYPACKETSTREAM_H
+#define IPFREELYPACKETSTREAM_H
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <cstdint>
+#include "IpFreelyPacketSource.h"
+
+// Forward declarations.
+struct AVFormatContext;
+
+namespace core_lib
+{
+namespace threads
+{
+
+class EventThread;
+
+} // namespace threads
+} // namespace core_lib
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+/*!
+ * \brief Class defining a compressed packet reader for a camera's video stream.
+ *
+ * The packet stream opens its own connection to the camera using libavformat and reads the
+ * camera's compressed video packets on a dedicated thread without decoding them. Each packet is
+ * passed to the registered packet handlers.
+ */
+class IpFreelyPacketStream final : public IpFreelyPacketSource
+{
+public:
+    /*!
+     * \brief IpFreelyPacketStream constructor.
+     * \param[in] name - A name for the stream, used for logging.
+     * \param[in] streamUrl - The complete URL, including any credentials, of the camera's stream.
+     *
+     * Throws std::runtime_error if the stream cannot be opened or contains no video.
+     */
+    IpFreelyPacketStream(std::string const& name, std::string const& streamUrl);
+
+    /*! \brief IpFreelyPacketStream destructor. */
+    ~IpFreelyPacketStream() override;
+
+    /*! \brief IpFreelyPacketStream deleted copy constructor. */
+    IpFreelyPacketStream(IpFreelyPacketStream const&) = delete;
+
+    /*! \brief IpFreelyPacketStream deleted copy assignment operator. */
+    IpFreelyPacketStream& operator=(IpFreelyPacketStream const&) = delete;
+
+    /*!
+     * \brief PacketsRead reports the number of video packets read from the stream.
+     * \return The number of packets.
+     */
+    uint64_t PacketsRead() const noexcept;
+
+private:
+    static int InterruptCallback(void* opaque);
+    void       OpenStream();
+    void       CloseStream() noexcept;
+    void       ThreadEventCallback() noexcept;
+
+private:
+    std::string                                     m_name{"cam"};
+    std::string                                     m_streamUrl{};
+    AVFormatContext*                                m_formatCtx{nullptr};
+    AVPacket*                                       m_packet{nullptr};
+    int                                             m_videoStreamIndex{-1};
+    std::atomic<bool>                               m_stopping{false};
+    std::atomic<uint64_t>                           m_packetsRead{0};
+    unsigned int                                    m_readFailures{0};
+    std::shared_ptr<core_lib::threads::EventThread> m_eventThread;
+};
+
+} // namespace ipfreely
+
+#endif // IPFREELYPACKETSTREAM_H
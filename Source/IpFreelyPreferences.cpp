@@ -179,6 +179,64 @@ void IpFreelyPreferences::SetMaxUsedDiskSpacePercent(int const maxUsedPercent) n
     m_maxUsedDiskSpacePercent = maxUsedPercent;
 }
 
+double IpFreelyPreferences::DeletionFilesPerSec() const noexcept
+{
+    return m_deletionFilesPerSec;
+}
+
+void IpFreelyPreferences::SetDeletionFilesPerSec(double const filesPerSec) noexcept
+{
+    m_deletionFilesPerSec = filesPerSec;
+}
+
+double IpFreelyPreferences::DeletionMebibytesPerSec() const noexcept
+{
+    return m_deletionMebibytesPerSec;
+}
+
+void IpFreelyPreferences::SetDeletionMebibytesPerSec(double const mebibytesPerSec) noexcept
+{
+    m_deletionMebibytesPerSec = mebibytesPerSec;
+}
+
+std::string IpFreelyPreferences::ArchiveFolderPath() const noexcept
+{
+    return m_archiveFolderPath;
+}
+
+void IpFreelyPreferences::SetArchiveFolderPath(std::string const& archiveFolderPath) noexcept
+{
+    if (archiveFolderPath.empty())
+    {
+        m_archiveFolderPath.clear();
+        return;
+    }
+
+    bfs::path p(archiveFolderPath);
+    p                   = bfs::system_complete(p);
+    m_archiveFolderPath = p.string();
+}
+
+int IpFreelyPreferences::ArchiveAfterHours() const noexcept
+{
+    return m_archiveAfterHours;
+}
+
+void IpFreelyPreferences::SetArchiveAfterHours(int const archiveAfterHours) noexcept
+{
+    m_archiveAfterHours = archiveAfterHours;
+}
+
+double IpFreelyPreferences::ArchiveMebibytesPerSec() const noexcept
+{
+    return m_archiveMebibytesPerSec;
+}
+
+void IpFreelyPreferences::SetArchiveMebibytesPerSec(double const mebibytesPerSec) noexcept
+{
+    m_archiveMebibytesPerSec = mebibytesPerSec;
+}
+
 void IpFreelyPreferences::Save() const
 {
     if (bfs::exists(m_cfgPath))
@@ -148,6 +148,66 @@ public:
      */
     void SetMaxUsedDiskSpacePercent(int const maxUsedPercent) noexcept;
 
+    /*!
+     * \brief DeletionFilesPerSec returns the most old recordings to delete each second.
+     * \return The number of files per second, 0 for no limit.
+     */
+    double DeletionFilesPerSec() const noexcept;
+
+    /*!
+     * \brief SetDeletionFilesPerSec sets the most old recordings to delete each second.
+     * \param[in] filesPerSec - The number of files per second, 0 for no limit.
+     */
+    void SetDeletionFilesPerSec(double const filesPerSec) noexcept;
+
+    /*!
+     * \brief DeletionMebibytesPerSec returns the most MiB of old recordings to delete each second.
+     * \return The number of MiB per second, 0 for no limit.
+     */
+    double DeletionMebibytesPerSec() const noexcept;
+
+    /*!
+     * \brief SetDeletionMebibytesPerSec sets the most MiB of old recordings to delete each second.
+     * \param[in] mebibytesPerSec - The number of MiB per second, 0 for no limit.
+     */
+    void SetDeletionMebibytesPerSec(double const mebibytesPerSec) noexcept;
+
+    /*!
+     * \brief ArchiveFolderPath retrieves the archive folder path.
+     * \return A string containing the archive folder path, empty if recordings are not archived.
+     */
+    std::string ArchiveFolderPath() const noexcept;
+
+    /*!
+     * \brief SetArchiveFolderPath sets the archive folder path.
+     * \param[in] archiveFolderPath - A string containing the archive folder path, empty for none.
+     */
+    void SetArchiveFolderPath(std::string const& archiveFolderPath) noexcept;
+
+    /*!
+     * \brief ArchiveAfterHours returns how long after recording to archive recordings.
+     * \return The number of hours.
+     */
+    int ArchiveAfterHours() const noexcept;
+
+    /*!
+     * \brief SetArchiveAfterHours sets how long after recording to archive recordings.
+     * \param[in] archiveAfterHours - The number of hours.
+     */
+    void SetArchiveAfterHours(int const archiveAfterHours) noexcept;
+
+    /*!
+     * \brief ArchiveMebibytesPerSec returns the most MiB of recordings to archive each second.
+     * \return The number of MiB per second, 0 for no limit.
+     */
+    double ArchiveMebibytesPerSec() const noexcept;
+
+    /*!
+     * \brief SetArchiveMebibytesPerSec sets the most MiB of recordings to archive each second.
+     * \param[in] mebibytesPerSec - The number of MiB per second, 0 for no limit.
+     */
+    void SetArchiveMebibytesPerSec(double const mebibytesPerSec) noexcept;
+
     /*!
      * \brief Save the preferences to disk from memory.
      */
@@ -176,6 +236,20 @@ private:
            CEREAL_NVP(m_mtSchedule),
            CEREAL_NVP(m_maxNumDaysData),
            CEREAL_NVP(m_maxUsedDiskSpacePercent));
+
+        if (version > 1)
+        {
+            // Added with version 2.
+            ar(CEREAL_NVP(m_deletionFilesPerSec), CEREAL_NVP(m_deletionMebibytesPerSec));
+        }
+
+        if (version > 2)
+        {
+            // Added with version 3.
+            ar(CEREAL_NVP(m_archiveFolderPath),
+               CEREAL_NVP(m_archiveAfterHours),
+               CEREAL_NVP(m_archiveMebibytesPerSec));
+        }
     }
 
 private:
@@ -189,12 +263,17 @@ private:
     std::vector<std::vector<bool>> m_mtSchedule{
         7, {true, true, true, true, true, true, true, true, true, true, true, true,
             true, true, true, true, true, true, true, true, true, true, true, true}};
-    int m_maxNumDaysData{7};
-    int m_maxUsedDiskSpacePercent{90};
+    int         m_maxNumDaysData{7};
+    int         m_maxUsedDiskSpacePercent{90};
+    double      m_deletionFilesPerSec{10.0};
+    double      m_deletionMebibytesPerSec{0.0};
+    std::string m_archiveFolderPath{};
+    int         m_archiveAfterHours{24};
+    double      m_archiveMebibytesPerSec{20.0};
 };
 
 } // namespace ipfreely
 
-CEREAL_CLASS_VERSION(ipfreely::IpFreelyPreferences, 1);
+CEREAL_CLASS_VERSION(ipfreely::IpFreelyPreferences, 3);
 
 #endif // IPFREELYPREFERENCES_H
@@ -25,6 +25,7 @@
 #include "IpFreelyPreferencesDialog.h"
 #include "ui_IpFreelyPreferencesDialog.h"
 #include <QFileDialog>
+#include <QDir>
 #include <QScreen>
 #include <boost/filesystem.hpp>
 #include "IpFreelyPreferences.h"
@@ -50,6 +51,11 @@ IpFreelyPreferencesDialog::IpFreelyPreferencesDialog(ipfreely::IpFreelyPreferenc
     ui->connectOnStartupCheckBox->setChecked(m_prefs.ConnectToCamerasOnStartup());
     ui->maxDaysOfDataSpinBox->setValue(m_prefs.MaxNumDaysData());
     ui->percentDiskUsedSpinBox->setValue(m_prefs.MaxUsedDiskSpacePercent());
+    ui->deletionFilesPerSecDoubleSpinBox->setValue(m_prefs.DeletionFilesPerSec());
+    ui->deletionMebibytesPerSecDoubleSpinBox->setValue(m_prefs.DeletionMebibytesPerSec());
+    ui->archiveFolderPathLineEdit->setText(QString::fromStdString(m_prefs.ArchiveFolderPath()));
+    ui->archiveAfterHoursSpinBox->setValue(m_prefs.ArchiveAfterHours());
+    ui->archiveMebibytesPerSecDoubleSpinBox->setValue(m_prefs.ArchiveMebibytesPerSec());
     SetDisplaySize();
 
     InitialisSchedules();
@@ -93,6 +99,11 @@ void IpFreelyPreferencesDialog::on_buttonBox_accepted()
     m_prefs.SetMotionTrackingSchedule(schedule);
     m_prefs.SetMaxNumDaysData(ui->maxDaysOfDataSpinBox->value());
     m_prefs.SetMaxUsedDiskSpacePercent(ui->percentDiskUsedSpinBox->value());
+    m_prefs.SetDeletionFilesPerSec(ui->deletionFilesPerSecDoubleSpinBox->value());
+    m_prefs.SetDeletionMebibytesPerSec(ui->deletionMebibytesPerSecDoubleSpinBox->value());
+    m_prefs.SetArchiveFolderPath(ui->archiveFolderPathLineEdit->text().trimmed().toStdString());
+    m_prefs.SetArchiveAfterHours(ui->archiveAfterHoursSpinBox->value());
+    m_prefs.SetArchiveMebibytesPerSec(ui->archiveMebibytesPerSecDoubleSpinBox->value());
 
     m_prefs.Save();
     accept();
@@ -126,6 +137,21 @@ void IpFreelyPreferencesDialog::on_saveFolderPathToolButton_clicked()
     ui->saveFolderPathLineEdit->setText(QString::fromStdWString(p.wstring()));
 }
 
+void IpFreelyPreferencesDialog::on_archiveFolderPathToolButton_clicked()
+{
+    // The archive is used as chosen, it may be a mount point shared with other data.
+    QString dir = QFileDialog::getExistingDirectory(
+        this,
+        tr("Select archive folder..."),
+        ui->archiveFolderPathLineEdit->text(),
+        QFileDialog::ShowDirsOnly | QFileDialog::DontResolveSymlinks);
+
+    if (!dir.isEmpty())
+    {
+        ui->archiveFolderPathLineEdit->setText(QDir::toNativeSeparators(dir));
+    }
+}
+
 void IpFreelyPreferencesDialog::on_selectNonePushButton_clicked()
 {
     for (int row = 0; row < ui->scheduleTableWidget->rowCount(); ++row)
@@ -59,6 +59,7 @@ private slots:
     void on_buttonBox_accepted();
     void on_buttonBox_rejected();
     void on_saveFolderPathToolButton_clicked();
+    void on_archiveFolderPathToolButton_clicked();
     void on_selectNonePushButton_clicked();
     void on_selectAllPushButton_clicked();
     void on_revertSchedulePushButton_clicked();
@@ -0,0 +1,1057 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+
+/*!
+ * \file IpFreelyRecordingCatalog.cpp
+ * \brief File containing definition of IpFreelyRecordingCatalog class.
+ */
+#include "IpFreelyRecordingCatalog.h"
+#include <sstream>
+#include <cstring>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+#include <boost/throw_exception.hpp>
+#include <boost/exception/all.hpp>
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+#include "DebugLog/DebugLogging.h"
+
+namespace bfs = boost::filesystem;
+namespace bip = boost::interprocess;
+
+namespace ipfreely
+{
+
+static constexpr char     CATALOG_FILE_NAME[]  = "IpFreely.catalog";
+static constexpr char     CATALOG_MAGIC[]      = "IPFCATLG";
+static constexpr uint32_t CATALOG_VERSION      = 3;
+static constexpr size_t   CATALOG_PATH_CHARS   = 224;
+static constexpr size_t   ARCHIVE_PATH_CHARS   = 480;
+static constexpr size_t   COMPACT_MIN_RECORDS  = 1024;
+static constexpr char     MOTION_CLIP_SUFFIX[] = "_motion";
+static constexpr size_t   MAX_SECONDS_DIGITS   = 10;
+static constexpr int64_t  MAX_DURATION_MILLIS  = 24 * 3600 * 1000;
+
+/*! \brief Structure defining the catalog file's header. */
+struct CatalogHeader final
+{
+    char     magic[8];
+    uint32_t version;
+    uint32_t recordBytes;
+    uint8_t  reserved[16];
+    char     archiveFolderPath[ARCHIVE_PATH_CHARS];
+};
+
+/*! \brief Structure defining a catalog file record, in the platform's byte order. */
+struct CatalogRecord final
+{
+    int64_t  startMillisecs;
+    int64_t  endMillisecs;
+    uint64_t bytes;
+    uint8_t  camId;
+    uint8_t  type;
+    uint8_t  removed;
+    uint8_t  tier;
+    uint8_t  reserved[4];
+    char     path[CATALOG_PATH_CHARS];
+};
+
+static_assert(sizeof(CatalogHeader) == 512, "Catalog header must be 512 bytes.");
+static_assert(sizeof(CatalogRecord) == 256, "Catalog record must be 256 bytes.");
+static_assert(std::is_trivially_copyable<CatalogRecord>::value,
+              "Catalog record must be trivially copyable.");
+
+namespace utils
+{
+
+inline CatalogHeader MakeHeader(std::string const& archiveFolderPath) noexcept
+{
+    CatalogHeader header{};
+    std::memcpy(header.magic, CATALOG_MAGIC, sizeof(header.magic));
+    header.version     = CATALOG_VERSION;
+    header.recordBytes = sizeof(CatalogRecord);
+
+    // A path too long to record is left empty, so the archive is reconciled on every load.
+    if (archiveFolderPath.size() < ARCHIVE_PATH_CHARS)
+    {
+        std::memcpy(
+            header.archiveFolderPath, archiveFolderPath.data(), archiveFolderPath.size());
+    }
+
+    return header;
+}
+
+inline std::string HeaderArchivePath(CatalogHeader const& header)
+{
+    return std::string(header.archiveFolderPath,
+                       strnlen(header.archiveFolderPath, ARCHIVE_PATH_CHARS));
+}
+
+inline bool HeaderIsValid(CatalogHeader const& header) noexcept
+{
+    return (std::memcmp(header.magic, CATALOG_MAGIC, sizeof(header.magic)) == 0) &&
+           (header.version == CATALOG_VERSION) && (header.recordBytes == sizeof(CatalogRecord));
+}
+
+inline CatalogRecord MakeRecord(RecordingEntry const& entry, bool const removed) noexcept
+{
+    CatalogRecord record{};
+    record.startMillisecs = entry.startMillisecs;
+    record.endMillisecs   = entry.endMillisecs;
+    record.bytes          = entry.bytes;
+    record.camId          = static_cast<uint8_t>(entry.camId);
+    record.type           = static_cast<uint8_t>(entry.type);
+    record.removed        = removed ? 1 : 0;
+    record.tier           = static_cast<uint8_t>(entry.tier);
+    std::memcpy(record.path, entry.path.data(), std::min(entry.path.size(), CATALOG_PATH_CHARS));
+    return record;
+}
+
+inline RecordingEntry MakeEntry(CatalogRecord const& record)
+{
+    RecordingEntry entry;
+    entry.path.assign(record.path, strnlen(record.path, CATALOG_PATH_CHARS));
+    entry.camId          = static_cast<eCamId>(record.camId);
+    entry.type           = static_cast<eRecordingType>(record.type);
+    entry.tier           = static_cast<eStorageTier>(record.tier);
+    entry.startMillisecs = record.startMillisecs;
+    entry.endMillisecs   = record.endMillisecs;
+    entry.bytes          = record.bytes;
+    return entry;
+}
+
+inline eCamId CameraIdFromName(std::string const& name) noexcept
+{
+    // Matches the names the main window gives each camera's stream processor.
+    static std::vector<std::pair<std::string, eCamId>> const names{{"Camera1", eCamId::cam1},
+                                                                   {"Camera2", eCamId::cam2},
+                                                                   {"Camera3", eCamId::cam3},
+                                                                   {"Camera4", eCamId::cam4}};
+
+    for (auto const& camName : names)
+    {
+        if (name == camName.first)
+        {
+            return camName.second;
+        }
+    }
+
+    return eCamId::noCam;
+}
+
+bool EntryFromFile(bfs::path const& filePath, RecordingEntry& entry)
+{
+    // Recordings are named <camera>[_motion]_<start millisecs> and snapshots <camera>_<secs>.
+    // Recordings made by older versions have a start time in seconds.
+    auto stem      = filePath.stem().string();
+    auto extension = boost::to_lower_copy(filePath.extension().string());
+    auto separator = stem.find_last_of('_');
+
+    if ((separator == std::string::npos) || (separator + 1 == stem.size()) ||
+        (stem.find_first_not_of("0123456789", separator + 1) != std::string::npos))
+    {
+        return false;
+    }
+
+    auto       name      = stem.substr(0, separator);
+    auto const startText = stem.substr(separator + 1);
+    int64_t    start     = std::stoll(startText);
+
+    if (extension == ".png")
+    {
+        entry.type           = eRecordingType::snapshot;
+        entry.startMillisecs = start * 1000;
+        entry.endMillisecs   = entry.startMillisecs;
+    }
+    else if ((extension == ".mkv") || (extension == ".avi"))
+    {
+        entry.type = eRecordingType::segment;
+
+        if (boost::ends_with(name, MOTION_CLIP_SUFFIX))
+        {
+            entry.type = eRecordingType::motionClip;
+            name.resize(name.size() - std::strlen(MOTION_CLIP_SUFFIX));
+        }
+
+        if (startText.size() <= MAX_SECONDS_DIGITS)
+        {
+            start *= 1000;
+        }
+
+        // The file was last written when it was finished, unless it has been touched since.
+        auto const lastWriteMillisecs =
+            static_cast<int64_t>(bfs::last_write_time(filePath)) * 1000;
+        entry.startMillisecs = start;
+        entry.endMillisecs =
+            std::min(std::max(start, lastWriteMillisecs), start + MAX_DURATION_MILLIS);
+    }
+    else
+    {
+        return false;
+    }
+
+    entry.camId = CameraIdFromName(name);
+    entry.bytes = bfs::file_size(filePath);
+    return true;
+}
+
+} // namespace utils
+
+IpFreelyRecordingCatalog::IpFreelyRecordingCatalog(std::string const& saveFolderPath,
+                                                   std::string const& archiveFolderPath)
+{
+    bfs::path p(saveFolderPath);
+    p = bfs::system_complete(p);
+
+    if (!bfs::exists(p))
+    {
+        if (!bfs::create_directories(p))
+        {
+            std::ostringstream oss;
+            oss << "Failed to create directories: " << p.string();
+            BOOST_THROW_EXCEPTION(std::runtime_error(oss.str()));
+        }
+    }
+
+    m_saveFolderPath = p.string();
+    m_catalogPath    = (p / CATALOG_FILE_NAME).string();
+
+    // The archive folder may be on a volume that is not mounted yet so is not created here.
+    if (!archiveFolderPath.empty())
+    {
+        auto const archivePath = bfs::system_complete(archiveFolderPath);
+
+        boost::system::error_code ec;
+
+        if ((archivePath.lexically_normal() == p.lexically_normal()) ||
+            bfs::equivalent(archivePath, p, ec))
+        {
+            DEBUG_MESSAGE_EX_WARNING("Archive folder is the save folder, recordings will not be "
+                                     "archived: "
+                                     << archivePath.string());
+        }
+        else
+        {
+            m_archiveFolderPath = archivePath.string();
+        }
+    }
+}
+
+void IpFreelyRecordingCatalog::Open()
+{
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (m_open)
+    {
+        return;
+    }
+
+    Load();
+
+    std::lock_guard<std::mutex> openingLock(m_openingMutex);
+
+    for (auto const& change : m_openingChanges)
+    {
+        if (change.second)
+        {
+            RemoveEntry(change.first.path);
+        }
+        else
+        {
+            AddEntry(change.first);
+        }
+    }
+
+    m_openingChanges.clear();
+    m_open = true;
+}
+
+bool IpFreelyRecordingCatalog::IsOpen() const noexcept
+{
+    return m_open;
+}
+
+std::string const& IpFreelyRecordingCatalog::SaveFolderPath() const noexcept
+{
+    return m_saveFolderPath;
+}
+
+std::string const& IpFreelyRecordingCatalog::ArchiveFolderPath() const noexcept
+{
+    return m_archiveFolderPath;
+}
+
+std::string IpFreelyRecordingCatalog::FullPath(RecordingEntry const& entry) const
+{
+    auto const& folderPath =
+        (entry.tier == eStorageTier::archive) ? m_archiveFolderPath : m_saveFolderPath;
+    auto p = bfs::path(folderPath) / entry.path;
+    return p.make_preferred().string();
+}
+
+void IpFreelyRecordingCatalog::AddRecording(RecordingEntry const& entry)
+{
+    auto relativeEntry = entry;
+    relativeEntry.path = RelativePath(entry.path);
+
+    if (DeferUntilOpen(relativeEntry, false))
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    AddEntry(relativeEntry);
+}
+
+void IpFreelyRecordingCatalog::RemoveRecording(std::string const& path)
+{
+    RecordingEntry entry;
+    entry.path = RelativePath(path);
+
+    if (DeferUntilOpen(entry, true))
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+    RemoveEntry(entry.path);
+}
+
+bool IpFreelyRecordingCatalog::MarkPendingDeletion(std::string const& path)
+{
+    auto const relativePath = RelativePath(path);
+
+    if (!m_open)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto startIt = m_startTimes.find(relativePath);
+
+    if (startIt == m_startTimes.end())
+    {
+        return false;
+    }
+
+    // Only the in-memory indexes change, the file keeps the entry until it is removed.
+    m_pendingDeletions[relativePath] = m_entries.at(key_t(startIt->second, relativePath));
+    Erase(relativePath);
+    return true;
+}
+
+void IpFreelyRecordingCatalog::CancelPendingDeletion(std::string const& path)
+{
+    auto const relativePath = RelativePath(path);
+
+    if (!m_open)
+    {
+        return;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto pendingIt = m_pendingDeletions.find(relativePath);
+
+    if (pendingIt == m_pendingDeletions.end())
+    {
+        return;
+    }
+
+    Insert(pendingIt->second);
+    m_pendingDeletions.erase(pendingIt);
+}
+
+bool IpFreelyRecordingCatalog::MoveRecording(std::string const& path, eStorageTier const tier)
+{
+    auto const relativePath = RelativePath(path);
+
+    if (!m_open)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto startIt = m_startTimes.find(relativePath);
+
+    if (startIt == m_startTimes.end())
+    {
+        return false;
+    }
+
+    auto entry = m_entries.at(key_t(startIt->second, relativePath));
+    entry.tier = tier;
+    Append(entry, false);
+    Insert(entry);
+    return true;
+}
+
+std::vector<RecordingEntry> IpFreelyRecordingCatalog::FindRecordings(int64_t const fromMillisecs,
+                                                                     int64_t const toMillisecs,
+                                                                     eCamId const  camId) const
+{
+    std::vector<RecordingEntry> entries;
+
+    if (!m_open)
+    {
+        return entries;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // No recording lasts longer than the longest seen so only those that started
+    // up to that long before the range can overlap it.
+    key_t const first(
+        (fromMillisecs > std::numeric_limits<int64_t>::min() + m_maxDurationMillisecs)
+            ? fromMillisecs - m_maxDurationMillisecs
+            : std::numeric_limits<int64_t>::min(),
+        std::string());
+
+    auto addOverlapping = [&](RecordingEntry const& entry) {
+        if (entry.endMillisecs >= fromMillisecs)
+        {
+            entries.emplace_back(entry);
+        }
+    };
+
+    if (camId == eCamId::noCam)
+    {
+        for (auto it = m_entries.lower_bound(first);
+             (it != m_entries.end()) && (it->first.first <= toMillisecs);
+             ++it)
+        {
+            addOverlapping(it->second);
+        }
+    }
+    else
+    {
+        auto cameraIt = m_cameraEntries.find(camId);
+
+        if (cameraIt != m_cameraEntries.end())
+        {
+            for (auto it = cameraIt->second.lower_bound(first);
+                 (it != cameraIt->second.end()) && (it->first <= toMillisecs);
+                 ++it)
+            {
+                addOverlapping(m_entries.at(*it));
+            }
+        }
+    }
+
+    return entries;
+}
+
+bool IpFreelyRecordingCatalog::OldestRecording(RecordingEntry& entry, eCamId const camId) const
+{
+    if (!m_open)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (camId == eCamId::noCam)
+    {
+        if (m_entries.empty())
+        {
+            return false;
+        }
+
+        entry = m_entries.begin()->second;
+        return true;
+    }
+
+    auto cameraIt = m_cameraEntries.find(camId);
+
+    if ((cameraIt == m_cameraEntries.end()) || cameraIt->second.empty())
+    {
+        return false;
+    }
+
+    entry = m_entries.at(*cameraIt->second.begin());
+    return true;
+}
+
+bool IpFreelyRecordingCatalog::OldestRecording(RecordingEntry& entry, eCamId const camId,
+                                               eRecordingType const type,
+                                               eStorageTier const   tier) const
+{
+    if (!m_open)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto typeIt = m_typeEntries.find(type_key_t(camId, type, tier));
+
+    if ((typeIt == m_typeEntries.end()) || typeIt->second.empty())
+    {
+        return false;
+    }
+
+    entry = m_entries.at(*typeIt->second.begin());
+    return true;
+}
+
+bool IpFreelyRecordingCatalog::OldestUnknownCameraRecording(RecordingEntry& entry) const
+{
+    if (!m_open)
+    {
+        return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Unlike the type indexes, the camera index for noCam only holds noCam's own entries.
+    auto cameraIt = m_cameraEntries.find(eCamId::noCam);
+
+    if ((cameraIt == m_cameraEntries.end()) || cameraIt->second.empty())
+    {
+        return false;
+    }
+
+    entry = m_entries.at(*cameraIt->second.begin());
+    return true;
+}
+
+std::vector<RecordingEntry>
+IpFreelyRecordingCatalog::OldestRecordings(size_t const maxCount, eCamId const camId,
+                                           eRecordingType const type,
+                                           eStorageTier const   tier) const
+{
+    std::vector<RecordingEntry> entries;
+
+    if (!m_open)
+    {
+        return entries;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    auto typeIt = m_typeEntries.find(type_key_t(camId, type, tier));
+
+    if (typeIt == m_typeEntries.end())
+    {
+        return entries;
+    }
+
+    for (auto it = typeIt->second.begin();
+         (it != typeIt->second.end()) && (entries.size() < maxCount);
+         ++it)
+    {
+        entries.emplace_back(m_entries.at(*it));
+    }
+
+    return entries;
+}
+
+size_t IpFreelyRecordingCatalog::RecordingCount(eCamId const camId) const
+{
+    if (!m_open)
+    {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (camId == eCamId::noCam)
+    {
+        return m_entries.size();
+    }
+
+    auto cameraIt = m_cameraEntries.find(camId);
+    return (cameraIt == m_cameraEntries.end()) ? 0 : cameraIt->second.size();
+}
+
+uint64_t IpFreelyRecordingCatalog::TotalBytes(eCamId const camId, eStorageTier const tier) const
+{
+    if (!m_open)
+    {
+        return 0;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (tier != eStorageTier::anyTier)
+    {
+        auto tierIt = m_tierBytes.find(tier_key_t(camId, tier));
+        return (tierIt == m_tierBytes.end()) ? 0 : tierIt->second;
+    }
+
+    if (camId == eCamId::noCam)
+    {
+        return m_totalBytes;
+    }
+
+    auto bytesIt = m_cameraBytes.find(camId);
+    return (bytesIt == m_cameraBytes.end()) ? 0 : bytesIt->second;
+}
+
+std::array<IpFreelyRecordingCatalog::type_key_t, 4>
+IpFreelyRecordingCatalog::TypeKeys(RecordingEntry const& entry)
+{
+    return {{type_key_t(entry.camId, entry.type, entry.tier),
+             type_key_t(entry.camId, entry.type, eStorageTier::anyTier),
+             type_key_t(eCamId::noCam, entry.type, entry.tier),
+             type_key_t(eCamId::noCam, entry.type, eStorageTier::anyTier)}};
+}
+
+std::string IpFreelyRecordingCatalog::RelativePath(std::string const& path) const
+{
+    bfs::path p(path);
+
+    if (p.is_absolute())
+    {
+        p = p.lexically_relative(m_saveFolderPath);
+
+        if (p.empty() || (*p.begin() == ".."))
+        {
+            BOOST_THROW_EXCEPTION(
+                std::invalid_argument("Recording is outside the save folder: " + path));
+        }
+    }
+
+    auto relativePath = p.generic_string();
+
+    if (relativePath.empty() || (relativePath.size() >= CATALOG_PATH_CHARS))
+    {
+        BOOST_THROW_EXCEPTION(
+            std::invalid_argument("Recording path is empty or too long: " + relativePath));
+    }
+
+    return relativePath;
+}
+
+bool IpFreelyRecordingCatalog::DeferUntilOpen(RecordingEntry const& entry, bool const removed)
+{
+    std::lock_guard<std::mutex> lock(m_openingMutex);
+
+    if (m_open)
+    {
+        return false;
+    }
+
+    m_openingChanges.emplace_back(entry, removed);
+    return true;
+}
+
+void IpFreelyRecordingCatalog::AddEntry(RecordingEntry const& entry)
+{
+    Append(entry, false);
+    m_pendingDeletions.erase(entry.path);
+    m_offlineArchive.erase(entry.path);
+    Insert(entry);
+}
+
+void IpFreelyRecordingCatalog::RemoveEntry(std::string const& path)
+{
+    if ((m_startTimes.count(path) == 0) && (m_pendingDeletions.count(path) == 0) &&
+        (m_offlineArchive.count(path) == 0))
+    {
+        return;
+    }
+
+    RecordingEntry entry;
+    entry.path = path;
+    Append(entry, true);
+    m_pendingDeletions.erase(path);
+    m_offlineArchive.erase(path);
+    Erase(path);
+}
+
+void IpFreelyRecordingCatalog::Clear()
+{
+    m_entries.clear();
+    m_pendingDeletions.clear();
+    m_offlineArchive.clear();
+    m_startTimes.clear();
+    m_cameraEntries.clear();
+    m_typeEntries.clear();
+    m_cameraBytes.clear();
+    m_tierBytes.clear();
+    m_totalBytes           = 0;
+    m_maxDurationMillisecs = 0;
+}
+
+void IpFreelyRecordingCatalog::Load()
+{
+    // A previous attempt to open may have failed part way through.
+    m_catalogFile.close();
+    Clear();
+
+    boost::system::error_code ec;
+    auto const                fileBytes = bfs::file_size(m_catalogPath, ec);
+
+    if (ec || (fileBytes < sizeof(CatalogHeader)))
+    {
+        if (bfs::exists(m_catalogPath))
+        {
+            DEBUG_MESSAGE_EX_WARNING("Catalog file is unreadable, recreating: " << m_catalogPath);
+        }
+
+        Scan();
+        Compact();
+        OpenForAppend();
+        return;
+    }
+
+    auto records = static_cast<size_t>((fileBytes - sizeof(CatalogHeader)) /
+                                       sizeof(CatalogRecord));
+    bool valid   = true;
+
+    {
+        bip::file_mapping  mapping(m_catalogPath.c_str(), bip::read_only);
+        bip::mapped_region region(mapping, bip::read_only, 0, static_cast<size_t>(fileBytes));
+        auto const*        data = static_cast<char const*>(region.get_address());
+
+        CatalogHeader header;
+        std::memcpy(&header, data, sizeof(header));
+        valid                = utils::HeaderIsValid(header);
+        m_catalogArchivePath = utils::HeaderArchivePath(header);
+
+        // Records are copied out as the mapping need not be aligned for them.
+        for (size_t i = 0; valid && (i < records); ++i)
+        {
+            CatalogRecord record;
+            std::memcpy(&record,
+                        data + sizeof(CatalogHeader) + (i * sizeof(CatalogRecord)),
+                        sizeof(record));
+
+            if (record.removed != 0)
+            {
+                Erase(utils::MakeEntry(record).path);
+            }
+            else
+            {
+                Insert(utils::MakeEntry(record));
+            }
+        }
+    }
+
+    if (!valid)
+    {
+        DEBUG_MESSAGE_EX_WARNING("Catalog file has an unknown format, recreating: "
+                                 << m_catalogPath);
+
+        Scan();
+        Compact();
+        OpenForAppend();
+        return;
+    }
+
+    m_records = records;
+
+    auto const archiveChanged = ReconcileArchive();
+
+    auto const wholeBytes = sizeof(CatalogHeader) + (records * sizeof(CatalogRecord));
+
+    if (fileBytes != wholeBytes)
+    {
+        DEBUG_MESSAGE_EX_WARNING("Discarding torn record at end of catalog: " << m_catalogPath);
+        bfs::resize_file(m_catalogPath, wholeBytes);
+    }
+
+    // Removals are only ever appended so compact once they dominate the file.
+    if (archiveChanged ||
+        ((m_records > COMPACT_MIN_RECORDS) && (m_records > 2 * m_entries.size())))
+    {
+        Compact();
+    }
+
+    OpenForAppend();
+
+    DEBUG_MESSAGE_EX_INFO("Loaded catalog of " << m_entries.size() << " recordings ("
+                                               << m_totalBytes << " bytes) from: "
+                                               << m_catalogPath);
+}
+
+void IpFreelyRecordingCatalog::Scan()
+{
+    Clear();
+
+    DEBUG_MESSAGE_EX_INFO("Scanning save folder to create catalog: " << m_saveFolderPath);
+
+    ScanFolder(m_saveFolderPath, eStorageTier::local);
+
+    if (!m_archiveFolderPath.empty() && bfs::exists(m_archiveFolderPath))
+    {
+        DEBUG_MESSAGE_EX_INFO("Scanning archive folder to create catalog: "
+                              << m_archiveFolderPath);
+
+        ScanFolder(m_archiveFolderPath, eStorageTier::archive);
+        m_catalogArchivePath = m_archiveFolderPath;
+    }
+    else
+    {
+        m_catalogArchivePath.clear();
+    }
+}
+
+void IpFreelyRecordingCatalog::ScanFolder(std::string const& folderPath, eStorageTier const tier)
+{
+    // Recordings and snapshots are only ever saved in the daily sub-folders.
+    for (auto const& folder : bfs::directory_iterator(folderPath))
+    {
+        if (!bfs::is_directory(folder.status()))
+        {
+            continue;
+        }
+
+        for (auto const& file : bfs::directory_iterator(folder.path()))
+        {
+            try
+            {
+                RecordingEntry entry;
+
+                if (bfs::is_regular_file(file.status()) &&
+                    utils::EntryFromFile(file.path(), entry))
+                {
+                    entry.path =
+                        RelativePath((folder.path().filename() / file.path().filename()).string());
+                    entry.tier = tier;
+
+                    // A recording in both folders was being archived, the local copy is kept.
+                    if ((tier != eStorageTier::archive) || (m_startTimes.count(entry.path) == 0))
+                    {
+                        Insert(entry);
+                    }
+                }
+            }
+            catch (...)
+            {
+                DEBUG_MESSAGE_EX_WARNING("Not adding file to catalog: " << file.path().string());
+            }
+        }
+    }
+}
+
+bool IpFreelyRecordingCatalog::ReconcileArchive()
+{
+    std::vector<std::string> archivedPaths;
+
+    for (auto const& entry : m_entries)
+    {
+        if (entry.second.tier == eStorageTier::archive)
+        {
+            archivedPaths.emplace_back(entry.second.path);
+        }
+    }
+
+    if (!m_archiveFolderPath.empty() && (m_archiveFolderPath == m_catalogArchivePath))
+    {
+        return false;
+    }
+
+    // Archived recordings that cannot be reached are kept in the file, but left out of the
+    // catalog, until their archive folder is set and available again.
+    if (m_archiveFolderPath.empty() || !bfs::exists(m_archiveFolderPath))
+    {
+        if (!archivedPaths.empty())
+        {
+            DEBUG_MESSAGE_EX_WARNING("Archive folder is not available, ignoring "
+                                     << archivedPaths.size() << " archived recordings in: "
+                                     << m_catalogArchivePath);
+        }
+
+        for (auto const& path : archivedPaths)
+        {
+            m_offlineArchive[path] = m_entries.at(key_t(m_startTimes.at(path), path));
+            Erase(path);
+        }
+
+        return false;
+    }
+
+    // The archive folder has been set or changed so its recordings replace those catalogued in
+    // the previous one, which are found again if the archive was moved there.
+    DEBUG_MESSAGE_EX_INFO("Archive folder has changed, scanning it to update catalog: "
+                          << m_archiveFolderPath);
+
+    for (auto const& path : archivedPaths)
+    {
+        Erase(path);
+    }
+
+    ScanFolder(m_archiveFolderPath, eStorageTier::archive);
+
+    auto const numMissing = std::count_if(
+        archivedPaths.begin(), archivedPaths.end(), [this](std::string const& path) {
+            return m_startTimes.count(path) == 0;
+        });
+
+    if (numMissing > 0)
+    {
+        DEBUG_MESSAGE_EX_WARNING(numMissing << " archived recordings are not in the new archive "
+                                               "folder, they are no longer catalogued: "
+                                            << m_catalogArchivePath);
+    }
+
+    m_catalogArchivePath = m_archiveFolderPath;
+    return true;
+}
+
+void IpFreelyRecordingCatalog::Compact()
+{
+    m_catalogFile.close();
+
+    // Write the live entries to a new file then replace the old file with it in one step.
+    auto const tempPath = m_catalogPath + ".tmp";
+
+    {
+        std::ofstream tempFile(tempPath, std::ios::binary | std::ios::trunc);
+
+        auto const header = utils::MakeHeader(m_catalogArchivePath);
+        tempFile.write(reinterpret_cast<char const*>(&header), sizeof(header));
+
+        for (auto const& entry : m_entries)
+        {
+            auto const record = utils::MakeRecord(entry.second, false);
+            tempFile.write(reinterpret_cast<char const*>(&record), sizeof(record));
+        }
+
+        for (auto const& pending : m_pendingDeletions)
+        {
+            auto const record = utils::MakeRecord(pending.second, false);
+            tempFile.write(reinterpret_cast<char const*>(&record), sizeof(record));
+        }
+
+        for (auto const& offline : m_offlineArchive)
+        {
+            auto const record = utils::MakeRecord(offline.second, false);
+            tempFile.write(reinterpret_cast<char const*>(&record), sizeof(record));
+        }
+
+        if (!tempFile.flush())
+        {
+            std::ostringstream oss;
+            oss << "Failed to write catalog file: " << tempPath;
+            BOOST_THROW_EXCEPTION(std::runtime_error(oss.str()));
+        }
+    }
+
+    bfs::rename(tempPath, m_catalogPath);
+    m_records = m_entries.size() + m_pendingDeletions.size() + m_offlineArchive.size();
+}
+
+void IpFreelyRecordingCatalog::OpenForAppend()
+{
+    m_catalogFile.open(m_catalogPath, std::ios::binary | std::ios::app);
+
+    if (!m_catalogFile)
+    {
+        std::ostringstream oss;
+        oss << "Failed to open catalog file: " << m_catalogPath;
+        BOOST_THROW_EXCEPTION(std::runtime_error(oss.str()));
+    }
+}
+
+void IpFreelyRecordingCatalog::Append(RecordingEntry const& entry, bool const removed)
+{
+    // Each record is flushed as it is written so a crash can at most tear the last one.
+    auto const record = utils::MakeRecord(entry, removed);
+    m_catalogFile.write(reinterpret_cast<char const*>(&record), sizeof(record));
+
+    if (!m_catalogFile.flush())
+    {
+        m_catalogFile.clear();
+
+        std::ostringstream oss;
+        oss << "Failed to append to catalog file: " << m_catalogPath;
+        BOOST_THROW_EXCEPTION(std::runtime_error(oss.str()));
+    }
+
+    ++m_records;
+}
+
+void IpFreelyRecordingCatalog::Insert(RecordingEntry const& entry)
+{
+    Erase(entry.path);
+
+    key_t key(entry.startMillisecs, entry.path);
+    m_entries[key]           = entry;
+    m_startTimes[entry.path] = entry.startMillisecs;
+    m_cameraEntries[entry.camId].insert(key);
+
+    for (auto const& typeKey : TypeKeys(entry))
+    {
+        m_typeEntries[typeKey].insert(key);
+    }
+
+    m_cameraBytes[entry.camId] += entry.bytes;
+    m_tierBytes[tier_key_t(entry.camId, entry.tier)] += entry.bytes;
+
+    // An entry with no known camera is already counted in the all cameras total.
+    if (entry.camId != eCamId::noCam)
+    {
+        m_tierBytes[tier_key_t(eCamId::noCam, entry.tier)] += entry.bytes;
+    }
+
+    m_totalBytes += entry.bytes;
+    // A bad time in one entry must not make every search start from the oldest recording.
+    m_maxDurationMillisecs = std::max(
+        m_maxDurationMillisecs,
+        std::min(entry.endMillisecs - entry.startMillisecs, MAX_DURATION_MILLIS));
+}
+
+void IpFreelyRecordingCatalog::Erase(std::string const& path)
+{
+    auto startIt = m_startTimes.find(path);
+
+    if (startIt == m_startTimes.end())
+    {
+        return;
+    }
+
+    key_t key(startIt->second, path);
+    auto  entryIt = m_entries.find(key);
+
+    if (entryIt != m_entries.end())
+    {
+        auto const& entry = entryIt->second;
+        m_cameraEntries[entry.camId].erase(key);
+
+        for (auto const& typeKey : TypeKeys(entry))
+        {
+            m_typeEntries[typeKey].erase(key);
+        }
+
+        m_cameraBytes[entry.camId] -= entry.bytes;
+        m_tierBytes[tier_key_t(entry.camId, entry.tier)] -= entry.bytes;
+
+        if (entry.camId != eCamId::noCam)
+        {
+            m_tierBytes[tier_key_t(eCamId::noCam, entry.tier)] -= entry.bytes;
+        }
+
+        m_totalBytes -= entry.bytes;
+        m_entries.erase(entryIt);
+    }
+
+    m_startTimes.erase(startIt);
+}
+
+} // namespace ipfreely
@@ -0,0 +1,334 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+
+/*!
+ * \file IpFreelyRecordingCatalog.h
+ * \brief File containing declaration of IpFreelyRecordingCatalog class.
+ */
+#ifndef IPFREELYRECORDINGCATALOG_H
+#define IPFREELYRECORDINGCATALOG_H
+
+#include <string>
+#include <map>
+#include <set>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <fstream>
+#include <utility>
+#include <tuple>
+#include <array>
+#include <cstdint>
+#include "IpFreelyCameraDatabase.h"
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+/*! \brief Type of recording held in the catalog. */
+enum class eRecordingType : uint8_t
+{
+    segment,
+    motionClip,
+    snapshot
+};
+
+/*! \brief Storage tier a recording is held in. */
+enum class eStorageTier : uint8_t
+{
+    local,
+    archive,
+    anyTier
+};
+
+/*! \brief Structure holding a catalog entry for one recorded file. */
+struct RecordingEntry final
+{
+    /*! \brief The file's path relative to the save folder, with '/' separators. */
+    std::string path{};
+
+    /*! \brief The camera that recorded the file. */
+    eCamId camId{eCamId::noCam};
+
+    /*! \brief The type of recording. */
+    eRecordingType type{eRecordingType::segment};
+
+    /*! \brief The tier the file is held in, the save folder or the archive folder. */
+    eStorageTier tier{eStorageTier::local};
+
+    /*! \brief Wall-clock time of the start of the recording, in milliseconds since the epoch. */
+    int64_t startMillisecs{0};
+
+    /*! \brief Wall-clock time of the end of the recording, in milliseconds since the epoch. */
+    int64_t endMillisecs{0};
+
+    /*! \brief The file's size in bytes. */
+    uint64_t bytes{0};
+};
+
+/*!
+ * \brief Class defining the catalog of recorded files in a save folder.
+ *
+ * Every segment, motion clip and snapshot is added to the catalog as it is finished, and removed
+ * when it is deleted, so nothing needs to scan the save folder to find out what is stored there.
+ *
+ * The catalog is kept in memory, indexed by start time, camera and type, and persisted to an
+ * append-only file in the save folder. The file is a header followed by fixed size records, one
+ * per addition or removal, so it can be memory-mapped and is never rewritten while in use. A
+ * torn record from a crash is discarded when the file is loaded and, when most records are
+ * removals, the file is compacted. If there is no catalog file the save folder is scanned once
+ * to create it.
+ *
+ * Loading or scanning can take a long time so is not done until Open is called, on a background
+ * thread. Until then the catalog is empty, and recordings added or removed are applied once it is
+ * open.
+ *
+ * Recordings may be moved from the save folder to an archive folder, for example on a network
+ * volume, keeping the same path relative to it. Each entry records which of the two it is in, and
+ * the file records the archive folder. While the archive folder is not set or not available its
+ * recordings are left out of the catalog, but kept in the file. When it is set to a different
+ * folder that folder is scanned and its recordings replace the previous folder's.
+ *
+ * A recording queued for deletion is marked pending, hiding it from searches, counts and totals,
+ * but is only removed from the file once its file is deleted. If the application stops first it
+ * is back in the catalog when next loaded, so it will be picked for deletion again.
+ *
+ * The catalog is thread safe, each camera's recorders and the disk space manager share it.
+ */
+class IpFreelyRecordingCatalog final
+{
+public:
+    /*!
+     * \brief IpFreelyRecordingCatalog constructor.
+     * \param[in] saveFolderPath - The save folder the catalog is for.
+     * \param[in] archiveFolderPath - (Optional) The folder recordings are archived to.
+     *
+     * The catalog is empty until it is opened.
+     */
+    explicit IpFreelyRecordingCatalog(std::string const& saveFolderPath,
+                                      std::string const& archiveFolderPath = "");
+
+    /*! \brief IpFreelyRecordingCatalog destructor. */
+    ~IpFreelyRecordingCatalog() = default;
+
+    /*! \brief IpFreelyRecordingCatalog deleted copy constructor. */
+    IpFreelyRecordingCatalog(IpFreelyRecordingCatalog const&) = delete;
+
+    /*! \brief IpFreelyRecordingCatalog deleted copy assignment operator. */
+    IpFreelyRecordingCatalog& operator=(IpFreelyRecordingCatalog const&) = delete;
+
+    /*!
+     * \brief Open loads the save folder's catalog file, creating it if needed.
+     *
+     * Does nothing if already open. Throws if the catalog file cannot be written, in which case
+     * it can be opened again later.
+     */
+    void Open();
+
+    /*!
+     * \brief IsOpen reports whether the catalog has been opened.
+     * \return True if open, false if still empty.
+     */
+    bool IsOpen() const noexcept;
+
+    /*!
+     * \brief SaveFolderPath gives access to the save folder's full path.
+     * \return The path.
+     */
+    std::string const& SaveFolderPath() const noexcept;
+
+    /*!
+     * \brief ArchiveFolderPath gives access to the archive folder's full path.
+     * \return The path, empty if recordings are not archived.
+     */
+    std::string const& ArchiveFolderPath() const noexcept;
+
+    /*!
+     * \brief FullPath gives the full path of a recording.
+     * \param[in] entry - The recording's entry.
+     * \return The path, in the save folder or archive folder depending on the entry's tier.
+     */
+    std::string FullPath(RecordingEntry const& entry) const;
+
+    /*!
+     * \brief AddRecording adds a finished recording to the catalog.
+     * \param[in] entry - The recording's entry, the path may be a full path in the save folder.
+     *
+     * An existing entry with the same path is replaced. Throws std::invalid_argument if the path
+     * is outside the save folder or too long.
+     */
+    void AddRecording(RecordingEntry const& entry);
+
+    /*!
+     * \brief RemoveRecording removes a recording from the catalog, once its file is deleted.
+     * \param[in] path - The recording's path, relative to the save folder or in full.
+     */
+    void RemoveRecording(std::string const& path);
+
+    /*!
+     * \brief MarkPendingDeletion hides a recording that is queued for deletion.
+     * \param[in] path - The recording's path, relative to the save folder or in full.
+     * \return True if marked, false if not in the catalog or already pending deletion.
+     *
+     * The recording is no longer found, counted or moved but stays in the catalog file until
+     * RemoveRecording is called for it.
+     */
+    bool MarkPendingDeletion(std::string const& path);
+
+    /*!
+     * \brief CancelPendingDeletion restores a recording that could not be deleted.
+     * \param[in] path - The recording's path, relative to the save folder or in full.
+     */
+    void CancelPendingDeletion(std::string const& path);
+
+    /*!
+     * \brief MoveRecording records that a recording's file has been moved to another tier.
+     * \param[in] path - The recording's path, relative to the save folder.
+     * \param[in] tier - The tier the file is now held in.
+     * \return True if moved, false if the recording is no longer in the catalog.
+     */
+    bool MoveRecording(std::string const& path, eStorageTier const tier);
+
+    /*!
+     * \brief FindRecordings finds the recordings overlapping a time range, oldest first.
+     * \param[in] fromMillisecs - Start of the range, in milliseconds since the epoch.
+     * \param[in] toMillisecs - End of the range, in milliseconds since the epoch.
+     * \param[in] camId - (Optional) Only find recordings by this camera.
+     * \return The recordings' entries.
+     */
+    std::vector<RecordingEntry> FindRecordings(int64_t const fromMillisecs,
+                                               int64_t const toMillisecs,
+                                               eCamId const  camId = eCamId::noCam) const;
+
+    /*!
+     * \brief OldestRecording finds the recording that started first.
+     * \param[out] entry - The recording's entry, if found.
+     * \param[in] camId - (Optional) Only find recordings by this camera.
+     * \return True if found, false if there are no recordings.
+     */
+    bool OldestRecording(RecordingEntry& entry, eCamId const camId = eCamId::noCam) const;
+
+    /*!
+     * \brief OldestRecording finds the recording of a type that started first.
+     * \param[out] entry - The recording's entry, if found.
+     * \param[in] camId - Only find recordings by this camera, noCam finds any camera's.
+     * \param[in] type - Only find recordings of this type.
+     * \param[in] tier - (Optional) Only find recordings held in this tier.
+     * \return True if found, false if there are no such recordings.
+     */
+    bool OldestRecording(RecordingEntry& entry, eCamId const camId, eRecordingType const type,
+                         eStorageTier const tier = eStorageTier::anyTier) const;
+
+    /*!
+     * \brief OldestUnknownCameraRecording finds the recording that started first of those whose
+     * camera is noCam, such as files found by a scan whose names match no camera.
+     * \param[out] entry - The recording's entry, if found.
+     * \return True if found, false if there are no such recordings.
+     */
+    bool OldestUnknownCameraRecording(RecordingEntry& entry) const;
+
+    /*!
+     * \brief OldestRecordings finds the recordings of a type that started first, oldest first.
+     * \param[in] maxCount - Most recordings to find.
+     * \param[in] camId - Only find recordings by this camera, noCam finds any camera's.
+     * \param[in] type - Only find recordings of this type.
+     * \param[in] tier - (Optional) Only find recordings held in this tier.
+     * \return The recordings' entries.
+     */
+    std::vector<RecordingEntry>
+    OldestRecordings(size_t const maxCount, eCamId const camId, eRecordingType const type,
+                     eStorageTier const tier = eStorageTier::anyTier) const;
+
+    /*!
+     * \brief RecordingCount reports the number of recordings in the catalog.
+     * \param[in] camId - (Optional) Only count recordings by this camera.
+     * \return The number of recordings.
+     */
+    size_t RecordingCount(eCamId const camId = eCamId::noCam) const;
+
+    /*!
+     * \brief TotalBytes reports the total size of the recordings in the catalog.
+     * \param[in] camId - (Optional) Only count recordings by this camera.
+     * \param[in] tier - (Optional) Only count recordings held in this tier.
+     * \return The number of bytes.
+     */
+    uint64_t TotalBytes(eCamId const       camId = eCamId::noCam,
+                        eStorageTier const tier = eStorageTier::anyTier) const;
+
+private:
+    /*! \brief Typedef to an index key, ordering entries by start time. */
+    typedef std::pair<int64_t, std::string> key_t;
+
+    /*! \brief Typedef to a camera's index, ordered by start time. */
+    typedef std::set<key_t> camera_index_t;
+
+    /*! \brief Typedef to a camera, recording type and tier, noCam and anyTier for every one. */
+    typedef std::tuple<eCamId, eRecordingType, eStorageTier> type_key_t;
+
+    /*! \brief Typedef to a camera and tier, noCam for every camera. */
+    typedef std::pair<eCamId, eStorageTier> tier_key_t;
+
+    /*! \brief Typedef to a recording added, or removed if true, before the catalog was opened. */
+    typedef std::pair<RecordingEntry, bool> change_t;
+
+    static std::array<type_key_t, 4> TypeKeys(RecordingEntry const& entry);
+
+    std::string RelativePath(std::string const& path) const;
+    bool        DeferUntilOpen(RecordingEntry const& entry, bool const removed);
+    void        AddEntry(RecordingEntry const& entry);
+    void        RemoveEntry(std::string const& path);
+    void        Clear();
+    void        Load();
+    void        Scan();
+    void        ScanFolder(std::string const& folderPath, eStorageTier const tier);
+    bool        ReconcileArchive();
+    void        Compact();
+    void        OpenForAppend();
+    void        Append(RecordingEntry const& entry, bool const removed);
+    void        Insert(RecordingEntry const& entry);
+    void        Erase(std::string const& path);
+
+private:
+    mutable std::mutex                    m_mutex{};
+    std::mutex                            m_openingMutex{};
+    std::atomic<bool>                     m_open{false};
+    std::vector<change_t>                 m_openingChanges{};
+    std::string                           m_saveFolderPath{};
+    std::string                           m_archiveFolderPath{};
+    std::string                           m_catalogPath{};
+    std::string                           m_catalogArchivePath{};
+    std::ofstream                         m_catalogFile{};
+    std::map<key_t, RecordingEntry>       m_entries{};
+    std::map<std::string, RecordingEntry> m_pendingDeletions{};
+    std::map<std::string, RecordingEntry> m_offlineArchive{};
+    std::map<std::string, int64_t>        m_startTimes{};
+    std::map<eCamId, camera_index_t>      m_cameraEntries{};
+    std::map<type_key_t, camera_index_t>  m_typeEntries{};
+    std::map<eCamId, uint64_t>            m_cameraBytes{};
+    std::map<tier_key_t, uint64_t>        m_tierBytes{};
+    uint64_t                              m_totalBytes{0};
+    int64_t                               m_maxDurationMillisecs{0};
+    size_t                                m_records{0};
+};
+
+} // namespace ipfreely
+
+#endif // IPFREELYRECORDINGCATALOG_H
@@ -0,0 +1,164 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyRecordingWriter.cpp
+ * \brief File containing definition of IpFreelyRecordingWriter class.
+ */
+#include "IpFreelyRecordingWriter.h"
+#include <boost/exception/all.hpp>
+#include "IpFreelyVideoEncoder.h"
+#include "Threads/EventThread.h"
+#include "DebugLog/DebugLogging.h"
+
+namespace ipfreely
+{
+
+static constexpr unsigned int WRITER_THREAD_PERIOD_MS = 1;
+static constexpr unsigned int WRITER_POP_TIMEOUT_MS   = 100;
+static constexpr double       ENCODE_TIME_AVE_FACTOR  = 0.9;
+
+IpFreelyRecordingWriter::IpFreelyRecordingWriter(
+    std::string const& name, std::shared_ptr<IpFreelyVideoEncoder> const& videoEncoder,
+    size_t const queueCapacity)
+    : m_name(name)
+    , m_videoEncoder(videoEncoder)
+    , m_queue(queueCapacity)
+{
+    DEBUG_MESSAGE_EX_INFO("Creating recording writer thread for camera: "
+                          << m_name << ", queue capacity: " << queueCapacity);
+
+    m_writerThread = std::make_shared<core_lib::threads::EventThread>(
+        std::bind(&IpFreelyRecordingWriter::ThreadEventCallback, this), WRITER_THREAD_PERIOD_MS);
+}
+
+IpFreelyRecordingWriter::~IpFreelyRecordingWriter()
+{
+    // Stop the thread before releasing any queued work.
+    m_writerThread.reset();
+    m_queue.Clear();
+}
+
+bool IpFreelyRecordingWriter::WriteFrame(cv::Mat const&                               frame,
+                                         std::chrono::steady_clock::time_point const& timestamp,
+                                         bool const                                   droppable)
+{
+    if (!m_videoEncoder)
+    {
+        return false;
+    }
+
+    auto task = std::bind(&IpFreelyRecordingWriter::EncodeFrame, this, frame, timestamp);
+
+    if (!droppable)
+    {
+        m_queue.Push(task);
+        return true;
+    }
+
+    if (m_queue.TryPush(task))
+    {
+        m_queueFullWarned = false;
+        return true;
+    }
+
+    ++m_framesDropped;
+
+    if (!m_queueFullWarned.exchange(true))
+    {
+        DEBUG_MESSAGE_EX_WARNING("Recording writer queue full, dropping frames for camera: "
+                                 << m_name);
+    }
+
+    return false;
+}
+
+void IpFreelyRecordingWriter::ForceKeyFrame()
+{
+    if (m_videoEncoder)
+    {
+        auto videoEncoder = m_videoEncoder;
+        m_queue.Push([videoEncoder]() { videoEncoder->ForceKeyFrame(); });
+    }
+}
+
+void IpFreelyRecordingWriter::Post(task_t const& task)
+{
+    m_queue.Push(task);
+}
+
+bool IpFreelyRecordingWriter::TryPost(task_t const& task)
+{
+    return m_queue.TryPush(task);
+}
+
+size_t IpFreelyRecordingWriter::QueueDepth() const
+{
+    return m_queue.Size();
+}
+
+uint64_t IpFreelyRecordingWriter::FramesDropped() const noexcept
+{
+    return m_framesDropped;
+}
+
+double IpFreelyRecordingWriter::EncodeMillisecs() const noexcept
+{
+    return m_encodeMillisecs;
+}
+
+void IpFreelyRecordingWriter::ThreadEventCallback() noexcept
+{
+    try
+    {
+        task_t task;
+
+        if (m_queue.Pop(task, WRITER_POP_TIMEOUT_MS))
+        {
+            task();
+        }
+    }
+    catch (...)
+    {
+        auto exceptionMsg = boost::current_exception_diagnostic_information();
+        DEBUG_MESSAGE_EX_ERROR(exceptionMsg);
+    }
+}
+
+void IpFreelyRecordingWriter::EncodeFrame(cv::Mat const&                               frame,
+                                          std::chrono::steady_clock::time_point const& timestamp)
+{
+    auto start = std::chrono::steady_clock::now();
+
+    // Encoding also writes the resulting packets to any open files.
+    if (!m_videoEncoder->Encode(frame, timestamp))
+    {
+        return;
+    }
+
+    auto encodeMillisecs =
+        std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+            .count();
+
+    m_encodeMillisecs = (m_encodeMillisecs * ENCODE_TIME_AVE_FACTOR) +
+                        (encodeMillisecs * (1.0 - ENCODE_TIME_AVE_FACTOR));
+}
+
+} // namespace ipfreely
@@ -0,0 +1,148 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyRecordingWriter.h
+ * \brief File containing declaration of IpFreelyRecordingWriter class.
+ */
+#ifndef IPFREELYRECORDINGWRITER_H
+#define IPFREELYRECORDINGWRITER_H
+
+#include <string>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <opencv2/opencv.hpp>
+#include "IpFreelyBoundedQueue.h"
+
+namespace core_lib
+{
+namespace threads
+{
+
+class EventThread;
+
+} // namespace threads
+} // namespace core_lib
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+class IpFreelyVideoEncoder;
+
+/*!
+ * \brief Class defining a camera's recording writer stage.
+ *
+ * The writer stage runs video encoding and recording control, such as starting and stopping
+ * recorders, on its own thread so that slow encodes, disk stalls and file rotation never block
+ * frame acquisition. Work is queued in order, video frames, and a camera's packets passed on by a
+ * packet relay, are dropped rather than queued once the queue is full.
+ */
+class IpFreelyRecordingWriter final
+{
+public:
+    /*! \brief Typedef to writer task function object. */
+    typedef std::function<void()> task_t;
+
+    /*!
+     * \brief IpFreelyRecordingWriter constructor.
+     * \param[in] name - A name for the writer, used for logging.
+     * \param[in] videoEncoder - (Optional) The encoder for video frames, null if the camera's
+     * compressed stream is recorded directly.
+     * \param[in] queueCapacity - The queue depth beyond which video frames are dropped.
+     */
+    IpFreelyRecordingWriter(std::string const&                           name,
+                            std::shared_ptr<IpFreelyVideoEncoder> const& videoEncoder,
+                            size_t const                                 queueCapacity);
+
+    /*! \brief IpFreelyRecordingWriter destructor. */
+    ~IpFreelyRecordingWriter();
+
+    /*! \brief IpFreelyRecordingWriter deleted copy constructor. */
+    IpFreelyRecordingWriter(IpFreelyRecordingWriter const&) = delete;
+
+    /*! \brief IpFreelyRecordingWriter deleted copy assignment operator. */
+    IpFreelyRecordingWriter& operator=(IpFreelyRecordingWriter const&) = delete;
+
+    /*!
+     * \brief WriteFrame queues a video frame to be encoded.
+     * \param[in] frame - The BGR video frame, which must not be modified once queued.
+     * \param[in] timestamp - The time the frame was captured.
+     * \param[in] droppable - If false the frame is queued even if the queue is full.
+     * \return True if the frame was queued, false if it was dropped.
+     */
+    bool WriteFrame(cv::Mat const& frame, std::chrono::steady_clock::time_point const& timestamp,
+                    bool const droppable = true);
+
+    /*! \brief ForceKeyFrame makes the next queued video frame a keyframe. */
+    void ForceKeyFrame();
+
+    /*!
+     * \brief Post queues a task to run on the writer's thread.
+     * \param[in] task - The task, which is never dropped.
+     */
+    void Post(task_t const& task);
+
+    /*!
+     * \brief TryPost queues a task to run on the writer's thread if there is room.
+     * \param[in] task - The task, which is dropped if the queue is full.
+     * \return True if the task was queued, false if it was dropped.
+     */
+    bool TryPost(task_t const& task);
+
+    /*!
+     * \brief QueueDepth reports the number of frames and tasks waiting to be written.
+     * \return The queue depth.
+     */
+    size_t QueueDepth() const;
+
+    /*!
+     * \brief FramesDropped reports the number of frames dropped because the queue was full.
+     * \return The number of frames.
+     */
+    uint64_t FramesDropped() const noexcept;
+
+    /*!
+     * \brief EncodeMillisecs reports the average time taken to encode and write a frame.
+     * \return The time in milliseconds.
+     */
+    double EncodeMillisecs() const noexcept;
+
+private:
+    void ThreadEventCallback() noexcept;
+    void EncodeFrame(cv::Mat const&                               frame,
+                     std::chrono::steady_clock::time_point const& timestamp);
+
+private:
+    std::string                                     m_name{"cam"};
+    std::shared_ptr<IpFreelyVideoEncoder>           m_videoEncoder;
+    IpFreelyBoundedQueue<task_t>                    m_queue;
+    std::atomic<uint64_t>                           m_framesDropped{0};
+    std::atomic<double>                             m_encodeMillisecs{0.0};
+    std::atomic<bool>                               m_queueFullWarned{false};
+    std::shared_ptr<core_lib::threads::EventThread> m_writerThread;
+};
+
+} // namespace ipfreely
+
+#endif // IPFREELYRECORDINGWRITER_H
@@ -0,0 +1,148 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyStorageUtils.cpp
+ * \brief File containing definitions of helpers for the background storage threads.
+ */
+#include "IpFreelyStorageUtils.h"
+#include <boost/filesystem.hpp>
+#include "DebugLog/DebugLogging.h"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__)
+#include <sys/syscall.h>
+#endif
+#endif
+
+namespace bfs = boost::filesystem;
+
+namespace ipfreely
+{
+
+std::string DayFolderName(time_t const time)
+{
+    auto localTime = std::localtime(&time);
+    char folderName[9];
+    std::strftime(folderName, sizeof(folderName), "%Y%m%d", localTime);
+    return folderName;
+}
+
+void SetBackgroundIoPriority(std::string const& threadName)
+{
+#if defined(__linux__)
+    static constexpr int IOPRIO_WHO_PROCESS = 1;
+    static constexpr int IOPRIO_CLASS_IDLE  = 3;
+    static constexpr int IOPRIO_CLASS_SHIFT = 13;
+
+    if (syscall(SYS_ioprio_set, IOPRIO_WHO_PROCESS, 0, IOPRIO_CLASS_IDLE << IOPRIO_CLASS_SHIFT))
+    {
+        DEBUG_MESSAGE_EX_WARNING("Failed to set idle I/O priority for " << threadName
+                                                                          << " thread.");
+    }
+#elif defined(_WIN32)
+    if (!SetThreadPriority(GetCurrentThread(), THREAD_MODE_BACKGROUND_BEGIN))
+    {
+        DEBUG_MESSAGE_EX_WARNING("Failed to set background priority for " << threadName
+                                                                            << " thread.");
+    }
+#else
+    (void)threadName;
+#endif
+}
+
+void RemoveEmptyDayFolder(std::string const& dayFolderPath)
+{
+    bfs::path const           dayFolder(dayFolderPath);
+    boost::system::error_code ec;
+
+    if ((dayFolder.filename().string() != DayFolderName(time(0))) &&
+        bfs::is_empty(dayFolder, ec) && !ec)
+    {
+        bfs::remove(dayFolder, ec);
+    }
+}
+
+bool FlushFileToDisk(std::string const& filePath)
+{
+#if defined(_WIN32)
+    auto handle = CreateFileW(bfs::path(filePath).wstring().c_str(),
+                              GENERIC_WRITE,
+                              FILE_SHARE_READ | FILE_SHARE_WRITE,
+                              nullptr,
+                              OPEN_EXISTING,
+                              FILE_ATTRIBUTE_NORMAL,
+                              nullptr);
+
+    if (handle == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    auto const flushed = FlushFileBuffers(handle) != 0;
+    CloseHandle(handle);
+    return flushed;
+#else
+    auto fd = open(filePath.c_str(), O_RDONLY);
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    auto const flushed = fsync(fd) == 0;
+    close(fd);
+    return flushed;
+#endif
+}
+
+bool FlushFolderToDisk(std::string const& folderPath)
+{
+#if defined(_WIN32)
+    (void)folderPath;
+    return true;
+#else
+    return FlushFileToDisk(folderPath);
+#endif
+}
+
+void DropCachedFile(std::string const& filePath)
+{
+#if defined(POSIX_FADV_DONTNEED)
+    auto fd = open(filePath.c_str(), O_RDONLY);
+
+    if (fd >= 0)
+    {
+        posix_fadvise(fd, 0, 0, POSIX_FADV_DONTNEED);
+        close(fd);
+    }
+#else
+    (void)filePath;
+#endif
+}
+
+} // namespace ipfreely
@@ -0,0 +1,90 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyStorageUtils.h
+ * \brief File containing declarations of helpers for the background storage threads.
+ */
+#ifndef IPFREELYSTORAGEUTILS_H
+#define IPFREELYSTORAGEUTILS_H
+
+#include <string>
+#include <ctime>
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+/*! \brief Extension added to a recording's path for its event markers sidecar file. */
+static constexpr char const* EVENT_MARKERS_EXTENSION = ".events.csv";
+
+/*!
+ * \brief DayFolderName gives the name of the daily sub-folder recordings are saved in.
+ * \param[in] time - A time in the day.
+ * \return The folder's name, YYYYMMDD.
+ */
+std::string DayFolderName(time_t const time);
+
+/*!
+ * \brief SetBackgroundIoPriority lowers the calling thread's disk priority.
+ * \param[in] threadName - The thread's name, for logging.
+ *
+ * Uses the idle I/O class on Linux, so the thread only uses the disk when nothing else is, and
+ * background mode on Windows, which lowers its I/O priority as well as its CPU priority.
+ */
+void SetBackgroundIoPriority(std::string const& threadName);
+
+/*!
+ * \brief RemoveEmptyDayFolder removes a daily sub-folder once its last recording has gone.
+ * \param[in] dayFolderPath - The folder's full path.
+ *
+ * Today's folder is kept as it is still in use.
+ */
+void RemoveEmptyDayFolder(std::string const& dayFolderPath);
+
+/*!
+ * \brief FlushFileToDisk waits for a file's writes to reach stable storage.
+ * \param[in] filePath - The file's full path.
+ * \return True if flushed, false on error.
+ */
+bool FlushFileToDisk(std::string const& filePath);
+
+/*!
+ * \brief FlushFolderToDisk waits for a folder's entries, e.g. a renamed file, to reach stable
+ * storage.
+ * \param[in] folderPath - The folder's full path.
+ * \return True if flushed, false on error.
+ *
+ * Does nothing on Windows, where folders cannot be flushed and NTFS journals their changes.
+ */
+bool FlushFolderToDisk(std::string const& folderPath);
+
+/*!
+ * \brief DropCachedFile asks the OS to drop a flushed file's pages from its cache.
+ * \param[in] filePath - The file's full path.
+ *
+ * The file's next read then comes from the disk, or the server for a network volume, rather
+ * than from memory. Does nothing where the OS has no way to ask.
+ */
+void DropCachedFile(std::string const& filePath);
+
+} // namespace ipfreely
+
+#endif // IPFREELYSTORAGEUTILS_H
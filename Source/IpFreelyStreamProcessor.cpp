@@ -25,9 +25,18 @@
 #include "IpFreelyStreamProcessor.h"
 #include <sstream>
 #include <cmath>
+#include <thread>
+#include <algorithm>
 #include <boost/exception/all.hpp>
 #include <boost/filesystem.hpp>
 #include "IpFreelyMotionDetector.h"
+#include "IpFreelyPacketStream.h"
+#include "IpFreelyPacketRelay.h"
+#include "IpFreelyLumaDecoder.h"
+#include "IpFreelyPacketRecorder.h"
+#include "IpFreelyVideoEncoder.h"
+#include "IpFreelyRecordingWriter.h"
+#include "IpFreelyDeletionQueue.h"
 #include "Threads/EventThread.h"
 #include "StringUtils/StringUtils.h"
 #include "DebugLog/DebugLogging.h"
@@ -37,9 +46,19 @@ namespace bfs = boost::filesystem;
 namespace ipfreely
 {
 
+static constexpr size_t       FRAME_RING_CAPACITY      = 4;
+static constexpr unsigned int CAPTURE_THREAD_PERIOD_MS = 1;
+static constexpr unsigned int CAPTURE_RETRY_PERIOD_MS  = 100;
+static constexpr double       DISPLAY_UPDATE_FPS       = 10.0;
+static constexpr double       WRITER_QUEUE_SECS        = 1.0;
+static constexpr double       WRITER_PRESSURE_FRACTION = 0.5;
+static constexpr size_t       FRAME_POOL_SPARE_BUFFERS = 24;
+
 namespace utils
 {
 
+// The resulting image never shares the cv::Mat's pixels
+// so it remains valid once the frame has been released.
 inline bool CvMatToQImage(cv::Mat const& inMat, QImage& image)
 {
     switch (inMat.type())
@@ -51,7 +70,8 @@ inline bool CvMatToQImage(cv::Mat const& inMat, QImage& image)
                        inMat.cols,
                        inMat.rows,
                        static_cast<int>(inMat.step),
-                       QImage::Format_ARGB32);
+                       QImage::Format_ARGB32)
+                    .copy();
         return true;
     }
 
@@ -73,7 +93,8 @@ inline bool CvMatToQImage(cv::Mat const& inMat, QImage& image)
                        inMat.cols,
                        inMat.rows,
                        static_cast<int>(inMat.step),
-                       QImage::Format_Grayscale8);
+                       QImage::Format_Grayscale8)
+                    .copy();
         return true;
     }
 
@@ -83,12 +104,84 @@ inline bool CvMatToQImage(cv::Mat const& inMat, QImage& image)
     }
 }
 
+inline void ReleasePooledFrame(void* frame)
+{
+    delete static_cast<cv::Mat*>(frame);
+}
+
+inline bool CvMatToRgb(cv::Mat const& inMat, cv::Mat& rgbMat)
+{
+    switch (inMat.type())
+    {
+    case CV_8UC4:
+        cv::cvtColor(inMat, rgbMat, cv::COLOR_BGRA2RGB);
+        return true;
+    case CV_8UC3:
+        cv::cvtColor(inMat, rgbMat, cv::COLOR_BGR2RGB);
+        return true;
+    case CV_8UC1:
+        cv::cvtColor(inMat, rgbMat, cv::COLOR_GRAY2RGB);
+        return true;
+    default:
+        DEBUG_MESSAGE_EX_ERROR("unsupported cv::Mat format");
+        return false;
+    }
+}
+
+inline QSize FitSize(int const width, int const height, QSize const& targetSize,
+                     bool const enlarge)
+{
+    if ((width <= 0) || (height <= 0) || targetSize.isEmpty())
+    {
+        return QSize();
+    }
+
+    if (!enlarge && (width <= targetSize.width()) && (height <= targetSize.height()))
+    {
+        return QSize(width, height);
+    }
+
+    double frameAspectRatio = static_cast<double>(width) / static_cast<double>(height);
+    double targetAspectRatio =
+        static_cast<double>(targetSize.width()) / static_cast<double>(targetSize.height());
+
+    if (targetAspectRatio < frameAspectRatio)
+    {
+        return QSize(targetSize.width(),
+                     static_cast<int>(static_cast<double>(targetSize.width()) / frameAspectRatio));
+    }
+
+    return QSize(static_cast<int>(static_cast<double>(targetSize.height()) * frameAspectRatio),
+                 targetSize.height());
+}
+
+inline void UpdatePacketRecorder(IpFreelyPacketRecorder& recorder, bool const record)
+{
+    if (record == recorder.IsRecording())
+    {
+        return;
+    }
+
+    if (record)
+    {
+        recorder.Start();
+    }
+    else
+    {
+        recorder.Stop();
+    }
+}
+
 } // namespace utils
 
 IpFreelyStreamProcessor::IpFreelyStreamProcessor(
     std::string const& name, IpCamera const& cameraDetails, std::string const& saveFolderPath,
-    double const requiredFileDurationSecs, std::vector<std::vector<bool>> const& recordingSchedule,
-    std::vector<std::vector<bool>> const& motionSchedule)
+    double const                                     requiredFileDurationSecs,
+    std::shared_ptr<IpFreelyWorkerPool> const&       motionWorkerPool,
+    std::shared_ptr<IpFreelyRecordingCatalog> const& recordingCatalog,
+    std::shared_ptr<IpFreelyDeletionQueue> const&    deletionQueue,
+    std::vector<std::vector<bool>> const&            recordingSchedule,
+    std::vector<std::vector<bool>> const&            motionSchedule)
     : m_name(core_lib::string_utils::RemoveIllegalChars(name))
     , m_cameraDetails(cameraDetails)
     , m_saveFolderPath(saveFolderPath)
@@ -96,6 +189,11 @@ IpFreelyStreamProcessor::IpFreelyStreamProcessor(
     , m_recordingSchedule(recordingSchedule)
     , m_motionSchedule(motionSchedule)
     , m_fps(m_cameraDetails.cameraMaxFps)
+    , m_frameRing(FRAME_RING_CAPACITY)
+    , m_framePool(m_name, FRAME_RING_CAPACITY + FRAME_POOL_SPARE_BUFFERS)
+    , m_motionWorkerPool(motionWorkerPool)
+    , m_recordingCatalog(recordingCatalog)
+    , m_deletionQueue(deletionQueue)
 {
     m_useRecordingSchedule = VerifySchedule("Recording", m_recordingSchedule);
     m_useMotionSchedule    = VerifySchedule("Motion", m_motionSchedule);
@@ -116,6 +214,7 @@ IpFreelyStreamProcessor::IpFreelyStreamProcessor(
     CreateVideoCapture();
 
     m_originalFps = m_videoCapture->get(cv::CAP_PROP_FPS);
+    m_detectedFps = m_originalFps;
 
     DEBUG_MESSAGE_EX_INFO("Stream at: " << m_cameraDetails.streamUrl
                                         << " has detected stream FPS: " << m_originalFps);
@@ -129,6 +228,15 @@ IpFreelyStreamProcessor::IpFreelyStreamProcessor(
                           << m_cameraDetails.streamUrl << ", recording with FPS of: " << m_fps
                           << ", thread update period (ms): " << m_updatePeriodMillisecs);
 
+    CreateRecordingSinks();
+    UpdateRequiredDecodeFps();
+    UpdateFramePoolSize();
+
+    if (m_cameraDetails.enableCaptureThread)
+    {
+        StartCaptureThread();
+    }
+
     DEBUG_MESSAGE_EX_INFO("Creating event thread for stream URL: " << m_cameraDetails.streamUrl);
 
     m_eventThread = std::make_shared<core_lib::threads::EventThread>(
@@ -167,16 +275,30 @@ bool IpFreelyStreamProcessor::VideoWritingEnabled() const noexcept
 
     if (!isWriting && m_motionDetector)
     {
-        isWriting = m_motionDetector->WritingStream();
+        isWriting = m_motionDetector->MotionInProgress();
     }
 
     return isWriting;
 }
 
-bool IpFreelyStreamProcessor::VideoFrameUpdated() const noexcept
+void IpFreelyStreamProcessor::RegisterDisplaySize(int const displayId, QSize const& size,
+                                                  bool const enlarge)
 {
-    std::lock_guard<std::mutex> lock(m_frameMutex);
-    return m_videoFrameUpdated;
+    std::lock_guard<std::mutex> lock(m_displaySizesMutex);
+    m_displaySizes[displayId] = std::make_pair(size, enlarge);
+}
+
+void IpFreelyStreamProcessor::UnregisterDisplaySize(int const displayId)
+{
+    std::lock_guard<std::mutex> lock(m_displaySizesMutex);
+    m_displaySizes.erase(displayId);
+}
+
+bool IpFreelyStreamProcessor::CurrentSnapshot(VideoSnapshot& snapshot) const
+{
+    m_snapshots.Update();
+    snapshot = m_snapshots.ReadBuffer();
+    return !snapshot.frame.empty();
 }
 
 double IpFreelyStreamProcessor::GetAspectRatioAndSize(int& width, int& height) const
@@ -188,14 +310,20 @@ double IpFreelyStreamProcessor::GetAspectRatioAndSize(int& width, int& height) c
 
 QImage IpFreelyStreamProcessor::CurrentVideoFrame(QRect* motionRectangle) const
 {
+    VideoSnapshot snapshot;
+    QImage        image;
+
+    if (CurrentSnapshot(snapshot))
+    {
+        utils::CvMatToQImage(snapshot.frame, image);
+    }
+
     if (motionRectangle)
     {
-        std::lock_guard<std::mutex> lockM(m_motionMutex);
-        *motionRectangle = m_motionRectangle;
+        *motionRectangle = snapshot.motionRectangle;
     }
 
-    std::lock_guard<std::mutex> lockF(m_frameMutex);
-    return m_currentFrame;
+    return image;
 }
 
 double IpFreelyStreamProcessor::OriginalFps() const noexcept
@@ -208,6 +336,33 @@ double IpFreelyStreamProcessor::CurrentFps() const noexcept
     return m_fps;
 }
 
+CaptureStatistics IpFreelyStreamProcessor::GetCaptureStatistics() const noexcept
+{
+    CaptureStatistics stats;
+    stats.framesGrabbed          = m_framesGrabbed;
+    stats.framesCaptured         = m_frameRing.FramesPushed();
+    stats.framesDropped          = m_frameRing.FramesDropped();
+    stats.displayFramesSkipped   = m_displayFramesSkipped;
+    stats.motionFramesSkipped    = m_motionFramesSkipped;
+    stats.recordingFramesSkipped = m_recordingFramesSkipped;
+    stats.motionQueueDepth       = m_motionQueueDepth;
+    stats.motionFramesDropped    = m_motionFramesDropped;
+    stats.motionLatencyMillisecs = m_motionLatencyMillisecs;
+    stats.motionEngineMillisecs  = m_motionEngineMillisecs;
+    stats.motionAnalysisFps      = m_motionAnalysisFps;
+    stats.motionLumaDecode       = m_motionLumaDecode;
+    stats.motionFromVectors      = m_motionFromVectors;
+    stats.preRollBytes           = m_preRollBytes;
+    stats.preRollSecs            = m_preRollSecs;
+    stats.writerQueueDepth       = m_writerQueueDepth;
+    stats.writerFramesDropped    = m_writerFramesDropped;
+    stats.encodeMillisecs        = m_encodeMillisecs;
+    stats.framePoolBuffers       = m_framePool.BuffersAllocated();
+    stats.framePoolHighWaterMark = m_framePool.HighWaterMark();
+    stats.framePoolOverflows     = m_framePool.Overflows();
+    return stats;
+}
+
 bool IpFreelyStreamProcessor::IsScheduleEnabled(std::vector<std::vector<bool>> const& schedule)
 {
     bool recordEnabled = false;
@@ -277,12 +432,26 @@ void IpFreelyStreamProcessor::ThreadEventCallback() noexcept
 
     try
     {
-        GrabVideoFrame();
+        // Without a dedicated capture thread we read the
+        // stream at the recording FPS on this thread.
+        if (!m_captureThread)
+        {
+            CaptureVideoFrame(false);
+        }
+
+        bool displayUpdated = GrabVideoFrame();
         CheckRecordingSchedule();
         CheckMotionDetector();
-        CreateCaptureObjects();
+        UpdateRecordingSinks();
         WriteVideoFrame();
+        UpdateRecordingStatistics();
+        UpdateRequiredDecodeFps();
         CheckFps();
+
+        if (displayUpdated)
+        {
+            PublishSnapshot();
+        }
     }
     catch (...)
     {
@@ -291,6 +460,136 @@ void IpFreelyStreamProcessor::ThreadEventCallback() noexcept
     }
 }
 
+void IpFreelyStreamProcessor::CaptureThreadCallback() noexcept
+{
+    try
+    {
+        if (CaptureVideoFrame(true))
+        {
+            m_detectedFps = m_videoCapture->get(cv::CAP_PROP_FPS);
+        }
+        else
+        {
+            // Don't spin if the stream has dropped out.
+            std::this_thread::sleep_for(std::chrono::milliseconds(CAPTURE_RETRY_PERIOD_MS));
+        }
+    }
+    catch (...)
+    {
+        auto exceptionMsg = boost::current_exception_diagnostic_information();
+        DEBUG_MESSAGE_EX_ERROR(exceptionMsg);
+    }
+}
+
+void IpFreelyStreamProcessor::StartCaptureThread()
+{
+    DEBUG_MESSAGE_EX_INFO("Creating capture thread for stream URL: " << m_cameraDetails.streamUrl);
+
+    m_captureThread = std::make_shared<core_lib::threads::EventThread>(
+        std::bind(&IpFreelyStreamProcessor::CaptureThreadCallback, this), CAPTURE_THREAD_PERIOD_MS);
+}
+
+void IpFreelyStreamProcessor::StopCaptureThread()
+{
+    if (m_captureThread)
+    {
+        DEBUG_MESSAGE_EX_INFO(
+            "Destroying capture thread for stream URL: " << m_cameraDetails.streamUrl);
+        m_captureThread.reset();
+    }
+}
+
+bool IpFreelyStreamProcessor::CaptureVideoFrame(bool const decimate)
+{
+    // OpenCV decodes every frame in grab(), which keeps the stream current and
+    // decodable, so skipping frames here only saves retrieve() converting them
+    // to BGR and copying them for the frames our consumers don't need.
+    if (!m_videoCapture->grab())
+    {
+        return false;
+    }
+
+    // Stamp frames from a monotonic clock as soon as they arrive so recordings
+    // follow real elapsed time however irregularly the frames are consumed.
+    auto captureTime = std::chrono::steady_clock::now();
+
+    ++m_framesGrabbed;
+
+    if (decimate && !FrameDecodeRequired())
+    {
+        return true;
+    }
+
+    // Always retrieve into a buffer no consumer still holds. As long as the
+    // stream's frame size doesn't change the pooled buffer is decoded into.
+    auto frame = m_framePool.Acquire(
+        m_captureFrameSize.height, m_captureFrameSize.width, m_captureFrameType);
+
+    if (!m_videoCapture->retrieve(frame) || frame.empty())
+    {
+        return false;
+    }
+
+    m_captureFrameSize = frame.size();
+    m_captureFrameType = frame.type();
+
+    m_frameRing.Push(frame, captureTime);
+
+    return true;
+}
+
+bool IpFreelyStreamProcessor::FrameDecodeRequired()
+{
+    // Accumulate decode credit at the required decode rate for the time
+    // elapsed since the previous grab. Whenever a whole frame's worth of
+    // credit is available we retrieve, this spreads retrieved frames evenly
+    // over the camera's actual frame rate without needing to trust its
+    // reported FPS.
+    auto now = std::chrono::steady_clock::now();
+    auto dt  = std::chrono::duration<double>(now - m_lastGrabTime).count();
+
+    m_lastGrabTime = now;
+    m_decodeCredit = std::min(m_decodeCredit + (m_requiredDecodeFps * dt), 1.0);
+
+    if (m_decodeCredit < 1.0)
+    {
+        return false;
+    }
+
+    m_decodeCredit -= 1.0;
+
+    return true;
+}
+
+void IpFreelyStreamProcessor::UpdateRequiredDecodeFps()
+{
+    // We always need frames for the display but only need to
+    // decode at the recording FPS if we're writing to disk or
+    // feeding frames to the motion detector, unless the motion
+    // detector's frames are decoded separately.
+    auto requiredFps = DISPLAY_UPDATE_FPS;
+
+    if (m_encoding || (m_motionDetector && !m_lumaDecoder))
+    {
+        requiredFps = std::max(requiredFps, m_fps);
+    }
+
+    m_requiredDecodeFps = requiredFps;
+}
+
+void IpFreelyStreamProcessor::UpdateFramePoolSize()
+{
+    // Enough buffers for every frame that can be held at once: the frame ring,
+    // the motion pre-roll, the recording writer's queue and the frames held
+    // for display and by the stages in between.
+    auto preRollFrames = static_cast<size_t>(
+        std::ceil(m_fps * std::min(m_cameraDetails.motionPreRollSecs, MAX_PRE_ROLL_SECS)));
+    auto writerQueueFrames = static_cast<size_t>(std::ceil(m_fps * WRITER_QUEUE_SECS));
+
+    m_framePool.SetMaxBuffers(FRAME_RING_CAPACITY + preRollFrames + writerQueueFrames +
+                              FRAME_POOL_SPARE_BUFFERS);
+}
+
 void IpFreelyStreamProcessor::SetEnableVideoWriting(bool enable) noexcept
 {
     std::lock_guard<std::mutex> lock(m_writingMutex);
@@ -333,95 +632,406 @@ void IpFreelyStreamProcessor::CheckRecordingSchedule()
     }
 }
 
-void IpFreelyStreamProcessor::CreateCaptureObjects()
+void IpFreelyStreamProcessor::CreateRecordingSinks()
 {
-    if (GetEnableVideoWriting())
+    // The writer must be stopped before the recorders it controls and the packet relay
+    // whose packets it queues, and the recorders, relay and luma decoder released before
+    // the packet source they're registered with.
+    m_recordingWriter.reset();
+    m_motionPacketRecorder.reset();
+    m_packetRecorder.reset();
+    m_packetRelay.reset();
+    m_lumaDecoder.reset();
+    m_packetStream.reset();
+    m_videoEncoder.reset();
+    m_encoding            = false;
+    m_continuousRecording = false;
+    m_motionRecording     = false;
+    m_lumaDecoderFailed   = false;
+    m_motionLumaDecode    = false;
+    m_motionFromVectors   = false;
+    m_motionSequence      = 0;
+    ClearPreRollFrames();
+
+    if (m_cameraDetails.recordingMode == eRecordingMode::passthrough)
     {
-        if (m_videoWriter)
+        bool isId;
+        auto completeStreamUrl = m_cameraDetails.CompleteStreamUrl(isId);
+
+        if (isId)
         {
-            if (m_fileDurationSecs < m_requiredFileDurationSecs)
+            DEBUG_MESSAGE_EX_WARNING(
+                "Passthrough recording is not available for local camera IDs, "
+                "will re-encode video instead for camera: "
+                << m_name);
+        }
+        else
+        {
+            try
+            {
+                m_packetStream = std::make_shared<IpFreelyPacketStream>(m_name, completeStreamUrl);
+            }
+            catch (...)
             {
-                return;
+                auto exceptionMsg = boost::current_exception_diagnostic_information();
+                DEBUG_MESSAGE_EX_ERROR("Passthrough recording unavailable, will re-encode video "
+                                       "instead for camera: "
+                                       << m_name << ", reason: " << exceptionMsg);
             }
+        }
+    }
+
+    // Continuous and motion recordings share the camera's one packet source
+    // so overlapping recordings never read or encode the video twice.
+    std::shared_ptr<IpFreelyPacketSource> packetSource;
+    std::string                           fileExtension;
+
+    try
+    {
+        if (!m_packetStream)
+        {
+            m_videoEncoder =
+                std::make_shared<IpFreelyVideoEncoder>(m_name, m_videoWidth, m_videoHeight, m_fps);
+        }
+
+        m_recordingWriter = std::make_shared<IpFreelyRecordingWriter>(
+            m_name,
+            m_videoEncoder,
+            static_cast<size_t>(std::ceil(m_fps * WRITER_QUEUE_SECS)));
 
-            m_videoWriter.release();
+        if (m_packetStream)
+        {
+            // The camera's packets are recorded from the writer's thread, like encoded
+            // packets are, so file writes never hold up reading the stream.
+            m_packetRelay =
+                std::make_shared<IpFreelyPacketRelay>(m_name, m_packetStream, m_recordingWriter);
+            packetSource  = m_packetRelay;
+            fileExtension = ".mkv";
         }
+        else
+        {
+            packetSource  = m_videoEncoder;
+            fileExtension = ".avi";
+        }
+
+        m_packetRecorder = std::make_shared<IpFreelyPacketRecorder>(m_name,
+                                                                    fileExtension,
+                                                                    m_saveFolderPath,
+                                                                    m_requiredFileDurationSecs,
+                                                                    0.0,
+                                                                    packetSource,
+                                                                    m_recordingCatalog,
+                                                                    m_cameraDetails.camId,
+                                                                    eRecordingType::segment);
+        m_motionPacketRecorder = std::make_shared<IpFreelyPacketRecorder>(
+            m_name + "_motion",
+            fileExtension,
+            m_saveFolderPath,
+            m_requiredFileDurationSecs,
+            std::min(m_cameraDetails.motionPreRollSecs, MAX_PRE_ROLL_SECS),
+            packetSource,
+            m_recordingCatalog,
+            m_cameraDetails.camId,
+            eRecordingType::motionClip);
+    }
+    catch (...)
+    {
+        m_recordingWriter.reset();
+        m_motionPacketRecorder.reset();
+        m_packetRecorder.reset();
+        m_packetRelay.reset();
+        m_packetStream.reset();
+        m_videoEncoder.reset();
+
+        auto exceptionMsg = boost::current_exception_diagnostic_information();
+        DEBUG_MESSAGE_EX_ERROR("Recording unavailable for camera: " << m_name << ", reason: "
+                                                                    << exceptionMsg);
+    }
+}
+
+void IpFreelyStreamProcessor::UpdateRecordingSinks()
+{
+    if (!m_recordingWriter)
+    {
+        return;
+    }
+
+    bool const continuous = GetEnableVideoWriting();
+    bool const motion     = m_motionDetector && m_motionDetector->MotionInProgress();
+
+    // Starting and stopping recorders opens and closes files so we leave it
+    // to the writer's thread, which also keeps it in order with the frames.
+    if (continuous != m_continuousRecording)
+    {
+        m_continuousRecording = continuous;
+        auto recorder         = m_packetRecorder;
+        m_recordingWriter->Post(
+            [recorder, continuous]() { utils::UpdatePacketRecorder(*recorder, continuous); });
+    }
+
+    if (motion != m_motionRecording)
+    {
+        m_motionRecording = motion;
+        auto recorder     = m_motionPacketRecorder;
+        m_recordingWriter->Post(
+            [recorder, motion]() { utils::UpdatePacketRecorder(*recorder, motion); });
+
+        // Mark motion events in the continuous recording so they can
+        // be found without having to open the separate motion clips.
+        recorder = m_packetRecorder;
+        m_recordingWriter->Post([recorder, motion]() {
+            if (recorder->IsRecording())
+            {
+                recorder->AddEventMarker(motion ? "motion_start" : "motion_end");
+            }
+        });
+    }
 
-        m_fileDurationSecs = 0.0;
+    // In passthrough mode the camera's packets are always flowing.
+    if (!m_videoEncoder)
+    {
+        return;
+    }
 
-        auto localTime = std::localtime(&m_currentTime);
-        char folderName[9];
-        std::strftime(folderName, sizeof(folderName), "%Y%m%d", localTime);
+    // Otherwise we encode once for both recorders whenever either needs it.
+    bool const encode = continuous || motion;
 
-        bfs::path p(m_saveFolderPath);
-        p /= folderName;
-        p = bfs::system_complete(p);
+    if (encode && !m_encoding)
+    {
+        // The recorders only start files on a keyframe.
+        m_recordingWriter->ForceKeyFrame();
 
-        if (!bfs::exists(p))
+        // The pre-roll is already bounded so none of it is dropped.
+        if (motion)
         {
-            if (!bfs::create_directories(p))
+            for (auto const& frame : m_preRollFrames)
             {
-                DEBUG_MESSAGE_EX_ERROR("Failed to create directories: " << p.string());
-                return;
+                m_recordingWriter->WriteFrame(frame.second, frame.first, false);
             }
         }
+    }
 
-        std::ostringstream oss;
-        oss << m_name << "_" << m_currentTime << ".avi";
-
-        p /= oss.str();
-
-        DEBUG_MESSAGE_EX_INFO("Creating new output video file: " << p.string()
-                                                                 << ", FPS: " << m_fps);
-
-#if BOOST_OS_WINDOWS
-        m_videoWriter = cv::makePtr<cv::VideoWriter>(p.string().c_str(),
-                                                     cv::VideoWriter::fourcc('D', 'I', 'V', 'X'),
-                                                     m_fps,
-                                                     cv::Size(m_videoWidth, m_videoHeight));
-#else
-        m_videoWriter = cv::makePtr<cv::VideoWriter>(p.string().c_str(),
-                                                     cv::VideoWriter::fourcc('X', 'V', 'I', 'D'),
-                                                     m_fps,
-                                                     cv::Size(m_videoWidth, m_videoHeight));
-#endif
-
-        if (!m_videoWriter->isOpened())
+    if (encode)
+    {
+        ClearPreRollFrames();
+    }
+
+    m_encoding = encode;
+}
+
+void IpFreelyStreamProcessor::BufferPreRollFrame(
+    cv::Mat const& frame, std::chrono::steady_clock::time_point const& timestamp)
+{
+    auto maxPreRollFrames = static_cast<size_t>(
+        std::ceil(m_fps * std::min(m_cameraDetails.motionPreRollSecs, MAX_PRE_ROLL_SECS)));
+
+    if (maxPreRollFrames == 0)
+    {
+        return;
+    }
+
+    // Frames are never modified once captured so we can hold
+    // references to them rather than copying their pixels.
+    m_preRollFrames.emplace_back(timestamp, frame);
+    m_preRollFrameBytes += frame.total() * frame.elemSize();
+
+    while ((m_preRollFrames.size() > maxPreRollFrames) ||
+           (m_preRollFrameBytes > MAX_PRE_ROLL_BYTES))
+    {
+        if ((m_preRollFrames.size() <= maxPreRollFrames) && !m_preRollCapWarned)
         {
-            m_videoWriter.release();
-            DEBUG_MESSAGE_EX_ERROR("Failed to open VideoWriter object for: " << p.string());
-            return;
+            DEBUG_MESSAGE_EX_WARNING("Pre-roll exceeds memory cap of "
+                                     << MAX_PRE_ROLL_BYTES << " bytes, shortening it for camera: "
+                                     << m_cameraDetails.streamUrl);
+            m_preRollCapWarned = true;
         }
+
+        auto const& oldest = m_preRollFrames.front().second;
+        m_preRollFrameBytes -= oldest.total() * oldest.elemSize();
+        m_preRollFrames.pop_front();
     }
-    else
+}
+
+void IpFreelyStreamProcessor::ClearPreRollFrames() noexcept
+{
+    m_preRollFrames.clear();
+    m_preRollFrameBytes = 0;
+}
+
+void IpFreelyStreamProcessor::UpdateRecordingStatistics()
+{
+    // While the encoder is idle the pre-roll is held as frames, once
+    // packets are flowing the motion packet recorder holds it instead.
+    size_t bytes = m_preRollFrameBytes;
+    double secs  = static_cast<double>(m_preRollFrames.size()) / m_fps;
+
+    if (m_motionPacketRecorder)
     {
-        if (m_videoWriter)
+        bytes += m_motionPacketRecorder->PreRollBytes();
+        secs = std::max(secs, m_motionPacketRecorder->PreRollSecs());
+    }
+
+    m_preRollBytes = bytes;
+    m_preRollSecs  = secs;
+
+    if (m_recordingWriter)
+    {
+        // In passthrough mode the writer's queue holds the camera's packets, so
+        // packets dropped by the relay count as the writer falling behind too.
+        auto const framesDropped = m_recordingWriter->FramesDropped() +
+                                   (m_packetRelay ? m_packetRelay->PacketsDropped() : 0);
+        auto const pressureDepth = std::max<size_t>(
+            static_cast<size_t>(std::ceil(m_fps * WRITER_QUEUE_SECS * WRITER_PRESSURE_FRACTION)),
+            2);
+
+        m_writerQueueDepth = m_recordingWriter->QueueDepth();
+
+        // Hold off deleting old recordings while the writer is struggling to keep up.
+        if (m_deletionQueue &&
+            ((m_writerQueueDepth >= pressureDepth) || (framesDropped > m_writerFramesDropped)))
         {
-            DEBUG_MESSAGE_EX_INFO(
-                "Video writing disabled, releasing video writer, camera: " << m_name);
-            m_videoWriter.release();
+            m_deletionQueue->NoteWriterPressure();
         }
+
+        m_writerFramesDropped = framesDropped;
+        m_encodeMillisecs     = m_recordingWriter->EncodeMillisecs();
+    }
+    else
+    {
+        m_writerQueueDepth = 0;
+        m_encodeMillisecs  = 0.0;
     }
 }
 
-void IpFreelyStreamProcessor::GrabVideoFrame()
+bool IpFreelyStreamProcessor::GrabVideoFrame()
 {
-    *m_videoCapture >> m_videoFrame;
+    static const auto displayPeriod =
+        std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / DISPLAY_UPDATE_FPS));
+
+    auto now = std::chrono::steady_clock::now();
+
+    if (now - m_lastDisplayUpdate < displayPeriod)
+    {
+        return false;
+    }
 
-    std::lock_guard<std::mutex> lock(m_frameMutex);
-    utils::CvMatToQImage(m_videoFrame, m_currentFrame);
-    m_videoFrameUpdated = true;
+    uint64_t skipped = 0;
+
+    if (!m_frameRing.Latest(m_displaySequence, m_displayFrame, &skipped))
+    {
+        return false;
+    }
+
+    m_displayFramesSkipped += skipped;
+    m_lastDisplayUpdate = now;
+
+    ScaleDisplayFrames();
+    return true;
 }
 
-void IpFreelyStreamProcessor::WriteVideoFrame()
+void IpFreelyStreamProcessor::ScaleDisplayFrames()
 {
-    if (m_videoWriter)
+    std::map<int, std::pair<QSize, bool>> displaySizes;
+
     {
+        std::lock_guard<std::mutex> lock(m_displaySizesMutex);
+        displaySizes = m_displaySizes;
+    }
+
+    // Always create new images as the previous ones may still be in use by the GUI.
+    m_displayImages.clear();
+
+    for (auto const& displaySize : displaySizes)
+    {
+        auto size = utils::FitSize(m_displayFrame.cols,
+                                   m_displayFrame.rows,
+                                   displaySize.second.first,
+                                   displaySize.second.second);
+
+        if (size.isEmpty())
+        {
+            continue;
+        }
+
+        auto source = m_displayFrame;
+
+        if ((size.width() != m_displayFrame.cols) || (size.height() != m_displayFrame.rows))
         {
-            *m_videoWriter << m_videoFrame;
+            auto interpolation =
+                (size.width() < m_displayFrame.cols) ? cv::INTER_AREA : cv::INTER_LINEAR;
+            source = m_framePool.Acquire(size.height(), size.width(), m_displayFrame.type());
+            cv::resize(m_displayFrame,
+                       source,
+                       cv::Size(size.width(), size.height()),
+                       0,
+                       0,
+                       interpolation);
         }
 
-        m_fileDurationSecs += static_cast<double>(m_updatePeriodMillisecs) / 1000.0;
+        // Convert straight into a pooled buffer. The image holds a reference
+        // to the buffer, returning it to the pool when the image is destroyed.
+        auto rgbFrame = m_framePool.Acquire(size.height(), size.width(), CV_8UC3);
+
+        if (!utils::CvMatToRgb(source, rgbFrame))
+        {
+            return;
+        }
+
+        m_displayImages[displaySize.first] = QImage(rgbFrame.data,
+                                                    rgbFrame.cols,
+                                                    rgbFrame.rows,
+                                                    static_cast<int>(rgbFrame.step),
+                                                    QImage::Format_RGB888,
+                                                    &utils::ReleasePooledFrame,
+                                                    new cv::Mat(rgbFrame));
+    }
+}
+
+void IpFreelyStreamProcessor::PublishSnapshot()
+{
+    // Only this thread writes snapshots so the whole display
+    // state can be published without locking out the GUI.
+    auto& snapshot           = m_snapshots.WriteBuffer();
+    snapshot.frame           = m_displayFrame;
+    snapshot.frameSize       = QSize(m_displayFrame.cols, m_displayFrame.rows);
+    snapshot.displayFrames   = m_displayImages;
+    snapshot.motionRectangle = m_motionRectangle;
+    snapshot.recording       = VideoWritingEnabled();
+    snapshot.fps             = m_fps;
+    snapshot.originalFps     = m_originalFps;
+    m_snapshots.Publish();
+}
+
+void IpFreelyStreamProcessor::WriteVideoFrame()
+{
+    // While not encoding we only need frames for the motion pre-roll.
+    if (!m_recordingWriter || !m_videoEncoder || (!m_encoding && !m_motionDetector))
+    {
+        ClearPreRollFrames();
+        m_recordingSequence = 0;
+        return;
+    }
+
+    uint64_t                              skipped = 0;
+    std::chrono::steady_clock::time_point captureTime;
+
+    // Frames are timestamped with their capture time so if no new frame has
+    // arrived since the last tick the gap is kept rather than filled.
+    if (!m_frameRing.Latest(m_recordingSequence, m_videoFrame, &skipped, &captureTime))
+    {
+        return;
+    }
+
+    m_recordingFramesSkipped += skipped;
+
+    if (m_encoding)
+    {
+        m_recordingWriter->WriteFrame(m_videoFrame, captureTime);
+    }
+    else
+    {
+        BufferPreRollFrame(m_videoFrame, captureTime);
     }
 }
 
@@ -442,34 +1052,149 @@ void IpFreelyStreamProcessor::InitialiseMotionDetector()
 {
     if (!m_motionDetector)
     {
-        m_motionDetector  = std::make_shared<IpFreelyMotionDetector>(m_name,
-                                                                    m_cameraDetails,
-                                                                    m_saveFolderPath,
-                                                                    m_requiredFileDurationSecs,
-                                                                    m_fps,
-                                                                    m_videoWidth,
-                                                                    m_videoHeight);
-        m_motionRectangle = QRect();
+        CreateMotionDetector();
     }
 }
 
+void IpFreelyStreamProcessor::CreateMotionDetector()
+{
+    m_motionDetector  = std::make_shared<IpFreelyMotionDetector>(
+        m_name, m_cameraDetails, m_fps, m_videoWidth, m_videoHeight, m_motionWorkerPool);
+    m_motionRectangle = QRect();
+
+    // With no analysis FPS set every frame is analysed, as this thread runs at the video's FPS.
+    m_motionFramePeriod =
+        (m_cameraDetails.motionAnalysisFps > 0.0)
+            ? std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                  std::chrono::duration<double>(1.0 / m_motionDetector->AnalysisFps()))
+            : std::chrono::steady_clock::duration::zero();
+    m_nextMotionFrameTime = std::chrono::steady_clock::time_point();
+    m_motionAnalysisFps   = m_motionDetector->AnalysisFps();
+}
+
 void IpFreelyStreamProcessor::CheckMotionDetector()
 {
     bool enableMotionDetector = CheckMotionSchedule();
 
     if (!enableMotionDetector)
     {
+        m_lumaDecoder.reset();
         m_motionDetector.reset();
-        m_motionRectangle = QRect();
+        m_motionRectangle  = QRect();
+        m_motionSequence   = 0;
+        m_motionQueueDepth = 0;
+        m_motionLumaDecode  = false;
+        m_motionFromVectors = false;
+        m_motionAnalysisFps = 0.0;
         return;
     }
 
     InitialiseMotionDetector();
+    UpdateLumaDecoder();
 
-    m_motionDetector->AddNextFrame(m_videoFrame);
+    uint64_t                              skipped = 0;
+    std::chrono::steady_clock::time_point captureTime;
+    cv::Mat                               motionVectors;
+    bool                                  frameAvailable = false;
+    auto                                  now = std::chrono::steady_clock::now();
 
-    std::lock_guard<std::mutex> lockM(m_motionMutex);
-    m_motionRectangle = m_motionDetector->CurrentMotionRect();
+    // Frames are sampled for analysis at the analysis FPS while recording still gets every
+    // frame. The luma decoder only produces grey frames at that rate so they're always
+    // taken, but motion vectors carry on being combined until they're next due.
+    bool const frameDue = (m_lumaDecoder && !m_lumaDecoder->ExportingMotionVectors()) ||
+                          (now >= m_nextMotionFrameTime);
+
+    if (frameDue && m_lumaDecoder && m_lumaDecoder->ExportingMotionVectors())
+    {
+        // Motion vectors are gathered from every frame decoded since they were last
+        // taken, so none are missed, and grey frames are only used to confirm hits.
+        frameAvailable = m_lumaDecoder->TakeMotionVectors(motionVectors, &captureTime);
+
+        if (frameAvailable && m_cameraDetails.confirmMotionVectors)
+        {
+            m_lumaDecoder->Latest(m_motionSequence, m_motionFrame, &skipped);
+        }
+    }
+    else if (frameDue)
+    {
+        frameAvailable =
+            m_lumaDecoder
+                ? m_lumaDecoder->Latest(m_motionSequence, m_motionFrame, &skipped, &captureTime)
+                : m_frameRing.Latest(m_motionSequence, m_motionFrame, &skipped, &captureTime);
+    }
+
+    if (frameAvailable)
+    {
+        m_motionFramesSkipped += skipped;
+
+        // Step on by the period to keep the rate on average, unless too far behind.
+        m_nextMotionFrameTime += m_motionFramePeriod;
+
+        if (m_nextMotionFrameTime <= now)
+        {
+            m_nextMotionFrameTime = now + m_motionFramePeriod;
+        }
+
+        // Hand the frame over rather than keeping a reference to it
+        // here so its buffer is reused as soon as it's been analysed.
+        m_motionDetector->AddNextFrame(
+            std::move(m_motionFrame), captureTime, std::move(motionVectors));
+        m_motionFrame.release();
+    }
+
+    m_motionRectangle        = m_motionDetector->CurrentMotionRect();
+    m_motionQueueDepth       = m_motionDetector->QueueDepth();
+    m_motionFramesDropped    = m_motionDetector->FramesDropped();
+    m_motionLatencyMillisecs = m_motionDetector->LatencyMillisecs();
+    m_motionEngineMillisecs  = m_motionDetector->EngineCostMillisecs();
+}
+
+void IpFreelyStreamProcessor::UpdateLumaDecoder()
+{
+    // The video capture already decodes every frame, so a luma decoder decodes the
+    // camera's stream a second time. It's only worth that for motion vectors mode,
+    // which needs the codec's motion vectors from the camera's passthrough packets.
+    // Grey frames are then only produced if they're needed to confirm hits. If the
+    // codec doesn't export motion vectors the decoded video frames are used instead.
+    if (m_lumaDecoder && (m_lumaDecoder->Failed() || !m_lumaDecoder->ExportingMotionVectors()))
+    {
+        DEBUG_MESSAGE_EX_WARNING(
+            "Motion detector falling back to decoded video frames for camera: " << m_name);
+
+        m_lumaDecoder.reset();
+        m_lumaDecoderFailed = true;
+        m_motionSequence    = 0;
+    }
+
+    bool const motionVectors =
+        m_cameraDetails.motionDectorMode == eMotionDetectorMode::motionVectors;
+
+    if (!m_lumaDecoder && motionVectors && m_packetStream && !m_lumaDecoderFailed)
+    {
+        try
+        {
+            m_lumaDecoder = std::make_shared<IpFreelyLumaDecoder>(
+                m_name,
+                m_motionDetector->AnalysisFrameSize(),
+                m_packetStream,
+                m_cameraDetails.confirmMotionVectors,
+                true,
+                (m_cameraDetails.motionAnalysisFps > 0.0) ? m_motionDetector->AnalysisFps()
+                                                          : 0.0);
+            m_motionSequence = 0;
+        }
+        catch (...)
+        {
+            m_lumaDecoderFailed = true;
+
+            auto exceptionMsg = boost::current_exception_diagnostic_information();
+            DEBUG_MESSAGE_EX_ERROR("Luma decoding unavailable for camera: "
+                                   << m_name << ", reason: " << exceptionMsg);
+        }
+    }
+
+    m_motionLumaDecode  = m_lumaDecoder != nullptr;
+    m_motionFromVectors = m_lumaDecoder && m_lumaDecoder->ExportingMotionVectors();
 }
 
 void IpFreelyStreamProcessor::CreateVideoCapture()
@@ -498,8 +1223,9 @@ void IpFreelyStreamProcessor::CreateVideoCapture()
         BOOST_THROW_EXCEPTION(std::runtime_error(oss.str()));
     }
 
-    m_videoWidth  = static_cast<int>(m_videoCapture->get(cv::CAP_PROP_FRAME_WIDTH));
-    m_videoHeight = static_cast<int>(m_videoCapture->get(cv::CAP_PROP_FRAME_HEIGHT));
+    m_videoWidth       = static_cast<int>(m_videoCapture->get(cv::CAP_PROP_FRAME_WIDTH));
+    m_videoHeight      = static_cast<int>(m_videoCapture->get(cv::CAP_PROP_FRAME_HEIGHT));
+    m_captureFrameSize = cv::Size(m_videoWidth, m_videoHeight);
 }
 
 bool IpFreelyStreamProcessor::ComputeFps()
@@ -538,7 +1264,7 @@ bool IpFreelyStreamProcessor::ComputeFps()
 
 void IpFreelyStreamProcessor::CheckFps()
 {
-    auto fps = m_videoCapture->get(cv::CAP_PROP_FPS);
+    auto fps = m_captureThread ? m_detectedFps.load() : m_videoCapture->get(cv::CAP_PROP_FPS);
 
     if (std::abs(fps - m_originalFps) > 0.1)
     {
@@ -552,20 +1278,30 @@ void IpFreelyStreamProcessor::CheckFps()
         if (ComputeFps())
         {
             m_updatePeriodMillisecs = static_cast<unsigned int>(1000.0 / m_fps);
+            UpdateFramePoolSize();
 
             DEBUG_MESSAGE_EX_INFO(
                 "Stream at: " << m_cameraDetails.streamUrl << ", recording with FPS of: " << m_fps
                               << ", thread update period (ms): " << m_updatePeriodMillisecs);
 
-            // If the FPS has changed then recreate the video capture object.
+            // If the FPS has changed then recreate the video capture object,
+            // stopping the capture thread while we do so if one is running.
+            bool restartCaptureThread = m_captureThread != nullptr;
+            StopCaptureThread();
             CreateVideoCapture();
+            m_frameRing.Clear();
+
+            if (restartCaptureThread)
+            {
+                StartCaptureThread();
+            }
 
-            // And release video writer.
-            if (m_videoWriter)
+            // And recreate the video encoder, and its recorders, with the new FPS.
+            if (m_videoEncoder)
             {
-                DEBUG_MESSAGE_EX_INFO("Releasing video writer due to FPS change, stream URL: "
+                DEBUG_MESSAGE_EX_INFO("Recreating video encoder with new FPS, stream URL: "
                                       << m_cameraDetails.streamUrl);
-                m_videoWriter.release();
+                CreateRecordingSinks();
             }
 
             // And recreate the motion detector.
@@ -574,15 +1310,7 @@ void IpFreelyStreamProcessor::CheckFps()
                 DEBUG_MESSAGE_EX_INFO("Recreating motion detector with new FPS, stream URL: "
                                       << m_cameraDetails.streamUrl);
                 m_motionDetector.reset();
-                m_motionRectangle = QRect();
-                m_motionDetector =
-                    std::make_shared<IpFreelyMotionDetector>(m_name,
-                                                             m_cameraDetails,
-                                                             m_saveFolderPath,
-                                                             m_requiredFileDurationSecs,
-                                                             m_fps,
-                                                             m_videoWidth,
-                                                             m_videoHeight);
+                CreateMotionDetector();
             }
 
             // Finally recreate the event thread.
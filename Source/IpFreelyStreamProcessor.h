@@ -26,13 +26,23 @@
 #define IPFREELYSTREAMPROCESSOR_H
 
 #include <QImage>
+#include <QSize>
 #include <string>
 #include <vector>
+#include <map>
+#include <deque>
+#include <utility>
 #include <ctime>
 #include <memory>
 #include <mutex>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
 #include <opencv2/opencv.hpp>
 #include "IpFreelyCameraDatabase.h"
+#include "IpFreelyFrameRing.h"
+#include "IpFreelyFramePool.h"
+#include "IpFreelyTripleBuffer.h"
 
 namespace core_lib
 {
@@ -49,10 +59,114 @@ namespace ipfreely
 {
 
 class IpFreelyMotionDetector;
+class IpFreelyPacketStream;
+class IpFreelyPacketRelay;
+class IpFreelyLumaDecoder;
+class IpFreelyVideoEncoder;
+class IpFreelyRecordingWriter;
+class IpFreelyPacketRecorder;
+class IpFreelyWorkerPool;
+class IpFreelyRecordingCatalog;
+class IpFreelyDeletionQueue;
+
+/*! \brief Structure holding a consistent snapshot of a stream processor's display state. */
+struct VideoSnapshot final
+{
+    /*! \brief The BGR video frame at full stream resolution, which must not be modified. */
+    cv::Mat frame{};
+
+    /*! \brief The size of the video frame at full stream resolution. */
+    QSize frameSize{};
+
+    /*! \brief RGB video frames scaled to fit each registered display, keyed on display ID. */
+    std::map<int, QImage> displayFrames{};
+
+    /*! \brief The motion bounding rectangle at the time of the frame. */
+    QRect motionRectangle{};
+
+    /*! \brief Flag to show if the stream was being written to disk. */
+    bool recording{false};
+
+    /*! \brief The stream's recording FPS. */
+    double fps{0.0};
+
+    /*! \brief The camera stream's reported FPS. */
+    double originalFps{0.0};
+};
+
+/*! \brief Structure holding a stream processor's frame capture statistics. */
+struct CaptureStatistics final
+{
+    /*! \brief Number of frames grabbed from the camera's stream. */
+    uint64_t framesGrabbed{0};
+
+    /*! \brief Number of grabbed frames that were decoded into the frame ring. */
+    uint64_t framesCaptured{0};
+
+    /*! \brief Number of frames dropped from the frame ring before any consumer used them. */
+    uint64_t framesDropped{0};
+
+    /*! \brief Number of captured frames never converted for display. */
+    uint64_t displayFramesSkipped{0};
+
+    /*! \brief Number of captured frames never passed to the motion detector. */
+    uint64_t motionFramesSkipped{0};
+
+    /*! \brief Number of captured frames never considered for recording. */
+    uint64_t recordingFramesSkipped{0};
+
+    /*! \brief Number of frames waiting in the motion detector's queue. */
+    size_t motionQueueDepth{0};
+
+    /*! \brief Number of frames dropped because the motion detector fell behind. */
+    uint64_t motionFramesDropped{0};
+
+    /*! \brief Average time from a frame's capture to the end of its motion analysis, in ms. */
+    double motionLatencyMillisecs{0.0};
+
+    /*! \brief Average cost per frame of the motion detector's motion engine, in ms. */
+    double motionEngineMillisecs{0.0};
+
+    /*! \brief Rate frames are sampled for motion detection, 0 if motion detection is off. */
+    double motionAnalysisFps{0.0};
+
+    /*! \brief Flag to show if motion frames are decoded to grey from the camera's packets. */
+    bool motionLumaDecode{false};
+
+    /*! \brief Flag to show if motion is found from the codec's motion vectors. */
+    bool motionFromVectors{false};
+
+    /*! \brief Memory used by the motion recording pre-roll. */
+    size_t preRollBytes{0};
+
+    /*! \brief Duration of the motion recording pre-roll currently held. */
+    double preRollSecs{0.0};
+
+    /*! \brief Number of frames, packets and tasks waiting in the recording writer's queue. */
+    size_t writerQueueDepth{0};
+
+    /*! \brief Number of frames or packets dropped because the recording writer's queue was full. */
+    uint64_t writerFramesDropped{0};
+
+    /*! \brief Average time taken to encode and write a frame, in milliseconds. */
+    double encodeMillisecs{0.0};
+
+    /*! \brief Number of buffers held by the frame pool. */
+    size_t framePoolBuffers{0};
+
+    /*! \brief Most frame pool buffers that have been in use at once. */
+    size_t framePoolHighWaterMark{0};
+
+    /*! \brief Number of frames allocated because the frame pool was exhausted. */
+    uint64_t framePoolOverflows{0};
+};
 
 /*! \brief Class defining a RTSP stream processor. */
 class IpFreelyStreamProcessor final
 {
+    /*! \brief Typedef to a video frame and the time it was captured. */
+    typedef std::pair<std::chrono::steady_clock::time_point, cv::Mat> timed_frame_t;
+
 public:
     /*!
      * \brief IpFreelyStreamProcessor constructor.
@@ -60,6 +174,11 @@ public:
      * \param[in] cameraDetails - Camera details we want to stream from.
      * \param[in] saveFolderPath - A local folder to save captured videos to.
      * \param[in] requiredFileDurationSecs - Duration to use for captured video files.
+     * \param[in] motionWorkerPool - The worker pool, shared by all cameras, used for motion
+     * detection.
+     * \param[in] recordingCatalog - The save folder's catalog, recorded files are added to it.
+     * \param[in] deletionQueue - (Optional) The save folder's deletion queue, paused while the
+     * recording writer falls behind.
      * \param[in] recordingSchedule - (Optional) The daily/hourly recording schedule.
      * \param[in] motionSchedule - (Optional) The daily/hourly motion detector schedule.
      *
@@ -68,10 +187,13 @@ public:
      * duration. One recording session can span multiple back-to-back video files.
      */
     IpFreelyStreamProcessor(std::string const& name, IpCamera const& cameraDetails,
-                            std::string const&                    saveFolderPath,
-                            double const                          requiredFileDurationSecs,
-                            std::vector<std::vector<bool>> const& recordingSchedule = {},
-                            std::vector<std::vector<bool>> const& motionSchedule    = {});
+                            std::string const&                         saveFolderPath,
+                            double const                               requiredFileDurationSecs,
+                            std::shared_ptr<IpFreelyWorkerPool> const&       motionWorkerPool,
+                            std::shared_ptr<IpFreelyRecordingCatalog> const& recordingCatalog,
+                            std::shared_ptr<IpFreelyDeletionQueue> const&    deletionQueue,
+                            std::vector<std::vector<bool>> const&            recordingSchedule = {},
+                            std::vector<std::vector<bool>> const&            motionSchedule = {});
 
     /*! \brief IpFreelyStreamProcessor destructor. */
     ~IpFreelyStreamProcessor() = default;
@@ -94,11 +216,34 @@ public:
      */
     bool VideoWritingEnabled() const noexcept;
 
-    /*!c
-     * \brief VideoFrameUpdated monitors stream activity.
-     * \return A flag denoting if the captured videdo stream is being updated.
+    /*!
+     * \brief RegisterDisplaySize asks for display frames scaled to fit a display.
+     * \param[in] displayId - The caller's ID for the display, also used to update its size.
+     * \param[in] size - The display's size.
+     * \param[in] enlarge - (Optional) Enlarge frames smaller than the display, else only shrink
+     * frames too big for it.
+     *
+     * Scaling and conversion to RGB are done on the stream processor's thread, the display
+     * frames are then published in the snapshots keyed on the display's ID.
      */
-    bool VideoFrameUpdated() const noexcept;
+    void RegisterDisplaySize(int const displayId, QSize const& size, bool const enlarge = true);
+
+    /*!
+     * \brief UnregisterDisplaySize stops display frames being produced for a display.
+     * \param[in] displayId - The display's ID.
+     */
+    void UnregisterDisplaySize(int const displayId);
+
+    /*!
+     * \brief CurrentSnapshot gives access to the latest published display state.
+     * \param[out] snapshot - The frame, motion rectangle, recording state and FPS, all taken at
+     * the same time.
+     * \return False if no frame has been published yet, true otherwise.
+     *
+     * This never waits for the stream processor's threads but must only ever be called from one
+     * thread, normally the GUI thread.
+     */
+    bool CurrentSnapshot(VideoSnapshot& snapshot) const;
 
     /*!
      * \brief GetAspectRatioAndSize return s the aspect ratio.
@@ -112,6 +257,8 @@ public:
      * \brief CurrentVideoFrame gives acces to current video frame.
      * \param[out] motionRectangle - (Optional) Used to get motion bounding rect.
      * \return A QImage of the current video frame at full stream resolution.
+     *
+     * Like CurrentSnapshot this must only ever be called from one thread.
      */
     QImage CurrentVideoFrame(QRect* motionRectangle = nullptr) const;
 
@@ -127,28 +274,49 @@ public:
      */
     double CurrentFps() const noexcept;
 
+    /*!
+     * \brief GetCaptureStatistics gives access to the stream's frame capture statistics.
+     * \return The capture statistics, including per consumer frame drop counters.
+     */
+    CaptureStatistics GetCaptureStatistics() const noexcept;
+
 private:
     static bool IsScheduleEnabled(std::vector<std::vector<bool>> const& schedule);
     static bool VerifySchedule(std::string const&                    scheduleId,
                                std::vector<std::vector<bool>> const& schedule);
     void        ThreadEventCallback() noexcept;
+    void        CaptureThreadCallback() noexcept;
+    void        StartCaptureThread();
+    void        StopCaptureThread();
+    bool        CaptureVideoFrame(bool const decimate);
+    bool        FrameDecodeRequired();
+    void        UpdateRequiredDecodeFps();
+    void        UpdateFramePoolSize();
     void        SetEnableVideoWriting(bool enable) noexcept;
     bool        GetEnableVideoWriting() const noexcept;
     void        CheckRecordingSchedule();
-    void        CreateCaptureObjects();
-    void        GrabVideoFrame();
+    void        CreateRecordingSinks();
+    void        UpdateRecordingSinks();
+    void        BufferPreRollFrame(cv::Mat const&                               frame,
+                                   std::chrono::steady_clock::time_point const& timestamp);
+    void        ClearPreRollFrames() noexcept;
+    void        UpdateRecordingStatistics();
+    bool        GrabVideoFrame();
+    void        ScaleDisplayFrames();
+    void        PublishSnapshot();
     void        WriteVideoFrame();
     bool        CheckMotionSchedule() const;
     void        InitialiseMotionDetector();
+    void        CreateMotionDetector();
     void        CheckMotionDetector();
+    void        UpdateLumaDecoder();
     void        CreateVideoCapture();
     bool        ComputeFps();
     void        CheckFps();
 
 private:
     mutable std::mutex                              m_writingMutex{};
-    mutable std::mutex                              m_frameMutex{};
-    mutable std::mutex                              m_motionMutex{};
+    mutable std::mutex                              m_displaySizesMutex{};
     std::string                                     m_name{"cam"};
     IpCamera                                        m_cameraDetails{};
     std::string                                     m_saveFolderPath{};
@@ -164,14 +332,63 @@ private:
     int                                             m_videoWidth{0};
     int                                             m_videoHeight{0};
     cv::Ptr<cv::VideoCapture>                       m_videoCapture{};
+    IpFreelyFrameRing                               m_frameRing;
+    IpFreelyFramePool                               m_framePool;
+    cv::Size                                        m_captureFrameSize{};
+    int                                             m_captureFrameType{CV_8UC3};
     cv::Mat                                         m_videoFrame{};
-    QImage                                          m_currentFrame{};
+    cv::Mat                                         m_displayFrame{};
+    cv::Mat                                         m_motionFrame{};
+    uint64_t                                        m_displaySequence{0};
+    uint64_t                                        m_motionSequence{0};
+    uint64_t                                        m_recordingSequence{0};
+    std::atomic<uint64_t>                           m_displayFramesSkipped{0};
+    std::atomic<uint64_t>                           m_motionFramesSkipped{0};
+    std::atomic<uint64_t>                           m_recordingFramesSkipped{0};
+    std::atomic<double>                             m_detectedFps{0.0};
+    std::atomic<size_t>                             m_motionQueueDepth{0};
+    std::atomic<uint64_t>                           m_motionFramesDropped{0};
+    std::atomic<double>                             m_motionLatencyMillisecs{0.0};
+    std::atomic<double>                             m_motionEngineMillisecs{0.0};
+    std::atomic<double>                             m_motionAnalysisFps{0.0};
+    std::chrono::steady_clock::duration             m_motionFramePeriod{};
+    std::chrono::steady_clock::time_point           m_nextMotionFrameTime{};
+    std::atomic<bool>                               m_motionLumaDecode{false};
+    std::atomic<bool>                               m_motionFromVectors{false};
+    std::atomic<size_t>                             m_preRollBytes{0};
+    std::atomic<double>                             m_preRollSecs{0.0};
+    std::atomic<size_t>                             m_writerQueueDepth{0};
+    std::atomic<uint64_t>                           m_writerFramesDropped{0};
+    std::atomic<double>                             m_encodeMillisecs{0.0};
+    std::atomic<double>                             m_requiredDecodeFps{0.0};
+    std::atomic<uint64_t>                           m_framesGrabbed{0};
+    double                                          m_decodeCredit{1.0};
+    std::chrono::steady_clock::time_point           m_lastGrabTime{};
+    std::chrono::steady_clock::time_point           m_lastDisplayUpdate{};
+    std::map<int, std::pair<QSize, bool>>           m_displaySizes{};
+    std::map<int, QImage>                           m_displayImages{};
     QRect                                           m_motionRectangle{};
-    cv::Ptr<cv::VideoWriter>                        m_videoWriter{};
-    double                                          m_fileDurationSecs{0.0};
-    bool                                            m_videoFrameUpdated{false};
+    mutable IpFreelyTripleBuffer<VideoSnapshot>     m_snapshots{};
     time_t                                          m_currentTime{};
+    std::shared_ptr<IpFreelyWorkerPool>             m_motionWorkerPool;
+    std::shared_ptr<IpFreelyRecordingCatalog>       m_recordingCatalog;
+    std::shared_ptr<IpFreelyDeletionQueue>          m_deletionQueue;
     std::shared_ptr<IpFreelyMotionDetector>         m_motionDetector;
+    std::shared_ptr<IpFreelyPacketStream>           m_packetStream;
+    std::shared_ptr<IpFreelyPacketRelay>            m_packetRelay;
+    std::shared_ptr<IpFreelyLumaDecoder>            m_lumaDecoder;
+    bool                                            m_lumaDecoderFailed{false};
+    std::shared_ptr<IpFreelyVideoEncoder>           m_videoEncoder;
+    std::shared_ptr<IpFreelyRecordingWriter>        m_recordingWriter;
+    bool                                            m_encoding{false};
+    bool                                            m_continuousRecording{false};
+    bool                                            m_motionRecording{false};
+    std::deque<timed_frame_t>                       m_preRollFrames{};
+    size_t                                          m_preRollFrameBytes{0};
+    bool                                            m_preRollCapWarned{false};
+    std::shared_ptr<IpFreelyPacketRecorder>         m_packetRecorder;
+    std::shared_ptr<IpFreelyPacketRecorder>         m_motionPacketRecorder;
+    std::shared_ptr<core_lib::threads::EventThread> m_captureThread;
     std::shared_ptr<core_lib::threads::EventThread> m_eventThread;
 };
 
@@ -0,0 +1,112 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyTripleBuffer.h
+ * \brief File containing declaration of IpFreelyTripleBuffer template class.
+ */
+#ifndef IPFREELYTRIPLEBUFFER_H
+#define IPFREELYTRIPLEBUFFER_H
+
+#include <array>
+#include <atomic>
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+/*!
+ * \brief Template class defining a wait-free, single producer, single consumer triple buffer.
+ *
+ * The producer fills its write buffer and publishes it, the consumer picks up the most recently
+ * published buffer. Neither side ever waits for the other: the three buffers are only ever
+ * exchanged through a single atomic index, so the consumer always sees a complete value and
+ * values the consumer never picked up are simply overwritten.
+ */
+template <typename T> class IpFreelyTripleBuffer final
+{
+public:
+    /*! \brief IpFreelyTripleBuffer constructor. */
+    IpFreelyTripleBuffer() = default;
+
+    /*! \brief IpFreelyTripleBuffer destructor. */
+    ~IpFreelyTripleBuffer() = default;
+
+    /*! \brief IpFreelyTripleBuffer deleted copy constructor. */
+    IpFreelyTripleBuffer(IpFreelyTripleBuffer const&) = delete;
+
+    /*! \brief IpFreelyTripleBuffer deleted copy assignment operator. */
+    IpFreelyTripleBuffer& operator=(IpFreelyTripleBuffer const&) = delete;
+
+    /*!
+     * \brief WriteBuffer gives the producer access to the buffer it is filling.
+     * \return The write buffer, which still holds an older value.
+     */
+    T& WriteBuffer() noexcept
+    {
+        return m_buffers[m_writeIndex];
+    }
+
+    /*! \brief Publish makes the write buffer available to the consumer. */
+    void Publish() noexcept
+    {
+        auto previous =
+            m_sharedIndex.exchange(m_writeIndex | FRESH_FLAG, std::memory_order_acq_rel);
+        m_writeIndex = previous & INDEX_MASK;
+    }
+
+    /*!
+     * \brief Update gives the consumer the most recently published buffer, if it hasn't got it.
+     * \return True if a newly published buffer was picked up, false otherwise.
+     */
+    bool Update() noexcept
+    {
+        if ((m_sharedIndex.load(std::memory_order_relaxed) & FRESH_FLAG) == 0)
+        {
+            return false;
+        }
+
+        auto previous = m_sharedIndex.exchange(m_readIndex, std::memory_order_acq_rel);
+        m_readIndex   = previous & INDEX_MASK;
+        return true;
+    }
+
+    /*!
+     * \brief ReadBuffer gives the consumer access to the buffer it last picked up.
+     * \return The read buffer.
+     */
+    T const& ReadBuffer() const noexcept
+    {
+        return m_buffers[m_readIndex];
+    }
+
+private:
+    static constexpr unsigned int INDEX_MASK = 0x3;
+    static constexpr unsigned int FRESH_FLAG = 0x4;
+
+    std::array<T, 3>          m_buffers{};
+    unsigned int              m_writeIndex{0};
+    std::atomic<unsigned int> m_sharedIndex{1};
+    unsigned int              m_readIndex{2};
+};
+
+} // namespace ipfreely
+
+#endif // IPFREELYTRIPLEBUFFER_H
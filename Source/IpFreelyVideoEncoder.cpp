@@ -0,0 +1,194 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyVideoEncoder.cpp
+ * \brief File containing definition of IpFreelyVideoEncoder class.
+ */
+#include "IpFreelyVideoEncoder.h"
+#include <sstream>
+#include <mutex>
+#include <cmath>
+#include <algorithm>
+#include <boost/throw_exception.hpp>
+#include "DebugLog/DebugLogging.h"
+
+extern "C"
+{
+#include <libavcodec/avcodec.h>
+}
+
+namespace ipfreely
+{
+
+// Equivalent to XVID's default quality when recorded through cv::VideoWriter.
+static constexpr int ENCODER_QSCALE = 4;
+
+// MPEG-4 Part 2 limits the time base's denominator to 16 bits.
+static constexpr int MAX_TIME_BASE_DEN = 65535;
+
+IpFreelyVideoEncoder::IpFreelyVideoEncoder(std::string const& name, int const width,
+                                           int const height, double const fps)
+    : m_name(name)
+    // YUV 4:2:0 requires even dimensions.
+    , m_width(width & ~1)
+    , m_height(height & ~1)
+    , m_startTime(std::chrono::steady_clock::now())
+{
+#if LIBAVCODEC_VERSION_INT < AV_VERSION_INT(58, 10, 100)
+    static std::once_flag initFlag;
+    std::call_once(initFlag, []() { avcodec_register_all(); });
+#endif
+
+    auto codec = avcodec_find_encoder(AV_CODEC_ID_MPEG4);
+
+    if (!codec)
+    {
+        BOOST_THROW_EXCEPTION(std::runtime_error("MPEG-4 video encoder unavailable."));
+    }
+
+    m_codecCtx    = avcodec_alloc_context3(codec);
+    m_codecParams = avcodec_parameters_alloc();
+    m_frame       = av_frame_alloc();
+    m_packet      = av_packet_alloc();
+
+    if (!m_codecCtx || !m_codecParams || !m_frame || !m_packet)
+    {
+        Cleanup();
+        BOOST_THROW_EXCEPTION(std::runtime_error("Failed to allocate video encoder."));
+    }
+
+    m_codecCtx->width          = m_width;
+    m_codecCtx->height         = m_height;
+    m_codecCtx->pix_fmt        = AV_PIX_FMT_YUV420P;
+    m_codecCtx->time_base      = av_inv_q(av_d2q(fps, MAX_TIME_BASE_DEN));
+    m_codecCtx->gop_size       = std::max(1, static_cast<int>(std::lround(fps)));
+    m_codecCtx->max_b_frames   = 0;
+    m_codecCtx->flags         |= AV_CODEC_FLAG_QSCALE | AV_CODEC_FLAG_GLOBAL_HEADER;
+    m_codecCtx->global_quality = FF_QP2LAMBDA * ENCODER_QSCALE;
+
+    // Slice threading doesn't delay packets like frame threading.
+    m_codecCtx->thread_count = 0;
+    m_codecCtx->thread_type  = FF_THREAD_SLICE;
+
+    auto result = avcodec_open2(m_codecCtx, codec, nullptr);
+
+    if (result >= 0)
+    {
+        result = avcodec_parameters_from_context(m_codecParams, m_codecCtx);
+    }
+
+    if (result < 0)
+    {
+        Cleanup();
+        std::ostringstream oss;
+        oss << "Failed to open video encoder for camera: " << m_name;
+        BOOST_THROW_EXCEPTION(std::runtime_error(oss.str()));
+    }
+
+    m_frame->format = m_codecCtx->pix_fmt;
+    m_frame->width  = m_width;
+    m_frame->height = m_height;
+
+    DEBUG_MESSAGE_EX_INFO("Created video encoder for camera: " << m_name << ", size: " << m_width
+                                                               << "x" << m_height
+                                                               << ", FPS: " << fps);
+}
+
+IpFreelyVideoEncoder::~IpFreelyVideoEncoder()
+{
+    Cleanup();
+}
+
+void IpFreelyVideoEncoder::ForceKeyFrame() noexcept
+{
+    m_forceKeyFrame = true;
+}
+
+bool IpFreelyVideoEncoder::Encode(cv::Mat const&                               frame,
+                                  std::chrono::steady_clock::time_point const& timestamp)
+{
+    // Frame timestamps are in units of the encoder's frame interval so a frame that
+    // lands in the same interval as its predecessor exceeds the FPS and is skipped,
+    // while intervals without a frame are left as gaps for the muxer.
+    auto elapsedSecs = std::chrono::duration<double>(timestamp - m_startTime).count();
+    auto pts = static_cast<int64_t>(std::llround(elapsedSecs / av_q2d(m_codecCtx->time_base)));
+
+    if (pts <= m_lastPts)
+    {
+        return false;
+    }
+
+    auto const* source = &frame;
+
+    if ((frame.cols != m_width) || (frame.rows != m_height))
+    {
+        cv::resize(frame, m_resizedFrame, cv::Size(m_width, m_height));
+        source = &m_resizedFrame;
+    }
+
+    cv::cvtColor(*source, m_yuvFrame, cv::COLOR_BGR2YUV_I420);
+
+    // The I420 planes are contiguous, Y then U then V. The encoder
+    // copies the frame's pixels as they are not reference counted.
+    auto planeSize = m_width * m_height;
+
+    m_frame->data[0]     = m_yuvFrame.data;
+    m_frame->data[1]     = m_frame->data[0] + planeSize;
+    m_frame->data[2]     = m_frame->data[1] + (planeSize / 4);
+    m_frame->linesize[0] = m_width;
+    m_frame->linesize[1] = m_width / 2;
+    m_frame->linesize[2] = m_width / 2;
+    m_frame->quality     = m_codecCtx->global_quality;
+    m_frame->pict_type   = m_forceKeyFrame ? AV_PICTURE_TYPE_I : AV_PICTURE_TYPE_NONE;
+    m_forceKeyFrame      = false;
+    m_frame->pts         = pts;
+    m_lastPts            = pts;
+
+    auto result = avcodec_send_frame(m_codecCtx, m_frame);
+
+    if (result < 0)
+    {
+        DEBUG_MESSAGE_EX_ERROR("Failed to encode video frame for camera: " << m_name);
+        return false;
+    }
+
+    ReceivePackets();
+    return true;
+}
+
+void IpFreelyVideoEncoder::Cleanup() noexcept
+{
+    av_packet_free(&m_packet);
+    av_frame_free(&m_frame);
+    avcodec_parameters_free(&m_codecParams);
+    avcodec_free_context(&m_codecCtx);
+}
+
+void IpFreelyVideoEncoder::ReceivePackets()
+{
+    while (avcodec_receive_packet(m_codecCtx, m_packet) == 0)
+    {
+        DispatchPacket(*m_packet, *m_codecParams, m_codecCtx->time_base);
+        av_packet_unref(m_packet);
+    }
+}
+
+} // namespace ipfreely
@@ -0,0 +1,114 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyVideoEncoder.h
+ * \brief File containing declaration of IpFreelyVideoEncoder class.
+ */
+#ifndef IPFREELYVIDEOENCODER_H
+#define IPFREELYVIDEOENCODER_H
+
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <opencv2/opencv.hpp>
+#include "IpFreelyPacketSource.h"
+
+// Forward declarations.
+struct AVCodecContext;
+struct AVCodecParameters;
+struct AVFrame;
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+/*!
+ * \brief Class defining a camera's video encoder.
+ *
+ * The encoder compresses decoded video frames to MPEG-4 Part 2 (the format previously written
+ * through cv::VideoWriter as XVID/DIVX) and passes the resulting packets to its registered
+ * packet handlers. Frame timestamps are taken from the time each frame was captured so that gaps,
+ * where no frames were encoded, are preserved and recordings follow real elapsed time.
+ */
+class IpFreelyVideoEncoder final : public IpFreelyPacketSource
+{
+public:
+    /*!
+     * \brief IpFreelyVideoEncoder constructor.
+     * \param[in] name - A name for the encoder, used for logging.
+     * \param[in] width - The video's width.
+     * \param[in] height - The video's height.
+     * \param[in] fps - The video's FPS.
+     *
+     * Throws std::runtime_error if the encoder cannot be created.
+     */
+    IpFreelyVideoEncoder(std::string const& name, int const width, int const height,
+                         double const fps);
+
+    /*! \brief IpFreelyVideoEncoder destructor. */
+    ~IpFreelyVideoEncoder() override;
+
+    /*! \brief IpFreelyVideoEncoder deleted copy constructor. */
+    IpFreelyVideoEncoder(IpFreelyVideoEncoder const&) = delete;
+
+    /*! \brief IpFreelyVideoEncoder deleted copy assignment operator. */
+    IpFreelyVideoEncoder& operator=(IpFreelyVideoEncoder const&) = delete;
+
+    /*!
+     * \brief ForceKeyFrame makes the next encoded frame a keyframe.
+     *
+     * Used when encoding resumes so that newly started recordings can begin immediately.
+     */
+    void ForceKeyFrame() noexcept;
+
+    /*!
+     * \brief Encode compresses a video frame.
+     * \param[in] frame - The BGR video frame.
+     * \param[in] timestamp - The time the frame was captured.
+     * \return True if the frame was encoded, false if it was skipped or failed to encode.
+     *
+     * Frames captured within the same frame interval, at the encoder's FPS, as the previously
+     * encoded frame are skipped.
+     */
+    bool Encode(cv::Mat const& frame, std::chrono::steady_clock::time_point const& timestamp);
+
+private:
+    void Cleanup() noexcept;
+    void ReceivePackets();
+
+private:
+    std::string                           m_name{"cam"};
+    int                                   m_width{0};
+    int                                   m_height{0};
+    AVCodecContext*                       m_codecCtx{nullptr};
+    AVCodecParameters*                    m_codecParams{nullptr};
+    AVFrame*                              m_frame{nullptr};
+    AVPacket*                             m_packet{nullptr};
+    std::chrono::steady_clock::time_point m_startTime{};
+    int64_t                               m_lastPts{-1};
+    bool                                  m_forceKeyFrame{true};
+    cv::Mat                               m_resizedFrame{};
+    cv::Mat                               m_yuvFrame{};
+};
+
+} // namespace ipfreely
+
+#endif // IPFREELYVIDEOENCODER_H
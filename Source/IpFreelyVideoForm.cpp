@@ -54,7 +54,8 @@ IpFreelyVideoForm::~IpFreelyVideoForm()
     delete ui;
 }
 
-void IpFreelyVideoForm::SetVideoFrame(QImage const& videoFrame, double fps, double originalFps,
+void IpFreelyVideoForm::SetVideoFrame(QImage const& videoFrame, QSize const& originalSize,
+                                      double fps, double originalFps,
                                       QRect const& motionBoundingRect, bool streamBeingWritten,
                                       regions_t const& motionRegions)
 {
@@ -62,8 +63,13 @@ void IpFreelyVideoForm::SetVideoFrame(QImage const& videoFrame, double fps, doub
                  QString::number(originalFps) + tr(" Stream FPS");
     setWindowTitle(title);
 
+    if (originalSize.isEmpty())
+    {
+        return;
+    }
+
     double frameAspectRatio =
-        static_cast<double>(videoFrame.width()) / static_cast<double>(videoFrame.height());
+        static_cast<double>(originalSize.width()) / static_cast<double>(originalSize.height());
 
     if (m_resetSize)
     {
@@ -76,13 +82,13 @@ void IpFreelyVideoForm::SetVideoFrame(QImage const& videoFrame, double fps, doub
                                            (layout()->contentsMargins().top() +
                                             layout()->contentsMargins().bottom() + 2));
 
-        if (videoFrame.height() >= static_cast<int>(h))
+        if (originalSize.height() >= static_cast<int>(h))
         {
             w = h * frameAspectRatio;
         }
         else
         {
-            h = videoFrame.height() + layout()->contentsMargins().top() +
+            h = originalSize.height() + layout()->contentsMargins().top() +
                 layout()->contentsMargins().bottom() + 2;
             w = h * frameAspectRatio;
         }
@@ -91,13 +97,17 @@ void IpFreelyVideoForm::SetVideoFrame(QImage const& videoFrame, double fps, doub
         setMaximumSize(static_cast<int>(w), static_cast<int>(h));
     }
 
+    // Until the stream processor has picked up our size there's nothing to show.
+    if (videoFrame.isNull())
+    {
+        return;
+    }
+
+    // The video frame has already been scaled to fit the display.
     double scalar =
-        static_cast<double>(m_videoFrame->height()) / static_cast<double>(videoFrame.height());
+        static_cast<double>(videoFrame.height()) / static_cast<double>(originalSize.height());
 
-    auto resizedImage = videoFrame.scaled(m_videoFrame->width(),
-                                          m_videoFrame->height(),
-                                          Qt::KeepAspectRatio,
-                                          Qt::SmoothTransformation);
+    auto resizedImage = videoFrame;
 
     QPainter p(&resizedImage);
     auto     rect                   = motionBoundingRect;
@@ -159,6 +169,11 @@ void IpFreelyVideoForm::SetVideoFrame(QImage const& videoFrame, double fps, doub
     m_videoFrame->setPixmap(QPixmap::fromImage(resizedImage));
 }
 
+QSize IpFreelyVideoForm::VideoFrameSize() const
+{
+    return m_videoFrame->size();
+}
+
 void IpFreelyVideoForm::SetTitle(QString const& title)
 {
     m_title = title;
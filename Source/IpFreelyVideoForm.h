@@ -36,6 +36,7 @@ class IpFreelyVideoForm;
 } // namespace Ui
 
 class QImage;
+class QSize;
 class QShowEvent;
 class QLabel;
 
@@ -65,16 +66,23 @@ public:
 
     /*!
      * \brief SetVideoFrame sets the current frame of video in the display.
-     * \param[in] videoFrame - The frame of video to display.
+     * \param[in] videoFrame - The frame of video to display, already scaled to VideoFrameSize.
+     * \param[in] originalSize - The video stream's full resolution frame size.
      * \param[in] fps - The video stream's recording FPS.
      * \param[in] originalFps - The video stream's actual FPS.
      * \param[in] motionBoundingRect - The video stream's detected motion bounding rectangle.
      * \param[in] streamBeingWritten - The video stream is currently having data recorded.
      * \param[in] motionRegions - (Optional) The motion rectangles being monitored.
      */
-    void SetVideoFrame(QImage const& videoFrame, double fps, double originalFps,
-                       QRect const& motionBoundingRect, bool streamBeingWritten,
-                       regions_t const& motionRegions = {});
+    void SetVideoFrame(QImage const& videoFrame, QSize const& originalSize, double fps,
+                       double originalFps, QRect const& motionBoundingRect,
+                       bool streamBeingWritten, regions_t const& motionRegions = {});
+
+    /*!
+     * \brief VideoFrameSize gives the size video frames are displayed at.
+     * \return The size of the form's video display area.
+     */
+    QSize VideoFrameSize() const;
 
     /*!
      * \brief SetTitle sets title text of the form.
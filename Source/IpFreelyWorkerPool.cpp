@@ -0,0 +1,214 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyWorkerPool.cpp
+ * \brief File containing definition of IpFreelyWorkerPool class.
+ */
+#include "IpFreelyWorkerPool.h"
+#include <thread>
+#include <chrono>
+#include <algorithm>
+#include <boost/exception/all.hpp>
+#include "Threads/EventThread.h"
+#include "DebugLog/DebugLogging.h"
+
+namespace ipfreely
+{
+
+static constexpr unsigned int WORKER_THREAD_PERIOD_MS = 1;
+static constexpr unsigned int WORKER_WAIT_TIMEOUT_MS  = 100;
+
+/*! \brief Client's scheduling state. */
+enum class eClientState
+{
+    idle,
+    ready,
+    running
+};
+
+/*! \brief Structure holding a client's state, only accessed with the pool's mutex locked. */
+struct IpFreelyWorkerPool::Client final
+{
+    /*! \brief The client's work function. */
+    work_t work{};
+
+    /*! \brief The client's scheduling state. */
+    eClientState state{eClientState::idle};
+
+    /*! \brief Flag to show more work arrived while the client was running. */
+    bool notified{false};
+
+    /*! \brief Flag to show the client has been removed. */
+    bool removed{false};
+};
+
+IpFreelyWorkerPool::IpFreelyWorkerPool(std::string const& name, size_t const numThreads)
+    : m_name(name)
+{
+    auto threadCount = numThreads;
+
+    if (threadCount == 0)
+    {
+        threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+    }
+
+    DEBUG_MESSAGE_EX_INFO("Creating worker pool: " << m_name << ", threads: " << threadCount);
+
+    for (size_t i = 0; i < threadCount; ++i)
+    {
+        m_workerThreads.emplace_back(std::make_shared<core_lib::threads::EventThread>(
+            std::bind(&IpFreelyWorkerPool::ThreadEventCallback, this), WORKER_THREAD_PERIOD_MS));
+    }
+}
+
+IpFreelyWorkerPool::~IpFreelyWorkerPool()
+{
+    // Stop the threads before releasing any clients.
+    m_workerThreads.clear();
+}
+
+IpFreelyWorkerPool::client_t IpFreelyWorkerPool::AddClient(work_t const& work)
+{
+    auto client  = std::make_shared<Client>();
+    client->work = work;
+    return client;
+}
+
+void IpFreelyWorkerPool::Notify(client_t const& client)
+{
+    {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        if (client->removed)
+        {
+            return;
+        }
+
+        switch (client->state)
+        {
+        case eClientState::idle:
+            client->state = eClientState::ready;
+            m_readyClients.push_back(client);
+            break;
+        case eClientState::running:
+            // Rescheduled once its current work is done so that
+            // it never runs on two worker threads at once.
+            client->notified = true;
+            return;
+        case eClientState::ready:
+            return;
+        }
+    }
+
+    m_workReady.notify_one();
+}
+
+void IpFreelyWorkerPool::RemoveClient(client_t const& client)
+{
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    client->removed = true;
+
+    m_readyClients.erase(std::remove(m_readyClients.begin(), m_readyClients.end(), client),
+                         m_readyClients.end());
+
+    m_workDone.wait(lock, [&client]() { return client->state != eClientState::running; });
+
+    client->state = eClientState::idle;
+}
+
+size_t IpFreelyWorkerPool::NumThreads() const noexcept
+{
+    return m_workerThreads.size();
+}
+
+void IpFreelyWorkerPool::ThreadEventCallback() noexcept
+{
+    try
+    {
+        client_t client;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+
+            if (!m_workReady.wait_for(lock,
+                                      std::chrono::milliseconds(WORKER_WAIT_TIMEOUT_MS),
+                                      [this]() { return !m_readyClients.empty(); }))
+            {
+                return;
+            }
+
+            client = m_readyClients.front();
+            m_readyClients.pop_front();
+            client->state    = eClientState::running;
+            client->notified = false;
+        }
+
+        // Do one unit of work only, if the client has more work waiting
+        // it goes to the back of the queue behind the other clients.
+        bool moreWork = false;
+
+        try
+        {
+            moreWork = client->work();
+        }
+        catch (...)
+        {
+            auto exceptionMsg = boost::current_exception_diagnostic_information();
+            DEBUG_MESSAGE_EX_ERROR(exceptionMsg);
+        }
+
+        bool reschedule = false;
+
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+
+            if (client->removed)
+            {
+                client->state = eClientState::idle;
+            }
+            else if (moreWork || client->notified)
+            {
+                client->state = eClientState::ready;
+                m_readyClients.push_back(client);
+                reschedule = true;
+            }
+            else
+            {
+                client->state = eClientState::idle;
+            }
+        }
+
+        m_workDone.notify_all();
+
+        if (reschedule)
+        {
+            m_workReady.notify_one();
+        }
+    }
+    catch (...)
+    {
+        auto exceptionMsg = boost::current_exception_diagnostic_information();
+        DEBUG_MESSAGE_EX_ERROR(exceptionMsg);
+    }
+}
+
+} // namespace ipfreely
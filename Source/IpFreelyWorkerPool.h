@@ -0,0 +1,128 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyWorkerPool.h
+ * \brief File containing declaration of IpFreelyWorkerPool class.
+ */
+#ifndef IPFREELYWORKERPOOL_H
+#define IPFREELYWORKERPOOL_H
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <functional>
+#include <condition_variable>
+
+namespace core_lib
+{
+namespace threads
+{
+
+class EventThread;
+
+} // namespace threads
+} // namespace core_lib
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+/*!
+ * \brief Class defining a pool of worker threads shared by many clients, e.g. one per camera.
+ *
+ * Each client's work is done one unit at a time and never on more than one thread at once, so
+ * a client's work is always done in order. Clients with work waiting take turns in a round-robin
+ * so a client whose units of work take much longer than others, such as a 4K camera's motion
+ * detector, cannot starve them.
+ */
+class IpFreelyWorkerPool final
+{
+    /*! \brief Forward declaration of client state structure. */
+    struct Client;
+
+public:
+    /*! \brief Typedef to a client's work function, returns true if more work is waiting. */
+    typedef std::function<bool()> work_t;
+
+    /*! \brief Typedef to a client handle. */
+    typedef std::shared_ptr<Client> client_t;
+
+    /*!
+     * \brief IpFreelyWorkerPool constructor.
+     * \param[in] name - A name for the pool, used for logging.
+     * \param[in] numThreads - (Optional) Number of worker threads, 0 means one per CPU core.
+     */
+    explicit IpFreelyWorkerPool(std::string const& name, size_t const numThreads = 0);
+
+    /*! \brief IpFreelyWorkerPool destructor. */
+    ~IpFreelyWorkerPool();
+
+    /*! \brief IpFreelyWorkerPool deleted copy constructor. */
+    IpFreelyWorkerPool(IpFreelyWorkerPool const&) = delete;
+
+    /*! \brief IpFreelyWorkerPool deleted copy assignment operator. */
+    IpFreelyWorkerPool& operator=(IpFreelyWorkerPool const&) = delete;
+
+    /*!
+     * \brief AddClient adds a client to the pool.
+     * \param[in] work - The client's work function, which does one unit of work.
+     * \return The client's handle.
+     */
+    client_t AddClient(work_t const& work);
+
+    /*!
+     * \brief Notify tells the pool that a client has work waiting.
+     * \param[in] client - The client's handle.
+     */
+    void Notify(client_t const& client);
+
+    /*!
+     * \brief RemoveClient removes a client from the pool.
+     * \param[in] client - The client's handle.
+     *
+     * Waits for any work in progress for the client to finish, after which its work function is
+     * never called again. Must not be called from the client's own work function.
+     */
+    void RemoveClient(client_t const& client);
+
+    /*!
+     * \brief NumThreads reports the number of worker threads.
+     * \return The number of threads.
+     */
+    size_t NumThreads() const noexcept;
+
+private:
+    void ThreadEventCallback() noexcept;
+
+private:
+    mutable std::mutex                                           m_mutex{};
+    std::condition_variable                                      m_workReady{};
+    std::condition_variable                                      m_workDone{};
+    std::string                                                  m_name{"pool"};
+    std::deque<client_t>                                         m_readyClients{};
+    std::vector<std::shared_ptr<core_lib::threads::EventThread>> m_workerThreads{};
+};
+
+} // namespace ipfreely
+
+#endif // IPFREELYWORKERPOOL_H
@@ -0,0 +1,233 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyWriteRateModel.cpp
+ * \brief File containing definition of IpFreelyWriteRateModel class.
+ */
+#include "IpFreelyWriteRateModel.h"
+#include <algorithm>
+#include "IpFreelyRecordingCatalog.h"
+
+namespace ipfreely
+{
+
+static constexpr time_t SECS_IN_HOUR        = 3600;
+static constexpr time_t LEARN_DELAY_SECS    = 3600;
+static constexpr int    MAX_LEARN_DAYS      = 7;
+static constexpr double DAILY_LEARNING_RATE = 0.3;
+static constexpr eCamId CAMERA_IDS[]        = {
+    eCamId::cam1, eCamId::cam2, eCamId::cam3, eCamId::cam4};
+
+namespace utils
+{
+
+inline int HourOfDay(time_t const time)
+{
+    return std::localtime(&time)->tm_hour;
+}
+
+inline time_t HourStart(time_t const time)
+{
+    // Local hours, which are not whole UTC hours in every time zone.
+    auto localTime    = *std::localtime(&time);
+    localTime.tm_min  = 0;
+    localTime.tm_sec  = 0;
+    return std::mktime(&localTime);
+}
+
+} // namespace utils
+
+void IpFreelyWriteRateModel::Update(IpFreelyRecordingCatalog const& catalog, time_t const now)
+{
+    if (m_nextHourStart == 0)
+    {
+        m_nextHourStart = utils::HourStart(now - MAX_LEARN_DAYS * 24 * SECS_IN_HOUR);
+    }
+
+    // Recordings are only catalogued once closed so give them time to finish.
+    while (m_nextHourStart + SECS_IN_HOUR + LEARN_DELAY_SECS <= now)
+    {
+        LearnHour(catalog, m_nextHourStart);
+        m_nextHourStart += SECS_IN_HOUR;
+    }
+}
+
+double IpFreelyWriteRateModel::BytesPerHour(int const hourOfDay, eCamId const camId) const
+{
+    double bytes = 0.0;
+
+    for (auto const& camera : m_hourlyBytes)
+    {
+        if ((camId != eCamId::noCam) && (camera.first != camId))
+        {
+            continue;
+        }
+
+        auto const& hourlyBytes = camera.second;
+
+        if (hourlyBytes[hourOfDay] >= 0.0)
+        {
+            bytes += hourlyBytes[hourOfDay];
+            continue;
+        }
+
+        // Not seen this hour yet so assume the camera's average over the hours it has been seen.
+        double seenBytes = 0.0;
+        int    seenHours = 0;
+
+        for (auto const hourBytes : hourlyBytes)
+        {
+            if (hourBytes >= 0.0)
+            {
+                seenBytes += hourBytes;
+                ++seenHours;
+            }
+        }
+
+        bytes += seenBytes / static_cast<double>(std::max(seenHours, 1));
+    }
+
+    return bytes;
+}
+
+double IpFreelyWriteRateModel::BytesPerDay(eCamId const camId) const
+{
+    double bytes = 0.0;
+
+    for (int hour = 0; hour < 24; ++hour)
+    {
+        bytes += BytesPerHour(hour, camId);
+    }
+
+    return bytes;
+}
+
+double IpFreelyWriteRateModel::ForecastBytes(time_t const from, int const hours) const
+{
+    double bytes = 0.0;
+
+    for (int hour = 0; hour < hours; ++hour)
+    {
+        bytes += BytesPerHour(utils::HourOfDay(from + hour * SECS_IN_HOUR));
+    }
+
+    return bytes;
+}
+
+double IpFreelyWriteRateModel::HoursToRecord(time_t const from, double const bytes,
+                                             int const maxHours) const
+{
+    if (bytes <= 0.0)
+    {
+        return 0.0;
+    }
+
+    double recordedBytes = 0.0;
+
+    for (int hour = 0; hour < maxHours; ++hour)
+    {
+        auto const hourBytes = BytesPerHour(utils::HourOfDay(from + hour * SECS_IN_HOUR));
+
+        if (recordedBytes + hourBytes >= bytes)
+        {
+            return static_cast<double>(hour) + (bytes - recordedBytes) / hourBytes;
+        }
+
+        recordedBytes += hourBytes;
+    }
+
+    return static_cast<double>(maxHours);
+}
+
+void IpFreelyWriteRateModel::LearnHour(IpFreelyRecordingCatalog const& catalog,
+                                       time_t const                    hourStart)
+{
+    auto const fromMillisecs = static_cast<int64_t>(hourStart) * 1000;
+    auto const toMillisecs   = fromMillisecs + static_cast<int64_t>(SECS_IN_HOUR) * 1000;
+
+    std::map<eCamId, double> cameraBytes;
+
+    // Share each recording's bytes between the hours it spans.
+    for (auto const& entry : catalog.FindRecordings(fromMillisecs, toMillisecs - 1))
+    {
+        auto const durationMillisecs = entry.endMillisecs - entry.startMillisecs;
+
+        if (durationMillisecs <= 0)
+        {
+            if (entry.startMillisecs >= fromMillisecs)
+            {
+                cameraBytes[entry.camId] += static_cast<double>(entry.bytes);
+            }
+
+            continue;
+        }
+
+        auto const overlapMillisecs = std::min(entry.endMillisecs, toMillisecs) -
+                                      std::max(entry.startMillisecs, fromMillisecs);
+
+        if (overlapMillisecs > 0)
+        {
+            cameraBytes[entry.camId] += static_cast<double>(entry.bytes) *
+                                        static_cast<double>(overlapMillisecs) /
+                                        static_cast<double>(durationMillisecs);
+        }
+    }
+
+    auto const hourOfDay = utils::HourOfDay(hourStart);
+
+    for (auto const camId : CAMERA_IDS)
+    {
+        auto bytesIt  = cameraBytes.find(camId);
+        auto cameraIt = m_hourlyBytes.find(camId);
+
+        // Only learn quiet hours for a camera once it has recorded something.
+        if (bytesIt == cameraBytes.end())
+        {
+            if (cameraIt == m_hourlyBytes.end())
+            {
+                continue;
+            }
+
+            cameraBytes[camId] = 0.0;
+            bytesIt            = cameraBytes.find(camId);
+        }
+
+        if (cameraIt == m_hourlyBytes.end())
+        {
+            hourly_bytes_t unseen;
+            unseen.fill(-1.0);
+            cameraIt = m_hourlyBytes.emplace(camId, unseen).first;
+        }
+
+        auto& hourBytes = cameraIt->second[hourOfDay];
+
+        if (hourBytes < 0.0)
+        {
+            hourBytes = bytesIt->second;
+        }
+        else
+        {
+            hourBytes += DAILY_LEARNING_RATE * (bytesIt->second - hourBytes);
+        }
+    }
+}
+
+} // namespace ipfreely
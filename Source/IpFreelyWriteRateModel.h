@@ -0,0 +1,118 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file IpFreelyWriteRateModel.h
+ * \brief File containing declaration of IpFreelyWriteRateModel class.
+ */
+#ifndef IPFREELYWRITERATEMODEL_H
+#define IPFREELYWRITERATEMODEL_H
+
+#include <map>
+#include <array>
+#include <ctime>
+#include <cstdint>
+#include "IpFreelyCameraDatabase.h"
+
+/*! \brief The ipfreely namespace. */
+namespace ipfreely
+{
+
+class IpFreelyRecordingCatalog;
+
+/*!
+ * \brief Class defining a model of the bytes each camera records in each hour of the day.
+ *
+ * The model learns from the recordings in the catalog, sharing each recording's bytes between
+ * the local hours it spans. Each hour of the day keeps an exponential moving average over the
+ * days seen, so a daily pattern, such as more motion in the day or scheduled recording, is
+ * forecast too. An hour is only learned once its recordings should all have been finished and
+ * catalogued.
+ */
+class IpFreelyWriteRateModel final
+{
+public:
+    /*! \brief IpFreelyWriteRateModel default constructor. */
+    IpFreelyWriteRateModel() = default;
+
+    /*! \brief IpFreelyWriteRateModel default destructor. */
+    ~IpFreelyWriteRateModel() = default;
+
+    /*! \brief IpFreelyWriteRateModel default copy constructor. */
+    IpFreelyWriteRateModel(IpFreelyWriteRateModel const&) = default;
+
+    /*! \brief IpFreelyWriteRateModel default copy assignment operator. */
+    IpFreelyWriteRateModel& operator=(IpFreelyWriteRateModel const&) = default;
+
+    /*!
+     * \brief Update learns from the hours finished since the last update.
+     * \param[in] catalog - The catalog of recordings.
+     * \param[in] now - The current time.
+     *
+     * The first update learns from up to a week of recordings already in the catalog.
+     */
+    void Update(IpFreelyRecordingCatalog const& catalog, time_t const now);
+
+    /*!
+     * \brief BytesPerHour forecasts the bytes recorded in an hour of the day.
+     * \param[in] hourOfDay - The local hour of the day, 0 to 23.
+     * \param[in] camId - (Optional) Only forecast this camera's recordings.
+     * \return The number of bytes.
+     */
+    double BytesPerHour(int const hourOfDay, eCamId const camId = eCamId::noCam) const;
+
+    /*!
+     * \brief BytesPerDay forecasts the bytes recorded in a whole day.
+     * \param[in] camId - (Optional) Only forecast this camera's recordings.
+     * \return The number of bytes.
+     */
+    double BytesPerDay(eCamId const camId = eCamId::noCam) const;
+
+    /*!
+     * \brief ForecastBytes forecasts the bytes recorded over the coming hours.
+     * \param[in] from - The time to forecast from.
+     * \param[in] hours - The number of hours to forecast.
+     * \return The number of bytes.
+     */
+    double ForecastBytes(time_t const from, int const hours) const;
+
+    /*!
+     * \brief HoursToRecord forecasts how long it takes to record a number of bytes.
+     * \param[in] from - The time to forecast from.
+     * \param[in] bytes - The number of bytes.
+     * \param[in] maxHours - The furthest to forecast ahead.
+     * \return The number of hours, or maxHours if it takes longer.
+     */
+    double HoursToRecord(time_t const from, double const bytes, int const maxHours) const;
+
+private:
+    /*! \brief Typedef to a camera's average bytes in each hour of the day, negative if unseen. */
+    typedef std::array<double, 24> hourly_bytes_t;
+
+    void LearnHour(IpFreelyRecordingCatalog const& catalog, time_t const hourStart);
+
+private:
+    std::map<eCamId, hourly_bytes_t> m_hourlyBytes{};
+    time_t                           m_nextHourStart{0};
+};
+
+} // namespace ipfreely
+
+#endif // IPFREELYWRITERATEMODEL_H
@@ -0,0 +1,49 @@
+#-------------------------------------------------
+#
+# Micro-benchmark comparing the fused motion kernel
+# against the reference OpenCV implementation.
+#
+#-------------------------------------------------
+
+QT       -= core gui
+
+TARGET = MotionKernelBenchmark
+TEMPLATE = app
+
+CONFIG += console c++14
+CONFIG -= app_bundle
+
+INCLUDEPATH += $$PWD/../..
+
+win32 {
+    DEFINES += _CRT_SECURE_NO_WARNINGS=1
+
+    INCLUDEPATH += $$(OPENCV_DIR)/../../include \
+        $$(THIRD_PARTY_LIBS)
+
+    CONFIG(debug, debug|release) {
+      LIBS += -L$$(OPENCV_DIR)/lib \
+              -lopencv_world340d
+    } else {
+      LIBS += -L$$(OPENCV_DIR)/lib \
+              -lopencv_world340
+    }
+}
+else {
+    QMAKE_CXXFLAGS += -std=c++14
+
+    INCLUDEPATH += /usr/include/opencv4
+
+    LIBS += -L/usr/lib   \
+            -lopencv_core      \
+            -lopencv_imgproc
+}
+
+SOURCES += \
+    main.cpp \
+    ../../IpFreelyMotionKernel.cpp \
+    ../../IpFreelyMotionBlobs.cpp
+
+HEADERS += \
+    ../../IpFreelyMotionKernel.h \
+    ../../IpFreelyMotionBlobs.h
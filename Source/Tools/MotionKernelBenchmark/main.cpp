@@ -0,0 +1,322 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+/*!
+ * \file main.cpp
+ * \brief File containing the motion kernel micro-benchmark.
+ *
+ * Checks FusedMotionKernel gives identical results to ReferenceMotionKernel
+ * on a set of frames, with both a single threshold and a threshold map, then
+ * times both over a range of frame sizes. Also checks IpFreelyMotionBlobs finds
+ * the same blobs as cv::connectedComponentsWithStats in the motion masks and
+ * times both.
+ */
+#include <chrono>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+#include <algorithm>
+#include <functional>
+#include <tuple>
+#include "IpFreelyMotionKernel.h"
+#include "IpFreelyMotionBlobs.h"
+
+namespace
+{
+
+static constexpr int     BENCHMARK_ITERATIONS = 200;
+static constexpr int     BLOCK_SIZE           = 64;
+static constexpr double  PIXEL_THRESHOLD      = 20.0;
+static constexpr uint8_t MASKED_THRESHOLD     = 255;
+
+/*! \brief Typedef to a motion kernel function. */
+typedef std::function<void(cv::Mat const&, cv::Mat const&, cv::Mat const&, double const,
+                           ipfreely::MotionKernelResult&, cv::Mat*)>
+    kernel_t;
+
+// The kernels are overloaded so wrap the single threshold versions for TimeKernel.
+void FusedKernel(cv::Mat const& prev, cv::Mat const& current, cv::Mat const& next,
+                 double const pixelThreshold, ipfreely::MotionKernelResult& result,
+                 cv::Mat* motionMask)
+{
+    ipfreely::FusedMotionKernel(prev, current, next, pixelThreshold, result, motionMask);
+}
+
+void ReferenceKernel(cv::Mat const& prev, cv::Mat const& current, cv::Mat const& next,
+                     double const pixelThreshold, ipfreely::MotionKernelResult& result,
+                     cv::Mat* motionMask)
+{
+    ipfreely::ReferenceMotionKernel(prev, current, next, pixelThreshold, result, motionMask);
+}
+
+/*! \brief Structure holding three consecutive grey frames. */
+struct FrameSet final
+{
+    cv::Mat prev;
+    cv::Mat current;
+    cv::Mat next;
+};
+
+FrameSet MakeFrames(int const rows, int const cols, int const seed)
+{
+    cv::theRNG().state = static_cast<uint64_t>(seed);
+
+    // Mild noise everywhere plus a block moving across the frame.
+    FrameSet frames;
+    std::vector<cv::Mat*> frameList{&frames.prev, &frames.current, &frames.next};
+
+    for (size_t i = 0; i < frameList.size(); ++i)
+    {
+        auto& frame = *frameList[i];
+        frame.create(rows, cols, CV_8UC1);
+        cv::randn(frame, cv::Scalar(128), cv::Scalar(12));
+
+        auto x = std::min(static_cast<int>(i) * BLOCK_SIZE / 2 + cols / 4, cols - 1);
+        auto y = rows / 4;
+        cv::rectangle(frame,
+                      cv::Rect(x, y, BLOCK_SIZE, BLOCK_SIZE),
+                      cv::Scalar(255),
+                      cv::FILLED);
+    }
+
+    return frames;
+}
+
+cv::Mat MakeThresholdMap(int const rows, int const cols, double const pixelThreshold)
+{
+    // Masked out everywhere apart from two overlapping regions with their own thresholds.
+    cv::Mat thresholdMap(rows, cols, CV_8UC1, cv::Scalar(MASKED_THRESHOLD));
+    thresholdMap(cv::Rect(cols / 8, rows / 8, cols / 2, rows / 2))
+        .setTo(cv::Scalar(cv::saturate_cast<uint8_t>(pixelThreshold)));
+    thresholdMap(cv::Rect(cols / 3, rows / 3, cols / 2, rows / 2))
+        .setTo(cv::Scalar(cv::saturate_cast<uint8_t>(pixelThreshold / 2.0)));
+    return thresholdMap;
+}
+
+bool ResultsMatch(ipfreely::MotionKernelResult const& fused,
+                  ipfreely::MotionKernelResult const& reference, cv::Mat const& fusedMask,
+                  cv::Mat const& referenceMask)
+{
+    return (fused.stdDev == reference.stdDev) && (fused.changesFound == reference.changesFound) &&
+           (fused.minX == reference.minX) && (fused.maxX == reference.maxX) &&
+           (fused.minY == reference.minY) && (fused.maxY == reference.maxY) &&
+           (cv::countNonZero(fusedMask != referenceMask) == 0);
+}
+
+bool ResultsMatch(FrameSet const& frames, double const pixelThreshold)
+{
+    ipfreely::MotionKernelResult fused;
+    ipfreely::MotionKernelResult reference;
+    cv::Mat                      fusedMask;
+    cv::Mat                      referenceMask;
+
+    ipfreely::FusedMotionKernel(
+        frames.prev, frames.current, frames.next, pixelThreshold, fused, &fusedMask);
+    ipfreely::ReferenceMotionKernel(
+        frames.prev, frames.current, frames.next, pixelThreshold, reference, &referenceMask);
+
+    return ResultsMatch(fused, reference, fusedMask, referenceMask);
+}
+
+bool MapResultsMatch(FrameSet const& frames, double const pixelThreshold)
+{
+    ipfreely::MotionKernelResult fused;
+    ipfreely::MotionKernelResult reference;
+    cv::Mat                      fusedMask;
+    cv::Mat                      referenceMask;
+
+    auto thresholdMap = MakeThresholdMap(frames.next.rows, frames.next.cols, pixelThreshold);
+
+    ipfreely::FusedMotionKernel(
+        frames.prev, frames.current, frames.next, thresholdMap, fused, &fusedMask);
+    ipfreely::ReferenceMotionKernel(
+        frames.prev, frames.current, frames.next, thresholdMap, reference, &referenceMask);
+
+    return ResultsMatch(fused, reference, fusedMask, referenceMask);
+}
+
+/*! \brief Typedef to a blob's bounds and pixel count. */
+typedef std::tuple<int, int, int, int, int> blob_t;
+
+std::vector<blob_t> LabellerBlobs(ipfreely::IpFreelyMotionBlobs& labeller, cv::Mat const& mask)
+{
+    std::vector<blob_t> blobs;
+
+    for (auto const& blob : labeller.FindBlobs(mask))
+    {
+        blobs.emplace_back(
+            blob.bounds.x, blob.bounds.y, blob.bounds.width, blob.bounds.height, blob.pixels);
+    }
+
+    std::sort(blobs.begin(), blobs.end());
+    return blobs;
+}
+
+std::vector<blob_t> OpenCvBlobs(cv::Mat const& mask)
+{
+    cv::Mat labels;
+    cv::Mat stats;
+    cv::Mat centroids;
+    auto    count = cv::connectedComponentsWithStats(mask, labels, stats, centroids, 8, CV_32S);
+
+    // Label 0 is the background.
+    std::vector<blob_t> blobs;
+
+    for (int i = 1; i < count; ++i)
+    {
+        blobs.emplace_back(stats.at<int>(i, cv::CC_STAT_LEFT),
+                           stats.at<int>(i, cv::CC_STAT_TOP),
+                           stats.at<int>(i, cv::CC_STAT_WIDTH),
+                           stats.at<int>(i, cv::CC_STAT_HEIGHT),
+                           stats.at<int>(i, cv::CC_STAT_AREA));
+    }
+
+    std::sort(blobs.begin(), blobs.end());
+    return blobs;
+}
+
+bool BlobsMatch(FrameSet const& frames, double const pixelThreshold)
+{
+    ipfreely::MotionKernelResult  result;
+    ipfreely::IpFreelyMotionBlobs labeller;
+    cv::Mat                       mask;
+
+    ipfreely::FusedMotionKernel(
+        frames.prev, frames.current, frames.next, pixelThreshold, result, &mask);
+
+    return LabellerBlobs(labeller, mask) == OpenCvBlobs(mask);
+}
+
+double TimeKernel(kernel_t const& kernel, FrameSet const& frames)
+{
+    ipfreely::MotionKernelResult result;
+
+    // Warm up caches and OpenCV's thread pool first.
+    kernel(frames.prev, frames.current, frames.next, PIXEL_THRESHOLD, result, nullptr);
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < BENCHMARK_ITERATIONS; ++i)
+    {
+        kernel(frames.prev, frames.current, frames.next, PIXEL_THRESHOLD, result, nullptr);
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / BENCHMARK_ITERATIONS;
+}
+
+double TimeLabeller(cv::Mat const& mask, bool const openCv)
+{
+    ipfreely::IpFreelyMotionBlobs labeller;
+    cv::Mat                       labels;
+    cv::Mat                       stats;
+    cv::Mat                       centroids;
+
+    auto start = std::chrono::steady_clock::now();
+
+    for (int i = 0; i < BENCHMARK_ITERATIONS; ++i)
+    {
+        if (openCv)
+        {
+            cv::connectedComponentsWithStats(mask, labels, stats, centroids, 8, CV_32S);
+        }
+        else
+        {
+            labeller.FindBlobs(mask);
+        }
+    }
+
+    std::chrono::duration<double, std::milli> elapsed = std::chrono::steady_clock::now() - start;
+    return elapsed.count() / BENCHMARK_ITERATIONS;
+}
+
+} // namespace
+
+int main()
+{
+    std::vector<cv::Size> sizes{{800, 600}, {1067, 600}, {1920, 1080}, {3840, 2160}, {333, 251}};
+    std::vector<double>   thresholds{-1.0, 0.0, 19.5, 20.0, 254.0, 255.0};
+    bool                  allMatch = true;
+
+    for (auto const& size : sizes)
+    {
+        auto frames = MakeFrames(size.height, size.width, size.area());
+
+        for (auto threshold : thresholds)
+        {
+            if (!ResultsMatch(frames, threshold))
+            {
+                std::cout << "MISMATCH: " << size.width << "x" << size.height
+                          << ", threshold: " << threshold << std::endl;
+                allMatch = false;
+            }
+
+            if (!MapResultsMatch(frames, threshold))
+            {
+                std::cout << "MISMATCH: " << size.width << "x" << size.height
+                          << ", threshold map: " << threshold << std::endl;
+                allMatch = false;
+            }
+
+            if (!BlobsMatch(frames, threshold))
+            {
+                std::cout << "BLOB MISMATCH: " << size.width << "x" << size.height
+                          << ", threshold: " << threshold << std::endl;
+                allMatch = false;
+            }
+        }
+    }
+
+    std::cout << "Results " << (allMatch ? "identical" : "differ") << std::endl;
+
+    std::cout << std::fixed << std::setprecision(3);
+
+    for (auto const& size : sizes)
+    {
+        auto frames          = MakeFrames(size.height, size.width, 1);
+        auto referenceMillis = TimeKernel(ReferenceKernel, frames);
+        auto fusedMillis     = TimeKernel(FusedKernel, frames);
+
+        std::cout << std::setw(4) << size.width << "x" << std::setw(4) << std::left
+                  << size.height << std::right << " reference: " << referenceMillis
+                  << " ms, fused: " << fusedMillis
+                  << " ms, speed-up: " << referenceMillis / fusedMillis << "x" << std::endl;
+    }
+
+    for (auto const& size : sizes)
+    {
+        ipfreely::MotionKernelResult result;
+        cv::Mat                      mask;
+        auto                         frames = MakeFrames(size.height, size.width, 1);
+
+        ipfreely::FusedMotionKernel(
+            frames.prev, frames.current, frames.next, PIXEL_THRESHOLD, result, &mask);
+
+        auto openCvMillis   = TimeLabeller(mask, true);
+        auto labellerMillis = TimeLabeller(mask, false);
+
+        std::cout << std::setw(4) << size.width << "x" << std::setw(4) << std::left
+                  << size.height << std::right << " blobs, OpenCV: " << openCvMillis
+                  << " ms, labeller: " << labellerMillis
+                  << " ms, speed-up: " << openCvMillis / labellerMillis << "x" << std::endl;
+    }
+
+    return allMatch ? 0 : 1;
+}
@@ -0,0 +1,69 @@
+#-------------------------------------------------
+#
+# Headless tool replaying recorded video through
+# the motion detector as fast as it can analyse it.
+#
+#-------------------------------------------------
+
+QT       += core
+QT       -= gui
+
+TARGET = MotionReplay
+TEMPLATE = app
+
+CONFIG += console core_lib c++14
+CONFIG -= app_bundle
+
+DEFINES += CORE_LIBRARY_LIB
+
+INCLUDEPATH += $$PWD/../..
+
+win32 {
+    QMAKE_CXXFLAGS += /wd4251 /wd4275 /wd4100
+    DEFINES += _CRT_SECURE_NO_WARNINGS=1
+
+    INCLUDEPATH += $$(OPENCV_DIR)/../../include \
+        $$(THIRD_PARTY_LIBS)
+
+    CONFIG(debug, debug|release) {
+      LIBS += -L$$(OPENCV_DIR)/lib \
+              -lopencv_world340d
+    } else {
+      LIBS += -L$$(OPENCV_DIR)/lib \
+              -lopencv_world340
+    }
+}
+else {
+    QMAKE_CXXFLAGS += -std=c++14
+
+    INCLUDEPATH += /usr/include/opencv4 \
+        /mnt/Data/projects/ThirdParty
+
+    LIBS += -L/usr/lib   \
+            -lopencv_core      \
+            -lopencv_imgproc   \
+            -lopencv_videoio
+}
+
+SOURCES += \
+    main.cpp \
+    ../../IpFreelyCameraDatabase.cpp \
+    ../../IpFreelyMotionDetector.cpp \
+    ../../IpFreelyWorkerPool.cpp \
+    ../../IpFreelyMotionKernel.cpp \
+    ../../IpFreelyMotionEngine.cpp \
+    ../../IpFreelyFrameDiffEngine.cpp \
+    ../../IpFreelyBackgroundEngine.cpp \
+    ../../IpFreelyMotionBlobs.cpp
+
+HEADERS += \
+    ../../IpFreelyCameraDatabase.h \
+    ../../IpFreelyMotionDetector.h \
+    ../../IpFreelyBoundedQueue.h \
+    ../../IpFreelyWorkerPool.h \
+    ../../IpFreelyMotionKernel.h \
+    ../../IpFreelyMotionEngine.h \
+    ../../IpFreelyFrameDiffEngine.h \
+    ../../IpFreelyBackgroundEngine.h \
+    ../../IpFreelyMotionBlobs.h \
+    ../../IpFreelyMotionPresets.h
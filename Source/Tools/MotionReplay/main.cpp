@@ -0,0 +1,617 @@
+// This file is part of IpFreely application.
+//
+// Copyright (C) 2018, Duncan Crutchley
+// Contact <dac1976github@outlook.com>
+//
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU Lesser General Public License as published
+// by the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License and GNU Lesser General Public License
+// for more details.
+//
+// You should have received a copy of the GNU General Public License
+// and GNU Lesser General Public License along with this program. If
+// not, see <http://www.gnu.org/licenses/>.
+
+
+/*!
+ * \file main.cpp
+ * \brief File containing the motion detection replay tool.
+ *
+ * Replays recorded video files, or directories of them, through the motion detector as fast as it
+ * can analyse them, one frame at a time, and reports the time spent in each stage of analysis,
+ * the analysis frame rate, the allocations made per frame and when motion was detected. Camera
+ * settings come from a sensitivity preset or a camera in IpFreely.db, with optional overrides, so
+ * settings, engines and code changes can be compared on the same footage.
+ *
+ * Frames are decoded by OpenCV so motion vectors are not available, in motion vectors mode the
+ * motion detector falls back to its motion engine.
+ */
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+#include <utility>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+#include <cstdlib>
+#include <cstdint>
+#include <stdexcept>
+#include <QJsonArray>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <boost/filesystem.hpp>
+#include <boost/algorithm/string.hpp>
+#include <boost/exception/all.hpp>
+#include <opencv2/opencv.hpp>
+#include "DebugLog/DebugLogging.h"
+#include "IpFreelyCameraDatabase.h"
+#include "IpFreelyMotionDetector.h"
+#include "IpFreelyMotionPresets.h"
+#include "IpFreelyWorkerPool.h"
+
+namespace bfs = boost::filesystem;
+
+namespace
+{
+
+static constexpr double DEFAULT_VIDEO_FPS = 25.0;
+
+std::atomic<uint64_t> g_heapAllocations{0};
+
+#if CV_VERSION_MAJOR < 4
+typedef int access_flag_t;
+#else
+typedef cv::AccessFlag access_flag_t;
+#endif
+
+/*! \brief Class counting the pixel buffers OpenCV allocates, which don't use operator new. */
+class CountingMatAllocator final : public cv::MatAllocator
+{
+public:
+    cv::UMatData* allocate(int dims, const int* sizes, int type, void* data, size_t* step,
+                           access_flag_t flags, cv::UMatUsageFlags usageFlags) const override
+    {
+        if (data == nullptr)
+        {
+            ++m_allocations;
+        }
+
+        return m_allocator->allocate(dims, sizes, type, data, step, flags, usageFlags);
+    }
+
+    bool allocate(cv::UMatData* data, access_flag_t accessFlags,
+                  cv::UMatUsageFlags usageFlags) const override
+    {
+        return m_allocator->allocate(data, accessFlags, usageFlags);
+    }
+
+    void deallocate(cv::UMatData* data) const override
+    {
+        m_allocator->deallocate(data);
+    }
+
+    uint64_t Allocations() const noexcept
+    {
+        return m_allocations;
+    }
+
+private:
+    cv::MatAllocator*             m_allocator{cv::Mat::getStdAllocator()};
+    mutable std::atomic<uint64_t> m_allocations{0};
+};
+
+/*! \brief Structure holding the tool's options. */
+struct ReplayOptions final
+{
+    ipfreely::IpCamera       camera{};
+    std::vector<std::string> paths{};
+    bool                     json{false};
+};
+
+/*! \brief Structure holding the results of replaying one video file. */
+struct ReplayReport final
+{
+    std::string                            path{};
+    cv::Size                               frameSize{};
+    double                                 videoFps{0.0};
+    double                                 analysisFps{0.0};
+    cv::Size                               analysisFrameSize{};
+    uint64_t                               framesDecoded{0};
+    double                                 decodeMillisecs{0.0};
+    double                                 analysisMillisecs{0.0};
+    ipfreely::MotionStageTimings           stageTimings{};
+    uint64_t                               heapAllocations{0};
+    uint64_t                               matAllocations{0};
+    std::vector<std::pair<double, double>> motionEvents{};
+};
+
+void PrintUsage()
+{
+    std::cout
+        << "Usage: MotionReplay [options] <video file or directory>...\n"
+           "  --camera <1-4>           Use the camera's settings from IpFreely.db in the working\n"
+           "                           directory.\n"
+           "  --mode <low|medium|high> Use a sensitivity preset, medium if no camera is given.\n"
+           "  --engine <diff|background>\n"
+           "                           Motion engine to find motion with.\n"
+           "  --pixel-threshold <n>    Differences at or below this level are ignored.\n"
+           "  --analysis-fps <n>       Rate frames are sampled for analysis, 0 for every frame.\n"
+           "  --shrink                 Shrink video frames for analysis.\n"
+           "  --json                   Print the report as JSON.\n";
+}
+
+void ApplyPreset(std::string const& mode, ipfreely::IpCamera& camera)
+{
+    if (mode == "low")
+    {
+        camera.motionDectorMode           = ipfreely::eMotionDetectorMode::lowSensitivity;
+        camera.pixelThreshold             = ipfreely::LOW_SENSITIVITY_DIFF_THRESHOLD;
+        camera.maxMotionStdDev            = ipfreely::LOW_SENSITIVITY_STDDEV;
+        camera.minMotionAreaPercentFactor = ipfreely::LOW_SENSITIVITY_AREA_PERCENT;
+    }
+    else if (mode == "medium")
+    {
+        camera.motionDectorMode           = ipfreely::eMotionDetectorMode::mediumSensitivity;
+        camera.pixelThreshold             = ipfreely::MEDIUM_SENSITIVITY_DIFF_THRESHOLD;
+        camera.maxMotionStdDev            = ipfreely::MEDIUM_SENSITIVITY_STDDEV;
+        camera.minMotionAreaPercentFactor = ipfreely::MEDIUM_SENSITIVITY_AREA_PERCENT;
+    }
+    else if (mode == "high")
+    {
+        camera.motionDectorMode           = ipfreely::eMotionDetectorMode::highSensitivity;
+        camera.pixelThreshold             = ipfreely::HIGH_SENSITIVITY_DIFF_THRESHOLD;
+        camera.maxMotionStdDev            = ipfreely::HIGH_SENSITIVITY_STDDEV;
+        camera.minMotionAreaPercentFactor = ipfreely::HIGH_SENSITIVITY_AREA_PERCENT;
+    }
+    else
+    {
+        BOOST_THROW_EXCEPTION(std::invalid_argument("unknown mode: " + mode));
+    }
+
+    camera.motionAreaAveFactor = ipfreely::BOUNDING_RECT_SMOOTHING_FACTOR;
+}
+
+bool ParseOptions(int argc, char* argv[], ReplayOptions& options)
+{
+    std::string mode;
+    int         camId = 0;
+
+    std::vector<std::pair<std::string, std::string>> overrides;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+
+        if ((arg == "--help") || (arg == "-h"))
+        {
+            return false;
+        }
+        else if (arg == "--json")
+        {
+            options.json = true;
+        }
+        else if (arg == "--shrink")
+        {
+            overrides.emplace_back(arg, "");
+        }
+        else if (boost::starts_with(arg, "--"))
+        {
+            if (++i == argc)
+            {
+                BOOST_THROW_EXCEPTION(std::invalid_argument("missing value for option: " + arg));
+            }
+
+            if (arg == "--camera")
+            {
+                camId = std::stoi(argv[i]);
+            }
+            else if (arg == "--mode")
+            {
+                mode = argv[i];
+            }
+            else
+            {
+                overrides.emplace_back(arg, argv[i]);
+            }
+        }
+        else
+        {
+            options.paths.emplace_back(arg);
+        }
+    }
+
+    if (options.paths.empty())
+    {
+        return false;
+    }
+
+    if (camId != 0)
+    {
+        auto const cam = static_cast<ipfreely::eCamId>(camId);
+
+        if ((cam < ipfreely::eCamId::cam1) || (cam > ipfreely::eCamId::cam4) ||
+            !ipfreely::IpFreelyCameraDatabase().FindCamera(cam, options.camera))
+        {
+            BOOST_THROW_EXCEPTION(
+                std::invalid_argument("camera not found in IpFreely.db: " + std::to_string(camId)));
+        }
+    }
+
+    if (!mode.empty() || (camId == 0))
+    {
+        ApplyPreset(mode.empty() ? "medium" : mode, options.camera);
+    }
+
+    // Overrides are applied last so they change a camera's settings or a preset alike.
+    for (auto const& option : overrides)
+    {
+        if (option.first == "--shrink")
+        {
+            options.camera.shrinkVideoFrames = true;
+        }
+        else if (option.first == "--engine")
+        {
+            if (option.second == "diff")
+            {
+                options.camera.motionEngine = ipfreely::eMotionEngine::frameDifferencing;
+            }
+            else if (option.second == "background")
+            {
+                options.camera.motionEngine = ipfreely::eMotionEngine::backgroundModel;
+            }
+            else
+            {
+                BOOST_THROW_EXCEPTION(std::invalid_argument("unknown engine: " + option.second));
+            }
+        }
+        else if (option.first == "--pixel-threshold")
+        {
+            options.camera.pixelThreshold = std::stod(option.second);
+        }
+        else if (option.first == "--analysis-fps")
+        {
+            options.camera.motionAnalysisFps = std::max(std::stod(option.second), 0.0);
+        }
+        else
+        {
+            BOOST_THROW_EXCEPTION(std::invalid_argument("unknown option: " + option.first));
+        }
+    }
+
+    if (options.camera.motionDectorMode == ipfreely::eMotionDetectorMode::off)
+    {
+        BOOST_THROW_EXCEPTION(std::invalid_argument("motion detection is off for the camera"));
+    }
+
+    return true;
+}
+
+std::vector<std::string> FindVideoFiles(std::vector<std::string> const& paths)
+{
+    // The extensions the stream processor records with, plus the common MP4 container.
+    static std::vector<std::string> const extensions{".mkv", ".avi", ".mp4"};
+
+    std::vector<std::string> files;
+
+    for (auto const& path : paths)
+    {
+        if (!bfs::is_directory(path))
+        {
+            files.emplace_back(path);
+            continue;
+        }
+
+        std::vector<std::string> directoryFiles;
+
+        for (auto const& entry : bfs::directory_iterator(path))
+        {
+            auto extension = boost::to_lower_copy(entry.path().extension().string());
+
+            if (bfs::is_regular_file(entry.status()) &&
+                (std::find(extensions.begin(), extensions.end(), extension) != extensions.end()))
+            {
+                directoryFiles.emplace_back(entry.path().string());
+            }
+        }
+
+        // Recordings are named by time so sorting replays them in order.
+        std::sort(directoryFiles.begin(), directoryFiles.end());
+        files.insert(files.end(), directoryFiles.begin(), directoryFiles.end());
+    }
+
+    return files;
+}
+
+double MillisecsSince(std::chrono::steady_clock::time_point const& start)
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start)
+        .count();
+}
+
+ReplayReport ReplayFile(std::string const& path, ipfreely::IpCamera const& camera,
+                        std::shared_ptr<ipfreely::IpFreelyWorkerPool> const& workerPool,
+                        CountingMatAllocator const&                          matAllocator)
+{
+    cv::VideoCapture capture(path);
+
+    if (!capture.isOpened())
+    {
+        BOOST_THROW_EXCEPTION(std::runtime_error("failed to open video file: " + path));
+    }
+
+    ReplayReport report;
+    report.path      = path;
+    report.frameSize = cv::Size(static_cast<int>(capture.get(cv::CAP_PROP_FRAME_WIDTH)),
+                                static_cast<int>(capture.get(cv::CAP_PROP_FRAME_HEIGHT)));
+    report.videoFps  = capture.get(cv::CAP_PROP_FPS);
+
+    if (report.videoFps <= 0.0)
+    {
+        report.videoFps = DEFAULT_VIDEO_FPS;
+    }
+
+    ipfreely::IpFreelyMotionDetector detector(bfs::path(path).filename().string(),
+                                              camera,
+                                              report.videoFps,
+                                              report.frameSize.width,
+                                              report.frameSize.height,
+                                              workerPool);
+
+    report.analysisFps       = detector.AnalysisFps();
+    report.analysisFrameSize = detector.AnalysisFrameSize();
+
+    // Frames are given capture times from their position in the video, so the motion
+    // detector's smoothing and post-roll behave as they would have live, and are
+    // sampled for analysis the same way the stream processor samples them.
+    auto const clipStart   = std::chrono::steady_clock::now();
+    auto const framePeriod = std::chrono::duration<double>(
+        (camera.motionAnalysisFps > 0.0) ? 1.0 / report.analysisFps : 0.0);
+
+    std::chrono::duration<double> nextFrameTime{0.0};
+    std::chrono::duration<double> frameTime{0.0};
+    uint64_t                      framesAdded = 0;
+    bool                          inProgress  = false;
+    cv::Mat                       videoFrame;
+
+    while (true)
+    {
+        auto decodeStart = std::chrono::steady_clock::now();
+
+        if (!capture.read(videoFrame))
+        {
+            break;
+        }
+
+        report.decodeMillisecs += MillisecsSince(decodeStart);
+        frameTime = std::chrono::duration<double>(
+            static_cast<double>(report.framesDecoded++) / report.videoFps);
+
+        if (frameTime < nextFrameTime)
+        {
+            continue;
+        }
+
+        nextFrameTime += framePeriod;
+
+        if (nextFrameTime <= frameTime)
+        {
+            nextFrameTime = frameTime + framePeriod;
+        }
+
+        auto heapAllocations = g_heapAllocations.load();
+        auto matAllocations  = matAllocator.Allocations();
+        auto analysisStart   = std::chrono::steady_clock::now();
+
+        // Only one frame is analysed at a time so none are dropped and the
+        // decoder can reuse the frame's buffer once it has been analysed.
+        detector.AddNextFrame(
+            videoFrame,
+            clipStart + std::chrono::duration_cast<std::chrono::steady_clock::duration>(frameTime));
+        ++framesAdded;
+
+        while (detector.FramesAnalysed() < framesAdded)
+        {
+            std::this_thread::yield();
+        }
+
+        report.analysisMillisecs += MillisecsSince(analysisStart);
+        report.heapAllocations += g_heapAllocations - heapAllocations;
+        report.matAllocations += matAllocator.Allocations() - matAllocations;
+
+        if (detector.MotionInProgress() != inProgress)
+        {
+            inProgress = !inProgress;
+
+            if (inProgress)
+            {
+                report.motionEvents.emplace_back(frameTime.count(), frameTime.count());
+            }
+            else
+            {
+                report.motionEvents.back().second = frameTime.count();
+            }
+        }
+    }
+
+    // Motion still in progress at the end of the video ends with it.
+    if (inProgress)
+    {
+        report.motionEvents.back().second = frameTime.count();
+    }
+
+    report.stageTimings = detector.StageTimings();
+
+    return report;
+}
+
+double PerFrame(double const total, uint64_t const frames)
+{
+    return (frames > 0) ? total / static_cast<double>(frames) : 0.0;
+}
+
+void PrintReport(ReplayReport const& report)
+{
+    auto const& timings = report.stageTimings;
+
+    std::cout << report.path << "\n"
+              << "  video: " << report.frameSize.width << "x" << report.frameSize.height << " @ "
+              << report.videoFps << " FPS, analysing: " << report.analysisFrameSize.width << "x"
+              << report.analysisFrameSize.height << " @ " << report.analysisFps << " FPS\n"
+              << "  frames decoded: " << report.framesDecoded
+              << ", analysed: " << timings.frames << ", decode: "
+              << PerFrame(report.decodeMillisecs, report.framesDecoded) << " ms/frame\n"
+              << "  analysis: " << PerFrame(report.analysisMillisecs, timings.frames)
+              << " ms/frame, "
+              << ((report.analysisMillisecs > 0.0)
+                      ? 1000.0 * static_cast<double>(timings.frames) / report.analysisMillisecs
+                      : 0.0)
+              << " FPS\n"
+              << "  stages (ms/frame), resize: "
+              << PerFrame(timings.resizeMillisecs, timings.frames)
+              << ", grey: " << PerFrame(timings.greyMillisecs, timings.frames)
+              << ", engine: " << PerFrame(timings.engineMillisecs, timings.frames)
+              << ", blobs: " << PerFrame(timings.blobsMillisecs, timings.frames) << "\n"
+              << "  allocations (per frame), heap: "
+              << PerFrame(static_cast<double>(report.heapAllocations), timings.frames)
+              << ", pixel buffers: "
+              << PerFrame(static_cast<double>(report.matAllocations), timings.frames) << "\n"
+              << "  motion events: " << report.motionEvents.size() << "\n";
+
+    for (auto const& event : report.motionEvents)
+    {
+        std::cout << "    " << event.first << " s - " << event.second << " s\n";
+    }
+}
+
+QJsonObject ReportToJson(ReplayReport const& report)
+{
+    auto const& timings = report.stageTimings;
+
+    QJsonObject stages;
+    stages["resizeMillisecs"] = PerFrame(timings.resizeMillisecs, timings.frames);
+    stages["greyMillisecs"]   = PerFrame(timings.greyMillisecs, timings.frames);
+    stages["engineMillisecs"] = PerFrame(timings.engineMillisecs, timings.frames);
+    stages["blobsMillisecs"]  = PerFrame(timings.blobsMillisecs, timings.frames);
+
+    QJsonArray events;
+
+    for (auto const& event : report.motionEvents)
+    {
+        QJsonObject motionEvent;
+        motionEvent["startSecs"] = event.first;
+        motionEvent["endSecs"]   = event.second;
+        events.append(motionEvent);
+    }
+
+    // JSON numbers are doubles, as are the per frame averages.
+    QJsonObject json;
+    json["path"]              = QString::fromStdString(report.path);
+    json["width"]             = report.frameSize.width;
+    json["height"]            = report.frameSize.height;
+    json["videoFps"]          = report.videoFps;
+    json["analysisWidth"]     = report.analysisFrameSize.width;
+    json["analysisHeight"]    = report.analysisFrameSize.height;
+    json["analysisFps"]       = report.analysisFps;
+    json["framesDecoded"]     = static_cast<double>(report.framesDecoded);
+    json["framesAnalysed"]    = static_cast<double>(timings.frames);
+    json["decodeMillisecs"]   = PerFrame(report.decodeMillisecs, report.framesDecoded);
+    json["analysisMillisecs"] = PerFrame(report.analysisMillisecs, timings.frames);
+    json["stages"]            = stages;
+    json["heapAllocations"] =
+        PerFrame(static_cast<double>(report.heapAllocations), timings.frames);
+    json["pixelBufferAllocations"] =
+        PerFrame(static_cast<double>(report.matAllocations), timings.frames);
+    json["motionEvents"] = events;
+    return json;
+}
+
+} // namespace
+
+// Counts every heap allocation made with operator new, on any thread.
+void* operator new(std::size_t size)
+{
+    ++g_heapAllocations;
+
+    if (auto p = std::malloc(size > 0 ? size : 1))
+    {
+        return p;
+    }
+
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+    std::free(p);
+}
+
+int main(int argc, char* argv[])
+{
+    int retCode = EXIT_SUCCESS;
+
+    try
+    {
+        ReplayOptions options;
+
+        if (!ParseOptions(argc, argv, options))
+        {
+            PrintUsage();
+            return EXIT_FAILURE;
+        }
+
+        // The motion detector's log messages go to the log file rather than the report.
+        DEBUG_MESSAGE_INSTANTIATE_EX("1.0", "", "MotionReplay", core_lib::log::BYTES_IN_MEBIBYTE);
+
+        CountingMatAllocator matAllocator;
+        cv::Mat::setDefaultAllocator(&matAllocator);
+
+        auto workerPool = std::make_shared<ipfreely::IpFreelyWorkerPool>("replay", 1);
+
+        QJsonArray reports;
+
+        std::cout << std::fixed << std::setprecision(3);
+
+        for (auto const& file : FindVideoFiles(options.paths))
+        {
+            auto report = ReplayFile(file, options.camera, workerPool, matAllocator);
+
+            if (options.json)
+            {
+                reports.append(ReportToJson(report));
+            }
+            else
+            {
+                PrintReport(report);
+            }
+        }
+
+        cv::Mat::setDefaultAllocator(nullptr);
+
+        if (options.json)
+        {
+            std::cout << QJsonDocument(reports).toJson().toStdString();
+        }
+    }
+    catch (...)
+    {
+        std::cerr << boost::current_exception_diagnostic_information() << std::endl;
+        retCode = EXIT_FAILURE;
+    }
+
+    return retCode;
+}